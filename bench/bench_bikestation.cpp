@@ -0,0 +1,442 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+// Microbenchmarks of the station implementations.
+//
+// Usage: bench_bikestation [--threads 1,2,4,...] [--ms duration per case]
+//                          [--impl name] [--scenario name]
+//
+// Every case (implementation, scenario, number of threads) prints one JSON
+// object per line on stdout:
+//   {"impl":"bikestation","scenario":"putget","threads":4,"ops":...,
+//    "seconds":...,"ops_per_s":...,"p50_ns":...,"p95_ns":...,"p99_ns":...,
+//    "p999_ns":...,"max_ns":...}
+// Latencies are per operation (one putBike, one getBike, one batch or one
+// nbBikes() read, depending on the scenario).
+
+#include "bikestation.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pcosynchro/pcomutex.h>
+#include <pcosynchro/pcoconditionvariable.h>
+#include <pcosynchro/pcothread.h>
+
+/**
+ * @brief What the benchmark needs from a station, so that implementations
+ *        can be compared on the same scenarios.
+ */
+class StationUnderTest
+{
+public:
+    virtual ~StationUnderTest() = default;
+    virtual void putBike(Bike* _bike) = 0;
+    virtual Bike* getBike(size_t _type) = 0;
+    virtual std::vector<Bike*> addBikes(std::vector<Bike*> _bikes) = 0;
+    virtual std::vector<Bike*> getBikes(size_t _nbBikes) = 0;
+    virtual size_t nbBikes() = 0;
+    virtual void ending() = 0;
+};
+
+class BikeStationUnderTest : public StationUnderTest
+{
+public:
+    explicit BikeStationUnderTest(size_t _capacity) : station((int)_capacity) {}
+    void putBike(Bike* _bike) override { station.putBike(_bike); }
+    Bike* getBike(size_t _type) override { return station.getBike(_type); }
+    std::vector<Bike*> addBikes(std::vector<Bike*> _bikes) override { return station.addBikes(_bikes); }
+    std::vector<Bike*> getBikes(size_t _nbBikes) override { return station.getBikes(_nbBikes); }
+    size_t nbBikes() override { return station.nbBikes(); }
+    void ending() override { station.ending(); }
+
+private:
+    BikeStation station;
+};
+
+/**
+ * @brief Reference: one list of bikes, one mutex and one condition for
+ *        everybody, every change wakes every waiting thread.
+ */
+class NaiveStation : public StationUnderTest
+{
+public:
+    explicit NaiveStation(size_t _capacity) : capacity(_capacity) {}
+
+    void putBike(Bike* _bike) override {
+        mutex.lock();
+        while (!shouldEnd && bikes.size() >= capacity) changed.wait(&mutex);
+        if (!shouldEnd) bikes.push_back(_bike);
+        changed.notifyAll();
+        mutex.unlock();
+    }
+
+    Bike* getBike(size_t _type) override {
+        mutex.lock();
+        Bike* bike = nullptr;
+        while (!shouldEnd && !(bike = take(_type))) changed.wait(&mutex);
+        changed.notifyAll();
+        mutex.unlock();
+        return bike;
+    }
+
+    std::vector<Bike*> addBikes(std::vector<Bike*> _bikes) override {
+        std::vector<Bike*> rejected;
+        mutex.lock();
+        for (Bike* bike : _bikes) {
+            while (!shouldEnd && bikes.size() >= capacity) changed.wait(&mutex);
+            if (shouldEnd) rejected.push_back(bike);
+            else bikes.push_back(bike);
+        }
+        changed.notifyAll();
+        mutex.unlock();
+        return rejected;
+    }
+
+    std::vector<Bike*> getBikes(size_t _nbBikes) override {
+        mutex.lock();
+        size_t n = std::min(_nbBikes, bikes.size());
+        std::vector<Bike*> result(bikes.begin(), bikes.begin() + n);
+        bikes.erase(bikes.begin(), bikes.begin() + n);
+        changed.notifyAll();
+        mutex.unlock();
+        return result;
+    }
+
+    size_t nbBikes() override {
+        mutex.lock();
+        size_t n = bikes.size();
+        mutex.unlock();
+        return n;
+    }
+
+    void ending() override {
+        mutex.lock();
+        shouldEnd = true;
+        changed.notifyAll();
+        mutex.unlock();
+    }
+
+private:
+    Bike* take(size_t _type) {
+        for (auto it = bikes.begin(); it != bikes.end(); ++it) {
+            if ((*it)->bikeType == _type) {
+                Bike* bike = *it;
+                bikes.erase(it);
+                return bike;
+            }
+        }
+        return nullptr;
+    }
+
+    const size_t capacity;
+    PcoMutex mutex;
+    PcoConditionVariable changed;
+    std::vector<Bike*> bikes;
+    bool shouldEnd = false;
+};
+
+struct Implementation
+{
+    const char* name;
+    std::function<std::unique_ptr<StationUnderTest>(size_t)> make;
+};
+
+static const Implementation IMPLEMENTATIONS[] = {
+    {"bikestation", [](size_t c) { return std::make_unique<BikeStationUnderTest>(c); }},
+    {"naive", [](size_t c) { return std::make_unique<NaiveStation>(c); }},
+};
+
+/**
+ * @brief Log-linear latency histogram (16 buckets per power of two),
+ *        one per thread, merged at the end.
+ */
+class LatencyHistogram
+{
+public:
+    void add(uint64_t _ns) {
+        counts[bucket(_ns)]++;
+        maxNs = std::max(maxNs, _ns);
+    }
+
+    void merge(const LatencyHistogram& _other) {
+        for (size_t b = 0; b < NB_BUCKETS; ++b) counts[b] += _other.counts[b];
+        maxNs = std::max(maxNs, _other.maxNs);
+    }
+
+    // Lower bound of the bucket holding the given fraction of the samples
+    uint64_t percentile(double _fraction) const {
+        uint64_t total = 0;
+        for (uint64_t count : counts) total += count;
+        uint64_t rank = (uint64_t)(_fraction * total), seen = 0;
+        for (size_t b = 0; b < NB_BUCKETS; ++b) {
+            seen += counts[b];
+            if (seen > rank) return lowerBound(b);
+        }
+        return maxNs;
+    }
+
+    uint64_t max() const { return maxNs; }
+
+private:
+    static const size_t SUB = 16;
+    static const size_t NB_BUCKETS = SUB * 61;
+
+    static size_t bucket(uint64_t _ns) {
+        if (_ns < SUB) return _ns;
+        unsigned int exp = 63 - __builtin_clzll(_ns); // >= 4
+        return (exp - 3) * SUB + ((_ns >> (exp - 4)) & (SUB - 1));
+    }
+
+    static uint64_t lowerBound(size_t _bucket) {
+        if (_bucket < SUB) return _bucket;
+        unsigned int exp = _bucket / SUB + 3;
+        return (1ULL << exp) | ((uint64_t)(_bucket % SUB) << (exp - 4));
+    }
+
+    std::array<uint64_t, NB_BUCKETS> counts{};
+    uint64_t maxNs = 0;
+};
+
+/**
+ * @brief State shared by the threads of one case.
+ */
+struct Run
+{
+    StationUnderTest* station;
+    unsigned int nbThreads;
+    std::atomic<unsigned int> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<bool> stop{false};
+};
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t nsSince(Clock::time_point _start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _start).count();
+}
+
+/**
+ * @brief A scenario: prepares the station, then runs one body per thread.
+ *
+ * The body loops until Run::stop and records one latency per operation;
+ * it must return when the station is ending. Each thread also gets a bike
+ * of type 0 of its own, outside of the station.
+ */
+struct Scenario
+{
+    const char* name;
+    size_t (*capacity)(unsigned int _threads);
+    std::vector<Bike*> (*stock)(unsigned int _threads, std::vector<std::unique_ptr<Bike>>& _owner);
+    void (*body)(Run& _run, unsigned int _thread, Bike* _spare, LatencyHistogram& _latency,
+                 uint64_t& _ops);
+};
+
+static Bike* newBike(size_t _type, std::vector<std::unique_ptr<Bike>>& _owner) {
+    _owner.push_back(std::make_unique<Bike>());
+    _owner.back()->bikeType = _type;
+    return _owner.back().get();
+}
+
+static std::vector<Bike*> stockOf(size_t _n, std::vector<std::unique_ptr<Bike>>& _owner,
+                                  size_t _types = Bike::nbBikeTypes) {
+    std::vector<Bike*> bikes;
+    for (size_t i = 0; i < _n; ++i) bikes.push_back(newBike(i % _types, _owner));
+    return bikes;
+}
+
+// One getBike() and one putBike() per iteration, on a half-full station
+static void putGet(Run& _run, unsigned int _thread, Bike*, LatencyHistogram& _latency,
+                   uint64_t& _ops) {
+    size_t type = _thread % Bike::nbBikeTypes;
+    while (!_run.stop.load(std::memory_order_relaxed)) {
+        auto start = Clock::now();
+        Bike* bike = _run.station->getBike(type);
+        _latency.add(nsSince(start));
+        if (!bike) return;
+        start = Clock::now();
+        _run.station->putBike(bike);
+        _latency.add(nsSince(start));
+        _ops += 2;
+    }
+}
+
+// Batches of 8 bikes taken then added back
+static void batch(Run& _run, unsigned int, Bike*, LatencyHistogram& _latency, uint64_t& _ops) {
+    while (!_run.stop.load(std::memory_order_relaxed)) {
+        auto start = Clock::now();
+        std::vector<Bike*> bikes = _run.station->getBikes(8);
+        _latency.add(nsSince(start));
+        start = Clock::now();
+        if (!_run.station->addBikes(bikes).empty()) return; // ending
+        _latency.add(nsSince(start));
+        _ops += 2;
+    }
+}
+
+// One slot for every thread holding a bike: each put waits for a full
+// station to empty, each get for an empty station to fill
+static void handoff(Run& _run, unsigned int, Bike* _spare, LatencyHistogram& _latency,
+                    uint64_t& _ops) {
+    Bike* bike = _spare;
+    while (!_run.stop.load(std::memory_order_relaxed)) {
+        auto start = Clock::now();
+        _run.station->putBike(bike);
+        _latency.add(nsSince(start));
+        start = Clock::now();
+        bike = _run.station->getBike(0);
+        _latency.add(nsSince(start));
+        if (!bike) return;
+        _ops += 2;
+    }
+}
+
+// Threads of every type on a station where the last type is scarce
+static void mixed(Run& _run, unsigned int _thread, Bike* _spare, LatencyHistogram& _latency,
+                  uint64_t& _ops) {
+    putGet(_run, _thread, _spare, _latency, _ops);
+}
+
+// Half of the threads read nbBikes() while the others take and return bikes;
+// only the reads are measured
+static void readers(Run& _run, unsigned int _thread, Bike* _spare, LatencyHistogram& _latency,
+                    uint64_t& _ops) {
+    if (_thread < _run.nbThreads / 2) {
+        LatencyHistogram ignored;
+        uint64_t ignoredOps = 0;
+        putGet(_run, _thread, _spare, ignored, ignoredOps);
+        return;
+    }
+    volatile size_t sink = 0;
+    while (!_run.stop.load(std::memory_order_relaxed)) {
+        auto start = Clock::now();
+        sink = _run.station->nbBikes();
+        _latency.add(nsSince(start));
+        _ops++;
+    }
+    (void)sink;
+}
+
+static const Scenario SCENARIOS[] = {
+    {"putget",
+     [](unsigned int t) { return (size_t)4 * t + 6; },
+     [](unsigned int t, std::vector<std::unique_ptr<Bike>>& o) { return stockOf(2 * t + 3, o); },
+     putGet},
+    {"batch",
+     [](unsigned int t) { return (size_t)16 * t; },
+     [](unsigned int t, std::vector<std::unique_ptr<Bike>>& o) { return stockOf(8 * t, o); },
+     batch},
+    {"handoff",
+     [](unsigned int) { return (size_t)1; },
+     [](unsigned int, std::vector<std::unique_ptr<Bike>>&) { return std::vector<Bike*>(); },
+     handoff},
+    {"mixed",
+     [](unsigned int t) { return (size_t)4 * t + 6; },
+     [](unsigned int t, std::vector<std::unique_ptr<Bike>>& o) {
+         std::vector<Bike*> bikes = stockOf(2 * t + 2, o, Bike::nbBikeTypes - 1);
+         bikes.push_back(newBike(Bike::nbBikeTypes - 1, o)); // a single bike of the last type
+         return bikes;
+     },
+     mixed},
+    {"readers",
+     [](unsigned int t) { return (size_t)4 * t + 6; },
+     [](unsigned int t, std::vector<std::unique_ptr<Bike>>& o) { return stockOf(2 * t + 3, o); },
+     readers},
+};
+
+static void runCase(const Implementation& _impl, const Scenario& _scenario, unsigned int _threads,
+                    unsigned int _ms) {
+    std::vector<std::unique_ptr<Bike>> owner;
+    std::unique_ptr<StationUnderTest> station = _impl.make(_scenario.capacity(_threads));
+    station->addBikes(_scenario.stock(_threads, owner));
+
+    Run run;
+    run.station = station.get();
+    run.nbThreads = _threads;
+    std::vector<LatencyHistogram> latencies(_threads);
+    std::vector<uint64_t> ops(_threads, 0);
+    std::vector<Bike*> spares;
+    for (unsigned int i = 0; i < _threads; ++i) spares.push_back(newBike(0, owner));
+
+    std::vector<std::unique_ptr<PcoThread>> threads;
+    for (unsigned int i = 0; i < _threads; ++i) {
+        threads.push_back(std::make_unique<PcoThread>([&, i]() {
+            run.ready.fetch_add(1);
+            while (!run.go.load()) std::this_thread::yield();
+            _scenario.body(run, i, spares[i], latencies[i], ops[i]);
+        }));
+    }
+    while (run.ready.load() < _threads) std::this_thread::yield();
+    auto start = Clock::now();
+    run.go = true;
+    PcoThread::usleep((uint64_t)_ms * 1000);
+    run.stop = true;
+    double seconds = nsSince(start) / 1e9;
+    station->ending(); // releases the blocked threads
+    for (auto& thread : threads) thread->join();
+
+    LatencyHistogram total;
+    uint64_t totalOps = 0;
+    for (unsigned int i = 0; i < _threads; ++i) {
+        total.merge(latencies[i]);
+        totalOps += ops[i];
+    }
+    std::printf("{\"impl\":\"%s\",\"scenario\":\"%s\",\"threads\":%u,\"ops\":%llu,\"seconds\":%.3f,"
+                "\"ops_per_s\":%.0f,\"p50_ns\":%llu,\"p95_ns\":%llu,\"p99_ns\":%llu,"
+                "\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+                _impl.name, _scenario.name, _threads, (unsigned long long)totalOps, seconds,
+                totalOps / seconds, (unsigned long long)total.percentile(0.50),
+                (unsigned long long)total.percentile(0.95), (unsigned long long)total.percentile(0.99),
+                (unsigned long long)total.percentile(0.999), (unsigned long long)total.max());
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<unsigned int> threadCounts = {1, 2, 4, 8, 16, 32, 64};
+    unsigned int ms = 200;
+    const char* implName = nullptr;
+    const char* scenarioName = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCounts.clear();
+            for (char* item = std::strtok(argv[++i], ","); item; item = std::strtok(nullptr, ",")) {
+                threadCounts.push_back(std::max(1, std::atoi(item)));
+            }
+        } else if (std::strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            ms = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--impl") == 0 && i + 1 < argc) {
+            implName = argv[++i];
+        } else if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+            scenarioName = argv[++i];
+        } else {
+            std::fprintf(stderr, "Usage: %s [--threads 1,2,4,...] [--ms duration per case] "
+                                 "[--impl name] [--scenario name]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (const Scenario& scenario : SCENARIOS) {
+        if (scenarioName && std::strcmp(scenarioName, scenario.name) != 0) continue;
+        for (const Implementation& impl : IMPLEMENTATIONS) {
+            if (implName && std::strcmp(implName, impl.name) != 0) continue;
+            for (unsigned int threads : threadCounts) {
+                runCase(impl, scenario, threads, ms);
+            }
+        }
+    }
+    return 0;
+}
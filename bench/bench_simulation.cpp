@@ -0,0 +1,335 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+// Scalability benchmark of the whole headless simulation (riders, vans,
+// optimizer, repair shop, stations) with every simulated delay removed.
+//
+// Usage: bench_simulation [--riders 10,100,...] [--cpus 1,2,...] [--ms duration]
+//                         [--runs count] [--baseline results] [--threshold fraction]
+//
+// The number of sites is fixed at compile time (config.h): the build makes
+// one bench_simulation_<sites> per site count (BENCH_SITES in CMake). Each
+// case (riders, cpus) runs <runs> times (default 3), each time in its own
+// process restricted to <cpus> cores, and prints one JSON object per line
+// with the measures of the median run:
+//   {"sites":8,"riders":100,"cpus":2,"runs":3,"trips":...,"seconds":...,
+//    "trips_per_s":...,"trips_per_s_min":...,"trips_per_s_max":...,"cpu_util":...,
+//    "voluntary_switches":...,"involuntary_switches":...,"peak_rss_kb":...}
+// Riders wait for their own bike type, so a run may stall until the van
+// brings one: the spread between runs is part of the result.
+// The output of a previous run can serve as baseline: a case whose throughput
+// falls more than <threshold> (default 0.1) below the baseline case with the
+// same sites, riders and cpus fails the run (exit status 1).
+
+#include "bikestation.h"
+#include "citymodel.h"
+#include "config.h"
+#include "eventlog.h"
+#include "metrics.h"
+#include "person.h"
+#include "rebalanceoptimizer.h"
+#include "repairshop.h"
+#include "simgate.h"
+#include "simulation.h"
+#include "simtime.h"
+#include "van.h"
+#include "vanfleet.h"
+
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pcosynchro/pcothread.h>
+
+/**
+ * @brief Measures of one case, sent by the process that ran it.
+ */
+struct CaseResult
+{
+    uint64_t trips;
+    double seconds;
+    double cpuSeconds;
+    uint64_t voluntarySwitches;
+    uint64_t involuntarySwitches;
+    uint64_t peakRssKb;
+};
+
+static double seconds(const timeval& _time) {
+    return _time.tv_sec + _time.tv_usec / 1e6;
+}
+
+// City of NBSITES sites of BORNES slots holding BORNES - 2 bikes each, plus
+// as many bikes again in the depots
+static void benchCity(CityModel& _model, unsigned int _riders) {
+    CityModelHeader header{CITY_MODEL_MAGIC, CITY_MODEL_VERSION, NBSITES, NBDEPOTS,
+                           Bike::nbBikeTypes, _riders, NB_VANS, 0, {}};
+    std::vector<CitySiteRecord> sites(NB_SITES_TOTAL);
+    size_t stocked = 0;
+    for (size_t s = 0; s < NBSITES; ++s) {
+        SitePosition p = sitePosition(s, NBSITES, NBDEPOTS);
+        sites[s] = {(float)p.x, (float)p.y, (uint32_t)BORNES, {}};
+        for (size_t k = 0; k < BORNES - 2; ++k, ++stocked) {
+            sites[s].stock[stocked % Bike::nbBikeTypes]++;
+        }
+    }
+    for (size_t d = NBSITES; d < NB_SITES_TOTAL; ++d) {
+        SitePosition p = sitePosition(d, NBSITES, NBDEPOTS);
+        sites[d] = {(float)p.x, (float)p.y, (uint32_t)(2 * stocked), {}};
+    }
+    for (size_t i = 0; i < 2 * stocked; ++i) {
+        header.fleet[i % Bike::nbBikeTypes]++;
+    }
+
+    std::string error;
+    if (!_model.assign(header, sites, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        std::exit(1);
+    }
+}
+
+// Runs one case in the calling (child) process
+static CaseResult runCase(unsigned int _riders, unsigned int _cpus, unsigned int _ms) {
+    cpu_set_t allowed, used;
+    CPU_ZERO(&used);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (int cpu = 0, n = 0; cpu < CPU_SETSIZE && n < (int)_cpus; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            CPU_SET(cpu, &used);
+            n++;
+        }
+    }
+    sched_setaffinity(0, sizeof(used), &used); // inherited by every thread started below
+
+    setTimeCompressed(true);
+
+    CityModel city;
+    benchCity(city, _riders);
+    std::array<BikeStation*, NB_SITES_TOTAL> stations;
+    std::vector<BikeStation*> built = buildStations(city);
+    std::copy(built.begin(), built.end(), stations.begin());
+    for (size_t s = 0; s < NBSITES; ++s) {
+        stations[s]->setTargetLevel(stations[s]->nbSlots() - 2);
+    }
+
+    globalEventLog.addSink(std::make_unique<NullLogSink>());
+    PcoThread loggerThread(&EventLog::run, &globalEventLog);
+
+    Person::setStations(stations);
+    Van::setStations(stations);
+    RebalanceOptimizer optimizer(stations);
+    Van::setOptimizer(&optimizer);
+    RepairShop repairShop(stations[DEPOT_ID]);
+    Van::setRepairShop(&repairShop);
+
+    globalStations = &stations;
+    globalOptimizer = &optimizer;
+    globalRepairShop = &repairShop;
+
+    std::vector<std::unique_ptr<PcoThread>> threads;
+    threads.emplace_back(std::make_unique<PcoThread>(&RebalanceOptimizer::run, &optimizer));
+    for (size_t w = 0; w < NB_REPAIR_WORKERS; ++w) {
+        globalGate.join();
+        threads.emplace_back(std::make_unique<PcoThread>(&RepairShop::workerRun, &repairShop));
+    }
+    VanFleet vanFleet;
+    vanFleet.setCount(city.nbVans());
+    std::vector<std::unique_ptr<Person>> persons;
+    for (unsigned int i = 1; i <= _riders; ++i) {
+        persons.push_back(std::make_unique<Person>(i));
+        globalGate.join();
+        threads.emplace_back(std::make_unique<PcoThread>(&Person::run, persons.back().get()));
+    }
+
+    // Warm-up, then the measured window
+    PcoThread::usleep((uint64_t)_ms * 100);
+    rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    uint64_t tripsBefore = globalMetrics.tripsCompleted.load();
+    auto start = std::chrono::steady_clock::now();
+    PcoThread::usleep((uint64_t)_ms * 1000);
+    uint64_t trips = globalMetrics.tripsCompleted.load() - tripsBefore;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    getrusage(RUSAGE_SELF, &after);
+
+    // Same shutdown as the application
+    stopSimulation();
+    for (auto& thread : threads) thread->join();
+    vanFleet.joinAll();
+    globalEventLog.requestStop();
+    loggerThread.join();
+
+    return {trips, elapsed,
+            seconds(after.ru_utime) + seconds(after.ru_stime)
+                - seconds(before.ru_utime) - seconds(before.ru_stime),
+            (uint64_t)(after.ru_nvcsw - before.ru_nvcsw),
+            (uint64_t)(after.ru_nivcsw - before.ru_nivcsw), (uint64_t)after.ru_maxrss};
+}
+
+// Runs a case in a child process, so that every case starts from a fresh
+// simulation and has its own peak memory
+static bool forkCase(unsigned int _riders, unsigned int _cpus, unsigned int _ms, CaseResult& _result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::perror("pipe");
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::perror("fork");
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        CaseResult result = runCase(_riders, _cpus, _ms);
+        _exit(write(fds[1], &result, sizeof(result)) == sizeof(result) ? 0 : 1);
+    }
+    close(fds[1]);
+    bool ok = read(fds[0], &_result, sizeof(_result)) == sizeof(_result);
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Throughput of a case of a previous run.
+ */
+struct BaselineCase
+{
+    unsigned long sites, riders, cpus;
+    double tripsPerSecond;
+};
+
+// Value of a numeric field of a JSON line, false if absent
+static bool field(const std::string& _line, const char* _key, double& _value) {
+    std::string pattern = std::string("\"") + _key + "\":";
+    size_t pos = _line.find(pattern);
+    if (pos == std::string::npos) return false;
+    _value = std::strtod(_line.c_str() + pos + pattern.size(), nullptr);
+    return true;
+}
+
+static bool readBaseline(const char* _path, std::vector<BaselineCase>& _cases) {
+    std::ifstream in(_path);
+    if (!in.is_open()) {
+        std::perror(_path);
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        double sites, riders, cpus, rate;
+        if (field(line, "sites", sites) && field(line, "riders", riders) && field(line, "cpus", cpus)
+            && field(line, "trips_per_s", rate)) {
+            _cases.push_back({(unsigned long)sites, (unsigned long)riders, (unsigned long)cpus, rate});
+        }
+    }
+    return true;
+}
+
+static std::vector<unsigned int> parseList(char* _list) {
+    std::vector<unsigned int> values;
+    for (char* item = std::strtok(_list, ","); item; item = std::strtok(nullptr, ",")) {
+        values.push_back(std::max(1, std::atoi(item)));
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    unsigned int nbCpus = CPU_COUNT(&allowed);
+
+    std::vector<unsigned int> riders = {10, 100, 1000};
+    std::vector<unsigned int> cpus;
+    for (unsigned int c = 1; c < nbCpus; c *= 2) cpus.push_back(c);
+    cpus.push_back(nbCpus);
+    unsigned int ms = 2000;
+    unsigned int runs = 3;
+    const char* baselinePath = nullptr;
+    double threshold = 0.1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--riders") == 0 && i + 1 < argc) {
+            riders = parseList(argv[++i]);
+        } else if (std::strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            cpus = parseList(argv[++i]);
+        } else if (std::strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            ms = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = std::atof(argv[++i]);
+        } else {
+            std::fprintf(stderr, "Usage: %s [--riders 10,100,...] [--cpus 1,2,...] [--ms duration] "
+                                 "[--runs count] [--baseline results] [--threshold fraction]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<BaselineCase> baseline;
+    if (baselinePath && !readBaseline(baselinePath, baseline)) {
+        return 2;
+    }
+
+    int ret = 0;
+    for (unsigned int r : riders) {
+        for (unsigned int c : cpus) {
+            c = std::min(c, nbCpus);
+            std::vector<CaseResult> results;
+            for (unsigned int run = 0; run < runs; ++run) {
+                CaseResult result;
+                if (forkCase(r, c, ms, result)) {
+                    results.push_back(result);
+                } else {
+                    std::fprintf(stderr, "Case riders=%u cpus=%u failed\n", r, c);
+                    ret = 1;
+                }
+            }
+            if (results.empty()) continue;
+            std::sort(results.begin(), results.end(), [](const CaseResult& a, const CaseResult& b) {
+                return a.trips / a.seconds < b.trips / b.seconds;
+            });
+            const CaseResult& result = results[results.size() / 2];
+            double rate = result.trips / result.seconds;
+            std::printf("{\"sites\":%zu,\"riders\":%u,\"cpus\":%u,\"runs\":%zu,\"trips\":%llu,"
+                        "\"seconds\":%.3f,\"trips_per_s\":%.0f,\"trips_per_s_min\":%.0f,"
+                        "\"trips_per_s_max\":%.0f,\"cpu_util\":%.3f,\"voluntary_switches\":%llu,"
+                        "\"involuntary_switches\":%llu,\"peak_rss_kb\":%llu}\n",
+                        NBSITES, r, c, results.size(), (unsigned long long)result.trips, result.seconds,
+                        rate, results.front().trips / results.front().seconds,
+                        results.back().trips / results.back().seconds,
+                        result.cpuSeconds / (result.seconds * c),
+                        (unsigned long long)result.voluntarySwitches,
+                        (unsigned long long)result.involuntarySwitches,
+                        (unsigned long long)result.peakRssKb);
+            std::fflush(stdout);
+
+            for (const BaselineCase& reference : baseline) {
+                if (reference.sites == NBSITES && reference.riders == r && reference.cpus == c
+                    && rate < reference.tripsPerSecond * (1 - threshold)) {
+                    std::fprintf(stderr, "Regression: sites=%zu riders=%u cpus=%u: %.0f trips/s, "
+                                         "baseline %.0f trips/s\n",
+                                 NBSITES, r, c, rate, reference.tripsPerSecond);
+                    ret = 1;
+                }
+            }
+        }
+    }
+    return ret;
+}
@@ -6,8 +6,8 @@
 /**
  * @brief Represents a bike with a given type.
  *
- * A bike is characterized only by its type. The type is encoded as an index
- * in the range [0, nbBikeTypes).
+ * A bike is characterized by its type, encoded as an index in the range
+ * [0, nbBikeTypes), and by its maintenance state.
  */
 class Bike
 {
@@ -19,6 +19,16 @@ public:
      */
     size_t bikeType;
 
+    /**
+     * @brief Wear accumulated since the last repair (one unit per trip).
+     */
+    unsigned int wear = 0;
+
+    /**
+     * @brief True if the bike is broken and must be repaired before being ridden.
+     */
+    bool broken = false;
+
     /**
      * @brief Total number of supported bike types.
      *
@@ -6,17 +6,68 @@
 #include <deque>
 #include <queue>
 #include <mutex>
+#include <atomic>
+#include <cstdint>
 
 #include <pcosynchro/pcomutex.h>
 #include <pcosynchro/pcoconditionvariable.h>
 
 #include "bike.h"
+#include "occupancyhistory.h"
+#include "lockprofiler.h"
+
+/**
+ * @brief Rider demand observed at a station since the last collection.
+ *
+ * Only rider operations (getBike() and putBike()) are counted; van transfers
+ * through addBikes() and getBikes() are not demand.
+ */
+struct DemandCounters
+{
+    std::array<size_t, Bike::nbBikeTypes> taken{};    ///< bikes taken per type
+    std::array<size_t, Bike::nbBikeTypes> returned{}; ///< bikes returned per type
+    std::array<size_t, Bike::nbBikeTypes> missed{};   ///< riders who had to wait, per type
+};
+
+/**
+ * @brief Lock-free view of the contents of a station, for observers.
+ */
+struct StationCounts
+{
+    std::array<uint32_t, Bike::nbBikeTypes> bikes{}; ///< available bikes per type
+    uint32_t broken = 0;                             ///< broken bikes (occupying a slot)
+    uint32_t waitingTakers = 0;                      ///< riders waiting for a bike
+    uint32_t waitingPutters = 0;                     ///< riders waiting for a free slot
+};
+
+/**
+ * @brief Time a station spent without a bike of each type and without a
+ *        free dock, since it was built.
+ */
+struct StationAvailability
+{
+    uint64_t elapsedNs = 0;                            ///< time since the station was built
+    std::array<uint64_t, Bike::nbBikeTypes> emptyNs{}; ///< no available bike of the type
+    uint64_t fullNs = 0;                               ///< no free dock (broken bikes included)
+
+    /**
+     * @brief Share of the time without an available bike of a type, in [0, 1].
+     */
+    double emptyFraction(size_t _type) const;
+
+    /**
+     * @brief Share of the time without a free dock, in [0, 1].
+     */
+    double fullFraction() const;
+};
 
 /**
  * @brief Thread-safe bike station storing bikes by type with a limited capacity.
  *
  * Bikes are stored. Multiple threads can safely
  * put and get bikes using internal synchronization.
+ * Broken bikes still occupy a slot but are never handed to riders; only
+ * getBrokenBikes() removes them.
  */
 class BikeStation
 {
@@ -35,6 +86,17 @@ public:
      */
     BikeStation(int _capacity);
 
+    /**
+     * @brief Constructs a bike station holding its initial bikes.
+     *
+     * Bulk form used to build a city: the bikes are stored directly, without
+     * locking nor waking anybody.
+     *
+     * @param _capacity Maximum number of bikes that can be stored at this station.
+     * @param _bikes Initial bikes, at most @p _capacity.
+     */
+    BikeStation(int _capacity, const std::vector<Bike*>& _bikes);
+
     /**
      * @brief Destructor.
      *
@@ -45,6 +107,7 @@ public:
     /**
      * @brief Inserts a bike into the station.
      *
+     * A broken bike is kept apart from the available ones.
      * If the station is full, the calling thread blocks until a slot becomes
      * available or the station is marked as ending.
      *
@@ -74,6 +137,16 @@ public:
      */
     std::vector<Bike*> addBikes(std::vector<Bike*> _bikesToAdd);
 
+    /**
+     * @brief Adds several bikes without ever waiting for a free slot.
+     *
+     * Inserts bikes while there is room; the others are returned at once.
+     *
+     * @param _bikesToAdd Vector of bike pointers to insert.
+     * @return Vector containing the bikes that did not fit.
+     */
+    std::vector<Bike*> tryAddBikes(std::vector<Bike*> _bikesToAdd);
+
     /**
      * @brief Retrieves up to a given number of bikes from the station.
      *
@@ -86,7 +159,26 @@ public:
     std::vector<Bike*> getBikes(size_t _nbBikes);
 
     /**
-     * @brief Counts the bikes of a specific type currently stored.
+     * @brief Retrieves bikes according to explicit per-type quotas.
+     *
+     * Takes up to @p _quotas[t] bikes of each type t, FIFO within each type.
+     * Never blocks: a type with fewer bikes than its quota yields what is there.
+     *
+     * @param _quotas Maximum number of bikes to take per type.
+     * @return Vector containing the bikes actually retrieved, grouped by type.
+     */
+    std::vector<Bike*> getBikes(const std::array<size_t, Bike::nbBikeTypes>& _quotas);
+
+    /**
+     * @brief Retrieves up to a given number of broken bikes (FIFO).
+     *
+     * @param _nbBikes Maximum number of bikes to retrieve.
+     * @return Vector containing the broken bikes actually retrieved.
+     */
+    std::vector<Bike*> getBrokenBikes(size_t _nbBikes);
+
+    /**
+     * @brief Counts the available (not broken) bikes of a specific type.
      *
      * @param type Bike type index (0..Bike::nbBikeTypes-1).
      * @return Number of bikes of the given type in the station.
@@ -94,12 +186,17 @@ public:
     size_t countBikesOfType(size_t type) const;
 
     /**
-     * @brief Returns the total number of bikes currently stored.
+     * @brief Returns the total number of bikes currently stored, broken ones included.
      *
-     * @return Current number of bikes in the station.
+     * @return Current number of occupied slots in the station.
      */
     size_t nbBikes();
 
+    /**
+     * @brief Returns the number of broken bikes currently stored.
+     */
+    size_t nbBrokenBikes() const;
+
     /**
      * @brief Returns the maximum number of bikes the station can contain.
      *
@@ -107,6 +204,125 @@ public:
      */
     size_t nbSlots();
 
+    /**
+     * @brief Returns the demand counters and resets them.
+     *
+     * @return Demand observed since the previous call.
+     */
+    DemandCounters collectDemand();
+
+    /**
+     * @brief Sets the occupancy target used to compute the rider bonuses.
+     *
+     * Until a target is set, the station publishes no bonus.
+     *
+     * @param _target Number of bikes the station should hold.
+     */
+    void setTargetLevel(size_t _target);
+
+    /**
+     * @brief Bonus offered to a rider who returns a bike here.
+     *
+     * Positive when the station holds fewer bikes than its target. Lock-free.
+     *
+     * @return Bonus points (0 if none).
+     */
+    int returnBonus() const;
+
+    /**
+     * @brief Bonus offered to a rider who takes a bike here.
+     *
+     * Positive when the station holds more bikes than its target. Lock-free.
+     *
+     * @return Bonus points (0 if none).
+     */
+    int takeBonus() const;
+
+    /**
+     * @brief Occupancy history of the station, readable from any thread.
+     */
+    const OccupancyHistory& occupancyHistory() const;
+
+    /**
+     * @brief Current contents and waiters, without locking.
+     *
+     * Each field is read atomically, but the fields may come from slightly
+     * different instants.
+     */
+    StationCounts counts() const;
+
+    /**
+     * @brief Time spent empty (per type) and full so far, without locking.
+     *
+     * The times are accumulated on each change of state, so a read costs
+     * the same whatever the length of the run, and a read sees all the
+     * fields at the same instant. Passing the same @p _nowNs to every
+     * station reads a whole city at one instant.
+     *
+     * @param _nowNs Current time, from availabilityClockNs().
+     */
+    StationAvailability availability(uint64_t _nowNs) const;
+
+    /**
+     * @brief Clock of the availability times (monotonic), in nanoseconds.
+     */
+    static uint64_t availabilityClockNs();
+
+    /**
+     * @brief Closes or reopens the station to riders.
+     *
+     * While closed, riders calling getBike() or putBike() wait as if the
+     * station were empty or full. Van and administration operations
+     * (addBikes(), getBikes()) are not affected.
+     *
+     * @param _open False to close, true to reopen.
+     */
+    void setOpen(bool _open);
+
+    /**
+     * @brief Returns whether the station is open to riders. Lock-free.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Freezes the station for a checkpoint (see SimulationGate).
+     *
+     * While frozen, getBike() and putBike() never complete: riders wait
+     * (and are counted as waiting) exactly as at a closed station.
+     *
+     * @param _frozen True to freeze, false to release the waiting riders.
+     */
+    void setFrozen(bool _frozen);
+
+    /**
+     * @brief Copies the contents of the station in FIFO order.
+     *
+     * @param _bikes Receives the available bikes type by type, then the
+     *        broken ones.
+     * @param _perType Receives the number of available bikes per type.
+     * @param _broken Receives the number of broken bikes.
+     */
+    void contents(std::vector<Bike*>& _bikes, std::array<uint32_t, Bike::nbBikeTypes>& _perType,
+                  uint32_t& _broken) const;
+
+    /**
+     * @brief Records every later change of the station in globalTrace.
+     *
+     * Records the current contents first (StationInit), so a replay can
+     * start from them. Has no effect while the trace is not open.
+     *
+     * @param _site Site of the station in the trace.
+     */
+    void traceAs(size_t _site);
+
+    /**
+     * @brief Names the station in the lock profile (see LockProfiler).
+     *        No effect when lock profiling is compiled out.
+     *
+     * @param _site Site of the station.
+     */
+    void profileAs(size_t _site);
+
     /**
      * @brief Signals that the station is ending and wakes up all waiting threads.
      *
@@ -116,16 +332,67 @@ public:
     void ending();
 
 private:
+    /**
+     * @brief Publishes a change of the occupied slots (bonuses and history).
+     *        Must be called with the mutex held.
+     */
+    void occupancyChanged();
+
+    /**
+     * @brief Starts or ends the empty and full periods that the last change
+     *        caused. Must be called with the mutex held.
+     */
+    void availabilityChanged();
+
+    /**
+     * @brief Recomputes the published bonuses. Must be called with the mutex held.
+     */
+    void updateIncentives();
+
+    /**
+     * @brief Number of occupied slots (available and broken bikes).
+     *        Must be called with the mutex held.
+     */
+    size_t occupiedSlots() const;
+
+    /**
+     * @brief Records the bikes added since the last call, then resets the
+     *        counts. Must be called with the mutex held.
+     */
+    void traceAdded(std::array<uint32_t, Bike::nbBikeTypes>& _added, uint32_t& _broken);
+
     /**
      * @brief Maximum number of bikes that can be stored in this station.
      */
     const size_t capacity;
 
-    mutable PcoMutex mutex;                             // PcoSynchro
+    mutable ProfiledMutex mutex;                        // PcoSynchro, see lockprofiler.h
     PcoConditionVariable condTakers[Bike::nbBikeTypes]; // une par type
     PcoConditionVariable condPutters;                   // pour les rendeurs
     std::vector<std::deque<Bike*>> bikesByType;         // deque for FIFO ordering
+    std::deque<Bike*> brokenBikes;                      // waiting for the van
     bool shouldEnd = false;
+    bool closed = false;                                // protected by mutex
+    bool frozen = false;                                // protected by mutex
+    std::atomic<bool> open{true};                       // lock-free copy of !closed
+    DemandCounters demand;                              // protected by mutex
+    bool hasTarget = false;                             // protected by mutex
+    size_t targetLevel = 0;                             // protected by mutex
+    std::atomic<int> returnBonusPoints{0};              // published bonuses
+    std::atomic<int> takeBonusPoints{0};
+    OccupancyHistory history;                           // written with mutex held
+    std::array<std::atomic<uint32_t>, Bike::nbBikeTypes> publishedBikes{}; // for counts()
+    std::atomic<uint32_t> publishedBroken{0};
+    std::atomic<uint32_t> waitingTakers{0};
+    std::atomic<uint32_t> waitingPutters{0};
+    const uint64_t createdNs;                           // availability clock
+    std::atomic<uint32_t> availabilityVersion{0};       // odd while the fields below change
+    std::array<std::atomic<uint64_t>, Bike::nbBikeTypes> emptyTotalNs{}; // ended periods
+    std::array<std::atomic<uint64_t>, Bike::nbBikeTypes> emptySinceNs{}; // 0 if not empty
+    std::atomic<uint64_t> fullTotalNs{0};
+    std::atomic<uint64_t> fullSinceNs{0};               // 0 if not full
+    static const size_t NO_TRACE = SIZE_MAX;
+    size_t traceSite = NO_TRACE;                        // protected by mutex
 };
 
 #endif // BIKESTATION_H
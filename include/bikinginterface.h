@@ -48,8 +48,12 @@ public:
       de type BikingInterface.
       \param nbConsoles Nombre de consoles d'affichage
       \param nbSites Nombre de sites où peuvent être trouvés les vélos
+      \param nbDepots Nombre de dépôts, numérotés à la suite des sites
+      \param nbBikes Nombre de vélos, pour créer leurs éléments graphiques
+             au démarrage
       */
-    static void initialize(unsigned int nbConsoles,unsigned int nbSites);
+    static void initialize(unsigned int nbConsoles,unsigned int nbSites,
+                           unsigned int nbDepots=1,unsigned int nbBikes=0);
 
     /**
       \brief Fonction permettant d'afficher du texte dans une console.
@@ -59,10 +63,22 @@ public:
       */
     void consoleAppendText(unsigned int consoleId,QString text);
 
+    /**
+      \brief Ajoute des événements structurés à la vue de log.
+
+      Les événements sont mis en attente (sans signal) et insérés dans la vue
+      à la prochaine image ; ils ne sont mis en forme que s'ils sont visibles.
+      \param records Evénements à ajouter.
+      */
+    void appendLogRecords(const std::vector<LogRecord>& records);
+
     /**
       \brief Définition du nombre de vélos sur un site.
 
       Fonction permettant de définir le nombre de vélos présents sur un site.
+      La valeur est écrite dans un instantané partagé (sans signal) que la
+      fenêtre principale relit à cadence fixe : appeler cette fonction très
+      souvent ne surcharge donc pas la boucle d'événements.
       \param site Identifiant du site. Attention, doit être compris entre
              0 et nombre_de_sites. Le site d'identifiant nombre_de_sites
              correspond au local de maintenance.
@@ -83,6 +99,17 @@ public:
       */
     void setInitBikes(unsigned int site,unsigned int nbBike);
 
+    /**
+      \brief Définition du nombre de places d'un site.
+
+      Utilisé par le mode grande ville pour afficher le taux d'occupation.
+      Ne doit être appelé que depuis le main() avant le lancement de la
+      boucle de gestion des événements.
+      \param site Identifiant du site (dépôts compris).
+      \param capacity Nombre de places.
+      */
+    void setSiteCapacity(unsigned int site,unsigned int capacity);
+
 
     /**
       \brief Place une personne sur un site.
@@ -112,13 +139,17 @@ public:
              entre 0 et nombre_de_sites. Le site d'identifiant nombre_de_sites
              correspond au local de maintenance.
       \param ms Nombre de millisecondes de l'animation.
+      \param waitEnd Si faux, retourne sans attendre la fin de l'animation
+             (rejeu d'une trace).
       */
-    void travel(unsigned int personId,unsigned int site1, unsigned int site2,unsigned int ms);
+    void travel(unsigned int personId,unsigned int site1, unsigned int site2,unsigned int ms,
+                bool waitEnd=true);
 
     void walk(unsigned int personId,
               unsigned int site1,
               unsigned int site2,
-              unsigned int ms);
+              unsigned int ms,
+              bool waitEnd=true);
     /**
       \brief Déplace la camionette d'un site à l'autre
 
@@ -135,8 +166,20 @@ public:
              entre 0 et nombre_de_sites. Le site d'identifiant nombre_de_sites
              correspond au local de maintenance.
       \param ms Nombre de millisecondes de l'animation.
+      \param waitEnd Si faux, retourne sans attendre la fin de l'animation
+             (rejeu d'une trace).
      */
-    void vanTravel(unsigned int site1, unsigned int site2,unsigned int ms);
+    void vanTravel(unsigned int site1, unsigned int site2,unsigned int ms,bool waitEnd=true);
+
+    /**
+      \brief Affiche le résultat d'un ordre d'administration de la flotte.
+
+      Appelée par le thread de FleetAdmin une fois l'ordre terminé (ou
+      abandonné faute de place ou de vélos) ; le texte est affiché dans la
+      barre d'état de la fenêtre principale.
+      \param result Résultat de l'ordre.
+      */
+    void fleetOrderDone(const FleetResult& result);
 
 private:
 
@@ -154,16 +197,6 @@ signals:
       */
     void sig_consoleAppendText(unsigned int consoleId,QString text);
 
-    /**
-      Signal envoyé à la fenêtre principale pour la définition du nombre de
-      vélos présents sur un site.
-      \param site Identifiant du site. Attention, doit être compris entre
-             0 et nombre_de_sites. Le site d'identifiant nombre_de_sites
-             correspond au local de maintenance.
-      \param nbBike Nombre de vélos à affecter.
-      */
-    void sig_setBikes(unsigned int site,unsigned int nbBike);
-
     /**
       Signal envoyé à la fenêtre principale pour déplacer un vélo d'un site à
       l'autre.
@@ -192,6 +225,13 @@ signals:
       \param ms Nombre de millisecondes de l'animation.
       */
     void sig_vanTravel(unsigned int site1, unsigned int site2,unsigned int ms);
+
+    /**
+      Signal envoyé à la fenêtre principale à la fin d'un ordre
+      d'administration de la flotte.
+      \param text Résultat mis en forme.
+      */
+    void sig_fleetOrderDone(QString text);
 };
 
 #endif // BIKINGINTERFACE_H
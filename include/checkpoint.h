@@ -0,0 +1,222 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bike.h"
+#include "config.h"
+
+class BikeStation;
+class Person;
+class Van;
+class VanFleet;
+class RepairShop;
+
+/**
+ * @brief Layout of a checkpoint file.
+ *
+ * The file starts with a CheckpointHeader, followed by arrays of fixed-size
+ * records at the offsets given by the header (8-byte aligned): the
+ * stations, the riders, the vans and one table of bikes. Stations, vans and
+ * the repair queue reference consecutive runs of this table. The file is
+ * read by mapping it in memory (see CheckpointFile), without any parsing.
+ *
+ * Records are written in the byte order of the machine; the header lets a
+ * reader reject a file from another layout version or city.
+ */
+
+/**
+ * @brief Magic number and version of the layout, checked by the readers.
+ */
+const uint32_t CHECKPOINT_MAGIC = 0x50434f43; // "PCOC"
+const uint32_t CHECKPOINT_VERSION = 1;
+
+/**
+ * @brief One bike.
+ */
+struct CheckpointBike
+{
+    uint32_t wear;
+    uint8_t type;
+    uint8_t broken;
+    uint16_t reserved;
+};
+
+/**
+ * @brief One station: its bikes are available ones type by type (FIFO),
+ *        then the broken ones.
+ */
+struct CheckpointStation
+{
+    uint64_t firstBike;                 ///< index in the bike table
+    uint32_t capacity;
+    uint32_t open;
+    uint32_t bikes[Bike::nbBikeTypes];  ///< available bikes per type
+    uint32_t broken;
+};
+
+/**
+ * @brief One rider, at the point where it was parked.
+ */
+struct CheckpointRider
+{
+    uint32_t id;
+    uint32_t site;          ///< current site
+    uint32_t destination;   ///< destination of the trip in progress
+    uint8_t phase;          ///< a Person::Phase
+    uint8_t preferredType;
+    uint8_t hasBike;        ///< true if @ref bike is held
+    uint8_t reserved;
+    CheckpointBike bike;
+    uint64_t rngSeed;       ///< CounterRng of the rider thread
+    uint64_t rngCounter;
+};
+
+/**
+ * @brief One van: its cargo is stacked type by type, then the broken bikes.
+ */
+struct CheckpointVan
+{
+    uint64_t firstBike;                 ///< index in the bike table
+    uint32_t id;
+    uint32_t site;                      ///< current site
+    uint32_t tourSite;                  ///< next site of the tour (NBSITES: not on a tour)
+    uint32_t retired;
+    uint32_t cargo[Bike::nbBikeTypes];
+    uint32_t broken;
+};
+
+/**
+ * @brief Run metrics (see SimulationMetrics).
+ */
+struct CheckpointMetrics
+{
+    uint64_t tripsCompleted;
+    uint64_t riderWaits;
+    uint64_t vanDistanceMilli;
+    uint64_t incentivesAccepted;
+    uint64_t bonusPointsPaid;
+    uint64_t breakdowns;
+    uint64_t repairs;
+};
+
+/**
+ * @brief Header of the file.
+ */
+struct CheckpointHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nbSites;       ///< regular sites
+    uint32_t nbDepots;
+    uint32_t nbTypes;
+    uint32_t nbRiders;
+    uint32_t nbVans;
+    uint32_t nbRepair;      ///< bikes in the repair queue
+    uint64_t nbBikes;       ///< size of the bike table
+    uint64_t stationsOffset;
+    uint64_t ridersOffset;
+    uint64_t vansOffset;
+    uint64_t bikesOffset;
+    uint64_t repairFirstBike;
+    CheckpointMetrics metrics;
+};
+
+/**
+ * @brief Everything a checkpoint is made of.
+ */
+struct CheckpointSources
+{
+    std::array<BikeStation*, NB_SITES_TOTAL> stations;
+    std::vector<Person*> persons;
+    VanFleet* vanFleet = nullptr;
+    RepairShop* repairShop = nullptr; // may be null
+};
+
+/**
+ * @brief Takes a checkpoint of the running simulation.
+ *
+ * Pauses the simulation at a consistent point (see SimulationGate), copies
+ * its state, resumes it, then writes the file (through a temporary file
+ * renamed at the end). The simulation is paused only during the copy.
+ *
+ * @param _path Path of the checkpoint file.
+ * @param _sources State to save.
+ * @param _error Receives the reason of a failure.
+ * @return False if the simulation did not reach a consistent point within
+ *         @ref CHECKPOINT_QUIESCE_MS or the file could not be written.
+ */
+bool saveCheckpoint(const std::string& _path, const CheckpointSources& _sources,
+                    std::string& _error);
+
+/**
+ * @brief Checkpoint file mapped in memory, used to restore a simulation.
+ */
+class CheckpointFile
+{
+public:
+    CheckpointFile() = default;
+    ~CheckpointFile();
+    CheckpointFile(const CheckpointFile&) = delete;
+    CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+    /**
+     * @brief Maps a file and checks its header and bounds.
+     *
+     * @param _path Path of the checkpoint file.
+     * @param _error Receives the reason of a failure.
+     * @return False if the file cannot be used with this build.
+     */
+    bool open(const std::string& _path, std::string& _error);
+
+    const CheckpointHeader& header() const;
+
+    /**
+     * @brief Creates the stations with their bikes.
+     */
+    void restoreStations(std::array<BikeStation*, NB_SITES_TOTAL>& _stations) const;
+
+    /**
+     * @brief Creates the riders, holding their bike if they had one.
+     */
+    std::vector<Person*> restoreRiders() const;
+
+    /**
+     * @brief Creates the vans in service with their cargo.
+     *
+     * @param _leftovers Receives the cargo of the vans that were retiring.
+     */
+    std::vector<std::unique_ptr<Van>> restoreVans(std::vector<Bike*>& _leftovers) const;
+
+    /**
+     * @brief Creates the bikes of the repair queue.
+     *
+     * @param _repaired Receives the bikes already repaired, which were
+     *        waiting to go back to the depot.
+     * @return Broken bikes to submit to the repair shop.
+     */
+    std::vector<Bike*> restoreRepairQueue(std::vector<Bike*>& _repaired) const;
+
+    /**
+     * @brief Restores the run metrics.
+     */
+    void restoreMetrics() const;
+
+private:
+    const CheckpointBike* bikes() const;
+    static Bike* makeBike(const CheckpointBike& _record);
+
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+/**
+ * @brief Copies a bike into its record.
+ */
+CheckpointBike checkpointBike(const Bike& _bike);
+
+#endif // CHECKPOINT_H
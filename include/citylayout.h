@@ -0,0 +1,73 @@
+#ifndef CITYLAYOUT_H
+#define CITYLAYOUT_H
+
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Position of a site in city radius units.
+ *
+ * The city fits in a circle of radius 1 centered on (0, 0).
+ */
+struct SitePosition
+{
+    double x;
+    double y;
+};
+
+/**
+ * @brief Positions given by a city model (see CityModel::positions()),
+ *        empty for the default layout. Set before any thread starts.
+ */
+inline std::vector<SitePosition>& modelSitePositions()
+{
+    static std::vector<SitePosition> positions;
+    return positions;
+}
+
+/**
+ * @brief Returns the position of a site.
+ *
+ * The position given by the city model if any. Otherwise regular sites are
+ * laid out on the unit circle. Depots are laid out on an
+ * inner circle, or at the center when there is only one depot.
+ *
+ * @param site Site index (0..nbSites+nbDepots-1), depots after regular sites.
+ * @param nbSites Number of regular sites.
+ * @param nbDepots Number of depots.
+ */
+inline SitePosition sitePosition(unsigned int site, unsigned int nbSites, unsigned int nbDepots)
+{
+    const double pi = 3.14159265358979323846;
+    const double depotRadius = 0.4;
+
+    const std::vector<SitePosition>& model = modelSitePositions();
+    if (site < model.size()) {
+        return model[site];
+    }
+
+    if (site < nbSites) {
+        double angle = 2.0 * pi / nbSites * site;
+        return {std::cos(angle), std::sin(angle)};
+    }
+
+    if (nbDepots <= 1) {
+        return {0.0, 0.0};
+    }
+
+    // offset by half a step so depots do not line up with a site
+    double angle = 2.0 * pi / nbDepots * ((site - nbSites) + 0.5);
+    return {depotRadius * std::cos(angle), depotRadius * std::sin(angle)};
+}
+
+/**
+ * @brief Straight-line distance between two sites, in city radius units.
+ */
+inline double siteDistance(unsigned int a, unsigned int b, unsigned int nbSites, unsigned int nbDepots)
+{
+    SitePosition pa = sitePosition(a, nbSites, nbDepots);
+    SitePosition pb = sitePosition(b, nbSites, nbDepots);
+    return std::hypot(pa.x - pb.x, pa.y - pb.y);
+}
+
+#endif // CITYLAYOUT_H
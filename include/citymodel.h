@@ -0,0 +1,149 @@
+#ifndef CITYMODEL_H
+#define CITYMODEL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bike.h"
+#include "citylayout.h"
+
+class BikeStation;
+
+/**
+ * @brief Binary form of a city model: a CityModelHeader followed by one
+ *        CitySiteRecord per site, the regular sites first, then the depots.
+ *
+ * The file is used in place through a memory mapping, so a large city is
+ * opened without being parsed.
+ */
+const uint32_t CITY_MODEL_MAGIC = 0x50434f4d; // "PCOM", not a checkpoint
+const uint32_t CITY_MODEL_VERSION = 1;
+
+struct CityModelHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nbSites;                    ///< regular sites
+    uint32_t nbDepots;
+    uint32_t nbTypes;                    ///< Bike::nbBikeTypes when written
+    uint32_t nbPeople;
+    uint32_t nbVans;
+    uint32_t reserved;
+    uint64_t fleet[Bike::nbBikeTypes];   ///< bikes of each type in the city
+};
+
+struct CitySiteRecord
+{
+    float x;                             ///< position, any unit (see CityModel::positions())
+    float y;
+    uint32_t capacity;                   ///< slots
+    uint32_t stock[Bike::nbBikeTypes];   ///< bikes of each type at startup
+};
+
+/**
+ * @brief Description of a city: sites with their position, capacity and
+ *        initial stock, depots, and the fleet (people, vans, bikes per type).
+ *
+ * Bikes of the fleet that are in no initial stock are dealt in turn to the
+ * depots, type after type.
+ *
+ * A model is read from its binary form (mapped) or from a text form, one
+ * item per line ('#' starts a comment):
+ *
+ *     people <count>
+ *     vans <count>
+ *     bikes <count of type 0> <count of type 1> ...
+ *     site <x> <y> <capacity> [<stock of type 0> ...]
+ *     depot <x> <y> <capacity> [<stock of type 0> ...]
+ */
+class CityModel
+{
+public:
+    CityModel() = default;
+    ~CityModel();
+    CityModel(const CityModel&) = delete;
+    CityModel& operator=(const CityModel&) = delete;
+
+    /**
+     * @brief The city described by config.h: sites on a circle with
+     *        BORNES - 2 bikes each, NB_BIKES bikes of every type in turn.
+     */
+    static void fromConfig(CityModel& _model);
+
+    /**
+     * @brief Reads a model, binary (recognized by its magic) or text.
+     *
+     * @param _error Receives the reason of a failure.
+     * @return False if the file cannot be read or the model is invalid
+     *         (see validate()).
+     */
+    bool open(const std::string& _path, std::string& _error);
+
+    /**
+     * @brief Writes the binary form of the model.
+     */
+    bool save(const std::string& _path, std::string& _error) const;
+
+    /**
+     * @brief Builds a model from its parts (see the binary form).
+     *
+     * @return False if the model is invalid (see validate()).
+     */
+    bool assign(const CityModelHeader& _header, const std::vector<CitySiteRecord>& _sites,
+                std::string& _error);
+
+    size_t nbSites() const;
+    size_t nbDepots() const;
+    size_t nbSitesTotal() const;
+    unsigned int nbPeople() const;
+    unsigned int nbVans() const;
+    uint64_t nbBikes() const;
+    const CitySiteRecord& site(size_t _site) const;
+
+    /**
+     * @brief Bikes of a type at a site at startup, the share of the depots
+     *        included.
+     */
+    uint64_t initialBikes(size_t _site, size_t _type) const;
+
+    /**
+     * @brief Positions of the sites, scaled to fit the city circle (radius 1,
+     *        centered on 0), the unit of the travel times.
+     */
+    std::vector<SitePosition> positions() const;
+
+private:
+    /**
+     * @brief Checks the model: counts and types, stocks within the
+     *        capacities and the fleet, depots able to hold their share.
+     *        Computes @ref unstocked.
+     */
+    bool validate(std::string& _error);
+
+    bool parseText(const std::string& _text, std::string& _error);
+    void release();
+
+    const CityModelHeader* header = nullptr;
+    const CitySiteRecord* records = nullptr;
+    std::vector<uint64_t> owned;         // image of a model not mapped (8-byte aligned)
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::array<uint64_t, Bike::nbBikeTypes> unstocked{}; // bikes in no stock, per type
+};
+
+/**
+ * @brief Creates the stations of a city and their bikes.
+ *
+ * The stations are built in parallel, each with its whole initial content
+ * at once (BikeStation bulk constructor), without any lock or wait.
+ *
+ * @param _model City to build.
+ * @param _nbThreads Builder threads, 0 for one per core.
+ * @return One station per site, depots last.
+ */
+std::vector<BikeStation*> buildStations(const CityModel& _model, unsigned int _nbThreads = 0);
+
+#endif // CITYMODEL_H
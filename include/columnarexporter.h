@@ -0,0 +1,157 @@
+#ifndef COLUMNAREXPORTER_H
+#define COLUMNAREXPORTER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pcosynchro/pcomutex.h>
+
+#include "config.h"
+#include "bikestation.h"
+#include "columnarformat.h"
+
+/**
+ * @brief Writes the occupancy of the stations and the completed trips into
+ *        a columnar file for offline analysis (layout in columnarformat.h).
+ *
+ * A dedicated thread (run()) samples the lock-free counters of every
+ * station every @ref COLUMNAR_SAMPLE_MS and drains the trips recorded by the
+ * riders. Riders only write into their own ring (no lock, the trip is
+ * dropped and counted if the ring is full). Rows are kept until a row group
+ * is full, so memory does not grow with the length of the run.
+ */
+class ColumnarExporter
+{
+public:
+    /**
+     * @brief Prepares the exporter, the file is created by open().
+     *
+     * @param _path Output file.
+     * @param _stations All stations (sites + depots).
+     */
+    ColumnarExporter(const std::string& _path,
+                     const std::array<BikeStation*, NB_SITES_TOTAL>& _stations);
+
+    /**
+     * @brief Closes the file (the rows not yet written are lost, see run()).
+     */
+    ~ColumnarExporter();
+
+    /**
+     * @brief Creates the file and writes its header.
+     *
+     * @return False if the file could not be created (the error is printed).
+     */
+    bool open();
+
+    /**
+     * @brief Time since the start of the export (ms), for recordTrip().
+     */
+    uint32_t elapsedMs() const;
+
+    /**
+     * @brief Records a completed trip, ending now. Lock-free, called by the
+     *        riders.
+     *
+     * @param _startMs Start of the trip (elapsedMs() when the bike was taken).
+     * @param _origin Site where the bike was taken.
+     * @param _destination Site where the bike was docked.
+     * @param _type Type of the bike.
+     */
+    void recordTrip(uint32_t _startMs, unsigned int _origin, unsigned int _destination,
+                    size_t _type);
+
+    /**
+     * @brief Sampling loop, runs in its own thread until requestStop(), then
+     *        writes the remaining rows.
+     */
+    void run();
+
+    /**
+     * @brief Asks run() to return after its next sample.
+     */
+    void requestStop();
+
+    /**
+     * @brief Trips lost because a ring was full.
+     */
+    uint64_t dropped() const;
+
+private:
+    struct OccupancyRow
+    {
+        uint32_t timeMs;
+        uint16_t station;
+        uint8_t type;
+        uint32_t bikes;
+    };
+
+    struct TripRecord
+    {
+        uint32_t endMs;
+        uint32_t durationMs;
+        uint16_t origin;
+        uint16_t destination;
+        uint8_t type;
+    };
+
+    /**
+     * @brief Single-producer single-consumer ring of trips.
+     */
+    struct Ring {
+        static const size_t SIZE = 1024; // power of two
+        std::array<TripRecord, SIZE> records;
+        std::atomic<size_t> head{0};     // next slot written by the rider
+        std::atomic<size_t> tail{0};     // next slot read by the exporter
+    };
+
+    Ring* threadRing();
+
+    /**
+     * @brief Adds one occupancy row per station and type.
+     *
+     * @param _timeMs Time of the sample on the sampling schedule.
+     */
+    void sample(uint32_t _timeMs);
+
+    /**
+     * @brief Moves the recorded trips into the pending rows.
+     */
+    void drainTrips();
+
+    /**
+     * @brief Sorts the pending samples by station, type and time and writes
+     *        them as one group: the count of a station rarely changes from
+     *        one sample to the next, so the columns shrink to a few runs.
+     */
+    void flushOccupancy();
+
+    /**
+     * @brief Sorts the pending trips by end time and writes them as one group.
+     */
+    void flushTrips();
+
+    void writeGroup(ColumnarTable _table, uint32_t _rows, const std::vector<uint8_t>& _columns);
+
+    std::string path;
+    std::array<BikeStation*, NB_SITES_TOTAL> stations;
+    std::chrono::steady_clock::time_point start;
+    std::FILE* file = nullptr;
+    std::atomic<bool> stopRequested{false};
+    std::atomic<uint64_t> droppedTrips{0};
+
+    PcoMutex mutex;                           // protects rings (registration only)
+    std::vector<std::unique_ptr<Ring>> rings;
+
+    // Pending rows (exporter thread only)
+    std::vector<OccupancyRow> pendingSamples;
+    std::vector<TripRecord> pendingTrips;
+};
+
+#endif // COLUMNAREXPORTER_H
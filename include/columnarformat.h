@@ -0,0 +1,129 @@
+#ifndef COLUMNARFORMAT_H
+#define COLUMNARFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Layout of the columnar export files (see ColumnarExporter).
+ *
+ * A ColumnarFileHeader, then row groups. Each row group is a
+ * ColumnarGroupHeader followed by the columns of its table, one after the
+ * other, each column holding the value of every row of the group:
+ *
+ * - Occupancy (one row per station, bike type and sample, ordered by
+ *   station, type, then time within a group):
+ *   time, station, type, bikes
+ * - Trips (one row per completed trip, by end time within a group):
+ *   time (end), duration, origin, destination, type
+ *
+ * Times are milliseconds since the start of the export, durations are in
+ * milliseconds. Row groups hold at most COLUMNAR_GROUP_ROWS rows.
+ *
+ * Column encodings (varints are unsigned LEB128):
+ * - packed: varint base, one byte width, then every value minus base in
+ *   width bits, least significant bit first, padded to a byte;
+ * - integers: one byte ColumnarMode, then
+ *   - Runs: varint number of runs, then for each run a varint zigzag delta
+ *     and a varint length (every row of a run adds the delta to the
+ *     previous row, the first row to 0),
+ *   - Deltas: the zigzag deltas as a packed column,
+ *   - Packed: the values as a packed column;
+ *   the writer picks the smallest;
+ * - dictionary: varint n, n varint values, then the index of each row in
+ *   the dictionary as an integers column.
+ *
+ * Stations are dictionary columns, every other column is an integers
+ * column: timestamps end up delta-encoded and types bit-packed, unless the
+ * runs of a sorted group are smaller.
+ */
+
+const uint32_t COLUMNAR_MAGIC = 0x50434f58; // "PCOX"
+const uint32_t COLUMNAR_VERSION = 1;
+
+/**
+ * @brief Rows of a full row group.
+ */
+const uint32_t COLUMNAR_GROUP_ROWS = 8192;
+
+/**
+ * @brief Tables of the export.
+ */
+enum class ColumnarTable : uint32_t
+{
+    Occupancy = 0,
+    Trips = 1
+};
+
+/**
+ * @brief Encodings of an integers column.
+ */
+enum class ColumnarMode : uint8_t
+{
+    Runs = 0,
+    Deltas = 1,
+    Packed = 2
+};
+
+/**
+ * @brief Header of an export file.
+ */
+struct ColumnarFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nbSites;
+    uint32_t nbTypes;
+    uint32_t groupRows;      ///< COLUMNAR_GROUP_ROWS when written
+    uint32_t samplePeriodMs; ///< period of the occupancy samples
+};
+
+/**
+ * @brief Header of a row group.
+ */
+struct ColumnarGroupHeader
+{
+    uint32_t table;  ///< a ColumnarTable
+    uint32_t rows;
+    uint32_t bytes;  ///< size of the columns following the header
+};
+
+/**
+ * @brief Appends a packed column.
+ */
+void encodePacked(std::vector<uint8_t>& _out, const std::vector<uint64_t>& _values);
+
+/**
+ * @brief Appends an integers column, in the smallest of its modes.
+ */
+void encodeIntegers(std::vector<uint8_t>& _out, const std::vector<uint64_t>& _values);
+
+/**
+ * @brief Appends a dictionary column.
+ */
+void encodeDictionary(std::vector<uint8_t>& _out, const std::vector<uint64_t>& _values);
+
+/**
+ * @brief Reads a packed column of _rows values.
+ *
+ * @param _data Start of the column, moved past it.
+ * @param _end End of the available bytes.
+ * @return False if the column is truncated or invalid.
+ */
+bool decodePacked(const uint8_t*& _data, const uint8_t* _end, size_t _rows,
+                  std::vector<uint64_t>& _values);
+
+/**
+ * @brief Reads an integers column of _rows values (see decodePacked()).
+ */
+bool decodeIntegers(const uint8_t*& _data, const uint8_t* _end, size_t _rows,
+                    std::vector<uint64_t>& _values);
+
+/**
+ * @brief Reads a dictionary column of _rows values (see decodePacked()).
+ */
+bool decodeDictionary(const uint8_t*& _data, const uint8_t* _end, size_t _rows,
+                      std::vector<uint64_t>& _values);
+
+#endif // COLUMNARFORMAT_H
@@ -3,23 +3,48 @@
 
 #include <random>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "eventlog.h"
 
 /**
  * @brief Number of bike-sharing sites (excluding the depot).
+ *
+ * PCO_NBSITES replaces it at compile time (benchmark builds).
  */
+#ifdef PCO_NBSITES
+const size_t NBSITES   = PCO_NBSITES;
+#else
 const size_t NBSITES   = 8;
+#endif
+
+/**
+ * @brief Number of depots.
+ */
+const size_t NBDEPOTS  = 2;
 
 /**
- * @brief Identifier of the depot site.
+ * @brief Identifier of the main depot site.
  *
- * The depot is considered as an extra site after the regular sites.
+ * Depots are considered as extra sites after the regular sites; they use the
+ * identifiers DEPOT_ID .. DEPOT_ID + NBDEPOTS - 1. The main depot is the one
+ * administrated from the GUI.
  */
 const size_t DEPOT_ID  = NBSITES;
 
 /**
- * @brief Total number of sites including the depot.
+ * @brief Total number of sites including the depots.
  */
-const size_t NB_SITES_TOTAL = NBSITES + 1;
+const size_t NB_SITES_TOTAL = NBSITES + NBDEPOTS;
+
+/**
+ * @brief Returns true if the given site is a depot.
+ */
+inline bool isDepot(size_t site)
+{
+    return site >= DEPOT_ID && site < NB_SITES_TOTAL;
+}
 
 /**
  * @brief Number of docking points (slots) per site.
@@ -36,15 +61,162 @@ const size_t NB_BIKES = 35;
  */
 const size_t NBPEOPLE = 10;
 
+/**
+ * @brief Number of vans at startup, and maximum number of vans.
+ *
+ * The number of vans can be changed at runtime through the control socket.
+ */
+const size_t NB_VANS = 1;
+const size_t MAX_VANS = 16;
+
 /**
  * @brief Maximum capacity of the van (number of bikes it can carry).
  */
 const size_t VAN_CAPACITY = 4;
 
+/**
+ * @brief Van driving time per unit of distance (milliseconds).
+ *
+ * Distances are expressed in city radius units (see citylayout.h).
+ */
+const unsigned int VAN_MS_PER_UNIT = 800;
+
+/**
+ * @brief Period between two runs of the rebalancing optimizer (milliseconds).
+ */
+const unsigned int OPTIMIZER_PERIOD_MS = 5000;
+
+/**
+ * @brief Smoothing factor of the demand rates used by the optimizer.
+ *
+ * Weight of the newest period in the exponential moving average (0..1].
+ */
+const double OPTIMIZER_SMOOTHING = 0.3;
+
+/**
+ * @brief Minimum number of free docks the optimizer keeps at each site.
+ */
+const size_t OPTIMIZER_MIN_FREE_DOCKS = 2;
+
+/**
+ * @brief Enables rider incentives (bonuses for helping rebalance stations).
+ */
+const bool INCENTIVES_ENABLED = true;
+
+/**
+ * @brief Bonus points per bike of gap between a station occupancy and its target.
+ */
+const int INCENTIVE_POINTS_PER_BIKE = 10;
+
+/**
+ * @brief Bonus points a rider needs to accept one unit of extra distance.
+ */
+const int INCENTIVE_POINTS_PER_UNIT = 40;
+
+/**
+ * @brief Wear added to a bike by each trip.
+ */
+const unsigned int WEAR_PER_TRIP = 1;
+
+/**
+ * @brief Probability for a bike to break at the end of a trip, per unit of wear.
+ */
+const double BREAKDOWN_PROBABILITY_PER_WEAR = 0.002;
+
+/**
+ * @brief Number of repair workers at the depot repair shop.
+ */
+const size_t NB_REPAIR_WORKERS = 2;
+
+/**
+ * @brief Time needed by a worker to repair one bike (milliseconds).
+ */
+const unsigned int REPAIR_TIME_MS = 4000;
+
+/**
+ * @brief Delay between two attempts to return a repaired bike to a full
+ *        depot (milliseconds).
+ */
+const unsigned int REPAIR_RETRY_MS = 50;
+
+/**
+ * @brief Fleet administration orders (see FleetAdmin): delay between two
+ *        attempts on a full or empty station, and time after which an order
+ *        is reported as partially done (milliseconds).
+ */
+const unsigned int FLEET_ADMIN_RETRY_MS = 50;
+const unsigned int FLEET_ADMIN_TIMEOUT_MS = 5000;
+
+/**
+ * @brief Number of per-second, per-minute and per-hour buckets kept in the
+ *        occupancy history of each station (see OccupancyHistory).
+ */
+const size_t HISTORY_SECONDS = 3600;    // last hour
+const size_t HISTORY_MINUTES = 24 * 60; // last day
+const size_t HISTORY_HOURS = 24 * 28;   // last four weeks
+
+/**
+ * @brief Default minimal level of the event log (can be changed at runtime).
+ */
+const LogLevel LOG_LEVEL = LogLevel::Info;
+
+/**
+ * @brief Period of the publication of the live state in shared memory (ms).
+ */
+const unsigned int EXPORT_PERIOD_MS = 100;
+
+/**
+ * @brief Period of the occupancy samples of the columnar export (ms).
+ */
+const unsigned int COLUMNAR_SAMPLE_MS = 1000;
+
+/**
+ * @brief Longest time a checkpoint waits for the threads to reach a
+ *        consistent point before giving up (milliseconds).
+ */
+const unsigned int CHECKPOINT_QUIESCE_MS = 10000;
+
+/**
+ * @brief Replay of recorded trips (see TripFeed): number of rider threads,
+ *        trips read ahead of their time, and recorded length of a ride when
+ *        the file gives no end time (seconds).
+ */
+const size_t TRIP_RIDERS = 64;
+const size_t TRIP_QUEUE_CAPACITY = 1024;
+const unsigned int TRIP_DEFAULT_RIDE_S = 900;
+
+/**
+ * @brief Counter-based random generator (SplitMix64).
+ *
+ * Its whole state is a seed and a draw counter, so a checkpoint can save
+ * and restore it in 16 bytes. Usable with the standard distributions.
+ */
+class CounterRng
+{
+public:
+    using result_type = uint64_t;
+
+    explicit CounterRng(uint64_t _seed) : seed(_seed) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        uint64_t z = seed + (++counter) * 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t seed;
+    uint64_t counter = 0; ///< number of draws so far
+};
+
 /**
  * @brief Thread-local random number generator used for the simulation.
  */
-static thread_local std::mt19937_64 c_rng(std::random_device{}());
+static thread_local CounterRng c_rng(((uint64_t)std::random_device{}() << 32) | std::random_device{}());
 
 /**
  * @brief Returns a random site index different from a given one.
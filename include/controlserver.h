@@ -0,0 +1,186 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "config.h"
+#include "bikestation.h"
+#include "bikinginterface.h"
+#include "spscqueue.h"
+#include "vanfleet.h"
+#include "checkpoint.h"
+#include "triplatency.h"
+
+/**
+ * @brief Default path of the control socket (used by --headless).
+ */
+const char* const CONTROL_SOCKET_PATH = "/tmp/pco_biking.sock";
+
+/**
+ * @brief Time left to the clients to read their last replies after a stop.
+ */
+const unsigned int CONTROL_DRAIN_MS = 1000;
+
+/**
+ * @brief Local control socket steering a running simulation.
+ *
+ * A Unix-domain stream socket accepts any number of clients speaking a line
+ * protocol, one command per line, one reply line per command ("ok ..." or
+ * "error ..."):
+ *
+ *   inject <site> <type> <n>   add n new bikes of a type at a station
+ *   close <site>               close a station to riders
+ *   open <site>                reopen a station
+ *   vans <n>                   change the number of vans in service
+ *   speed <factor>             change the speed factor (see simtime.h)
+ *   metrics                    aggregated run metrics
+ *   locks [n]                  n hottest station lock sites (see lockprofiler.h)
+ *   latency [<from> <to>]      per journey phase, count:p50/p95/p99 in ms, of
+ *                              the trips between two stations if given
+ *   checkpoint <path>          save the whole state (see checkpoint.h)
+ *   stop                       stop the simulation
+ *
+ * Two threads are used. The server thread (serverRun()) owns the sockets:
+ * it parses the lines and pushes the commands into a lock-free queue. The
+ * control thread (controlRun()) applies them and pushes the replies into a
+ * second lock-free queue, which the server thread sends back. Neither the
+ * simulation threads nor the GUI ever wait on a client: each client has an
+ * output buffer, written as far as its socket accepts and flushed again
+ * when it becomes writable. A client closing its side still gets the
+ * replies to the commands it has sent.
+ */
+class ControlServer
+{
+public:
+    /**
+     * @brief Prepares the server, the socket is created by open().
+     *
+     * @param _path Path of the socket file.
+     * @param _stations All stations (sites + depots).
+     * @param _vanFleet Vans of the simulation.
+     */
+    ControlServer(const std::string& _path,
+                  const std::array<BikeStation*, NB_SITES_TOTAL>& _stations,
+                  VanFleet* _vanFleet);
+
+    /**
+     * @brief Closes the sockets and removes the socket file.
+     */
+    ~ControlServer();
+
+    /**
+     * @brief Creates the listening socket.
+     *
+     * A socket file left over by a previous run is replaced; one still
+     * accepting connections belongs to a live run and makes open() fail.
+     *
+     * @return False if the socket could not be created (the error is printed).
+     */
+    bool open();
+
+    /**
+     * @brief Socket loop (accept, read, reply), runs until requestStop().
+     *
+     * The replies of the control thread are still delivered after the stop,
+     * for at most @ref CONTROL_DRAIN_MS.
+     */
+    void serverRun();
+
+    /**
+     * @brief Command loop, runs until requestStop().
+     */
+    void controlRun();
+
+    /**
+     * @brief Asks both loops to return.
+     */
+    void requestStop();
+
+    /**
+     * @brief Sets the user interface updated after an injection (may be null).
+     */
+    static void setInterface(BikingInterface* _binkingInterface);
+
+    /**
+     * @brief Sets the state saved by the checkpoint command (may be null).
+     */
+    static void setCheckpointSources(const CheckpointSources* _sources);
+
+private:
+    enum class CommandType { Inject, Close, Open, Vans, Speed, Metrics, Locks, Latency, Checkpoint, Stop };
+
+    struct Command
+    {
+        uint64_t client;
+        CommandType type;
+        unsigned int site;
+        unsigned int destination; ///< latency, NB_SITES_TOTAL for every trip
+        unsigned int bikeType;
+        unsigned int count;
+        double factor;
+        std::string path;
+    };
+
+    struct Reply
+    {
+        uint64_t client;
+        std::string text;
+    };
+
+    struct Client
+    {
+        int fd;
+        std::string input;         ///< partial line
+        std::string output;        ///< replies not written yet
+        unsigned int awaited = 0;  ///< commands queued, not answered yet
+        bool inputClosed = false;  ///< closed once its replies are written
+    };
+
+    /**
+     * @brief Parses one line; on error, @p _error receives the reply text.
+     */
+    bool parse(const std::string& _line, uint64_t _client, Command& _command,
+               std::string& _error) const;
+
+    /**
+     * @brief Applies a command and returns the reply text (control thread).
+     */
+    std::string apply(const Command& _command);
+
+    /**
+     * @brief Queues a reply for the server thread (control thread).
+     */
+    void reply(uint64_t _client, const std::string& _text);
+
+    /**
+     * @brief Appends text to the output of a client and writes what the
+     *        socket accepts (server thread).
+     */
+    void queueOutput(Client& _client, const std::string& _text);
+
+    /**
+     * @brief Writes the output of a client without blocking (server thread).
+     *
+     * @return False if the connection is broken.
+     */
+    bool flushOutput(Client& _client);
+
+    std::string path;
+    std::array<BikeStation*, NB_SITES_TOTAL> stations;
+    VanFleet* vanFleet;
+    int listenFd = -1;
+    std::map<uint64_t, Client> clients;       // server thread only
+    SpscQueue<Command, 256> commands;         // server -> control
+    SpscQueue<Reply, 256> replies;            // control -> server
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> controlReturned{false}; // no reply will be pushed anymore
+
+    static BikingInterface* binkingInterface;
+    static const CheckpointSources* checkpointSources;
+};
+
+#endif // CONTROLSERVER_H
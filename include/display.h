@@ -11,42 +11,218 @@
 
 #include <QGraphicsView>
 #include <QGraphicsItem>
+#include <QPixmap>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <vector>
+#include "occupancyhistory.h"
 
 
-class BikeItem :  public QObject, public QGraphicsPixmapItem
+/**
+  \brief Images de l'affichage, chargées une seule fois.
+
+  Les images sont lues depuis les ressources Qt (velo.qrc) et mises à
+  l'échelle au premier appel de instance(), puis partagées par tous les
+  éléments graphiques (QPixmap est partagé implicitement).
+  */
+class SpriteAtlas
+{
+public:
+    static const SpriteAtlas &instance();
+
+    QPixmap bike;
+    QPixmap van;
+    QVector<QPixmap> persons;
+
+private:
+    SpriteAtlas();
+};
+
+class BikeItem : public QGraphicsPixmapItem
 {
-    Q_OBJECT
-    Q_PROPERTY(QPointF pos READ pos WRITE setPos)
 public:
     BikeItem();
 
 };
 
 
-class PersonItem :  public QObject, public QGraphicsPixmapItem
+class PersonItem : public QGraphicsPixmapItem
 {
-    Q_OBJECT
-    Q_PROPERTY(QPointF pos READ pos WRITE setPos)
 public:
     PersonItem();
 
 };
 
+/**
+  \brief Couche dessinant l'occupation de tous les sites (mode grande ville).
+
+  Un seul élément graphique pour tous les sites : chaque site est un
+  glyphe (secteur proportionnel au taux d'occupation) au lieu d'un élément
+  par vélo. Seuls les sites de la zone exposée sont dessinés, et le niveau
+  de détail dépend du zoom.
+  */
+class SiteLayer : public QGraphicsItem
+{
+public:
+    SiteLayer(const QVector<QPointF> &pos,unsigned int nbSite,QRectF bounds);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter,const QStyleOptionGraphicsItem *option,
+               QWidget *widget) override;
+
+    void setCount(unsigned int site,unsigned int nbBike);
+    void setCapacity(unsigned int site,unsigned int capacity);
+
+private:
+    QRectF glyphRect(unsigned int site) const;
+
+    QVector<QPointF> m_pos;
+    QVector<unsigned int> m_count;
+    QVector<unsigned int> m_capacity;
+    unsigned int m_nbSite;
+    QRectF m_bounds;
+};
+
+/**
+  \brief Couche dessinant l'historique d'occupation de chaque site.
+
+  Une courbe (bande min-max) sous chaque site, toutes dessinées par un seul
+  élément et seulement dans la zone exposée. Les courbes ne sont dessinées
+  qu'à partir du niveau de détail minLod (mode grande ville).
+  */
+class SparklineLayer : public QGraphicsItem
+{
+public:
+    SparklineLayer(const QVector<QPointF> &pos,QSizeF size,qreal offset,
+                   qreal minLod,QRectF bounds);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter,const QStyleOptionGraphicsItem *option,
+               QWidget *widget) override;
+
+    void setSeries(unsigned int site,
+                   const std::vector<OccupancyHistory::Range> &series);
+
+private:
+    QRectF sparkRect(unsigned int site) const;
+
+    QVector<QPointF> m_pos;
+    QVector<std::vector<OccupancyHistory::Range>> m_series;
+    QSizeF m_size;
+    qreal m_offset;
+    qreal m_minLod;
+    QRectF m_bounds;
+};
+
+/**
+  \brief Couche dessinant toutes les personnes en déplacement (mode grande ville).
+
+  Chaque personne est un point, interpolé entre son départ et son arrivée.
+  advance() calcule les positions d'une image, paint() les dessine en un
+  seul appel par couleur.
+  */
+class MoverLayer : public QGraphicsItem
+{
+public:
+    MoverLayer(unsigned int nbPerson,QRectF bounds);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter,const QStyleOptionGraphicsItem *option,
+               QWidget *widget) override;
+
+    void setBounds(QRectF bounds);
+    void start(unsigned int personId,QPointF from,QPointF to,unsigned int ms,
+               bool riding);
+
+    //! Calcule les positions de l'image courante, faux si plus rien ne bouge
+    bool advance();
+
+private:
+    struct Mover {
+        unsigned int personId;
+        QPointF from;
+        QPointF to;
+        qint64 t0;
+        qint64 duration;
+        bool riding;
+    };
+
+    //! Les m_nbActive premiers enregistrements sont en route
+    QVector<Mover> m_movers;
+    int m_nbActive{0};
+    //! Indice de l'enregistrement de chaque personne, -1 si à l'arrêt
+    QVector<int> m_slot;
+    QVector<QPointF> m_riding;
+    QVector<QPointF> m_walking;
+    QElapsedTimer m_clock;
+    QRectF m_bounds;
+};
+
 class BikeDisplay : public QGraphicsView
 {
     Q_OBJECT
 public:
-    BikeDisplay(unsigned int nbSite,QWidget *parent=0);
+    BikeDisplay(unsigned int nbSite,unsigned int nbDepot,unsigned int nbPerson,
+                unsigned int nbBike,QWidget *parent=0);
     unsigned int m_nbSite;
+    unsigned int m_nbDepot;
     QList<BikeItem *> *m_sites;
     QPointF *m_sitePos;
+
+    //! Nombre de places d'un site, pour le glyphe du mode grande ville
+    void setSiteCapacity(unsigned int site,unsigned int capacity);
+
+    //! Historique d'occupation d'un site, affiché sous le site
+    void setSiteHistory(unsigned int site,
+                        const std::vector<OccupancyHistory::Range> &series);
+
+protected:
+    void drawBackground(QPainter *painter,const QRectF &rect) override;
+    void wheelEvent(QWheelEvent *event) override;
+
 private:
+    //! Mode grande ville : sites et personnes agrégés, voir SiteLayer
+    bool m_large;
+    double m_radius;
+    SiteLayer *m_siteLayer{nullptr};
+    MoverLayer *m_moverLayer{nullptr};
+    SparklineLayer *m_sparklines;
+
+    //! Action à la fin d'un déplacement
+    enum MoveEnd { MoveKeep, MoveFreeBike, MoveScatter };
+
+    //! Déplacement en cours d'un élément, interpolé à chaque image
+    struct Move {
+        QGraphicsItem *item;
+        QPointF from;
+        QPointF to;
+        qint64 t0;
+        qint64 duration;
+        MoveEnd end;
+    };
+
+    //! Enregistrements de déplacement, les m_nbMoves premiers sont actifs
+    QVector<Move> m_moves;
+    int m_nbMoves{0};
+    QElapsedTimer m_clock;
+    QTimer *m_frameTimer;
+
+    void startMove(QGraphicsItem *item,QPointF from,QPointF to,
+                   unsigned int ms,MoveEnd end);
+    void finishMove(const Move &move);
+
+    QRectF sceneBounds() const;
+    void startMover(unsigned int personId,unsigned int site1,
+                    unsigned int site2,unsigned int ms,bool riding);
+
     QList<BikeItem *>m_freeBikes;
     QList<BikeItem *>m_occupiedBikes;
     QGraphicsScene *m_scene;
     BikeItem *m_van;
     QList<PersonItem *> m_persons;
 
+    BikeItem *createBike();
     BikeItem *getFreeBike();
     void setFreeBike(BikeItem *bike);
 
@@ -57,9 +233,8 @@ public slots:
     void setPerson(unsigned int site, unsigned int personID);
     void travel(unsigned int personId,unsigned int site1, unsigned int site2,unsigned int ms);
     void walk(unsigned int personId,unsigned int site1, unsigned int site2,unsigned int ms);
-    void finishedAnimation();
     void vanTravel(unsigned int site1, unsigned int site2,unsigned int ms);
-    void finishedVanAnimation();
+    void advanceFrame();
 };
 
 #endif // DISPLAY_H
@@ -0,0 +1,217 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+#include <pcosynchro/pcomutex.h>
+
+/**
+ * @brief Severity of a log record.
+ */
+enum class LogLevel : uint8_t
+{
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Off = 3    ///< used as a level threshold only: nothing is logged
+};
+
+/**
+ * @brief Kind of actor a log record is about.
+ */
+enum class LogActor : uint8_t
+{
+    System = 0,
+    Person = 1,
+    Van = 2,
+    Station = 3
+};
+
+/**
+ * @brief Event codes. The meaning of the arguments is given per code.
+ */
+enum class LogEvent : uint16_t
+{
+    PersonPreference = 0, ///< args: preferred type
+    PersonTookBike,       ///< args: type, site
+    PersonDeposited,      ///< args: site
+    PersonBikeBroke,      ///< args: (none)
+    PersonExiting,        ///< args: (none)
+    VanLoaded,            ///< args: depot, number of bikes
+    VanUnloaded,          ///< args: depot, number of bikes
+    VanStopped,           ///< args: (none)
+    NbEvents
+};
+
+/**
+ * @brief Fixed-size binary log record (32 bytes).
+ *
+ * Records are created on the hot path and formatted only by the sinks.
+ */
+struct LogRecord
+{
+    uint64_t timestampNs;         ///< monotonic time since the log was created
+    uint32_t actorId;             ///< person or van identifier, site index...
+    uint16_t event;               ///< a LogEvent
+    uint8_t actor;                ///< a LogActor
+    uint8_t level;                ///< a LogLevel
+    std::array<uint32_t, 4> args; ///< event arguments
+};
+
+/**
+ * @brief Formats a record as one line of text (used by the text sinks).
+ */
+std::string formatLogRecord(const LogRecord& record);
+
+/**
+ * @brief Returns the site a record is about, or -1 if none.
+ */
+int logRecordSite(const LogRecord& record);
+
+/**
+ * @brief Destination of the log records, called by the logger thread only.
+ */
+class LogSink
+{
+public:
+    virtual ~LogSink() = default;
+
+    /**
+     * @brief Consumes a batch of records, in the order they were drained.
+     */
+    virtual void consume(const std::vector<LogRecord>& records) = 0;
+};
+
+/**
+ * @brief Sink discarding every record (measures logging overhead only).
+ */
+class NullLogSink : public LogSink
+{
+public:
+    void consume(const std::vector<LogRecord>&) override {}
+};
+
+/**
+ * @brief Sink appending formatted records to a text file.
+ */
+class FileLogSink : public LogSink
+{
+public:
+    /**
+     * @brief Opens (truncates) the output file.
+     *
+     * @param path Path of the log file.
+     */
+    FileLogSink(const std::string& path);
+    ~FileLogSink() override;
+
+    void consume(const std::vector<LogRecord>& records) override;
+
+private:
+    std::FILE* file;
+};
+
+/**
+ * @brief Asynchronous structured event log.
+ *
+ * Each thread pushes records into its own lock-free single-producer ring,
+ * registered the first time the thread logs. One logger thread (run())
+ * drains every ring and hands the records to the sinks, which format them.
+ * A record below the runtime level is never created, and a full ring drops
+ * the record instead of blocking the simulation.
+ */
+class EventLog
+{
+public:
+    EventLog();
+
+    /**
+     * @brief Sets the minimal level of the records to keep.
+     */
+    void setLevel(LogLevel level);
+
+    /**
+     * @brief Returns true if records of this level are kept. Lock-free.
+     */
+    bool enabled(LogLevel level) const
+    {
+        return (uint8_t)level >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Logs an event if its level is enabled.
+     *
+     * @param level Severity of the event.
+     * @param actor Kind of actor.
+     * @param actorId Identifier of the actor.
+     * @param event Event code.
+     * @param a0, a1, a2, a3 Event arguments (see LogEvent).
+     */
+    void log(LogLevel level, LogActor actor, uint32_t actorId, LogEvent event,
+             uint32_t a0 = 0, uint32_t a1 = 0, uint32_t a2 = 0, uint32_t a3 = 0)
+    {
+        if (!enabled(level)) return; // no record is built at all
+        push(level, actor, actorId, event, {a0, a1, a2, a3});
+    }
+
+    /**
+     * @brief Adds a sink. Must be called before run() is started.
+     *
+     * @param sink Sink, owned by the log from now on.
+     */
+    void addSink(std::unique_ptr<LogSink> sink);
+
+    /**
+     * @brief Main loop of the logger thread; drains the rings until
+     *        requestStop() is called, then drains them one last time.
+     */
+    void run();
+
+    /**
+     * @brief Asks run() to return after a last drain.
+     */
+    void requestStop();
+
+    /**
+     * @brief Number of records dropped because a ring was full.
+     */
+    uint64_t dropped() const;
+
+private:
+    /**
+     * @brief Single-producer single-consumer ring of records.
+     */
+    struct Ring {
+        static const size_t SIZE = 1024; // power of two
+        std::array<LogRecord, SIZE> records;
+        std::atomic<size_t> head{0};     // next slot written by the producer
+        std::atomic<size_t> tail{0};     // next slot read by the logger
+    };
+
+    void push(LogLevel level, LogActor actor, uint32_t actorId, LogEvent event,
+              const std::array<uint32_t, 4>& args);
+    Ring* threadRing();
+    size_t drain(std::vector<LogRecord>& batch);
+
+    std::atomic<uint8_t> minLevel;
+    std::atomic<bool> stopRequested{false};
+    std::atomic<uint64_t> droppedRecords{0};
+
+    PcoMutex mutex;                           // protects rings (registration only)
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::vector<std::unique_ptr<LogSink>> sinks;
+};
+
+/**
+ * @brief Event log of the running simulation (defined in eventlog.cpp).
+ */
+extern EventLog globalEventLog;
+
+#endif // EVENTLOG_H
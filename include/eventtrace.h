@@ -0,0 +1,297 @@
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pcosynchro/pcomutex.h>
+
+#include "bike.h"
+
+/**
+ * @brief Binary trace of every change of the stations, for replays and diffs.
+ *
+ * File layout: a TraceFileHeader, then chunks, each a TraceChunkHeader
+ * followed by bytes of one stream. A stream holds the records of one thread
+ * in order; its chunks appear in order in the file.
+ *
+ * A record is varint(delta << 4 | kind) followed by the varint fields of
+ * its kind (see TraceKind). delta is the time in nanoseconds since the
+ * previous record of the same stream (since the start of the trace for the
+ * first one). Station records are stamped under the station lock, so
+ * sorting all records by time gives the order of the operations on each
+ * station.
+ *
+ * A Gap record marks records the recorder had to drop. It is stamped at the
+ * time of the previous record of its stream: the trace holds every record
+ * up to the first gap, and only some of them after it.
+ */
+
+/**
+ * @brief Magic number and version of the layout, checked by the readers.
+ */
+const uint32_t TRACE_MAGIC = 0x50434f54; // "PCOT"
+const uint32_t TRACE_VERSION = 1;
+
+/**
+ * @brief Record kinds and their fields.
+ */
+enum class TraceKind : uint8_t
+{
+    Actor = 0,        ///< kind (LogActor), id: owner of the following records
+    StationInit,      ///< site, capacity, bikes per type, broken
+    Take,             ///< site, type: a rider takes a bike (trip start)
+    Put,              ///< site, type, broken: a bike is put back (trip end)
+    Add,              ///< site, bikes per type, broken: bulk add (van unload...)
+    Remove,           ///< site, bikes per type: bulk removal (van load...)
+    RemoveBroken,     ///< site, count: broken bikes collected
+    Ride,             ///< from, to, duration (ms): rider on a bike
+    Walk,             ///< from, to, duration (ms): rider walking
+    Drive,            ///< from, to, duration (ms): van driving
+    Gap,              ///< count: records of the stream dropped from here
+    NbKinds
+};
+
+/**
+ * @brief Header of a trace file.
+ */
+struct TraceFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nbSites;  ///< stations, depots included
+    uint32_t nbTypes;
+};
+
+/**
+ * @brief Header of a chunk of stream bytes.
+ */
+struct TraceChunkHeader
+{
+    uint32_t stream;
+    uint32_t bytes;
+};
+
+/**
+ * @brief One decoded record.
+ */
+struct TraceRecord
+{
+    uint64_t timeNs;    ///< since the start of the trace
+    uint32_t stream;
+    TraceKind kind;
+    uint8_t actor;      ///< LogActor of the stream at this record
+    uint32_t actorId;
+    uint32_t site;      ///< site, or origin of a move
+    uint32_t to;        ///< destination of a move
+    uint32_t value;     ///< type, capacity, count or duration (records dropped for a Gap)
+    std::array<uint32_t, Bike::nbBikeTypes> bikes; ///< per type counts
+    uint32_t broken;    ///< broken bikes (count or flag)
+};
+
+/**
+ * @brief Appends an unsigned LEB128 varint, returns the new end.
+ */
+inline uint8_t* traceVarint(uint8_t* _out, uint64_t _value)
+{
+    while (_value >= 0x80) {
+        *_out++ = (uint8_t)(_value | 0x80);
+        _value >>= 7;
+    }
+    *_out++ = (uint8_t)_value;
+    return _out;
+}
+
+/**
+ * @brief Recorder of the trace.
+ *
+ * Each thread encodes its records into its own lock-free single-producer
+ * byte ring, registered the first time the thread records. One writer
+ * thread (run()) moves the bytes of every ring into the file, which it
+ * maps in memory a window at a time. Records are made under the station
+ * locks, so a thread finding its ring full never waits for the writer: the
+ * record is dropped and counted (dropped()), and a Gap record with the
+ * number of records dropped is written before the next record of the
+ * thread, or at the end of the trace.
+ *
+ * Every record method returns at once while the trace is not open.
+ */
+class EventTrace
+{
+public:
+    EventTrace();
+    ~EventTrace();
+
+    /**
+     * @brief Creates the trace file; records are kept from now on.
+     *
+     * @param _path Path of the trace file.
+     * @param _nbSites Number of stations, depots included.
+     * @return False if the file could not be created (the error is printed).
+     */
+    bool open(const std::string& _path, uint32_t _nbSites);
+
+    /**
+     * @brief Returns true if records are kept. Lock-free.
+     */
+    bool enabled() const
+    {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Names the owner of the records of the calling thread.
+     *
+     * @param _actor A LogActor.
+     * @param _id Identifier of the actor.
+     */
+    void actor(uint8_t _actor, uint32_t _id);
+
+    void stationInit(uint32_t _site, uint32_t _capacity,
+                     const std::array<uint32_t, Bike::nbBikeTypes>& _bikes, uint32_t _broken);
+    void take(uint32_t _site, uint32_t _type);
+    void put(uint32_t _site, uint32_t _type, bool _broken);
+    void add(uint32_t _site, const std::array<uint32_t, Bike::nbBikeTypes>& _bikes, uint32_t _broken);
+    void remove(uint32_t _site, const std::array<uint32_t, Bike::nbBikeTypes>& _bikes);
+    void removeBroken(uint32_t _site, uint32_t _count);
+
+    /**
+     * @brief Records a move (Ride, Walk or Drive).
+     */
+    void move(TraceKind _kind, uint32_t _from, uint32_t _to, uint32_t _durationMs);
+
+    /**
+     * @brief Main loop of the writer thread; moves the bytes of the rings
+     *        to the file until requestStop() is called, then one last time.
+     */
+    void run();
+
+    /**
+     * @brief Asks run() to return after a last flush and closing the file.
+     */
+    void requestStop();
+
+    /**
+     * @brief Number of records dropped because a ring was full.
+     */
+    uint64_t dropped() const;
+
+private:
+    /**
+     * @brief Single-producer single-consumer ring of bytes.
+     */
+    struct Ring {
+        static const size_t SIZE = 64 * 1024; // power of two
+        std::array<uint8_t, SIZE> bytes;
+        std::atomic<size_t> head{0};           // next byte written by the producer
+        std::atomic<size_t> tail{0};           // next byte read by the writer
+        uint64_t lastNs = 0;                   // producer only: time of the last record
+        uint32_t stream = 0;
+        std::atomic<uint64_t> pendingDrops{0}; // dropped since the last record, read by the writer at the end
+    };
+
+    /**
+     * @brief Largest encoded record, with the Gap record that may precede it.
+     */
+    static const size_t MAX_RECORD = 16 + 10 * (4 + Bike::nbBikeTypes);
+
+    Ring* threadRing();
+
+    /**
+     * @brief Encodes one record into the ring of the calling thread.
+     */
+    void record(TraceKind _kind, const uint64_t* _fields, size_t _nbFields);
+
+    /**
+     * @brief Moves the pending bytes of every ring to the file (writer thread).
+     *
+     * @return Number of bytes moved.
+     */
+    size_t flush();
+
+    /**
+     * @brief Writes a Gap record for each ring whose last records were
+     *        dropped (writer thread, once the recording stopped).
+     */
+    void flushGaps();
+
+    /**
+     * @brief Copies bytes at the end of the file, mapping a new window if needed.
+     */
+    bool append(const void* _data, size_t _size);
+
+    /**
+     * @brief Unmaps the window and truncates the file to the bytes written.
+     */
+    void closeFile();
+
+    std::atomic<bool> active{false};
+    std::atomic<bool> stopRequested{false};
+    std::atomic<uint64_t> droppedRecords{0};
+    std::chrono::steady_clock::time_point start;
+
+    PcoMutex mutex;                          // protects rings
+    std::vector<std::unique_ptr<Ring>> rings;
+
+    // Writer thread only
+    int fd = -1;
+    uint8_t* window = nullptr;   // mapped part of the file
+    uint64_t windowOffset = 0;   // file offset of the window
+    uint64_t fileSize = 0;       // bytes written
+};
+
+/**
+ * @brief Trace file mapped in memory and decoded.
+ */
+class TraceReader
+{
+public:
+    /**
+     * @brief Reads a trace file.
+     *
+     * @param _path Path of the trace file.
+     * @param _error Receives the reason of a failure.
+     * @return False if the file is not a usable trace.
+     */
+    bool open(const std::string& _path, std::string& _error);
+
+    /**
+     * @brief Number of stations of the traced run.
+     */
+    uint32_t nbSites() const;
+
+    /**
+     * @brief All records, sorted by time.
+     */
+    const std::vector<TraceRecord>& records() const;
+
+    /**
+     * @brief Number of records dropped by the recorder (sum of the Gap
+     *        records), 0 for an exact trace.
+     */
+    uint64_t dropped() const;
+
+    /**
+     * @brief Time up to which the trace holds every record: that of the
+     *        first Gap record, UINT64_MAX for an exact trace.
+     */
+    uint64_t exactUntilNs() const;
+
+private:
+    uint32_t sites = 0;
+    std::vector<TraceRecord> decoded;
+    uint64_t droppedRecords = 0;
+    uint64_t firstGapNs = UINT64_MAX;
+};
+
+/**
+ * @brief Trace of the running simulation (defined in eventtrace.cpp).
+ */
+extern EventTrace globalTrace;
+
+#endif // EVENTTRACE_H
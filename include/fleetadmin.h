@@ -0,0 +1,112 @@
+#ifndef FLEETADMIN_H
+#define FLEETADMIN_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <pcosynchro/pcomutex.h>
+#include <pcosynchro/pcoconditionvariable.h>
+
+#include "bike.h"
+#include "bikestation.h"
+#include "config.h"
+
+/**
+ * @brief Fleet administration order: bikes to add or remove at a station.
+ */
+struct FleetOrder
+{
+    uint64_t id = 0;                              ///< given by FleetAdmin::submit()
+    unsigned int site = 0;                        ///< station index
+    std::array<int, Bike::nbBikeTypes> delta{};   ///< > 0 adds, < 0 removes, per type
+};
+
+/**
+ * @brief Outcome of an order, reported once it is done or timed out.
+ */
+struct FleetResult
+{
+    FleetOrder order;
+    std::array<int, Bike::nbBikeTypes> done{};    ///< bikes actually added/removed
+    bool complete = false;                        ///< false if timed out
+};
+
+/**
+ * @brief Background worker adding and removing bikes at the stations.
+ *
+ * Orders are queued by submit(), which never touches a station, and applied
+ * by run() in its own thread with the non-blocking station API (tryAddBikes(),
+ * getBikes()). An order that meets a full or empty station is retried every
+ * @ref FLEET_ADMIN_RETRY_MS, together with the other pending orders, until it
+ * is done or @ref FLEET_ADMIN_TIMEOUT_MS has elapsed. The completion callback
+ * is then called from the worker thread.
+ *
+ * The worker is registered with the simulation gate (see SimulationGate):
+ * a checkpoint waits for it to be idle or parked between two rounds of
+ * attempts, so no order changes a station while it is copied.
+ */
+class FleetAdmin
+{
+public:
+    using Callback = std::function<void(const FleetResult&)>;
+
+    /**
+     * @brief Constructs the worker for a set of stations.
+     *
+     * @param _stations All stations (sites + depots).
+     */
+    FleetAdmin(const std::array<BikeStation*, NB_SITES_TOTAL>& _stations);
+
+    /**
+     * @brief Sets the completion callback (before run() is started).
+     */
+    void setCallback(Callback _callback);
+
+    /**
+     * @brief Queues an order, returns at once.
+     *
+     * @param _site Station index.
+     * @param _delta Bikes to add (> 0) or remove (< 0) per type.
+     * @return Identifier of the order, found again in its FleetResult.
+     */
+    uint64_t submit(unsigned int _site, const std::array<int, Bike::nbBikeTypes>& _delta);
+
+    /**
+     * @brief Worker loop, returns once ending() has been called.
+     */
+    void run();
+
+    /**
+     * @brief Signals the end of the simulation and wakes up the worker.
+     *
+     * Pending orders are dropped without being reported.
+     */
+    void ending();
+
+private:
+    struct Pending
+    {
+        FleetResult result;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /**
+     * @brief One attempt on the station of an order, returns true once done.
+     */
+    bool apply(Pending& _pending);
+
+    std::array<BikeStation*, NB_SITES_TOTAL> stations;
+    Callback callback;
+
+    PcoMutex mutex;                   // protects orders, nextId and shouldEnd
+    PcoConditionVariable condWorker;  // worker waiting for an order
+    std::deque<FleetOrder> orders;
+    uint64_t nextId = 1;
+    bool shouldEnd = false;
+};
+
+#endif // FLEETADMIN_H
@@ -0,0 +1,26 @@
+#ifndef GUILOGSINK_H
+#define GUILOGSINK_H
+
+#include "eventlog.h"
+#include "bikinginterface.h"
+
+/**
+ * @brief Sink sending the records to the log view of the main window.
+ */
+class GuiLogSink : public LogSink
+{
+public:
+    /**
+     * @brief Constructs the sink.
+     *
+     * @param _binkingInterface Interface used to reach the consoles.
+     */
+    GuiLogSink(BikingInterface* _binkingInterface);
+
+    void consume(const std::vector<LogRecord>& records) override;
+
+private:
+    BikingInterface* binkingInterface;
+};
+
+#endif // GUILOGSINK_H
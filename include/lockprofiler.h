@@ -0,0 +1,233 @@
+#ifndef LOCKPROFILER_H
+#define LOCKPROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include <pcosynchro/pcomutex.h>
+#include <pcosynchro/pcoconditionvariable.h>
+
+/**
+ * @brief Critical sections of BikeStation, profiled separately.
+ */
+enum class LockSite : uint8_t
+{
+    PutBike = 0,
+    GetBike,
+    AddBikes,         ///< addBikes(), tryAddBikes()
+    GetBikes,         ///< getBikes(), getBrokenBikes()
+    CountBikesOfType,
+    NbBikes,          ///< nbBikes(), nbBrokenBikes()
+    Ending,
+    Other,            ///< administration: demand, targets, open, freeze...
+    NbSites
+};
+
+const size_t NB_LOCK_SITES = (size_t)LockSite::NbSites;
+
+/**
+ * @brief Name of a lock site, as in the reports.
+ */
+const char* lockSiteName(LockSite _site);
+
+/**
+ * @brief True if the build profiles the locks (PCO_LOCK_PROFILING defined,
+ *        CMake option WITH_LOCK_PROFILING).
+ */
+#ifdef PCO_LOCK_PROFILING
+const bool LOCK_PROFILING_ENABLED = true;
+#else
+const bool LOCK_PROFILING_ENABLED = false;
+#endif
+
+/**
+ * @brief Merged counters of one lock site of one station.
+ */
+struct LockProfileEntry
+{
+    long station;           ///< see ProfiledMutex::profileAs(), -1 if unknown
+    LockSite site;
+    uint64_t acquisitions;
+    uint64_t contended;     ///< acquisitions that found the lock taken
+    uint64_t waitNs;        ///< time spent waiting for the lock
+    uint64_t holdNs;        ///< time spent holding it (condition waits excluded)
+};
+
+/**
+ * @brief Collects the lock statistics of the profiled mutexes.
+ *
+ * Each thread counts in its own table, without any lock or shared write,
+ * and the tables are merged on demand by collect(). A table holds only the
+ * (mutex, lock site) pairs the thread used: it is an open-addressing hash
+ * table doubled when half full, so its size follows the locks a thread
+ * actually takes rather than the number of stations.
+ */
+class LockProfiler
+{
+public:
+    static const size_t MAX_LOCKS = 16384;   ///< the mutexes beyond share the last identifier
+    static const size_t INITIAL_SLOTS = 16;  ///< per thread, a power of two
+
+    LockProfiler() = default;
+    ~LockProfiler();
+    LockProfiler(const LockProfiler&) = delete;
+    LockProfiler& operator=(const LockProfiler&) = delete;
+
+    /**
+     * @brief Identifier of a new profiled mutex.
+     */
+    unsigned int newLock();
+
+    /**
+     * @brief Names a mutex after the station it protects.
+     */
+    void setStation(unsigned int _lock, size_t _station);
+
+    /**
+     * @brief Counts an acquisition by the calling thread.
+     */
+    void acquired(unsigned int _lock, LockSite _site, bool _contended, uint64_t _waitNs);
+
+    /**
+     * @brief Counts a holding time by the calling thread.
+     */
+    void held(unsigned int _lock, LockSite _site, uint64_t _holdNs);
+
+    /**
+     * @brief Counters of every thread merged, one entry per used lock site
+     *        and station, the longest total wait first.
+     */
+    std::vector<LockProfileEntry> collect() const;
+
+    /**
+     * @brief Writes the ranking of the lock sites, of the stations, and of
+     *        the @p _top hottest sites of a station.
+     */
+    void report(std::ostream& _out, size_t _top = 10) const;
+
+private:
+    struct Counters
+    {
+        // written by the owner thread only, read by collect()
+        std::atomic<uint64_t> acquisitions{0};
+        std::atomic<uint64_t> contended{0};
+        std::atomic<uint64_t> waitNs{0};
+        std::atomic<uint64_t> holdNs{0};
+    };
+
+    struct Slot
+    {
+        std::atomic<uint32_t> key{0}; // lock * NB_LOCK_SITES + site + 1, 0 if free
+        Counters counters;
+    };
+
+    struct Table
+    {
+        explicit Table(size_t _size) : size(_size), slots(new Slot[_size]) {}
+        size_t size;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    struct ThreadCounters
+    {
+        std::atomic<Table*> table{nullptr}; // the current one, read by collect()
+        size_t used = 0;                    // owner thread only
+        // current and outgrown tables, kept since collect() may still read them
+        std::vector<std::unique_ptr<Table>> tables;
+    };
+
+    Counters& counters(unsigned int _lock, LockSite _site);
+    ThreadCounters* threadCounters();
+    static Slot& findSlot(const Table& _table, uint32_t _key);
+    static Table* grow(ThreadCounters& _thread);
+
+    std::atomic<unsigned int> nextLock{0};
+    std::array<std::atomic<long>, MAX_LOCKS> stations{}; // station + 1, 0 if unknown
+    mutable PcoMutex mutex;                               // protects threads (registration only)
+    std::vector<std::unique_ptr<ThreadCounters>> threads;
+};
+
+/**
+ * @brief Lock statistics of the running simulation (defined in lockprofiler.cpp).
+ */
+extern LockProfiler globalLockProfiler;
+
+#ifdef PCO_LOCK_PROFILING
+
+/**
+ * @brief PcoMutex counting, per lock site, acquisitions, contended
+ *        acquisitions, wait and hold times in globalLockProfiler.
+ *
+ * Condition waits go through wait(), so that the time spent waiting for the
+ * condition is not counted as held.
+ */
+class ProfiledMutex : public PcoMutex
+{
+public:
+    ProfiledMutex() : id(globalLockProfiler.newLock()) {}
+
+    void lock(LockSite _site) {
+        bool contended = !trylock();
+        uint64_t waitNs = 0;
+        if (contended) {
+            uint64_t start = nowNs();
+            PcoMutex::lock();
+            waitNs = nowNs() - start;
+        }
+        heldSite = _site;
+        heldSince = nowNs();
+        globalLockProfiler.acquired(id, _site, contended, waitNs);
+    }
+
+    void unlock() {
+        LockSite site = heldSite;
+        uint64_t holdNs = nowNs() - heldSince;
+        PcoMutex::unlock();
+        globalLockProfiler.held(id, site, holdNs);
+    }
+
+    void wait(PcoConditionVariable& _condition) {
+        LockSite site = heldSite;
+        globalLockProfiler.held(id, site, nowNs() - heldSince);
+        _condition.wait(this);
+        heldSite = site;
+        heldSince = nowNs();
+    }
+
+    void profileAs(size_t _station) {
+        globalLockProfiler.setStation(id, _station);
+    }
+
+private:
+    static uint64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    const unsigned int id;
+    LockSite heldSite = LockSite::Other; // protected by the mutex itself
+    uint64_t heldSince = 0;
+};
+
+#else
+
+/**
+ * @brief Plain PcoMutex: lock profiling is compiled out.
+ */
+class ProfiledMutex : public PcoMutex
+{
+public:
+    void lock(LockSite) { PcoMutex::lock(); }
+    void wait(PcoConditionVariable& _condition) { _condition.wait(this); }
+    void profileAs(size_t) {}
+};
+
+#endif // PCO_LOCK_PROFILING
+
+#endif // LOCKPROFILER_H
@@ -0,0 +1,116 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QSortFilterProxyModel>
+#include <QMutex>
+#include <QString>
+#include <vector>
+#include "eventlog.h"
+
+/**
+ * @brief Bounded list model of the last log records, shown by a single view.
+ *
+ * Records are kept in a ring of fixed capacity: once full, each new record
+ * replaces the oldest one, so memory does not grow with the length of the run
+ * or the number of riders. Records stay binary and are formatted in data(),
+ * i.e. only for the rows the view actually paints.
+ *
+ * Any thread may post() records; they are buffered (also bounded) and
+ * inserted by flush(), called by the GUI thread once per frame.
+ */
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Custom roles exposing the fields used for filtering.
+     */
+    enum Roles {
+        ActorRole = Qt::UserRole, ///< LogActor of the record
+        ActorIdRole,              ///< actor identifier
+        SiteRole                  ///< site concerned by the record, -1 if none
+    };
+
+    /**
+     * @brief Creates an empty model.
+     *
+     * @param _capacity Maximum number of rows kept.
+     * @param _parent Parent object.
+     */
+    LogModel(int _capacity, QObject* _parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * @brief Buffers records for the next flush(). Thread-safe.
+     */
+    void post(const std::vector<LogRecord>& _records);
+
+    /**
+     * @brief Buffers a free text line, attributed to an actor. Thread-safe.
+     */
+    void postText(LogActor _actor, unsigned int _actorId, const QString& _text);
+
+    /**
+     * @brief Inserts the buffered records, dropping the oldest rows if needed.
+     *
+     * GUI thread only.
+     */
+    void flush();
+
+private:
+    struct Entry {
+        LogRecord record;
+        QString text; ///< empty for structured records
+    };
+
+    /**
+     * @brief Returns the entry shown at a given row.
+     */
+    const Entry& entryAt(int _row) const;
+
+    int capacity;
+    std::vector<Entry> ring; ///< reserved to capacity once
+    int first{0};            ///< ring index of row 0
+    int count{0};            ///< number of rows
+
+    QMutex pendingMutex;
+    std::vector<Entry> pending; ///< never larger than capacity
+    std::vector<Entry> incoming;
+};
+
+/**
+ * @brief Filter keeping the records of one person, the van or one station.
+ */
+class LogFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Kind of filter.
+     */
+    enum Mode { All, Person, Van, Station };
+
+    LogFilterModel(QObject* _parent = nullptr);
+
+    /**
+     * @brief Changes the filter.
+     *
+     * @param _mode Kind of filter.
+     * @param _id Person or station identifier, -1 for all of them.
+     */
+    void setFilter(Mode _mode, int _id);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+
+private:
+    Mode mode{All};
+    int id{-1};
+};
+
+#endif // LOGMODEL_H
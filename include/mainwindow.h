@@ -10,43 +10,77 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTextEdit>
 #include <QDockWidget>
+#include <QListView>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QTimer>
+#include <QLabel>
+#include <memory>
 #include "display.h"
+#include "occupancysnapshot.h"
+#include "logmodel.h"
+#include "fleetadmin.h"
 
 #include "config.h"
 #include "bikestation.h"
 #include "bike.h"
 
-extern std::array<BikeStation*, NB_SITES_TOTAL>* globalStations;
-
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
     MainWindow(unsigned int nbConsoles,unsigned int nbSite,
-               QWidget *parent = 0);
+               unsigned int nbDepot,unsigned int nbBike,QWidget *parent = 0);
     ~MainWindow();
 
-    QDockWidget **m_docks;
-    QTextEdit **m_consoles;
     BikeDisplay *m_display;
 
-    void setConsoleTitle(unsigned int consoleId,QString title);
+    //! Instantané partagé du nombre de vélos par site, écrit par les threads
+    OccupancySnapshot *occupancy();
+
+    //! Journal borné affiché par la vue de log, alimenté par les threads
+    LogModel *logModel();
 
 protected:
     unsigned int m_nbConsoles;
+    unsigned int m_nbSites;
     bool m_stopped{false};
+    QDockWidget *m_logDock;
+    QListView *m_logView;
+    QComboBox *m_logFilter;
+    QSpinBox *m_logFilterId;
+    LogModel *m_logModel;
+    LogFilterModel *m_logFilterModel;
+    std::unique_ptr<OccupancySnapshot> m_occupancy;
+    QTimer *m_frameTimer;
+    std::vector<unsigned int> m_changedSites;
+    QTimer *m_historyTimer;
+    QComboBox *m_historyRange;
+    std::vector<OccupancyHistory::Range> m_history;
+    QDockWidget *m_latencyDock;
+    QLabel *m_latencyLabel;
+    QDockWidget *m_availabilityDock;
+    QLabel *m_availabilityLabel;
+    QSpinBox *m_adminSite;
+    QComboBox *m_adminType;
+    QSpinBox *m_adminCount;
 
 private slots:
     void onStopClicked();
-    void onDepotPlusClicked();
-    void onDepotMinusClicked();
+    void onAdminAddClicked();
+    void onAdminRemoveClicked();
     void onEndClicked();
+    void refreshFrame();
+    void onLogFilterChanged();
+    void refreshHistory();
+    void refreshLatency();
+    void refreshAvailability();
 
 public slots:
     void consoleAppendText(unsigned int consoleId,QString text);
+    void fleetOrderDone(QString text);
     void setBikes(unsigned int site,unsigned int nbBike);
     void setPerson(unsigned int site, unsigned int personID);
     void travel(unsigned int personId,unsigned int site1, unsigned int site2,unsigned int ms);
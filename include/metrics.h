@@ -0,0 +1,89 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <chrono>
+
+#include <pcosynchro/pcomutex.h>
+
+/**
+ * @brief Counters describing a whole simulation run.
+ *
+ * All counters are atomic and updated with relaxed ordering, so any thread
+ * can update them without taking a lock. They are meant to compare runs,
+ * e.g. the van mileage needed for the same service level with and without
+ * rider incentives.
+ */
+struct SimulationMetrics
+{
+    std::atomic<uint64_t> tripsCompleted{0};     ///< bikes deposited by riders
+    std::atomic<uint64_t> riderWaits{0};         ///< riders who found no bike of their type
+    std::atomic<uint64_t> vanDistanceMilli{0};   ///< van mileage, thousandths of city radius
+    std::atomic<uint64_t> incentivesAccepted{0}; ///< riders who changed site for a bonus
+    std::atomic<uint64_t> bonusPointsPaid{0};    ///< bonus points earned by those riders
+    std::atomic<uint64_t> breakdowns{0};         ///< bikes that broke during a trip
+    std::atomic<uint64_t> repairs{0};            ///< bikes repaired at the depot
+
+    /**
+     * @brief Records a bike breaking down (unavailable until repaired).
+     */
+    void bikeBroken();
+
+    /**
+     * @brief Records a bike coming back from repair.
+     */
+    void bikeRepaired();
+
+    /**
+     * @brief Sets the number of broken bikes (restoring a checkpoint).
+     */
+    void setBrokenNow(size_t broken);
+
+    /**
+     * @brief Time-averaged share of the fleet that was not broken.
+     *
+     * @param fleetSize Number of bikes in the fleet.
+     * @return Availability in [0, 1].
+     */
+    double fleetAvailability(size_t fleetSize) const;
+
+    /**
+     * @brief Adds a distance driven by a van.
+     *
+     * @param distance Distance in city radius units.
+     */
+    void addVanDistance(double distance);
+
+    /**
+     * @brief Returns the total distance driven by vans, in city radius units.
+     */
+    double vanDistance() const;
+
+    /**
+     * @brief Writes a human readable summary of the run.
+     *
+     * @param out Output stream.
+     */
+    void report(std::ostream& out) const;
+
+private:
+    /**
+     * @brief Integrates the number of broken bikes over time. Mutex held.
+     */
+    void integrateUnavailable() const;
+
+    mutable PcoMutex mutex;                      // protects the fields below
+    size_t brokenNow = 0;                        ///< broken bikes right now
+    mutable double unavailableBikeSeconds = 0.0; ///< integral of brokenNow over time
+    mutable std::chrono::steady_clock::time_point lastChange = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+/**
+ * @brief Metrics of the running simulation (defined in metrics.cpp).
+ */
+extern SimulationMetrics globalMetrics;
+
+#endif // METRICS_H
@@ -0,0 +1,104 @@
+#ifndef MINCOSTFLOW_H
+#define MINCOSTFLOW_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Min-cost max-flow solver on a directed graph with integer costs.
+ *
+ * Uses the primal-dual method: a Dijkstra pass with node potentials computes
+ * shortest reduced distances, then a blocking flow is pushed along every arc
+ * whose reduced cost is zero. Arcs may have negative costs as long as the
+ * graph has no negative cycle (the initial potentials come from Bellman-Ford).
+ *
+ * Besides plain arcs, the graph accepts convex arcs: one arc whose k-th unit
+ * of flow costs unitCosts[k], with non-decreasing costs. A convex arc replaces
+ * k parallel unit arcs, which keeps the graph small when every unit has its
+ * own cost.
+ */
+class MinCostFlow
+{
+public:
+    /**
+     * @brief Creates an empty graph with a fixed number of nodes.
+     *
+     * @param _nbNodes Number of nodes, indexed in [0, _nbNodes).
+     */
+    MinCostFlow(size_t _nbNodes);
+
+    /**
+     * @brief Adds a directed arc with a constant cost per unit.
+     *
+     * @param _from Tail node.
+     * @param _to Head node.
+     * @param _capacity Capacity of the arc (>= 0).
+     * @param _cost Cost per unit of flow (may be negative).
+     * @return Identifier of the arc, to be passed to flowOn().
+     */
+    size_t addArc(size_t _from, size_t _to, int64_t _capacity, int64_t _cost);
+
+    /**
+     * @brief Adds a directed arc whose k-th unit costs @p _unitCosts[k].
+     *
+     * @param _from Tail node.
+     * @param _to Head node.
+     * @param _unitCosts Cost of each unit, must be non-decreasing.
+     * @return Identifier of the arc, to be passed to flowOn().
+     */
+    size_t addConvexArc(size_t _from, size_t _to, std::vector<int64_t> _unitCosts);
+
+    /**
+     * @brief Pushes the maximum flow of minimum cost from source to sink.
+     *
+     * @param _source Source node.
+     * @param _sink Sink node.
+     * @return Total amount of flow pushed.
+     */
+    int64_t solve(size_t _source, size_t _sink);
+
+    /**
+     * @brief Returns the flow carried by an arc after solve().
+     *
+     * @param _arcId Identifier returned by addArc() or addConvexArc().
+     */
+    int64_t flowOn(size_t _arcId) const;
+
+    /**
+     * @brief Returns the total cost of the flow computed by solve().
+     */
+    int64_t totalCost() const;
+
+private:
+    /**
+     * @brief Arc of the original graph; its residual arcs are 2*i and 2*i+1.
+     */
+    struct Arc {
+        size_t from;
+        size_t to;
+        int64_t capacity;
+        int64_t flow = 0;
+        int64_t cost;                   // unused for convex arcs
+        std::vector<int64_t> unitCosts; // empty for plain arcs
+    };
+
+    bool residual(size_t _residualId, size_t& _to, int64_t& _cost) const;
+    int64_t run(size_t _residualId) const;
+    void push(size_t _residualId, int64_t _amount);
+
+    void initPotentials(size_t _source);
+    bool dijkstra(size_t _source, size_t _sink);
+    int64_t augment(size_t _node, size_t _sink, int64_t _limit);
+
+    size_t nbNodes;
+    std::vector<Arc> arcs;
+    std::vector<std::vector<size_t>> adj;  // outgoing residual ids per node
+    std::vector<int64_t> potential;
+    std::vector<int64_t> dist;
+    std::vector<size_t> level;             // BFS depth in the admissible graph
+    std::vector<size_t> nextArc;           // current-arc pointer for blocking flow
+    int64_t cost = 0;
+};
+
+#endif // MINCOSTFLOW_H
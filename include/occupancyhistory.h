@@ -0,0 +1,88 @@
+#ifndef OCCUPANCYHISTORY_H
+#define OCCUPANCYHISTORY_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Fixed-memory occupancy history of one station at several resolutions.
+ *
+ * Three rings of buckets are kept: one per second for the last hour, one per
+ * minute for the last day and one per hour for the last weeks (sizes in
+ * config.h). Each bucket stores the minimum and maximum occupancy seen
+ * during its period, quantized to 8 bits of the station capacity, so the
+ * memory used never grows with the length of the run.
+ *
+ * record() is called by one writer at a time (the station, with its mutex
+ * held) and only performs atomic stores. read() may be called from any
+ * thread at any time without locking; a concurrent read may mix old and new
+ * buckets, which is acceptable for display.
+ */
+class OccupancyHistory
+{
+public:
+    /**
+     * @brief Available resolutions.
+     */
+    enum Resolution { Seconds = 0, Minutes, Hours, NbResolutions };
+
+    /**
+     * @brief Occupancy range of one bucket, as a fraction of the capacity.
+     */
+    struct Range
+    {
+        float min;
+        float max;
+    };
+
+    /**
+     * @brief Creates an empty history (all buckets at 0 bikes).
+     *
+     * @param _capacity Capacity of the station, used for quantization.
+     */
+    OccupancyHistory(size_t _capacity);
+
+    /**
+     * @brief Records the current number of bikes. Lock-free, single writer.
+     *
+     * @param _nbBikes Number of occupied slots.
+     */
+    void record(size_t _nbBikes);
+
+    /**
+     * @brief Reads the last buckets of a resolution, oldest first. Lock-free.
+     *
+     * @param _resolution Resolution to read.
+     * @param _count Number of buckets wanted (capped by the ring size).
+     * @param _out Receives the buckets; its capacity is reused.
+     */
+    void read(Resolution _resolution, size_t _count, std::vector<Range>& _out) const;
+
+    /**
+     * @brief Number of buckets kept for a resolution.
+     */
+    static size_t ringSize(Resolution _resolution);
+
+private:
+    struct Level
+    {
+        size_t size;
+        int64_t periodMs;
+        std::unique_ptr<std::atomic<uint16_t>[]> buckets; // max << 8 | min
+        std::atomic<int64_t> lastIndex{0};                 // last bucket written
+    };
+
+    /**
+     * @brief Quantizes a number of bikes to 0..255.
+     */
+    uint8_t quantize(size_t _nbBikes) const;
+
+    size_t capacity;
+    std::array<Level, NbResolutions> levels;
+    std::atomic<uint8_t> current{0}; // last quantized value
+};
+
+#endif // OCCUPANCYHISTORY_H
@@ -0,0 +1,62 @@
+#ifndef OCCUPANCYSNAPSHOT_H
+#define OCCUPANCYSNAPSHOT_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Shared, double-buffered view of the number of bikes per site.
+ *
+ * Simulation threads write the latest count of a site into the back buffer
+ * with publish(), a single relaxed atomic store. The GUI thread pulls the
+ * back buffer at a fixed rate with collectChanges(), which copies it into
+ * its front buffer and returns only the sites whose count changed since the
+ * previous frame. The cost per frame is bounded by the number of sites,
+ * whatever the number of events published in between. No shared counter
+ * tells the GUI that something was published: each publish() only writes
+ * the slot of its site, and the GUI scans every slot at each frame anyway.
+ */
+class OccupancySnapshot
+{
+public:
+    /**
+     * @brief Creates a snapshot for a given number of sites (depots included).
+     *
+     * @param _nbSites Number of sites.
+     */
+    OccupancySnapshot(unsigned int _nbSites);
+
+    /**
+     * @brief Publishes the current number of bikes of a site. Lock-free.
+     *
+     * @param _site Site index.
+     * @param _nbBikes Number of bikes at the site.
+     */
+    void publish(unsigned int _site, unsigned int _nbBikes);
+
+    /**
+     * @brief Copies the back buffer into the front buffer (GUI thread only).
+     *
+     * @param _changed Receives the sites whose count changed since the last call.
+     * @return False if no count changed since the last call.
+     */
+    bool collectChanges(std::vector<unsigned int>& _changed);
+
+    /**
+     * @brief Number of bikes of a site in the front buffer (GUI thread only).
+     */
+    unsigned int count(unsigned int _site) const;
+
+    /**
+     * @brief Number of sites.
+     */
+    unsigned int nbSites() const;
+
+private:
+    unsigned int sites;
+    std::unique_ptr<std::atomic<unsigned int>[]> back; // written by the simulation
+    std::vector<unsigned int> front;                   // last frame drawn by the GUI
+};
+
+#endif // OCCUPANCYSNAPSHOT_H
@@ -5,6 +5,8 @@
 #include "config.h"
 #include "bikestation.h"
 #include "bikinginterface.h"
+#include "checkpoint.h"
+#include "columnarexporter.h"
 
 /**
  * @brief Simulates an person using the bike-sharing system.
@@ -18,6 +20,11 @@
 class Person
 {
 public:
+    /**
+     * @brief Step of the loop the person is about to perform.
+     */
+    enum class Phase : uint8_t { Taking, Riding, Depositing, Walking };
+
     /**
      * @brief Constructs an person with a given identifier.
      *
@@ -28,6 +35,32 @@ public:
      */
     Person(unsigned int _id);
 
+    /**
+     * @brief Constructs a person from a checkpoint.
+     *
+     * @param _record Saved state of the person.
+     * @param _bike Bike held by the person (null if none).
+     */
+    Person(const CheckpointRider& _record, Bike* _bike);
+
+    /**
+     * @brief Saved state of the person.
+     *
+     * Only meaningful while the simulation is paused (see SimulationGate):
+     * the person is then parked or waiting in a station.
+     */
+    CheckpointRider checkpointState() const;
+
+    /**
+     * @brief Identifier of the person.
+     */
+    unsigned int identifier() const;
+
+    /**
+     * @brief Site where the person is.
+     */
+    unsigned int site() const;
+
     /**
      * @brief Main loop of the person.
      *
@@ -50,6 +83,13 @@ public:
      */
     static void setStations(const std::array<BikeStation*, NB_SITES_TOTAL>& _stations);
 
+    /**
+     * @brief Sets the exporter receiving the completed trips.
+     *
+     * @param _columnarExporter Pointer to the exporter (may be null).
+     */
+    static void setColumnarExporter(ColumnarExporter* _columnarExporter);
+
 private:
     /**
      * @brief Chooses a random site different from the given one.
@@ -59,6 +99,21 @@ private:
      */
     unsigned int chooseOtherSite(unsigned int _from) const;
 
+    /**
+     * @brief Chooses the next site, taking station bonuses into account.
+     *
+     * The person first picks an intended site with chooseOtherSite(). When
+     * incentives are enabled, any other site may be chosen instead if its
+     * bonus outweighs the extra distance to the intended site
+     * (see @ref INCENTIVE_POINTS_PER_UNIT).
+     *
+     * @param _from Origin site index.
+     * @param _returning True to return a bike (return bonus), false to walk to
+     *        the site of the next take (take bonus).
+     * @return Index of the chosen site.
+     */
+    unsigned int chooseDestination(unsigned int _from, bool _returning) const;
+
     /**
      * @brief Computes a random travel time for a bike trip.
      *
@@ -105,6 +160,15 @@ private:
      */
     void bikeTo(unsigned int _dest, Bike* _bike);
 
+    /**
+     * @brief Adds the wear of one trip to a bike and may break it.
+     *
+     * The bike breaks with probability wear * @ref BREAKDOWN_PROBABILITY_PER_WEAR.
+     *
+     * @param _bike Bike that has just been ridden.
+     */
+    void wearBike(Bike* _bike);
+
     /**
      * @brief Simulates walking from the current site to a destination.
      *
@@ -115,11 +179,16 @@ private:
     void walkTo(unsigned int _dest);
 
     /**
-     * @brief Writes a message to the user interface console if available.
+     * @brief Records an event about this person in the event log.
+     *
+     * Nothing is recorded if @p _level is disabled.
      *
-     * @param _msg Message to log.
+     * @param _event Event code.
+     * @param _a0, _a1 Event arguments (see LogEvent).
+     * @param _level Severity of the event.
      */
-    void log(const QString& _msg) const;
+    void log(LogEvent _event, uint32_t _a0 = 0, uint32_t _a1 = 0,
+             LogLevel _level = LogLevel::Info) const;
 
     /**
      * @brief Unique identifier of the person.
@@ -143,6 +212,34 @@ private:
      */
     unsigned int currentSite;
 
+    /**
+     * @brief Next step of the loop, with its destination and bike.
+     */
+    Phase phase = Phase::Taking;
+    unsigned int destination = 0;
+    Bike* bike = nullptr;
+
+    /**
+     * @brief Site and time (ColumnarExporter::elapsedMs()) where the current
+     *        trip started; tripOrigin is @ref NB_SITES_TOTAL if unknown
+     *        (trip resumed from a checkpoint).
+     */
+    unsigned int tripOrigin = NB_SITES_TOTAL;
+    uint32_t tripStart = 0;
+
+    /**
+     * @brief Time (TripLatency::nowUs()) when the person asked for the bike
+     *        of the current trip.
+     */
+    uint64_t tripBeginUs = 0;
+
+    /**
+     * @brief Copy of the random generator of the thread at the last safe point.
+     */
+    uint64_t rngSeed = 0;
+    uint64_t rngCounter = 0;
+    bool restoredRng = false;
+
     /**
      * @brief User interface shared by all people (may be null).
      */
@@ -152,6 +249,11 @@ private:
      * @brief Shared array of bike stations for all sites and the depot.
      */
     static std::array<BikeStation*, NB_SITES_TOTAL> stations;
+
+    /**
+     * @brief Columnar exporter shared by all people (may be null).
+     */
+    static ColumnarExporter* columnarExporter;
 };
 
 #endif // PERSON_H
@@ -0,0 +1,111 @@
+#ifndef REBALANCEOPTIMIZER_H
+#define REBALANCEOPTIMIZER_H
+
+#include <array>
+#include <vector>
+#include <atomic>
+
+#include <pcosynchro/pcomutex.h>
+
+#include "config.h"
+#include "bike.h"
+#include "bikestation.h"
+
+/**
+ * @brief Computes a target inventory per (site, type) for the van.
+ *
+ * The optimizer periodically collects rider demand and the time spent empty
+ * or full from every site, smooths them into per-period rates and solves a
+ * min-cost-flow problem that places the whole fleet over the sites and the
+ * depot. The resulting targets are published and read by the van through
+ * target().
+ *
+ * It is meant to run in its own thread (see run()) so riders never wait for it.
+ */
+class RebalanceOptimizer
+{
+public:
+    /**
+     * @brief State of one site as seen by the optimizer.
+     */
+    struct SiteState {
+        size_t capacity = 0;                                ///< number of docks
+        std::array<size_t, Bike::nbBikeTypes> bikes{};      ///< current bikes per type
+        std::array<double, Bike::nbBikeTypes> takeRate{};   ///< bikes taken per period
+        std::array<double, Bike::nbBikeTypes> returnRate{}; ///< bikes returned per period
+        std::array<double, Bike::nbBikeTypes> missRate{};   ///< riders waiting per period
+        std::array<double, Bike::nbBikeTypes> emptyShare{}; ///< time without a bike of the type
+        double fullShare = 0.0;                             ///< time without a free dock
+    };
+
+    /**
+     * @brief Target inventory of one site, per bike type.
+     */
+    using SiteTarget = std::array<size_t, Bike::nbBikeTypes>;
+
+    /**
+     * @brief Constructs the optimizer over the given stations.
+     *
+     * @param _stations Array of pointers to all stations (sites + depots).
+     */
+    RebalanceOptimizer(const std::array<BikeStation*, NB_SITES_TOTAL>& _stations);
+
+    /**
+     * @brief Main loop: collects demand and recomputes targets every
+     *        @ref OPTIMIZER_PERIOD_MS until requestStop() is called.
+     */
+    void run();
+
+    /**
+     * @brief Asks run() to return as soon as possible.
+     */
+    void requestStop();
+
+    /**
+     * @brief Indicates whether targets have been published at least once.
+     */
+    bool hasTargets() const;
+
+    /**
+     * @brief Returns the published target of a site.
+     *
+     * @param _site Site index (0..NBSITES-1).
+     * @return Number of bikes per type the van should leave at the site.
+     */
+    SiteTarget target(unsigned int _site) const;
+
+    /**
+     * @brief Solves the placement problem for a set of sites.
+     *
+     * Each bike of type t placed as the k-th of its type at site s earns a
+     * benefit decreasing in k and proportional to the demand for t at s.
+     * Leaving a bike where it already is earns a small bonus (no move), and
+     * the first bike of each type earns a bonus so every type stays available.
+     * Bikes that earn nothing stay at the depot. A type often missing at a
+     * site weighs more there, and a site often full keeps more free docks.
+     *
+     * @param _sites State of every site.
+     * @param _depotStock Bikes per type currently at the depots.
+     * @return Target per site, in the same order as @p _sites.
+     */
+    static std::vector<SiteTarget> computeTargets(const std::vector<SiteState>& _sites,
+                                                  const std::array<size_t, Bike::nbBikeTypes>& _depotStock);
+
+private:
+    /**
+     * @brief Collects demand, updates the smoothed rates and publishes new targets.
+     */
+    void optimizeOnce();
+
+    std::array<BikeStation*, NB_SITES_TOTAL> stations;
+    std::vector<SiteState> sites;  // smoothed rates, only touched by run()
+    std::vector<StationAvailability> lastAvailability; // at the previous period
+
+    mutable PcoMutex mutex;        // protects targets and published
+    std::vector<SiteTarget> targets;
+    bool published = false;
+
+    std::atomic<bool> stopRequested{false};
+};
+
+#endif // REBALANCEOPTIMIZER_H
@@ -0,0 +1,86 @@
+#ifndef REPAIRSHOP_H
+#define REPAIRSHOP_H
+
+#include <vector>
+#include <deque>
+#include <atomic>
+
+#include <pcosynchro/pcomutex.h>
+#include <pcosynchro/pcoconditionvariable.h>
+
+#include "bike.h"
+#include "bikestation.h"
+
+/**
+ * @brief Repair shop attached to a depot.
+ *
+ * Vans drop broken bikes into a FIFO repair queue. A pool of repair workers,
+ * each running workerRun() in its own thread, repairs them one at a time and
+ * puts the repaired bikes back into the depot stock.
+ */
+class RepairShop
+{
+public:
+    /**
+     * @brief Constructs a repair shop returning repaired bikes to a depot.
+     *
+     * @param _depot Depot station receiving repaired bikes.
+     */
+    RepairShop(BikeStation* _depot);
+
+    /**
+     * @brief Adds broken bikes to the repair queue and wakes up workers.
+     *
+     * @param _bikes Broken bikes dropped by a van.
+     */
+    void submit(const std::vector<Bike*>& _bikes);
+
+    /**
+     * @brief Main loop of a repair worker.
+     *
+     * Waits for a broken bike, repairs it (@ref REPAIR_TIME_MS) and adds it
+     * back to the depot stock, retrying every @ref REPAIR_RETRY_MS while the
+     * depot is full. Returns once ending() has been called.
+     */
+    void workerRun();
+
+    /**
+     * @brief Signals the end of the simulation and wakes up all workers.
+     */
+    void ending();
+
+    /**
+     * @brief Number of bikes waiting in the repair queue.
+     */
+    size_t queueLength() const;
+
+    /**
+     * @brief Number of bikes currently being repaired.
+     */
+    size_t inRepair() const;
+
+    /**
+     * @brief Copies the bikes in the queue, then the ones held by workers.
+     *
+     * Only meaningful while the simulation is paused (see SimulationGate).
+     */
+    std::vector<Bike*> contents() const;
+
+private:
+    /**
+     * @brief True once ending() has been called.
+     */
+    bool isEnding() const;
+
+    BikeStation* depot;
+
+    mutable PcoMutex mutex;              // protects queue and shouldEnd
+    PcoConditionVariable condWorkers;    // workers waiting for a bike
+    std::deque<Bike*> queue;
+    std::vector<Bike*> held;             // taken by a worker, not yet in the depot
+    bool shouldEnd = false;
+
+    std::atomic<size_t> repairing{0};
+};
+
+#endif // REPAIRSHOP_H
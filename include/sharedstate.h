@@ -0,0 +1,146 @@
+#ifndef SHAREDSTATE_H
+#define SHAREDSTATE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "bike.h"
+
+/**
+ * @brief Layout of the POSIX shared-memory segment exported by the simulation.
+ *
+ * The segment starts with a SharedStateHeader, followed by nbSites
+ * SharedStationState. It is written by one thread of the simulation
+ * (StateExporter) and may be mapped read-only by any number of processes.
+ *
+ * Consistency uses a sequence lock: the writer makes the sequence odd,
+ * writes, then makes it even again. A reader copies the data and retries if
+ * the sequence was odd or changed meanwhile (see readSharedState()). Readers
+ * never write to the segment, so the simulation does not know they exist.
+ */
+
+/**
+ * @brief Usual name of the shared-memory segment, read by default by the
+ *        monitor. The simulation only exports under the name given to
+ *        --state-name.
+ */
+const char* const SHARED_STATE_NAME = "/pco_biking";
+
+/**
+ * @brief Magic number and version of the layout, checked by the readers.
+ */
+const uint32_t SHARED_STATE_MAGIC = 0x50434f42; // "PCOB"
+const uint32_t SHARED_STATE_VERSION = 1;
+
+/**
+ * @brief Maximum number of vans described in the segment.
+ */
+const uint32_t SHARED_STATE_MAX_VANS = 16;
+
+/**
+ * @brief Exported state of one station (regular site or depot).
+ */
+struct SharedStationState
+{
+    uint32_t bikes[Bike::nbBikeTypes]; ///< available bikes per type
+    uint32_t broken;                   ///< broken bikes occupying a slot
+    uint32_t slots;                    ///< capacity
+    uint32_t waitingTakers;            ///< riders waiting for a bike
+    uint32_t waitingPutters;           ///< riders waiting for a free slot
+};
+
+/**
+ * @brief Exported state of one van.
+ */
+struct SharedVanState
+{
+    uint32_t fromSite; ///< site the van left (or is parked at)
+    uint32_t toSite;   ///< site the van is driving to
+    uint32_t cargo;    ///< bikes in the van
+};
+
+/**
+ * @brief Header of the segment: identification, sequence and global counters.
+ */
+struct SharedStateHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nbSites; ///< stations after the header, depots included
+    uint32_t nbDepots;
+    uint32_t nbTypes;
+    uint32_t nbVans;
+    std::atomic<uint64_t> sequence; ///< odd while the writer is updating
+
+    // Protected by the sequence
+    uint64_t timestampMs;      ///< time of the last publication since start
+    uint64_t tripsCompleted;
+    uint64_t riderWaits;
+    uint64_t breakdowns;
+    uint64_t repairs;
+    uint64_t vanDistanceMilli; ///< thousandths of city radius
+    SharedVanState vans[SHARED_STATE_MAX_VANS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the sequence must be lock-free to live in shared memory");
+
+/**
+ * @brief Size in bytes of a segment for a given number of stations.
+ */
+inline size_t sharedStateSize(uint32_t nbSites)
+{
+    return sizeof(SharedStateHeader) + nbSites * sizeof(SharedStationState);
+}
+
+/**
+ * @brief Stations following the header.
+ */
+inline const SharedStationState* sharedStations(const SharedStateHeader* header)
+{
+    return reinterpret_cast<const SharedStationState*>(header + 1);
+}
+
+/**
+ * @brief Consistent copy of the segment, as read by a monitor.
+ */
+struct SharedStateCopy
+{
+    SharedStateHeader header;
+    std::vector<SharedStationState> stations;
+};
+
+/**
+ * @brief Reads a consistent copy of the segment (seqlock read side).
+ *
+ * @param _segment Mapped segment.
+ * @param _copy Receives the copy; its capacity is reused.
+ * @param _maxTries Attempts before giving up while the writer is busy.
+ * @return False if no consistent copy could be made.
+ */
+inline bool readSharedState(const SharedStateHeader* _segment, SharedStateCopy& _copy,
+                            unsigned int _maxTries = 100)
+{
+    const uint32_t nbSites = _segment->nbSites;
+    _copy.stations.resize(nbSites);
+
+    for (unsigned int i = 0; i < _maxTries; ++i) {
+        uint64_t before = _segment->sequence.load(std::memory_order_acquire);
+        if (before & 1) continue; // writer busy
+
+        // Plain copy, validated by the sequence check below
+        std::memcpy(static_cast<void*>(&_copy.header), _segment, sizeof(SharedStateHeader));
+        std::memcpy(_copy.stations.data(), sharedStations(_segment),
+                    nbSites * sizeof(SharedStationState));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_segment->sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // SHAREDSTATE_H
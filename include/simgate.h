@@ -0,0 +1,102 @@
+#ifndef SIMGATE_H
+#define SIMGATE_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+#include <pcosynchro/pcomutex.h>
+#include <pcosynchro/pcoconditionvariable.h>
+
+/**
+ * @brief Brings the simulation threads to a consistent point (checkpoints).
+ *
+ * Every thread changing the simulation state (people, vans, repair workers,
+ * fleet administration) is registered by join() before it is started, so a
+ * thread that has not run yet is already waited for, and calls leave() when
+ * it returns. It calls safePoint() wherever its whole state is described by
+ * its members, and surrounds its idle waits with beginIdle() / endIdle().
+ *
+ * After requestPause(), threads reaching a safe point (or leaving an idle
+ * wait) park until resume(). The other threads are either idle or waiting
+ * inside a frozen station (see BikeStation::setFrozen()). waitQuiescent()
+ * returns once every registered thread is in one of these states: nothing
+ * can move until resume().
+ *
+ * safePoint() costs one atomic load when no pause is requested.
+ */
+class SimulationGate
+{
+public:
+    /**
+     * @brief Registers a thread, called by its creator before starting it.
+     */
+    void join();
+
+    /**
+     * @brief Unregisters the calling thread (it is returning).
+     */
+    void leave();
+
+    /**
+     * @brief Parks the calling thread while a pause is requested.
+     */
+    void safePoint()
+    {
+        if (pausing.load(std::memory_order_acquire)) park();
+    }
+
+    /**
+     * @brief The calling thread starts waiting for work (counts as parked).
+     */
+    void beginIdle();
+
+    /**
+     * @brief The calling thread has work again; parks while a pause is requested.
+     */
+    void endIdle();
+
+    /**
+     * @brief Asks the registered threads to park at their next safe point.
+     */
+    void requestPause();
+
+    /**
+     * @brief Waits until every registered thread is parked, idle or waiting
+     *        in a station.
+     *
+     * @param waiting Returns the number of threads waiting in the stations.
+     * @param timeoutMs Maximum waiting time in milliseconds.
+     * @return False on timeout or at the end of the simulation (the pause is
+     *         still requested, call resume()).
+     */
+    bool waitQuiescent(const std::function<size_t()>& waiting, unsigned int timeoutMs);
+
+    /**
+     * @brief Ends the pause and wakes up the parked threads.
+     */
+    void resume();
+
+    /**
+     * @brief Signals the end of the simulation; safe points no longer park.
+     */
+    void ending();
+
+private:
+    void park();
+
+    std::atomic<bool> pausing{false};
+    PcoMutex mutex;                  // protects the fields below
+    PcoConditionVariable condParked; // threads parked by the pause
+    size_t registered = 0;
+    size_t parked = 0;
+    size_t idle = 0;
+    bool shouldEnd = false;
+};
+
+/**
+ * @brief Gate of the running simulation (defined in simgate.cpp).
+ */
+extern SimulationGate globalGate;
+
+#endif // SIMGATE_H
@@ -0,0 +1,46 @@
+#ifndef SIMTIME_H
+#define SIMTIME_H
+
+/**
+ * @brief Sets the speed factor of the simulation (2 = twice as fast).
+ *
+ * Applies to every simulated delay (trips, van drives, repairs, optimizer
+ * period) from the next delay on. Values <= 0 are ignored. Thread-safe.
+ *
+ * @param _factor New speed factor.
+ */
+void setSpeedFactor(double _factor);
+
+/**
+ * @brief Returns the current speed factor. Thread-safe.
+ */
+double speedFactor();
+
+/**
+ * @brief Removes every simulated delay (benchmarks): scaledMs() then
+ *        returns 0, whatever the speed factor. Thread-safe.
+ *
+ * @param _compressed True to remove the delays, false to restore them.
+ */
+void setTimeCompressed(bool _compressed);
+
+/**
+ * @brief Converts a simulated duration into a real duration.
+ *
+ * @param _ms Simulated duration in milliseconds.
+ * @return Real duration in milliseconds (at least 1, 0 if time is
+ *         compressed).
+ */
+unsigned int scaledMs(unsigned int _ms);
+
+/**
+ * @brief Sleeps for a real duration already returned by scaledMs().
+ *
+ * Used when no user interface performs the delay (headless runs). A zero
+ * duration only yields the processor.
+ *
+ * @param _realMs Duration in milliseconds.
+ */
+void sleepMs(unsigned int _realMs);
+
+#endif // SIMTIME_H
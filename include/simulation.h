@@ -0,0 +1,41 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "config.h"
+
+class BikeStation;
+class PcoThread;
+class RebalanceOptimizer;
+class RepairShop;
+class StateExporter;
+class ControlServer;
+class FleetAdmin;
+class TripFeed;
+
+/**
+ * @brief Parts of the running simulation reached by stopSimulation(), the
+ *        GUI and the control socket (defined in simulation.cpp).
+ *
+ * Set by main() (or a benchmark) once the parts exist; null when absent.
+ */
+extern std::array<BikeStation*, NB_SITES_TOTAL>* globalStations;
+extern std::vector<std::unique_ptr<PcoThread>>* globalThreads;
+extern RebalanceOptimizer* globalOptimizer;
+extern RepairShop* globalRepairShop;
+extern StateExporter* globalStateExporter;
+extern ControlServer* globalControlServer;
+extern FleetAdmin* globalFleetAdmin;
+extern TripFeed* globalTripFeed;
+
+/**
+ * @brief Stops every thread of the simulation and releases the waiting ones.
+ *
+ * Callable from any thread (GUI, control socket), any number of times.
+ */
+void stopSimulation();
+
+#endif // SIMULATION_H
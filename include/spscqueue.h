@@ -0,0 +1,58 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer and one consumer.
+ *
+ * @tparam T Element type (copied or moved in and out).
+ * @tparam N Capacity, a power of two.
+ */
+template<typename T, size_t N>
+class SpscQueue
+{
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    /**
+     * @brief Adds an element (producer thread only).
+     *
+     * @return False if the queue is full.
+     */
+    bool push(T _value)
+    {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head - tailIndex.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        slots[head % N] = std::move(_value);
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest element (consumer thread only).
+     *
+     * @return False if the queue is empty.
+     */
+    bool pop(T& _value)
+    {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail == headIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        _value = std::move(slots[tail % N]);
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, N> slots;
+    std::atomic<size_t> headIndex{0}; // next slot written by the producer
+    std::atomic<size_t> tailIndex{0}; // next slot read by the consumer
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,89 @@
+#ifndef STATEEXPORTER_H
+#define STATEEXPORTER_H
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#include "config.h"
+#include "bikestation.h"
+#include "sharedstate.h"
+
+/**
+ * @brief Publishes the live state of the simulation into POSIX shared memory.
+ *
+ * A dedicated thread (run()) copies the lock-free counters of the stations,
+ * the van positions and the run metrics into the segment every
+ * @ref EXPORT_PERIOD_MS, under a sequence lock (see sharedstate.h). The cost
+ * for the simulation is this one periodic copy, whatever the number of
+ * processes reading the segment.
+ */
+class StateExporter
+{
+public:
+    /**
+     * @brief Prepares the exporter, the segment is created by open().
+     *
+     * @param _name Name of the shared-memory segment (starts with '/').
+     * @param _stations All stations (sites + depots).
+     */
+    StateExporter(const std::string& _name,
+                  const std::array<BikeStation*, NB_SITES_TOTAL>& _stations);
+
+    /**
+     * @brief Unmaps and removes the segment.
+     */
+    ~StateExporter();
+
+    /**
+     * @brief Creates and maps the segment.
+     *
+     * An existing segment of the same name, which may belong to another
+     * run, is left alone: open() fails instead of taking it over.
+     *
+     * @return False if the segment could not be created (the error is printed).
+     */
+    bool open();
+
+    /**
+     * @brief Records the position of a van. Lock-free, called by the van.
+     *
+     * @param _vanId Van identifier (ignored beyond @ref SHARED_STATE_MAX_VANS).
+     * @param _from Site the van leaves.
+     * @param _to Site the van drives to.
+     * @param _cargo Bikes in the van.
+     */
+    void setVanPosition(unsigned int _vanId, unsigned int _from, unsigned int _to, size_t _cargo);
+
+    /**
+     * @brief Publishing loop, runs in its own thread until requestStop().
+     */
+    void run();
+
+    /**
+     * @brief Asks run() to return after its next publication.
+     */
+    void requestStop();
+
+private:
+    /**
+     * @brief Writes the current state into the segment.
+     */
+    void publish();
+
+    struct VanPosition
+    {
+        std::atomic<uint32_t> from{DEPOT_ID};
+        std::atomic<uint32_t> to{DEPOT_ID};
+        std::atomic<uint32_t> cargo{0};
+    };
+
+    std::string name;
+    std::array<BikeStation*, NB_SITES_TOTAL> stations;
+    std::array<VanPosition, SHARED_STATE_MAX_VANS> vans;
+    std::atomic<uint32_t> nbVans{0};
+    SharedStateHeader* segment = nullptr;
+    std::atomic<bool> stopRequested{false};
+};
+
+#endif // STATEEXPORTER_H
@@ -0,0 +1,116 @@
+#ifndef TRACEREPLAYER_H
+#define TRACEREPLAYER_H
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "bike.h"
+#include "bikestation.h"
+#include "eventtrace.h"
+
+/**
+ * @brief Re-drives fresh BikeStation objects from a recorded trace.
+ *
+ * Stations are created by their StationInit records, then every station
+ * record is applied with the same BikeStation operation as in the recorded
+ * run, in the order of the trace. Bikes are anonymous: a bike taken at one
+ * station is the one of the same type put back later. An operation the
+ * recorded state cannot explain (e.g. a take at an empty station) is
+ * skipped and counted as a mismatch instead of blocking. Past the first Gap
+ * record of a trace (see TraceReader::exactUntilNs()), some operations are
+ * missing: the others are still applied, but no longer counted as
+ * mismatches when they do not fit.
+ *
+ * Moves (Ride, Walk, Drive) change no station; they are only passed to the
+ * observer, e.g. to animate BikeDisplay.
+ */
+class TraceReplayer
+{
+public:
+    /**
+     * @brief Prepares the replay of a trace.
+     *
+     * @param _trace Trace to replay; must outlive the replayer.
+     */
+    explicit TraceReplayer(const TraceReader& _trace);
+
+    /**
+     * @brief Deletes the replayed stations and their bikes.
+     */
+    ~TraceReplayer();
+
+    /**
+     * @brief Sets the function called after each applied record.
+     *
+     * Called from the thread running the replay.
+     */
+    void setObserver(std::function<void(const TraceRecord&)> _observer);
+
+    /**
+     * @brief Sets the replay speed.
+     *
+     * @param _speed Recorded time divided by replay time (2 = twice as fast);
+     *        0 replays without waiting.
+     */
+    void setSpeed(double _speed);
+
+    /**
+     * @brief Applies the next record.
+     *
+     * @return False once every record was applied.
+     */
+    bool step();
+
+    /**
+     * @brief Applies every remaining record at the replay speed, until the
+     *        end of the trace or requestStop().
+     */
+    void run();
+
+    /**
+     * @brief Asks run() to return.
+     */
+    void requestStop();
+
+    /**
+     * @brief Replayed stations, indexed by site (nullptr before their init).
+     */
+    const std::vector<BikeStation*>& stations() const;
+
+    /**
+     * @brief Number of records applied so far.
+     */
+    size_t position() const;
+
+    /**
+     * @brief Number of records that could not be applied, before the first
+     *        gap of the trace.
+     */
+    size_t mismatches() const;
+
+private:
+    /**
+     * @brief A bike out of the stations, of the given type.
+     */
+    Bike* takeLoose(size_t _type);
+
+    /**
+     * @brief Applies a station record, false if it does not fit the state.
+     */
+    bool apply(const TraceRecord& _record);
+
+    const TraceReader& trace;
+    std::vector<BikeStation*> replayed;
+    std::vector<std::unique_ptr<Bike>> bikes;                // every bike created
+    std::array<std::vector<Bike*>, Bike::nbBikeTypes> loose; // out of the stations
+    std::function<void(const TraceRecord&)> observer;
+    double speed = 0;
+    size_t next = 0;
+    size_t mismatchCount = 0;
+    std::atomic<bool> stopRequested{false};
+};
+
+#endif // TRACEREPLAYER_H
@@ -0,0 +1,207 @@
+#ifndef TRIPFEED_H
+#define TRIPFEED_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <pcosynchro/pcomutex.h>
+#include <pcosynchro/pcoconditionvariable.h>
+
+#include "bikestation.h"
+#include "config.h"
+
+class BikingInterface;
+class ColumnarExporter;
+
+/**
+ * @brief Columns of a trip file (0-based).
+ *
+ * Times are Unix times in seconds (a fraction is allowed) or UTC dates
+ * "YYYY-MM-DD HH:MM:SS" ('T' separator and fraction allowed). Bike types
+ * are numbers (taken modulo Bike::nbBikeTypes) or names, numbered in order
+ * of first appearance.
+ */
+struct TripColumns
+{
+    size_t start = 0;       ///< start time of the trip
+    size_t origin = 1;      ///< real identifier of the origin station
+    size_t destination = 2; ///< real identifier of the destination station
+    size_t type = 3;        ///< bike type
+    long end = -1;          ///< end time of the trip, -1 if the file has none
+};
+
+/**
+ * @brief Parses a column list "start,origin,destination,type[,end]".
+ *
+ * @return False if the list is malformed.
+ */
+bool parseTripColumns(const char* _text, TripColumns& _columns);
+
+/**
+ * @brief One recorded trip, mapped to simulation sites.
+ */
+struct Trip
+{
+    int64_t startMs;      ///< recorded start time (ms since the Unix epoch)
+    uint32_t rideMs;      ///< recorded length of the ride (ms)
+    uint32_t origin;      ///< site
+    uint32_t destination; ///< site
+    uint32_t bikeType;
+};
+
+/**
+ * @brief Reads a CSV trip file mapped in memory, one trip at a time.
+ *
+ * Fields are views into the mapping: no line is copied. Pages already read
+ * are released, so files larger than memory can be streamed.
+ */
+class TripReader
+{
+public:
+    TripReader();
+    ~TripReader();
+
+    /**
+     * @brief Maps the trip file and the station table.
+     *
+     * The station table has one "real identifier,site" line per station;
+     * lines starting with '#' and lines whose site is not a number (a
+     * header) are ignored.
+     *
+     * @param _tripsPath Trip file (CSV, optional header line).
+     * @param _mapPath Station table (CSV).
+     * @param _columns Columns of the trip file.
+     * @param _error Receives the reason of a failure.
+     * @return False if a file cannot be read or the table is invalid.
+     */
+    bool open(const std::string& _tripsPath, const std::string& _mapPath,
+              const TripColumns& _columns, std::string& _error);
+
+    /**
+     * @brief Reads the next trip; lines that cannot be used are counted
+     *        and skipped.
+     *
+     * @param _trip Receives the trip.
+     * @return False at the end of the file.
+     */
+    bool next(Trip& _trip);
+
+    /**
+     * @brief Lines skipped because a station is not in the table.
+     */
+    uint64_t unmapped() const;
+
+    /**
+     * @brief Lines skipped because a field is missing or invalid.
+     */
+    uint64_t malformed() const;
+
+private:
+    /**
+     * @brief Splits the line at the cursor into fields, moves past it.
+     *
+     * @return Number of fields (at most fields.size()).
+     */
+    size_t splitLine();
+
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t cursor = 0;
+    size_t released = 0;           // bytes given back to the system
+    uint64_t lineNumber = 0;
+    TripColumns columns;
+    std::array<std::string_view, 16> fields;
+
+    std::string mapText;           // owns the keys of sites
+    std::unordered_map<std::string_view, uint32_t> sites;
+    std::unordered_map<std::string_view, uint32_t> typeNames; // keys in the trip file
+    uint64_t unmappedLines = 0;
+    uint64_t malformedLines = 0;
+};
+
+/**
+ * @brief Riders driven by a recorded trip file instead of random choices.
+ *
+ * A feed thread (run()) reads the trips in order and hands each one, at its
+ * recorded time, to a pool of rider threads (riderRun()). A rider takes a
+ * bike of the recorded type at the origin (waiting like any rider if there
+ * is none), rides for the recorded length and docks at the destination.
+ *
+ * With a speed of 0 the feed runs in virtual time: trips are handed out as
+ * soon as a rider is free and rides take no time. Otherwise the recorded
+ * time is divided by the speed (600 = ten recorded minutes per second).
+ *
+ * Trip riders do not take part in checkpoints.
+ */
+class TripFeed
+{
+public:
+    /**
+     * @brief Constructs a feed for the given stations.
+     */
+    TripFeed(std::array<BikeStation*, NB_SITES_TOTAL> _stations);
+
+    /**
+     * @brief Opens the trip file (see TripReader::open()).
+     */
+    bool open(const std::string& _tripsPath, const std::string& _mapPath,
+              const TripColumns& _columns, std::string& _error);
+
+    /**
+     * @brief Sets the replay speed (recorded seconds per real second, 0 for
+     *        virtual time). Must be called before run().
+     */
+    void setSpeed(double _speed);
+
+    /**
+     * @brief Feed thread: hands out the trips until the end of the file or
+     *        ending().
+     */
+    void run();
+
+    /**
+     * @brief Rider thread: performs trips until ending().
+     *
+     * @param _riderId Identifier of the rider in the user interface.
+     */
+    void riderRun(unsigned int _riderId);
+
+    /**
+     * @brief Stops the feed and wakes up the riders.
+     */
+    void ending();
+
+    /**
+     * @brief Number of trips completed so far.
+     */
+    uint64_t completed() const;
+
+    static void setInterface(BikingInterface* _binkingInterface);
+
+    /**
+     * @brief Sets the exporter receiving the completed trips (may be null).
+     */
+    static void setColumnarExporter(ColumnarExporter* _columnarExporter);
+
+private:
+    static BikingInterface* binkingInterface;
+    static ColumnarExporter* columnarExporter;
+
+    std::array<BikeStation*, NB_SITES_TOTAL> stations;
+    TripReader reader;
+    double speed = 0;
+
+    PcoMutex mutex;                      // protects queue and shouldEnd
+    PcoConditionVariable condRiders;     // riders waiting for a trip
+    PcoConditionVariable condFeed;       // feed waiting for room in the queue
+    std::deque<Trip> queue;
+    bool shouldEnd = false;
+    std::atomic<uint64_t> completedTrips{0};
+};
+
+#endif // TRIPFEED_H
@@ -0,0 +1,193 @@
+#ifndef TRIPLATENCY_H
+#define TRIPLATENCY_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+/**
+ * @brief Phases of a rider journey, timed separately.
+ */
+enum class TripPhase : uint8_t
+{
+    WaitBike = 0, ///< waiting for a bike of the wanted type at the origin
+    Ride,
+    WaitDock,     ///< waiting for a free dock at the destination
+    Walk,
+    Trip,         ///< end to end: from asking for a bike to docking it
+    NbPhases
+};
+
+const size_t NB_TRIP_PHASES = (size_t)TripPhase::NbPhases;
+
+/**
+ * @brief Name of a phase, as in the reports and exports.
+ */
+const char* tripPhaseName(TripPhase _phase);
+
+/**
+ * @brief Log-linear histogram of durations in microseconds.
+ *
+ * Each power of two is split into SUB_BUCKETS buckets, so a percentile is
+ * known within 1 / SUB_BUCKETS of its value, from 1 us to about 4 hours.
+ * Histograms of the same layout add up, whatever the runs or threads that
+ * filled them.
+ */
+class LatencyHistogram
+{
+public:
+    static const size_t SUB_BUCKETS = 8;
+    static const size_t OCTAVES = 32;
+    static const size_t NB_BUCKETS = SUB_BUCKETS * OCTAVES;
+
+    /**
+     * @brief Bucket of a duration (the longest ones share the last bucket).
+     */
+    static size_t bucketOf(uint64_t _us);
+
+    /**
+     * @brief Duration reported for a bucket (its middle), in microseconds.
+     */
+    static uint64_t bucketValue(size_t _bucket);
+
+    void add(uint64_t _us, uint64_t _count = 1);
+
+    /**
+     * @brief Adds the counts of another histogram.
+     */
+    void merge(const LatencyHistogram& _other);
+
+    uint64_t count() const;
+
+    /**
+     * @brief Duration below which a share @p _q of the samples falls
+     *        (0.5 = median), in microseconds; 0 if empty.
+     */
+    uint64_t percentile(double _q) const;
+
+    std::array<uint64_t, NB_BUCKETS> buckets{};
+
+private:
+    uint64_t total = 0;
+};
+
+/**
+ * @brief Journey phase durations of the riders, per phase and per pair of
+ *        stations.
+ *
+ * The riders record their phases without any lock: a sample is one relaxed
+ * increment in the histogram of its phase, and one in the histogram of its
+ * pair of stations. The pairs are kept in an open-addressing table of
+ * PAIR_SLOTS slots, allocated on their first trip; beyond MAX_PAIRS pairs,
+ * the samples of new pairs only count in the phase histograms. Readers may
+ * read at any time; a concurrent read may miss the samples being added.
+ * A trip (wait for a bike, ride, wait for a dock) is counted for its
+ * origin and destination, a walk for the stations it links.
+ */
+class TripLatency
+{
+public:
+    static const size_t MAX_PAIRS = 1024;             ///< pairs with their own histograms
+    static const size_t PAIR_SLOTS = 2 * MAX_PAIRS;   ///< table at most half full
+    TripLatency() = default;
+    ~TripLatency();
+    TripLatency(const TripLatency&) = delete;
+    TripLatency& operator=(const TripLatency&) = delete;
+
+    /**
+     * @brief Monotonic clock used to time the phases, in microseconds.
+     */
+    static uint64_t nowUs();
+
+    /**
+     * @brief Records the duration of a phase. Lock-free.
+     *
+     * @param _phase Phase that just ended.
+     * @param _from, _to Stations of the trip or walk.
+     * @param _us Duration in microseconds.
+     */
+    void record(TripPhase _phase, unsigned int _from, unsigned int _to, uint64_t _us);
+
+    /**
+     * @brief Durations of a phase, every pair of stations merged.
+     */
+    LatencyHistogram phase(TripPhase _phase) const;
+
+    /**
+     * @brief Durations of a phase between two stations.
+     */
+    LatencyHistogram pair(TripPhase _phase, unsigned int _from, unsigned int _to) const;
+
+    /**
+     * @brief Number of samples of the pairs beyond MAX_PAIRS, counted in
+     *        phase() only.
+     */
+    uint64_t untracked() const;
+
+    /**
+     * @brief Writes p50/p95/p99 of each phase, and the @p _top pairs with
+     *        the slowest trips (p95).
+     */
+    void report(std::ostream& _out, size_t _top = 10) const;
+
+    /**
+     * @brief Writes the percentiles of each phase and of each used pair to
+     *        a CSV file.
+     *
+     * @param _path Output file.
+     * @param _error Receives the reason of a failure.
+     * @return False if the file could not be written.
+     */
+    bool exportCsv(const std::string& _path, std::string& _error) const;
+
+private:
+    // one relaxed increment per sample
+    using Counters = std::array<std::array<std::atomic<uint32_t>, LatencyHistogram::NB_BUCKETS>,
+                                NB_TRIP_PHASES>;
+
+    struct PairHistograms
+    {
+        explicit PairHistograms(uint32_t _key) : key(_key) {}
+        const uint32_t key; // from * NB_SITES_TOTAL + to
+        Counters phases{};
+    };
+
+    /**
+     * @brief Adds the counters of a phase to a histogram.
+     */
+    static void addTo(const Counters& _counters, TripPhase _phase, LatencyHistogram& _out);
+
+    /**
+     * @brief Histograms of a pair, allocated on its first trip; nullptr once
+     *        MAX_PAIRS pairs are used.
+     */
+    PairHistograms* findOrAdd(uint32_t _key);
+
+    /**
+     * @brief Histograms of a pair, nullptr if it has none.
+     */
+    const PairHistograms* find(uint32_t _key) const;
+
+    /**
+     * @brief Pairs with histograms, by origin then destination.
+     */
+    std::vector<const PairHistograms*> usedPairs() const;
+
+    Counters phases{}; // every pair merged
+    std::array<std::atomic<PairHistograms*>, PAIR_SLOTS> pairs{};
+    std::atomic<size_t> nbPairs{0};
+    std::atomic<uint64_t> untrackedSamples{0};
+};
+
+/**
+ * @brief Journey phases of the running simulation (defined in triplatency.cpp).
+ */
+extern TripLatency globalTripLatency;
+
+#endif // TRIPLATENCY_H
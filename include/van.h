@@ -3,17 +3,26 @@
 
 #include <vector>
 #include <array>
+#include <atomic>
 #include "config.h"
 #include "bikestation.h"
 #include "bikinginterface.h"
+#include "rebalanceoptimizer.h"
+#include "repairshop.h"
+#include "stateexporter.h"
+#include "checkpoint.h"
 
 /**
- * @brief Simulates the van that rebalances bikes between sites and the depot.
+ * @brief Simulates the van that rebalances bikes between sites and the depots.
  *
  * The van regularly:
- *  - loads bikes at the depot,
+ *  - loads bikes at the cheapest depot that has bikes,
  *  - drives to each site to remove surplus bikes or drop missing ones,
- *  - returns to the depot with remaining bikes.
+ *  - returns to the cheapest depot that has room for its remaining bikes,
+ *  - moves bikes from an over-stocked depot to an under-stocked one.
+ *
+ * Broken bikes found at the sites are collected first and dropped at the
+ * repair shop when the van returns to a depot.
  */
 class Van
 {
@@ -27,17 +36,50 @@ public:
      */
     Van(unsigned int _id);
 
+    /**
+     * @brief Constructs a van from a checkpoint.
+     *
+     * The van resumes its tour at the saved site of the tour.
+     *
+     * @param _record Saved state of the van.
+     * @param _cargo Cargo, stacked type by type, then the broken bikes.
+     */
+    Van(const CheckpointVan& _record, const std::vector<Bike*>& _cargo);
+
+    /**
+     * @brief Saved state of the van.
+     *
+     * Only meaningful while the simulation is paused (see SimulationGate).
+     *
+     * @param _cargo Receives the cargo, stacked type by type, then the
+     *        broken bikes.
+     */
+    CheckpointVan checkpointState(std::vector<Bike*>& _cargo) const;
+
+    /**
+     * @brief Identifier of the van.
+     */
+    unsigned int identifier() const;
+
     /**
      * @brief Main loop of the van.
      *
      * Repeatedly:
-     *  - loads bikes at the depot,
+     *  - loads bikes at a depot,
      *  - visits sites to balance bike counts,
-     *  - returns to the depot.
+     *  - returns to a depot and rebalances the depots.
      * This function is usually run in its own thread and never returns.
      */
     void run();
 
+    /**
+     * @brief Asks the van to leave the service.
+     *
+     * The van finishes its current tour, unloads at a depot, then run()
+     * returns. Thread-safe.
+     */
+    void retire();
+
     /**
      * @brief Sets the user interface used to display van actions.
      *
@@ -48,21 +90,56 @@ public:
     /**
      * @brief Sets the array of bike stations used by the van.
      *
-     * @param _stations Array of pointers to all stations (sites + depot).
+     * @param _stations Array of pointers to all stations (sites + depots).
      */
     static void setStations(const std::array<BikeStation*, NB_SITES_TOTAL>& _stations);
 
+    /**
+     * @brief Sets the optimizer providing per-site, per-type targets.
+     *
+     * Without optimizer (or before its first result) the van keeps the
+     * default target of BORNES - 2 bikes per site.
+     *
+     * @param _optimizer Pointer to the optimizer (may be null).
+     */
+    static void setOptimizer(RebalanceOptimizer* _optimizer);
+
+    /**
+     * @brief Sets the repair shop receiving the broken bikes.
+     *
+     * @param _repairShop Pointer to the repair shop (may be null: broken
+     *        bikes are then left at the sites).
+     */
+    static void setRepairShop(RepairShop* _repairShop);
+
+    /**
+     * @brief Sets the exporter publishing the van positions.
+     *
+     * @param _stateExporter Pointer to the exporter (may be null).
+     */
+    static void setStateExporter(StateExporter* _stateExporter);
+
+    /**
+     * @brief Asks every van to stop after its current tour.
+     *
+     * Needed when the vans carry nothing: an empty van never sees the
+     * stations refuse its bikes, which is how it otherwise detects the end.
+     */
+    static void requestStop();
+
 private:
     /**
-     * @brief Writes a message about the van to the user interface console.
+     * @brief Records an event about the van in the event log.
      *
-     * @param msg Message to log.
+     * @param _event Event code.
+     * @param _a0, _a1 Event arguments (see LogEvent).
      */
-    void log(const QString& msg) const;
+    void log(LogEvent _event, uint32_t _a0 = 0, uint32_t _a1 = 0) const;
 
     /**
      * @brief Simulates driving the van from the current site to a destination site.
      *
+     * The driving time is proportional to the distance between both sites.
      * Notifies the user interface and updates @ref currentSite.
      *
      * @param _dest Destination site index.
@@ -70,41 +147,114 @@ private:
     void driveTo(unsigned int _dest);
 
     /**
-     * @brief Loads bikes from the depot into the van.
+     * @brief Chooses the depot to drive to.
      *
-     * Clears the current cargo, drives to the depot if necessary,
-     * and takes a limited number of bikes from the depot station.
+     * Picks the nearest depot from @ref currentSite that can serve the request:
+     * one with bikes when loading, one with enough free slots for the cargo when
+     * unloading. Falls back to the nearest depot if none qualifies.
+     *
+     * @param _loading True to load bikes, false to unload the cargo.
+     * @return Site index of the chosen depot.
+     */
+    unsigned int chooseDepot(bool _loading) const;
+
+    /**
+     * @brief Loads bikes from a depot into the van.
+     *
+     * Drives to the chosen depot if necessary, puts back the bikes left in
+     * the cargo when there is room, and takes the per-type load given by
+     * planDepotLoad().
      */
     void loadAtDepot();
 
+    /**
+     * @brief Returns the target of a site.
+     *
+     * @param _site Site index.
+     * @param _typeTarget Receives the number of bikes wanted per type.
+     * @param _total Receives the total number of bikes wanted.
+     * @return True if @p _typeTarget are exact per-type targets (optimizer),
+     *         false if they are only per-type minimums (default target).
+     */
+    bool siteTarget(unsigned int _site, RebalanceOptimizer::SiteTarget& _typeTarget,
+                    unsigned int& _total) const;
+
+    /**
+     * @brief Plans how many bikes of each type to load at a depot.
+     *
+     * Walks the upcoming route and follows, per type, the cargo balance
+     * (surplus picked up minus deficits dropped); the load of a type is the
+     * largest shortfall along the route. Loads are capped by the depot stock
+     * and shared fairly between types up to @ref VAN_CAPACITY.
+     *
+     * @param _depot Depot the van loads from.
+     * @return Number of bikes to load per type.
+     */
+    std::array<size_t, Bike::nbBikeTypes> planDepotLoad(BikeStation* _depot) const;
+
     /**
      * @brief Balances the number of bikes at a given site.
      *
      * If the site has more bikes than the target, the van takes some bikes.
-     * If the site has fewer bikes than the target, the van drops bikes from its cargo.
+     * If the site has fewer bikes than the target, the van drops bikes from its cargo,
+     * starting with the types that are furthest below their per-type target.
      *
      * @param _s Index of the site to balance.
      */
     void balanceSite(unsigned int _s);
 
     /**
-     * @brief Returns to the depot and drops all remaining bikes.
+     * @brief Loads the broken bikes of a site, within the free space of the van.
      *
-     * Any bikes still in the cargo are added back to the depot station.
+     * @param _site Index of the site.
+     */
+    void collectBrokenBikes(unsigned int _site);
+
+    /**
+     * @brief Returns to a depot and drops all remaining bikes.
+     *
+     * Any bikes still in the cargo are added back to the chosen depot station,
+     * broken bikes go to the repair shop.
      */
     void returnToDepot();
 
     /**
-     * @brief Takes a bike of a given type from the van cargo.
+     * @brief Moves bikes from the current depot to the most under-stocked one.
      *
-     * Searches the cargo for a bike of @p type, removes it if found,
-     * and returns it.
+     * Depots are balanced proportionally to their capacity. Nothing is moved
+     * unless the imbalance is at least one full van load. The van never waits
+     * for a free slot: bikes the target depot cannot take stay in the cargo.
+     */
+    void rebalanceDepots();
+
+    /**
+     * @brief Takes a bike of a given type from the van cargo in O(1).
      *
      * @param type Desired bike type index.
      * @return Pointer to the bike if found, nullptr otherwise.
      */
     Bike* takeBikeFromCargo(size_t type);
 
+    /**
+     * @brief Puts a bike on the stack of its type in the cargo.
+     */
+    void addToCargo(Bike* _bike);
+
+    /**
+     * @brief Returns the number of bikes in the cargo, broken ones excluded.
+     */
+    size_t cargoSize() const;
+
+    /**
+     * @brief Returns the free space in the van (broken bikes take space too).
+     */
+    size_t freeSpace() const;
+
+    /**
+     * @brief Empties the cargo and returns all its bikes.
+     */
+    std::vector<Bike*> unloadCargo();
+
     /**
      * @brief Identifier of the van.
      */
@@ -113,14 +263,29 @@ private:
     /**
      * @brief Site where the van is currently located.
      *
-     * Initialized to @ref DEPOT_ID.
+     * Initialized to @ref DEPOT_ID (main depot).
      */
     unsigned int currentSite;
 
     /**
-     * @brief Collection of bikes currently loaded in the van.
+     * @brief Next site of the current tour, @ref NBSITES between two tours.
+     */
+    unsigned int tourSite = NBSITES;
+
+    /**
+     * @brief Bikes currently loaded in the van, one stack per type.
      */
-    std::vector<Bike*> cargo;
+    std::array<std::vector<Bike*>, Bike::nbBikeTypes> cargo;
+
+    /**
+     * @brief Broken bikes collected for the repair shop.
+     */
+    std::vector<Bike*> brokenCargo;
+
+    /**
+     * @brief Set by retire().
+     */
+    std::atomic<bool> retired{false};
 
     /**
      * @brief User interface shared by all vans (may be null).
@@ -128,11 +293,26 @@ private:
     static BikingInterface* binkingInterface;
 
     /**
-     * @brief Shared array of bike stations for all sites and the depot.
+     * @brief Shared array of bike stations for all sites and the depots.
      */
     static std::array<BikeStation*, NB_SITES_TOTAL> stations;
 
-    static bool stopVanRequested;
+    /**
+     * @brief Optimizer shared by all vans (may be null).
+     */
+    static RebalanceOptimizer* optimizer;
+
+    /**
+     * @brief Repair shop shared by all vans (may be null).
+     */
+    static RepairShop* repairShop;
+
+    /**
+     * @brief Live state exporter shared by all vans (may be null).
+     */
+    static StateExporter* stateExporter;
+
+    static std::atomic<bool> stopVanRequested;
 
 };
 
@@ -0,0 +1,63 @@
+#ifndef VANFLEET_H
+#define VANFLEET_H
+
+#include <memory>
+#include <vector>
+
+#include <pcosynchro/pcomutex.h>
+#include <pcosynchro/pcothread.h>
+
+#include "van.h"
+
+/**
+ * @brief Owns the vans and their threads, and changes their number at runtime.
+ *
+ * Vans get increasing identifiers. Removing vans retires the most recent
+ * ones (see Van::retire()); their threads are joined by joinAll().
+ */
+class VanFleet
+{
+public:
+    VanFleet();
+
+    /**
+     * @brief Starts or retires vans until @p _count vans are in service.
+     *
+     * @param _count Wanted number of vans (capped by @ref MAX_VANS).
+     * @return Number of vans in service.
+     */
+    size_t setCount(size_t _count);
+
+    /**
+     * @brief Number of vans in service.
+     */
+    size_t count();
+
+    /**
+     * @brief Starts vans restored from a checkpoint (before setCount()).
+     *
+     * @param _vans Vans to put in service.
+     */
+    void restore(std::vector<std::unique_ptr<Van>> _vans);
+
+    /**
+     * @brief Every van started so far, retired ones included.
+     */
+    std::vector<Van*> all();
+
+    /**
+     * @brief Waits for every van thread, retired ones included.
+     *
+     * To be called once the simulation is ending.
+     */
+    void joinAll();
+
+private:
+    PcoMutex mutex;
+    std::vector<std::unique_ptr<Van>> vans;          // all vans ever started
+    std::vector<std::unique_ptr<PcoThread>> threads; // one per van
+    std::vector<Van*> inService;                     // most recent last
+    unsigned int nextId = 0;
+};
+
+#endif // VANFLEET_H
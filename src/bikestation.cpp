@@ -6,11 +6,29 @@
  */
 
 #include "bikestation.h"
-#include "bikinginterface.h"
+#include "config.h"
+#include "eventtrace.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <chrono>
 
 BikeStation::BikeStation(int _capacity) : capacity(_capacity), 
-      bikesByType(Bike::nbBikeTypes) {}
-extern BikingInterface* binkingInterface;
+      bikesByType(Bike::nbBikeTypes), history(_capacity), createdNs(availabilityClockNs()) {
+    availabilityChanged(); // empty from the start
+}
+
+BikeStation::BikeStation(int _capacity, const std::vector<Bike*>& _bikes)
+    : BikeStation(_capacity) {
+    for (Bike* bike : _bikes) {
+        if (bike->broken) {
+            brokenBikes.push_back(bike);
+        } else {
+            bikesByType[bike->bikeType].push_back(bike);
+        }
+    }
+    occupancyChanged(); // not shared yet: no lock needed
+}
 
 BikeStation::~BikeStation() {
     ending();
@@ -19,28 +37,34 @@ BikeStation::~BikeStation() {
 void BikeStation::putBike(Bike* _bike){
     size_t t = _bike->bikeType; // get bike type (used for indexing bikesByType and condTakers)
 
-    mutex.lock(); // lock the mutex to protect shared data
+    mutex.lock(LockSite::PutBike); // lock the mutex to protect shared data
 
     // Mesa-style waiting: loop until there is space or simulation ends
+    bool waiting = !shouldEnd && (closed || frozen || occupiedSlots() >= capacity);
+    if (waiting) waitingPutters.fetch_add(1, std::memory_order_relaxed);
     while (!shouldEnd) {
-        size_t total = 0;
-        for (const auto& bikes : bikesByType) {
-            total += bikes.size(); // count total bikes in station
-        }
-        if (total < capacity) break; // if space available, exit the loop
+        if (!closed && !frozen && occupiedSlots() < capacity) break; // if space available, exit the loop
 
-        condPutters.wait(&mutex); // release mutex and wait until someone signals (blocking wait)
+        mutex.wait(condPutters); // release mutex and wait until someone signals (blocking wait)
     }
+    if (waiting) waitingPutters.fetch_sub(1, std::memory_order_relaxed);
 
     if (shouldEnd) { // if simulation ended while waiting
         mutex.unlock(); // unlock and exit
         return;
     }
 
-    bikesByType[t].push_back(_bike); // put bike in the deque of its type
+    if (_bike->broken) {
+        brokenBikes.push_back(_bike); // occupies a slot, not available
+    } else {
+        bikesByType[t].push_back(_bike); // put bike in the deque of its type
+        // wake one thread waiting to take a bike of this type
+        condTakers[t].notifyOne();
+    }
+    demand.returned[t]++;
+    occupancyChanged();
+    if (traceSite != NO_TRACE) globalTrace.put(traceSite, t, _bike->broken);
 
-    // wake one thread waiting to take a bike of this type
-    condTakers[t].notifyOne();
     // wake one thread waiting to put a bike (space freed)
     condPutters.notifyOne();
 
@@ -50,12 +74,22 @@ void BikeStation::putBike(Bike* _bike){
 // Get a bike of a specific type
 Bike* BikeStation::getBike(size_t _bikeType)
 {
-    mutex.lock(); // lock mutex to access shared data
+    mutex.lock(LockSite::GetBike); // lock mutex to access shared data
+
+    bool waiting = !shouldEnd && (closed || frozen || bikesByType[_bikeType].empty());
+    if (waiting) {
+        if (!frozen) { // a checkpoint is not a lack of bikes
+            demand.missed[_bikeType]++; // rider will have to wait
+            globalMetrics.riderWaits.fetch_add(1, std::memory_order_relaxed);
+        }
+        waitingTakers.fetch_add(1, std::memory_order_relaxed);
+    }
 
     // wait until a bike of the requested type is available or simulation ends
-    while (!shouldEnd && bikesByType[_bikeType].empty()) {
-        condTakers[_bikeType].wait(&mutex); // blocking wait
+    while (!shouldEnd && (closed || frozen || bikesByType[_bikeType].empty())) {
+        mutex.wait(condTakers[_bikeType]); // blocking wait
     }
+    if (waiting) waitingTakers.fetch_sub(1, std::memory_order_relaxed);
 
     if (shouldEnd) { // if simulation ended while waiting
         mutex.unlock();
@@ -64,6 +98,9 @@ Bike* BikeStation::getBike(size_t _bikeType)
 
     Bike* bike = bikesByType[_bikeType].front(); // get the first bike (FIFO)
     bikesByType[_bikeType].pop_front();          // remove it from the deque
+    demand.taken[_bikeType]++;
+    occupancyChanged();
+    if (traceSite != NO_TRACE) globalTrace.take(traceSite, _bikeType);
 
     // wake one thread waiting to put a bike (space freed)
     condPutters.notifyOne();
@@ -78,8 +115,11 @@ Bike* BikeStation::getBike(size_t _bikeType)
 // Add multiple bikes at once
 std::vector<Bike*> BikeStation::addBikes(std::vector<Bike*> _bikesToAdd) {
     std::vector<Bike*> result; // bikes that couldn't be added (if simulation ends)
+    std::array<uint32_t, Bike::nbBikeTypes> added{};
+    uint32_t addedBroken = 0;
+    bool changed = false; // bikes added since the last publication
 
-    mutex.lock(); // lock shared data
+    mutex.lock(LockSite::AddBikes); // lock shared data
 
     for (Bike* bike : _bikesToAdd) { // try each bike
         if (shouldEnd) { // simulation ended
@@ -89,13 +129,16 @@ std::vector<Bike*> BikeStation::addBikes(std::vector<Bike*> _bikesToAdd) {
 
         // wait while station is full
         while (!shouldEnd) {
-            size_t total = 0;
-            for (const auto& bikes : bikesByType) {
-                total += bikes.size();
+            if (occupiedSlots() < capacity) break;
+
+            // publish the full station before waiting, riders may take the
+            // bikes already added meanwhile
+            if (changed) {
+                occupancyChanged();
+                traceAdded(added, addedBroken);
+                changed = false;
             }
-            if (total < capacity) break;
-
-            condPutters.wait(&mutex); // blocking wait for space
+            mutex.wait(condPutters); // blocking wait for space
         }
 
         if (shouldEnd) { // simulation ended while waiting
@@ -104,24 +147,67 @@ std::vector<Bike*> BikeStation::addBikes(std::vector<Bike*> _bikesToAdd) {
         }
 
         size_t t = bike->bikeType;
-        bikesByType[t].push_back(bike); // add bike
+        if (bike->broken) {
+            brokenBikes.push_back(bike);
+            addedBroken++;
+        } else {
+            bikesByType[t].push_back(bike); // add bike
+            condTakers[t].notifyOne();      // wake threads waiting for this type
+            added[t]++;
+        }
+        changed = true;
 
-        // wake threads waiting for this type or for space
-        condTakers[t].notifyOne();
+        // wake threads waiting for space
         condPutters.notifyOne();
     }
 
+    if (changed) {
+        occupancyChanged();
+        traceAdded(added, addedBroken);
+    }
     mutex.unlock(); // unlock
     return result;  // return bikes that couldn't be added
 }
 
+// Add multiple bikes without waiting for space
+std::vector<Bike*> BikeStation::tryAddBikes(std::vector<Bike*> _bikesToAdd) {
+    std::vector<Bike*> result; // bikes that did not fit
+    std::array<uint32_t, Bike::nbBikeTypes> added{};
+    uint32_t addedBroken = 0;
+
+    mutex.lock(LockSite::AddBikes);
+    for (Bike* bike : _bikesToAdd) {
+        if (shouldEnd || occupiedSlots() >= capacity) {
+            result.push_back(bike);
+            continue;
+        }
+
+        size_t t = bike->bikeType;
+        if (bike->broken) {
+            brokenBikes.push_back(bike);
+            addedBroken++;
+        } else {
+            bikesByType[t].push_back(bike);
+            condTakers[t].notifyOne();
+            added[t]++;
+        }
+    }
+
+    if (result.size() < _bikesToAdd.size()) {
+        occupancyChanged();
+        traceAdded(added, addedBroken);
+    }
+    mutex.unlock();
+    return result;
+}
+
 // Get multiple bikes at once
 std::vector<Bike*> BikeStation::getBikes(size_t _nbBikes) {
     std::vector<Bike*> result;
 
-    mutex.lock(); // lock shared data
+    mutex.lock(LockSite::GetBikes); // lock shared data
 
-    bool tookFromType[Bike::nbBikeTypes] = { false }; // track types we took bikes from
+    std::array<uint32_t, Bike::nbBikeTypes> taken{}; // bikes taken per type
 
     // iterate over bike types in order
     for (size_t type = 0; type < Bike::nbBikeTypes && result.size() < _nbBikes; ++type) {
@@ -129,39 +215,101 @@ std::vector<Bike*> BikeStation::getBikes(size_t _nbBikes) {
             Bike* bike = bikesByType[type].front(); // take first bike
             bikesByType[type].pop_front();
             result.push_back(bike);
-            tookFromType[type] = true;
+            taken[type]++;
         }
     }
 
     if (!result.empty()) {
         condPutters.notifyAll(); // wake all threads waiting to put a bike
         for (size_t type = 0; type < Bike::nbBikeTypes; ++type) {
-            if (tookFromType[type]) {
+            if (taken[type] > 0) {
                 condTakers[type].notifyOne(); // wake one waiting for this type
             }
         }
+        if (traceSite != NO_TRACE) globalTrace.remove(traceSite, taken);
     }
 
+    occupancyChanged();
     mutex.unlock();
     return result; // return bikes
 }
 
+// Get bikes with an explicit quota per type
+std::vector<Bike*> BikeStation::getBikes(const std::array<size_t, Bike::nbBikeTypes>& _quotas) {
+    std::vector<Bike*> result;
+    std::array<uint32_t, Bike::nbBikeTypes> taken{};
+
+    mutex.lock(LockSite::GetBikes);
+
+    for (size_t type = 0; type < Bike::nbBikeTypes; ++type) {
+        while (taken[type] < _quotas[type] && !bikesByType[type].empty()) {
+            result.push_back(bikesByType[type].front()); // FIFO within the type
+            bikesByType[type].pop_front();
+            taken[type]++;
+        }
+        if (taken[type] > 0) {
+            condTakers[type].notifyOne(); // Mesa style: let a waiter re-check
+        }
+    }
+
+    if (!result.empty()) {
+        condPutters.notifyAll(); // slots freed
+        if (traceSite != NO_TRACE) globalTrace.remove(traceSite, taken);
+    }
+
+    occupancyChanged();
+    mutex.unlock();
+    return result;
+}
+
 // Count bikes of a specific type
 size_t BikeStation::countBikesOfType(size_t type) const {
-    mutex.lock();
+    mutex.lock(LockSite::CountBikesOfType);
     size_t count = bikesByType[type].size(); // get size
     mutex.unlock();
     return count;
 }
 
-// Count total bikes
+// Get broken bikes (van collecting them for repair)
+std::vector<Bike*> BikeStation::getBrokenBikes(size_t _nbBikes) {
+    std::vector<Bike*> result;
+
+    mutex.lock(LockSite::GetBikes);
+    while (!brokenBikes.empty() && result.size() < _nbBikes) {
+        result.push_back(brokenBikes.front());
+        brokenBikes.pop_front();
+    }
+    if (!result.empty()) {
+        condPutters.notifyAll(); // slots freed
+        if (traceSite != NO_TRACE) globalTrace.removeBroken(traceSite, result.size());
+    }
+    occupancyChanged();
+    mutex.unlock();
+    return result;
+}
+
+// Count total bikes (broken ones occupy a slot too)
 size_t BikeStation::nbBikes() {
-    mutex.lock();
-    size_t total = 0;
+    mutex.lock(LockSite::NbBikes);
+    size_t total = occupiedSlots();
+    mutex.unlock();
+    return total;
+}
+
+// Count broken bikes
+size_t BikeStation::nbBrokenBikes() const {
+    mutex.lock(LockSite::NbBikes);
+    size_t count = brokenBikes.size();
+    mutex.unlock();
+    return count;
+}
+
+// Occupied slots (mutex held)
+size_t BikeStation::occupiedSlots() const {
+    size_t total = brokenBikes.size();
     for (const auto& bikes : bikesByType) {
         total += bikes.size();
     }
-    mutex.unlock();
     return total;
 }
 
@@ -170,9 +318,219 @@ size_t BikeStation::nbSlots() {
     return capacity;
 }
 
+// Read and reset rider demand counters
+DemandCounters BikeStation::collectDemand() {
+    mutex.lock(LockSite::Other);
+    DemandCounters result = demand;
+    demand = DemandCounters();
+    mutex.unlock();
+    return result;
+}
+
+// Set the occupancy target used for the rider bonuses
+void BikeStation::setTargetLevel(size_t _target) {
+    mutex.lock(LockSite::Other);
+    targetLevel = _target;
+    hasTarget = true;
+    updateIncentives();
+    mutex.unlock();
+}
+
+int BikeStation::returnBonus() const {
+    return returnBonusPoints.load(std::memory_order_relaxed);
+}
+
+int BikeStation::takeBonus() const {
+    return takeBonusPoints.load(std::memory_order_relaxed);
+}
+
+// After every change of the occupied slots (mutex held)
+void BikeStation::occupancyChanged() {
+    updateIncentives();
+    availabilityChanged();
+    history.record(occupiedSlots()); // lock-free, we are the only writer
+
+    // Lock-free copy of the counts for the observers
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        publishedBikes[t].store(bikesByType[t].size(), std::memory_order_relaxed);
+    }
+    publishedBroken.store(brokenBikes.size(), std::memory_order_relaxed);
+}
+
+uint64_t BikeStation::availabilityClockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Close or open the empty and full periods (mutex held, single writer).
+// Readers use availabilityVersion as a sequence lock
+void BikeStation::availabilityChanged() {
+    bool changes[Bike::nbBikeTypes + 1];
+    bool any = false;
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        bool empty = bikesByType[t].empty();
+        changes[t] = empty != (emptySinceNs[t].load(std::memory_order_relaxed) != 0);
+        any = any || changes[t];
+    }
+    bool full = occupiedSlots() >= capacity;
+    changes[Bike::nbBikeTypes] = full != (fullSinceNs.load(std::memory_order_relaxed) != 0);
+    if (!any && !changes[Bike::nbBikeTypes]) return;
+
+    uint64_t now = availabilityClockNs();
+    auto toggle = [now](std::atomic<uint64_t>& _since, std::atomic<uint64_t>& _total) {
+        uint64_t since = _since.load(std::memory_order_relaxed);
+        if (since == 0) {
+            _since.store(now, std::memory_order_relaxed);
+        } else {
+            _total.store(_total.load(std::memory_order_relaxed) + now - since, std::memory_order_relaxed);
+            _since.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    uint32_t version = availabilityVersion.load(std::memory_order_relaxed);
+    availabilityVersion.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        if (changes[t]) toggle(emptySinceNs[t], emptyTotalNs[t]);
+    }
+    if (changes[Bike::nbBikeTypes]) toggle(fullSinceNs, fullTotalNs);
+    availabilityVersion.store(version + 2, std::memory_order_release);
+}
+
+StationAvailability BikeStation::availability(uint64_t _nowNs) const {
+    StationAvailability result;
+    std::array<uint64_t, Bike::nbBikeTypes> emptySince;
+    uint64_t fullSince;
+    uint32_t before, after;
+    do {
+        before = availabilityVersion.load(std::memory_order_acquire);
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            result.emptyNs[t] = emptyTotalNs[t].load(std::memory_order_relaxed);
+            emptySince[t] = emptySinceNs[t].load(std::memory_order_relaxed);
+        }
+        result.fullNs = fullTotalNs.load(std::memory_order_relaxed);
+        fullSince = fullSinceNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = availabilityVersion.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    // Periods still running count up to _nowNs
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        if (emptySince[t] != 0 && _nowNs > emptySince[t]) result.emptyNs[t] += _nowNs - emptySince[t];
+    }
+    if (fullSince != 0 && _nowNs > fullSince) result.fullNs += _nowNs - fullSince;
+    result.elapsedNs = _nowNs > createdNs ? _nowNs - createdNs : 0;
+    return result;
+}
+
+double StationAvailability::emptyFraction(size_t _type) const {
+    return elapsedNs ? std::min(1.0, (double)emptyNs[_type] / elapsedNs) : 0.0;
+}
+
+double StationAvailability::fullFraction() const {
+    return elapsedNs ? std::min(1.0, (double)fullNs / elapsedNs) : 0.0;
+}
+
+const OccupancyHistory& BikeStation::occupancyHistory() const {
+    return history;
+}
+
+StationCounts BikeStation::counts() const {
+    StationCounts result;
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        result.bikes[t] = publishedBikes[t].load(std::memory_order_relaxed);
+    }
+    result.broken = publishedBroken.load(std::memory_order_relaxed);
+    result.waitingTakers = waitingTakers.load(std::memory_order_relaxed);
+    result.waitingPutters = waitingPutters.load(std::memory_order_relaxed);
+    return result;
+}
+
+// Publish the bonuses from the gap between occupancy and target (mutex held)
+void BikeStation::updateIncentives() {
+    if (!hasTarget) return;
+
+    size_t total = occupiedSlots();
+    int gap = (int)total - (int)targetLevel;
+    returnBonusPoints.store(gap < 0 ? -gap * INCENTIVE_POINTS_PER_BIKE : 0, std::memory_order_relaxed);
+    takeBonusPoints.store(gap > 0 ? gap * INCENTIVE_POINTS_PER_BIKE : 0, std::memory_order_relaxed);
+}
+
+// Close or reopen the station to riders
+void BikeStation::setOpen(bool _open) {
+    mutex.lock(LockSite::Other);
+    closed = !_open;
+    open.store(_open, std::memory_order_relaxed);
+
+    if (_open) { // riders who arrived meanwhile may proceed
+        condPutters.notifyAll();
+        for (size_t i = 0; i < Bike::nbBikeTypes; ++i) {
+            condTakers[i].notifyAll();
+        }
+    }
+    mutex.unlock();
+}
+
+bool BikeStation::isOpen() const {
+    return open.load(std::memory_order_relaxed);
+}
+
+// Freeze or release the rider operations (checkpoint)
+void BikeStation::setFrozen(bool _frozen) {
+    mutex.lock(LockSite::Other);
+    frozen = _frozen;
+
+    if (!_frozen) { // same wake-ups as a reopening
+        condPutters.notifyAll();
+        for (size_t i = 0; i < Bike::nbBikeTypes; ++i) {
+            condTakers[i].notifyAll();
+        }
+    }
+    mutex.unlock();
+}
+
+// Copy of the contents, FIFO order within each type
+void BikeStation::contents(std::vector<Bike*>& _bikes, std::array<uint32_t, Bike::nbBikeTypes>& _perType,
+                           uint32_t& _broken) const {
+    mutex.lock(LockSite::Other);
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        _bikes.insert(_bikes.end(), bikesByType[t].begin(), bikesByType[t].end());
+        _perType[t] = bikesByType[t].size();
+    }
+    _bikes.insert(_bikes.end(), brokenBikes.begin(), brokenBikes.end());
+    _broken = brokenBikes.size();
+    mutex.unlock();
+}
+
+// Start tracing the operations, from the current contents
+void BikeStation::traceAs(size_t _site) {
+    mutex.lock(LockSite::Other);
+    traceSite = _site;
+    std::array<uint32_t, Bike::nbBikeTypes> perType;
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        perType[t] = bikesByType[t].size();
+    }
+    globalTrace.stationInit(_site, capacity, perType, brokenBikes.size());
+    mutex.unlock();
+}
+
+void BikeStation::profileAs(size_t _site) {
+    mutex.profileAs(_site);
+}
+
+// Record the bikes added so far by addBikes() (mutex held)
+void BikeStation::traceAdded(std::array<uint32_t, Bike::nbBikeTypes>& _added, uint32_t& _broken) {
+    if (traceSite == NO_TRACE) return;
+    bool any = _broken > 0;
+    for (uint32_t count : _added) any = any || count > 0;
+    if (any) globalTrace.add(traceSite, _added, _broken);
+    _added.fill(0);
+    _broken = 0;
+}
+
 // Signal all threads that simulation is ending
 void BikeStation::ending() {
-    mutex.lock();
+    mutex.lock(LockSite::Ending);
     shouldEnd = true; // mark end
 
     condPutters.notifyAll(); // wake all putters
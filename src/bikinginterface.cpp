@@ -24,10 +24,6 @@ BikingInterface::BikingInterface()
                      SIGNAL(sig_consoleAppendText(unsigned int,QString)),
                      mainWindow,
                      SLOT(consoleAppendText(unsigned int,QString)));
-    QObject::connect(this,
-                     SIGNAL(sig_setBikes(unsigned int,unsigned int)),
-                     mainWindow,
-                     SLOT(setBikes(unsigned int,unsigned int)));
     QObject::connect(this,
                      SIGNAL(sig_travel(unsigned int,unsigned int,unsigned int,unsigned int)),
                      mainWindow,
@@ -41,51 +37,79 @@ BikingInterface::BikingInterface()
                      SIGNAL(sig_walk(unsigned int,unsigned int,unsigned int,unsigned int)),
                      mainWindow,
                      SLOT(walk(unsigned int,unsigned int,unsigned int,unsigned int)));
+    QObject::connect(this,
+                     SIGNAL(sig_fleetOrderDone(QString)),
+                     mainWindow,
+                     SLOT(fleetOrderDone(QString)));
 }
 
 
 #include <QTest>
 
 void BikingInterface::travel(unsigned int personId,unsigned int site1, unsigned int site2,
-                             unsigned int ms)
+                             unsigned int ms,bool waitEnd)
 {
     emit sig_travel(personId,site1,site2,ms);
-    QTest::qSleep(ms);
+    if (waitEnd)
+        QTest::qSleep(ms);
 }
 
 void BikingInterface::walk(unsigned int personId,
                            unsigned int site1,
                            unsigned int site2,
-                           unsigned int ms)
+                           unsigned int ms,
+                           bool waitEnd)
 {
     emit sig_walk(personId, site1, site2, ms);
-    QTest::qSleep(ms);
+    if (waitEnd)
+        QTest::qSleep(ms);
 }
 
 void BikingInterface::vanTravel(unsigned int site1, unsigned int site2,
-                                unsigned int ms)
+                                unsigned int ms,bool waitEnd)
 {
     emit sig_vanTravel(site1,site2,ms);
-    QTest::qSleep(ms);
+    if (waitEnd)
+        QTest::qSleep(ms);
+}
+
+void BikingInterface::fleetOrderDone(const FleetResult& result) {
+    QString text=QString("Ordre %1, site %2 :").arg(result.order.id).arg(result.order.site);
+    for (size_t t=0;t<Bike::nbBikeTypes;t++) {
+        if (result.order.delta[t]!=0)
+            text+=QString(" type %1 %2/%3").arg(t).arg(result.done[t]).arg(result.order.delta[t]);
+    }
+    if (!result.complete)
+        text+=" (incomplet)";
+    emit sig_fleetOrderDone(text);
 }
 
 void BikingInterface::consoleAppendText(unsigned int consoleId,QString text) {
     emit sig_consoleAppendText(consoleId,text);
 }
 
+void BikingInterface::appendLogRecords(const std::vector<LogRecord>& records) {
+    mainWindow->logModel()->post(records);
+}
+
 void BikingInterface::setBikes(unsigned int site,unsigned int nbBike) {
-    emit sig_setBikes(site,nbBike);
+    mainWindow->occupancy()->publish(site,nbBike);
 }
 
 void BikingInterface::setInitBikes(unsigned int site,unsigned int nbBike) {
     mainWindow->setBikes(site,nbBike);
 }
 
+void BikingInterface::setSiteCapacity(unsigned int site,unsigned int capacity) {
+    mainWindow->m_display->setSiteCapacity(site,capacity);
+}
+
 void BikingInterface::setInitPerson(unsigned int site,unsigned int personID) {
     mainWindow->setPerson(site,personID);
 }
 
-void BikingInterface::initialize(unsigned int nbConsoles,unsigned int nbSites)
+void BikingInterface::initialize(unsigned int nbConsoles,unsigned int nbSites,
+                                  unsigned int nbDepots,unsigned int nbBikes)
 {
     if (sm_didInitialize) {
         cout << "Vous devez ne devriez appeler BikingInteface::initialize()"
@@ -95,7 +119,7 @@ void BikingInterface::initialize(unsigned int nbConsoles,unsigned int nbSites)
                              "qu'une seule fois");
         return;
     }
-    mainWindow= new MainWindow(nbConsoles,nbSites,0);
+    mainWindow= new MainWindow(nbConsoles,nbSites,nbDepots,nbBikes,0);
     mainWindow->show();
     sm_didInitialize=true;
 }
@@ -0,0 +1,341 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "checkpoint.h"
+#include "bikestation.h"
+#include "metrics.h"
+#include "person.h"
+#include "repairshop.h"
+#include "simgate.h"
+#include "van.h"
+#include "vanfleet.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(CheckpointBike) == 8, "bike records are packed");
+static_assert(sizeof(CheckpointStation) % 8 == 0, "records keep the 8-byte alignment");
+static_assert(sizeof(CheckpointRider) % 8 == 0, "records keep the 8-byte alignment");
+static_assert(sizeof(CheckpointVan) % 8 == 0, "records keep the 8-byte alignment");
+static_assert(sizeof(CheckpointHeader) % 8 == 0, "records keep the 8-byte alignment");
+
+CheckpointBike checkpointBike(const Bike& _bike) {
+    CheckpointBike record{};
+    record.wear = _bike.wear;
+    record.type = _bike.bikeType;
+    record.broken = _bike.broken;
+    return record;
+}
+
+// Writes one array, returns false on error
+template<typename T>
+static bool writeArray(std::FILE* _file, const std::vector<T>& _records) {
+    return _records.empty() || std::fwrite(_records.data(), sizeof(T), _records.size(), _file) == _records.size();
+}
+
+bool saveCheckpoint(const std::string& _path, const CheckpointSources& _sources,
+                    std::string& _error) {
+    // 1. Consistent point: every thread parked, idle or waiting in a frozen station
+    globalGate.requestPause();
+    for (BikeStation* station : _sources.stations) {
+        station->setFrozen(true);
+    }
+    auto waiting = [&]() {
+        size_t total = 0;
+        for (BikeStation* station : _sources.stations) {
+            StationCounts counts = station->counts();
+            total += counts.waitingTakers + counts.waitingPutters;
+        }
+        return total;
+    };
+    bool quiescent = globalGate.waitQuiescent(waiting, CHECKPOINT_QUIESCE_MS);
+
+    // 2. Copy (the stations first: their locks order the reads of the riders)
+    CheckpointHeader header{};
+    std::vector<CheckpointStation> stations;
+    std::vector<CheckpointRider> riders;
+    std::vector<CheckpointVan> vans;
+    std::vector<CheckpointBike> bikes;
+    std::vector<Bike*> copied;
+
+    if (quiescent) {
+        for (BikeStation* station : _sources.stations) {
+            CheckpointStation record{};
+            std::array<uint32_t, Bike::nbBikeTypes> perType;
+            copied.clear();
+            station->contents(copied, perType, record.broken);
+            record.firstBike = bikes.size();
+            record.capacity = station->nbSlots();
+            record.open = station->isOpen();
+            std::copy(perType.begin(), perType.end(), record.bikes);
+            for (Bike* bike : copied) bikes.push_back(checkpointBike(*bike));
+            stations.push_back(record);
+        }
+
+        for (Person* person : _sources.persons) {
+            riders.push_back(person->checkpointState());
+        }
+
+        for (Van* van : _sources.vanFleet->all()) {
+            copied.clear();
+            CheckpointVan record = van->checkpointState(copied);
+            record.firstBike = bikes.size();
+            for (Bike* bike : copied) bikes.push_back(checkpointBike(*bike));
+            vans.push_back(record);
+        }
+
+        header.repairFirstBike = bikes.size();
+        if (_sources.repairShop) {
+            for (Bike* bike : _sources.repairShop->contents()) bikes.push_back(checkpointBike(*bike));
+        }
+        header.nbRepair = bikes.size() - header.repairFirstBike;
+
+        header.metrics.tripsCompleted = globalMetrics.tripsCompleted.load();
+        header.metrics.riderWaits = globalMetrics.riderWaits.load();
+        header.metrics.vanDistanceMilli = globalMetrics.vanDistanceMilli.load();
+        header.metrics.incentivesAccepted = globalMetrics.incentivesAccepted.load();
+        header.metrics.bonusPointsPaid = globalMetrics.bonusPointsPaid.load();
+        header.metrics.breakdowns = globalMetrics.breakdowns.load();
+        header.metrics.repairs = globalMetrics.repairs.load();
+    }
+
+    // 3. Resume before touching the disk
+    for (BikeStation* station : _sources.stations) {
+        station->setFrozen(false);
+    }
+    globalGate.resume();
+
+    if (!quiescent) {
+        _error = "simulation did not reach a consistent point";
+        return false;
+    }
+
+    // 4. Write, then rename so a crash never leaves a truncated checkpoint
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.nbSites = NBSITES;
+    header.nbDepots = NBDEPOTS;
+    header.nbTypes = Bike::nbBikeTypes;
+    header.nbRiders = riders.size();
+    header.nbVans = vans.size();
+    header.nbBikes = bikes.size();
+    header.stationsOffset = sizeof(CheckpointHeader);
+    header.ridersOffset = header.stationsOffset + stations.size() * sizeof(CheckpointStation);
+    header.vansOffset = header.ridersOffset + riders.size() * sizeof(CheckpointRider);
+    header.bikesOffset = header.vansOffset + vans.size() * sizeof(CheckpointVan);
+
+    std::string temporary = _path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        _error = std::strerror(errno);
+        return false;
+    }
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+                && writeArray(file, stations) && writeArray(file, riders)
+                && writeArray(file, vans) && writeArray(file, bikes);
+    written = (std::fclose(file) == 0) && written;
+    if (!written || std::rename(temporary.c_str(), _path.c_str()) != 0) {
+        _error = std::strerror(errno);
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+CheckpointFile::~CheckpointFile() {
+    if (data) {
+        munmap((void*)data, size);
+    }
+}
+
+bool CheckpointFile::open(const std::string& _path, std::string& _error) {
+    int fd = ::open(_path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        _error = _path + ": " + std::strerror(errno);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    size = info.st_size;
+    void* memory = size >= sizeof(CheckpointHeader)
+                 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd); // the mapping keeps the file
+    if (memory == MAP_FAILED) {
+        _error = _path + ": not a checkpoint";
+        size = 0;
+        return false;
+    }
+    data = (const char*)memory;
+    madvise(memory, size, MADV_SEQUENTIAL);
+
+    // Identification and city
+    const CheckpointHeader& h = header();
+    if (h.magic != CHECKPOINT_MAGIC || h.version != CHECKPOINT_VERSION) {
+        _error = _path + ": not a checkpoint of this version";
+        return false;
+    }
+    if (h.nbSites != NBSITES || h.nbDepots != NBDEPOTS || h.nbTypes != Bike::nbBikeTypes) {
+        _error = _path + ": saved for another city (sites, depots or bike types)";
+        return false;
+    }
+
+    // Bounds of the arrays, then of every run in the bike table
+    auto fits = [&](uint64_t offset, uint64_t count, size_t recordSize) {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / recordSize;
+    };
+    if (!fits(h.stationsOffset, NB_SITES_TOTAL, sizeof(CheckpointStation))
+        || !fits(h.ridersOffset, h.nbRiders, sizeof(CheckpointRider))
+        || !fits(h.vansOffset, h.nbVans, sizeof(CheckpointVan))
+        || !fits(h.bikesOffset, h.nbBikes, sizeof(CheckpointBike))) {
+        _error = _path + ": truncated";
+        return false;
+    }
+    auto inTable = [&](uint64_t first, uint64_t count) {
+        return first <= h.nbBikes && count <= h.nbBikes - first;
+    };
+    auto stations = (const CheckpointStation*)(data + h.stationsOffset);
+    for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+        uint64_t count = stations[s].broken;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) count += stations[s].bikes[t];
+        if (!inTable(stations[s].firstBike, count) || count > stations[s].capacity) {
+            _error = _path + ": corrupted station " + std::to_string(s);
+            return false;
+        }
+    }
+    auto vans = (const CheckpointVan*)(data + h.vansOffset);
+    for (size_t v = 0; v < h.nbVans; ++v) {
+        uint64_t count = vans[v].broken;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) count += vans[v].cargo[t];
+        if (!inTable(vans[v].firstBike, count) || vans[v].site >= NB_SITES_TOTAL
+            || vans[v].tourSite > NBSITES) {
+            _error = _path + ": corrupted van " + std::to_string(v);
+            return false;
+        }
+    }
+    auto riders = (const CheckpointRider*)(data + h.ridersOffset);
+    for (size_t r = 0; r < h.nbRiders; ++r) {
+        if (riders[r].site >= NBSITES || riders[r].destination >= NBSITES
+            || riders[r].phase > (uint8_t)Person::Phase::Walking
+            || riders[r].preferredType >= Bike::nbBikeTypes) {
+            _error = _path + ": corrupted rider " + std::to_string(r);
+            return false;
+        }
+    }
+    if (!inTable(h.repairFirstBike, h.nbRepair)) {
+        _error = _path + ": corrupted repair queue";
+        return false;
+    }
+    for (uint64_t b = 0; b < h.nbBikes; ++b) {
+        if (bikes()[b].type >= Bike::nbBikeTypes) {
+            _error = _path + ": corrupted bike " + std::to_string(b);
+            return false;
+        }
+    }
+    return true;
+}
+
+const CheckpointHeader& CheckpointFile::header() const {
+    return *(const CheckpointHeader*)data;
+}
+
+const CheckpointBike* CheckpointFile::bikes() const {
+    return (const CheckpointBike*)(data + header().bikesOffset);
+}
+
+Bike* CheckpointFile::makeBike(const CheckpointBike& _record) {
+    auto* bike = new Bike;
+    bike->bikeType = _record.type;
+    bike->wear = _record.wear;
+    bike->broken = _record.broken;
+    return bike;
+}
+
+void CheckpointFile::restoreStations(std::array<BikeStation*, NB_SITES_TOTAL>& _stations) const {
+    auto stations = (const CheckpointStation*)(data + header().stationsOffset);
+    std::vector<Bike*> content;
+    for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+        const CheckpointStation& record = stations[s];
+        size_t count = record.broken;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) count += record.bikes[t];
+
+        content.clear();
+        for (size_t b = 0; b < count; ++b) {
+            content.push_back(makeBike(bikes()[record.firstBike + b]));
+        }
+        _stations[s] = new BikeStation(record.capacity);
+        _stations[s]->tryAddBikes(content); // FIFO order kept, fits by construction
+        _stations[s]->setOpen(record.open);
+    }
+}
+
+std::vector<Person*> CheckpointFile::restoreRiders() const {
+    auto riders = (const CheckpointRider*)(data + header().ridersOffset);
+    std::vector<Person*> result;
+    result.reserve(header().nbRiders);
+    for (size_t r = 0; r < header().nbRiders; ++r) {
+        Bike* bike = riders[r].hasBike ? makeBike(riders[r].bike) : nullptr;
+        result.push_back(new Person(riders[r], bike));
+    }
+    return result;
+}
+
+std::vector<std::unique_ptr<Van>> CheckpointFile::restoreVans(std::vector<Bike*>& _leftovers) const {
+    auto vans = (const CheckpointVan*)(data + header().vansOffset);
+    std::vector<std::unique_ptr<Van>> result;
+    for (size_t v = 0; v < header().nbVans; ++v) {
+        const CheckpointVan& record = vans[v];
+        size_t count = record.broken;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) count += record.cargo[t];
+
+        std::vector<Bike*> cargo;
+        for (size_t b = 0; b < count; ++b) {
+            cargo.push_back(makeBike(bikes()[record.firstBike + b]));
+        }
+        if (record.retired) {
+            _leftovers.insert(_leftovers.end(), cargo.begin(), cargo.end());
+        } else {
+            result.push_back(std::make_unique<Van>(record, cargo));
+        }
+    }
+    return result;
+}
+
+std::vector<Bike*> CheckpointFile::restoreRepairQueue(std::vector<Bike*>& _repaired) const {
+    std::vector<Bike*> result;
+    for (size_t b = 0; b < header().nbRepair; ++b) {
+        Bike* bike = makeBike(bikes()[header().repairFirstBike + b]);
+        (bike->broken ? result : _repaired).push_back(bike);
+    }
+    return result;
+}
+
+void CheckpointFile::restoreMetrics() const {
+    const CheckpointMetrics& m = header().metrics;
+    globalMetrics.tripsCompleted = m.tripsCompleted;
+    globalMetrics.riderWaits = m.riderWaits;
+    globalMetrics.vanDistanceMilli = m.vanDistanceMilli;
+    globalMetrics.incentivesAccepted = m.incentivesAccepted;
+    globalMetrics.bonusPointsPaid = m.bonusPointsPaid;
+    globalMetrics.breakdowns = m.breakdowns;
+    globalMetrics.repairs = m.repairs;
+
+    // Broken bikes, wherever they are
+    size_t broken = 0;
+    for (uint64_t b = 0; b < header().nbBikes; ++b) {
+        broken += bikes()[b].broken;
+    }
+    auto riders = (const CheckpointRider*)(data + header().ridersOffset);
+    for (size_t r = 0; r < header().nbRiders; ++r) {
+        broken += riders[r].hasBike && riders[r].bike.broken;
+    }
+    globalMetrics.setBrokenNow(broken);
+}
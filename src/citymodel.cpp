@@ -0,0 +1,345 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "citymodel.h"
+#include "bikestation.h"
+#include "config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pcosynchro/pcothread.h>
+
+// Stations handed to a builder thread at a time
+static const size_t BUILD_CHUNK = 64;
+
+CityModel::~CityModel() {
+    release();
+}
+
+void CityModel::release() {
+    if (mapping) munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    owned.clear();
+    header = nullptr;
+    records = nullptr;
+}
+
+void CityModel::fromConfig(CityModel& _model) {
+    CityModelHeader header{CITY_MODEL_MAGIC, CITY_MODEL_VERSION, NBSITES, NBDEPOTS,
+                           Bike::nbBikeTypes, NBPEOPLE, NB_VANS, 0, {}};
+    for (size_t i = 0; i < NB_BIKES; ++i) {
+        header.fleet[i % Bike::nbBikeTypes]++;
+    }
+
+    // Bike i has type i % nbBikeTypes, the sites take BORNES - 2 bikes each in turn
+    std::vector<CitySiteRecord> sites(NB_SITES_TOTAL);
+    size_t idx = 0;
+    for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+        SitePosition p = sitePosition(s, NBSITES, NBDEPOTS);
+        sites[s] = {(float)p.x, (float)p.y, (uint32_t)(isDepot(s) ? NB_BIKES : BORNES), {}};
+        for (size_t k = 0; k < BORNES - 2 && !isDepot(s); ++k, ++idx) {
+            sites[s].stock[idx % Bike::nbBikeTypes]++;
+        }
+    }
+
+    std::string error;
+    _model.assign(header, sites, error); // valid by the checks of main()
+}
+
+bool CityModel::assign(const CityModelHeader& _header, const std::vector<CitySiteRecord>& _sites,
+                       std::string& _error) {
+    release();
+    size_t bytes = sizeof(CityModelHeader) + _sites.size() * sizeof(CitySiteRecord);
+    owned.resize((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    std::memcpy(owned.data(), &_header, sizeof(_header));
+    std::memcpy((char*)owned.data() + sizeof(_header), _sites.data(),
+                _sites.size() * sizeof(CitySiteRecord));
+    header = (const CityModelHeader*)owned.data();
+    records = (const CitySiteRecord*)(header + 1);
+
+    if (_sites.size() != (size_t)_header.nbSites + _header.nbDepots) {
+        _error = "the header does not match the number of sites";
+        return false;
+    }
+    return validate(_error);
+}
+
+bool CityModel::open(const std::string& _path, std::string& _error) {
+    release();
+    int fd = ::open(_path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        _error = _path + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+
+    uint32_t magic = 0;
+    if (info.st_size < (off_t)sizeof(magic) || pread(fd, &magic, sizeof(magic), 0) != sizeof(magic)
+        || magic != CITY_MODEL_MAGIC) {
+        ::close(fd);
+        std::ifstream file(_path);
+        std::stringstream content;
+        content << file.rdbuf();
+        if (!parseText(content.str(), _error)) {
+            _error = _path + ": " + _error;
+            return false;
+        }
+        return true;
+    }
+
+    size_t size = info.st_size;
+    void* memory = size >= sizeof(CityModelHeader)
+                 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd); // the mapping keeps the file
+    if (memory == MAP_FAILED) {
+        _error = _path + ": truncated city model";
+        return false;
+    }
+    mapping = memory;
+    mappingSize = size;
+    header = (const CityModelHeader*)memory;
+    records = (const CitySiteRecord*)(header + 1);
+
+    uint64_t expected = sizeof(CityModelHeader)
+                      + ((uint64_t)header->nbSites + header->nbDepots) * sizeof(CitySiteRecord);
+    if (header->version != CITY_MODEL_VERSION || size != expected) {
+        _error = _path + ": not a city model of this version";
+        return false;
+    }
+    if (!validate(_error)) {
+        _error = _path + ": " + _error;
+        return false;
+    }
+    return true;
+}
+
+bool CityModel::parseText(const std::string& _text, std::string& _error) {
+    CityModelHeader parsed{CITY_MODEL_MAGIC, CITY_MODEL_VERSION, 0, 0, Bike::nbBikeTypes,
+                           NBPEOPLE, NB_VANS, 0, {}};
+    std::vector<CitySiteRecord> sites, depots;
+
+    std::istringstream text(_text);
+    std::string line;
+    for (size_t number = 1; std::getline(text, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string item;
+        if (!(fields >> item)) continue; // empty line
+
+        bool valid = true;
+        if (item == "people") {
+            valid = static_cast<bool>(fields >> parsed.nbPeople);
+        } else if (item == "vans") {
+            valid = static_cast<bool>(fields >> parsed.nbVans);
+        } else if (item == "bikes") {
+            for (size_t t = 0; t < Bike::nbBikeTypes && valid; ++t) {
+                valid = static_cast<bool>(fields >> parsed.fleet[t]);
+            }
+        } else if (item == "site" || item == "depot") {
+            CitySiteRecord record{};
+            valid = static_cast<bool>(fields >> record.x >> record.y >> record.capacity);
+            std::vector<uint32_t> stock;
+            for (uint32_t count; valid && fields >> count;) stock.push_back(count);
+            valid = valid && fields.eof() && (stock.empty() || stock.size() == Bike::nbBikeTypes);
+            std::copy(stock.begin(), stock.end(), record.stock);
+            (item == "site" ? sites : depots).push_back(record);
+        } else {
+            valid = false;
+        }
+        std::string extra;
+        if (!valid || (fields.good() && fields >> extra)) {
+            _error = "line " + std::to_string(number) + ": invalid " + item;
+            return false;
+        }
+    }
+
+    parsed.nbSites = sites.size();
+    parsed.nbDepots = depots.size();
+    sites.insert(sites.end(), depots.begin(), depots.end());
+    return assign(parsed, sites, _error);
+}
+
+bool CityModel::validate(std::string& _error) {
+    if (header->magic != CITY_MODEL_MAGIC || header->nbTypes != Bike::nbBikeTypes) {
+        _error = "not a city model with " + std::to_string(Bike::nbBikeTypes) + " bike types";
+        return false;
+    }
+    if (header->nbSites < 2 || header->nbDepots < 1) {
+        _error = "a city needs at least two sites and a depot";
+        return false;
+    }
+    if (header->nbVans > MAX_VANS) {
+        _error = "more than " + std::to_string(MAX_VANS) + " vans";
+        return false;
+    }
+
+    std::array<uint64_t, Bike::nbBikeTypes> stocked{};
+    for (size_t s = 0; s < nbSitesTotal(); ++s) {
+        uint64_t total = 0;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            total += records[s].stock[t];
+            stocked[t] += records[s].stock[t];
+        }
+        if (total > records[s].capacity || (s < nbSites() && records[s].capacity < 4)) {
+            _error = "site " + std::to_string(s) + ": at least 4 slots and no more bikes than slots";
+            return false;
+        }
+        if (!std::isfinite(records[s].x) || !std::isfinite(records[s].y)) {
+            _error = "site " + std::to_string(s) + ": invalid position";
+            return false;
+        }
+    }
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        if (stocked[t] > header->fleet[t]) {
+            _error = "more bikes of type " + std::to_string(t) + " in stock than in the fleet";
+            return false;
+        }
+        unstocked[t] = header->fleet[t] - stocked[t];
+    }
+    for (size_t s = nbSites(); s < nbSitesTotal(); ++s) {
+        uint64_t total = 0;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) total += initialBikes(s, t);
+        if (total > records[s].capacity) {
+            _error = "depot " + std::to_string(s) + ": too small for its share of the fleet";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CityModel::save(const std::string& _path, std::string& _error) const {
+    std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)header, sizeof(CityModelHeader));
+    file.write((const char*)records, nbSitesTotal() * sizeof(CitySiteRecord));
+    if (!file) {
+        _error = _path + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+size_t CityModel::nbSites() const {
+    return header->nbSites;
+}
+
+size_t CityModel::nbDepots() const {
+    return header->nbDepots;
+}
+
+size_t CityModel::nbSitesTotal() const {
+    return (size_t)header->nbSites + header->nbDepots;
+}
+
+unsigned int CityModel::nbPeople() const {
+    return header->nbPeople;
+}
+
+unsigned int CityModel::nbVans() const {
+    return header->nbVans;
+}
+
+uint64_t CityModel::nbBikes() const {
+    uint64_t total = 0;
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) total += header->fleet[t];
+    return total;
+}
+
+const CitySiteRecord& CityModel::site(size_t _site) const {
+    return records[_site];
+}
+
+uint64_t CityModel::initialBikes(size_t _site, size_t _type) const {
+    uint64_t count = records[_site].stock[_type];
+    if (_site < nbSites()) return count;
+
+    // Depot: its stock and its share of the bikes in no stock, dealt in
+    // turn to the depots, type after type
+    auto dealt = [this](uint64_t _bikes, size_t _depot) {
+        return _bikes / nbDepots() + (_depot < _bikes % nbDepots() ? 1 : 0);
+    };
+    uint64_t before = 0;
+    for (size_t t = 0; t < _type; ++t) before += unstocked[t];
+    size_t depot = _site - nbSites();
+    return count + dealt(before + unstocked[_type], depot) - dealt(before, depot);
+}
+
+std::vector<SitePosition> CityModel::positions() const {
+    double minX = records[0].x, maxX = minX, minY = records[0].y, maxY = minY;
+    for (size_t s = 1; s < nbSitesTotal(); ++s) {
+        minX = std::min<double>(minX, records[s].x);
+        maxX = std::max<double>(maxX, records[s].x);
+        minY = std::min<double>(minY, records[s].y);
+        maxY = std::max<double>(maxY, records[s].y);
+    }
+    double centerX = (minX + maxX) / 2, centerY = (minY + maxY) / 2;
+    double radius = 0;
+    for (size_t s = 0; s < nbSitesTotal(); ++s) {
+        radius = std::max(radius, std::hypot(records[s].x - centerX, records[s].y - centerY));
+    }
+    if (radius == 0) radius = 1;
+
+    std::vector<SitePosition> result(nbSitesTotal());
+    for (size_t s = 0; s < nbSitesTotal(); ++s) {
+        result[s] = {(records[s].x - centerX) / radius, (records[s].y - centerY) / radius};
+    }
+    return result;
+}
+
+// Builder threads take chunks of stations; depots hold most of the bikes,
+// so they are built first to end together with the small sites
+std::vector<BikeStation*> buildStations(const CityModel& _model, unsigned int _nbThreads) {
+    const size_t total = _model.nbSitesTotal();
+    std::vector<BikeStation*> stations(total, nullptr);
+
+    std::vector<size_t> order;
+    order.reserve(total);
+    for (size_t d = _model.nbSites(); d < total; ++d) order.push_back(d);
+    for (size_t s = 0; s < _model.nbSites(); ++s) order.push_back(s);
+
+    std::atomic<size_t> next{0};
+    auto builder = [&]() {
+        std::vector<Bike*> content;
+        for (size_t first; (first = next.fetch_add(BUILD_CHUNK)) < total;) {
+            for (size_t i = first; i < std::min(first + BUILD_CHUNK, total); ++i) {
+                size_t s = order[i];
+                content.clear();
+                for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+                    for (uint64_t k = _model.initialBikes(s, t); k > 0; --k) {
+                        Bike* bike = new Bike;
+                        bike->bikeType = t;
+                        content.push_back(bike);
+                    }
+                }
+                stations[s] = new BikeStation(_model.site(s).capacity, content);
+            }
+        }
+    };
+
+    unsigned int nbThreads = _nbThreads ? _nbThreads : std::max(1u, std::thread::hardware_concurrency());
+    nbThreads = std::min<size_t>(nbThreads, (total + BUILD_CHUNK - 1) / BUILD_CHUNK);
+    std::vector<std::unique_ptr<PcoThread>> threads;
+    for (unsigned int i = 1; i < nbThreads; ++i) {
+        threads.push_back(std::make_unique<PcoThread>(builder));
+    }
+    builder(); // the calling thread builds too
+    for (auto& thread : threads) thread->join();
+    return stations;
+}
@@ -0,0 +1,198 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "columnarexporter.h"
+
+#include <algorithm>
+
+#include <pcosynchro/pcothread.h>
+
+ColumnarExporter::ColumnarExporter(const std::string& _path,
+                                   const std::array<BikeStation*, NB_SITES_TOTAL>& _stations)
+    : path(_path), stations(_stations), start(std::chrono::steady_clock::now()) {}
+
+ColumnarExporter::~ColumnarExporter() {
+    if (file) std::fclose(file);
+}
+
+bool ColumnarExporter::open() {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::perror(path.c_str());
+        return false;
+    }
+
+    ColumnarFileHeader header{COLUMNAR_MAGIC, COLUMNAR_VERSION, NB_SITES_TOTAL,
+                              Bike::nbBikeTypes, COLUMNAR_GROUP_ROWS, COLUMNAR_SAMPLE_MS};
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        std::perror(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+uint32_t ColumnarExporter::elapsedMs() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start).count();
+}
+
+// Registers the ring of the calling thread on its first trip
+ColumnarExporter::Ring* ColumnarExporter::threadRing() {
+    thread_local ColumnarExporter* owner = nullptr;
+    thread_local Ring* ring = nullptr;
+
+    if (owner != this) {
+        auto fresh = std::make_unique<Ring>();
+        mutex.lock();
+        ring = fresh.get();
+        rings.push_back(std::move(fresh));
+        mutex.unlock();
+        owner = this;
+    }
+    return ring;
+}
+
+// Producer side: never blocks, drops the trip if the ring is full
+void ColumnarExporter::recordTrip(uint32_t _startMs, unsigned int _origin,
+                                  unsigned int _destination, size_t _type) {
+    Ring* ring = threadRing();
+
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    size_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail == Ring::SIZE) {
+        droppedTrips.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint32_t end = elapsedMs();
+    ring->records[head % Ring::SIZE] = {end, end - std::min(_startMs, end), (uint16_t)_origin,
+                                        (uint16_t)_destination, (uint8_t)_type};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+// Consumer side
+void ColumnarExporter::drainTrips() {
+    mutex.lock();
+    std::vector<Ring*> snapshot;
+    snapshot.reserve(rings.size());
+    for (auto& ring : rings) snapshot.push_back(ring.get());
+    mutex.unlock();
+
+    for (Ring* ring : snapshot) {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            pendingTrips.push_back(ring->records[tail % Ring::SIZE]);
+            if (pendingTrips.size() == COLUMNAR_GROUP_ROWS) flushTrips();
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+}
+
+void ColumnarExporter::sample(uint32_t _timeMs) {
+    for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+        StationCounts counts = stations[s]->counts();
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            pendingSamples.push_back({_timeMs, (uint16_t)s, (uint8_t)t, counts.bikes[t]});
+            if (pendingSamples.size() == COLUMNAR_GROUP_ROWS) flushOccupancy();
+        }
+    }
+}
+
+void ColumnarExporter::writeGroup(ColumnarTable _table, uint32_t _rows,
+                                  const std::vector<uint8_t>& _columns) {
+    ColumnarGroupHeader header{(uint32_t)_table, _rows, (uint32_t)_columns.size()};
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1
+        || std::fwrite(_columns.data(), 1, _columns.size(), file) != _columns.size()) {
+        std::perror(path.c_str());
+    }
+}
+
+void ColumnarExporter::flushOccupancy() {
+    if (pendingSamples.empty()) return;
+
+    std::stable_sort(pendingSamples.begin(), pendingSamples.end(),
+                     [](const OccupancyRow& a, const OccupancyRow& b) {
+                         return a.station != b.station ? a.station < b.station : a.type < b.type;
+                     });
+
+    const size_t rows = pendingSamples.size();
+    std::vector<uint64_t> time(rows), station(rows), type(rows), bikes(rows);
+    for (size_t r = 0; r < rows; ++r) {
+        time[r] = pendingSamples[r].timeMs;
+        station[r] = pendingSamples[r].station;
+        type[r] = pendingSamples[r].type;
+        bikes[r] = pendingSamples[r].bikes;
+    }
+
+    std::vector<uint8_t> columns;
+    encodeIntegers(columns, time);
+    encodeDictionary(columns, station);
+    encodeIntegers(columns, type);
+    encodeIntegers(columns, bikes);
+    writeGroup(ColumnarTable::Occupancy, rows, columns);
+
+    pendingSamples.clear();
+}
+
+void ColumnarExporter::flushTrips() {
+    if (pendingTrips.empty()) return;
+
+    // Each ring is in order, the rings are not ordered between them
+    std::stable_sort(pendingTrips.begin(), pendingTrips.end(),
+                     [](const TripRecord& a, const TripRecord& b) { return a.endMs < b.endMs; });
+
+    const size_t rows = pendingTrips.size();
+    std::vector<uint64_t> time(rows), duration(rows), origin(rows), destination(rows), type(rows);
+    for (size_t r = 0; r < rows; ++r) {
+        time[r] = pendingTrips[r].endMs;
+        duration[r] = pendingTrips[r].durationMs;
+        origin[r] = pendingTrips[r].origin;
+        destination[r] = pendingTrips[r].destination;
+        type[r] = pendingTrips[r].type;
+    }
+
+    std::vector<uint8_t> columns;
+    encodeIntegers(columns, time);
+    encodeIntegers(columns, duration);
+    encodeDictionary(columns, origin);
+    encodeDictionary(columns, destination);
+    encodeIntegers(columns, type);
+    writeGroup(ColumnarTable::Trips, rows, columns);
+
+    pendingTrips.clear();
+}
+
+// Samples are stamped with their scheduled time, so that the time column
+// is a few runs instead of one jittered value per sample
+void ColumnarExporter::run() {
+    uint32_t next = 0;
+    while (!stopRequested.load()) {
+        sample(next);
+        drainTrips();
+        next += COLUMNAR_SAMPLE_MS;
+        uint32_t now = elapsedMs();
+        if (now < next) {
+            PcoThread::usleep((uint64_t)(next - now) * 1000);
+        } else {
+            next = now - now % COLUMNAR_SAMPLE_MS; // late: skip the missed samples
+        }
+    }
+    sample(elapsedMs()); // final state
+    drainTrips();
+    flushOccupancy();
+    flushTrips();
+    std::fflush(file);
+}
+
+void ColumnarExporter::requestStop() {
+    stopRequested = true;
+}
+
+uint64_t ColumnarExporter::dropped() const {
+    return droppedTrips.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,200 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "columnarformat.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+static void putVarint(std::vector<uint8_t>& _out, uint64_t _value) {
+    while (_value >= 0x80) {
+        _out.push_back((uint8_t)(_value | 0x80));
+        _value >>= 7;
+    }
+    _out.push_back((uint8_t)_value);
+}
+
+static bool getVarint(const uint8_t*& _data, const uint8_t* _end, uint64_t& _value) {
+    _value = 0;
+    for (unsigned int shift = 0; _data < _end && shift < 64; shift += 7) {
+        uint8_t byte = *_data++;
+        _value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t _value) {
+    return ((uint64_t)_value << 1) ^ (uint64_t)(_value >> 63);
+}
+
+static int64_t unzigzag(uint64_t _value) {
+    return (int64_t)(_value >> 1) ^ -(int64_t)(_value & 1);
+}
+
+// Bits needed for a value (0 for 0)
+static unsigned int bitWidth(uint64_t _value) {
+    unsigned int width = 0;
+    while (_value) {
+        width++;
+        _value >>= 1;
+    }
+    return width;
+}
+
+void encodePacked(std::vector<uint8_t>& _out, const std::vector<uint64_t>& _values) {
+    uint64_t base = _values.empty() ? 0 : *std::min_element(_values.begin(), _values.end());
+    uint64_t range = _values.empty() ? 0 : *std::max_element(_values.begin(), _values.end()) - base;
+    unsigned int width = bitWidth(range);
+    putVarint(_out, base);
+    _out.push_back((uint8_t)width);
+
+    uint64_t buffer = 0; // bits not yet written, at most 7 + width
+    unsigned int filled = 0;
+    for (uint64_t value : _values) {
+        uint64_t bits = value - base;
+        for (unsigned int done = 0; done < width;) { // by pieces: width may reach 64
+            unsigned int piece = std::min(width - done, 56u);
+            buffer |= ((bits >> done) & ((1ULL << piece) - 1)) << filled;
+            filled += piece;
+            done += piece;
+            while (filled >= 8) {
+                _out.push_back((uint8_t)buffer);
+                buffer >>= 8;
+                filled -= 8;
+            }
+        }
+    }
+    if (filled > 0) _out.push_back((uint8_t)buffer);
+}
+
+bool decodePacked(const uint8_t*& _data, const uint8_t* _end, size_t _rows,
+                  std::vector<uint64_t>& _values) {
+    uint64_t base;
+    if (!getVarint(_data, _end, base) || _data >= _end) return false;
+    unsigned int width = *_data++;
+    if (width > 64 || (uint64_t)(_end - _data) * 8 < (uint64_t)width * _rows) return false;
+
+    _values.resize(_rows);
+    uint64_t position = 0; // in bits
+    for (size_t r = 0; r < _rows; ++r) {
+        uint64_t value = 0;
+        for (unsigned int b = 0; b < width; ++b, ++position) {
+            value |= (uint64_t)((_data[position >> 3] >> (position & 7)) & 1) << b;
+        }
+        _values[r] = base + value;
+    }
+    _data += (position + 7) / 8;
+    return true;
+}
+
+void encodeIntegers(std::vector<uint8_t>& _out, const std::vector<uint64_t>& _values) {
+    std::vector<uint64_t> deltas;
+    deltas.reserve(_values.size());
+    uint64_t previous = 0;
+    for (uint64_t value : _values) {
+        deltas.push_back(zigzag((int64_t)(value - previous)));
+        previous = value;
+    }
+
+    std::vector<uint8_t> runs;
+    uint64_t nbRuns = 0;
+    for (size_t i = 0; i < deltas.size();) {
+        size_t j = i + 1;
+        while (j < deltas.size() && deltas[j] == deltas[i]) ++j;
+        putVarint(runs, deltas[i]);
+        putVarint(runs, j - i);
+        nbRuns++;
+        i = j;
+    }
+    std::vector<uint8_t> header;
+    putVarint(header, nbRuns);
+    runs.insert(runs.begin(), header.begin(), header.end());
+
+    std::vector<uint8_t> packedDeltas;
+    encodePacked(packedDeltas, deltas);
+    std::vector<uint8_t> packed;
+    encodePacked(packed, _values);
+
+    // Smallest first, packed on ties (the cheapest to decode)
+    const std::vector<uint8_t>* best = &packed;
+    ColumnarMode mode = ColumnarMode::Packed;
+    if (packedDeltas.size() < best->size()) {
+        best = &packedDeltas;
+        mode = ColumnarMode::Deltas;
+    }
+    if (runs.size() < best->size()) {
+        best = &runs;
+        mode = ColumnarMode::Runs;
+    }
+    _out.push_back((uint8_t)mode);
+    _out.insert(_out.end(), best->begin(), best->end());
+}
+
+bool decodeIntegers(const uint8_t*& _data, const uint8_t* _end, size_t _rows,
+                    std::vector<uint64_t>& _values) {
+    if (_data >= _end) return false;
+    ColumnarMode mode = (ColumnarMode)*_data++;
+    if (mode == ColumnarMode::Packed) return decodePacked(_data, _end, _rows, _values);
+
+    std::vector<uint64_t> deltas;
+    if (mode == ColumnarMode::Runs) {
+        uint64_t nbRuns;
+        if (!getVarint(_data, _end, nbRuns)) return false;
+        for (uint64_t r = 0; r < nbRuns; ++r) {
+            uint64_t delta, length;
+            if (!getVarint(_data, _end, delta) || !getVarint(_data, _end, length)
+                || length > _rows - deltas.size()) {
+                return false;
+            }
+            deltas.insert(deltas.end(), length, delta);
+        }
+        if (deltas.size() != _rows) return false;
+    } else if (mode != ColumnarMode::Deltas || !decodePacked(_data, _end, _rows, deltas)) {
+        return false;
+    }
+
+    _values.resize(_rows);
+    uint64_t value = 0;
+    for (size_t r = 0; r < _rows; ++r) {
+        value += unzigzag(deltas[r]);
+        _values[r] = value;
+    }
+    return true;
+}
+
+void encodeDictionary(std::vector<uint8_t>& _out, const std::vector<uint64_t>& _values) {
+    std::unordered_map<uint64_t, uint64_t> indexOf;
+    std::vector<uint64_t> dictionary;
+    std::vector<uint64_t> indices;
+    indices.reserve(_values.size());
+    for (uint64_t value : _values) {
+        auto entry = indexOf.emplace(value, dictionary.size());
+        if (entry.second) dictionary.push_back(value);
+        indices.push_back(entry.first->second);
+    }
+
+    putVarint(_out, dictionary.size());
+    for (uint64_t value : dictionary) putVarint(_out, value);
+    encodeIntegers(_out, indices);
+}
+
+bool decodeDictionary(const uint8_t*& _data, const uint8_t* _end, size_t _rows,
+                      std::vector<uint64_t>& _values) {
+    uint64_t size;
+    if (!getVarint(_data, _end, size) || size > (uint64_t)(_end - _data)) return false;
+    std::vector<uint64_t> dictionary(size);
+    for (uint64_t& value : dictionary) {
+        if (!getVarint(_data, _end, value)) return false;
+    }
+    if (!decodeIntegers(_data, _end, _rows, _values)) return false;
+    for (uint64_t& value : _values) {
+        if (value >= size) return false;
+        value = dictionary[value];
+    }
+    return true;
+}
@@ -0,0 +1,390 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "controlserver.h"
+#include "metrics.h"
+#include "lockprofiler.h"
+#include "simtime.h"
+#include "simulation.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <pcosynchro/pcothread.h>
+
+BikingInterface* ControlServer::binkingInterface = nullptr;
+const CheckpointSources* ControlServer::checkpointSources = nullptr;
+
+static const int POLL_TIMEOUT_MS = 10;        // also the reply latency
+static const unsigned int IDLE_SLEEP_US = 5000;
+static const unsigned int MAX_INJECT = 1000;  // bikes per inject command
+static const size_t MAX_LINE = 256;
+static const size_t MAX_OUTPUT = 1 << 20;     // unread replies before a client is dropped
+static const unsigned int DEFAULT_LOCK_ROWS = 5;  // locks command
+
+ControlServer::ControlServer(const std::string& _path,
+                             const std::array<BikeStation*, NB_SITES_TOTAL>& _stations,
+                             VanFleet* _vanFleet)
+    : path(_path), stations(_stations), vanFleet(_vanFleet) {}
+
+ControlServer::~ControlServer() {
+    for (auto& client : clients) {
+        close(client.second.fd);
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(path.c_str());
+    }
+}
+
+void ControlServer::setInterface(BikingInterface* _binkingInterface) {
+    binkingInterface = _binkingInterface;
+}
+
+void ControlServer::setCheckpointSources(const CheckpointSources* _sources) {
+    checkpointSources = _sources;
+}
+
+bool ControlServer::open() {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::fprintf(stderr, "Control socket path too long: %s\n", path.c_str());
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+
+    // A socket file is only replaced if nobody listens on it anymore
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            std::fprintf(stderr, "Control socket path is not a socket: %s\n", path.c_str());
+            return false;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0 && connect(probe, (sockaddr*)&address, sizeof(address)) == 0;
+        if (probe >= 0) close(probe);
+        if (live) {
+            std::fprintf(stderr, "Control socket in use by another run: %s\n", path.c_str());
+            return false;
+        }
+        unlink(path.c_str()); // left over by a previous run
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listenFd < 0) {
+        std::perror("socket");
+        return false;
+    }
+    if (bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 8) != 0) {
+        std::perror("bind/listen");
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+// Server thread: owns every socket
+void ControlServer::serverRun() {
+    uint64_t nextClient = 0;
+    std::vector<pollfd> fds;
+    std::vector<uint64_t> ids;
+    std::chrono::steady_clock::time_point drainDeadline;
+    bool draining = false;
+
+    while (true) {
+        fds.assign(1, {listenFd, (short)(draining ? 0 : POLLIN), 0});
+        ids.assign(1, 0);
+        for (auto& client : clients) {
+            short events = client.second.inputClosed ? 0 : POLLIN;
+            if (!client.second.output.empty()) events |= POLLOUT;
+            fds.push_back({client.second.fd, events, 0});
+            ids.push_back(client.first);
+        }
+        poll(fds.data(), fds.size(), POLL_TIMEOUT_MS);
+
+        // New clients
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                clients[nextClient++] = Client{fd, {}, {}};
+            }
+        }
+
+        // Complete lines become commands, errors are answered right away
+        for (size_t i = 1; i < fds.size(); ++i) {
+            Client& client = clients.at(ids[i]);
+            bool broken = (fds[i].revents & POLLERR) != 0;
+            if (fds[i].revents & POLLOUT) broken |= !flushOutput(client);
+            if (!broken && !client.inputClosed && (fds[i].revents & (POLLIN | POLLHUP))) {
+                char buffer[512];
+                ssize_t n = read(client.fd, buffer, sizeof(buffer));
+                if (n == 0) {
+                    client.inputClosed = true; // its replies are still sent
+                } else if (n < 0) {
+                    broken = errno != EAGAIN && errno != EINTR;
+                } else {
+                    client.input.append(buffer, n);
+                }
+            }
+
+            size_t end;
+            while (!broken && (end = client.input.find('\n')) != std::string::npos) {
+                std::string text = client.input.substr(0, end);
+                client.input.erase(0, end + 1);
+
+                Command command;
+                std::string error;
+                if (!parse(text, ids[i], command, error)) {
+                    queueOutput(client, "error " + error + "\n");
+                } else if (draining || !commands.push(command)) {
+                    queueOutput(client, draining ? "error stopping\n" : "error busy\n");
+                } else {
+                    client.awaited++;
+                }
+            }
+            if (client.input.size() > MAX_LINE) client.input.clear(); // garbage without newline
+
+            if (broken || client.output.size() > MAX_OUTPUT
+                || (client.inputClosed && client.awaited == 0 && client.output.empty())) {
+                close(client.fd);
+                clients.erase(ids[i]);
+            }
+        }
+
+        // Replies of the control thread; once it has returned, the queue
+        // holds its last ones
+        bool controlDone = controlReturned.load();
+        Reply answer;
+        while (replies.pop(answer)) {
+            auto client = clients.find(answer.client);
+            if (client == clients.end()) continue; // client gone
+            client->second.awaited--;
+            queueOutput(client->second, answer.text);
+        }
+
+        // After a stop, until every reply is written or the drain time is over
+        if (stopRequested.load()) {
+            auto now = std::chrono::steady_clock::now();
+            if (!draining) {
+                draining = true;
+                drainDeadline = now + std::chrono::milliseconds(CONTROL_DRAIN_MS);
+            }
+            bool written = true;
+            for (auto& client : clients) written &= client.second.output.empty();
+            if ((controlDone && written) || now >= drainDeadline) break;
+        }
+    }
+}
+
+void ControlServer::queueOutput(Client& _client, const std::string& _text) {
+    _client.output += _text;
+    flushOutput(_client); // a failure is seen at the next poll
+}
+
+bool ControlServer::flushOutput(Client& _client) {
+    while (!_client.output.empty()) {
+        ssize_t n = ::send(_client.fd, _client.output.data(), _client.output.size(),
+                           MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK; // POLLOUT resumes
+        }
+        _client.output.erase(0, n);
+    }
+    return true;
+}
+
+// Control thread: the only thread applying commands
+void ControlServer::controlRun() {
+    while (!stopRequested.load()) {
+        Command command;
+        if (!commands.pop(command)) {
+            PcoThread::usleep(IDLE_SLEEP_US);
+            continue;
+        }
+        reply(command.client, apply(command));
+    }
+    controlReturned = true;
+}
+
+void ControlServer::requestStop() {
+    stopRequested = true;
+}
+
+void ControlServer::reply(uint64_t _client, const std::string& _text) {
+    // The server thread drains the replies every poll timeout
+    while (!replies.push({_client, _text + "\n"}) && !stopRequested.load()) {
+        PcoThread::usleep(IDLE_SLEEP_US);
+    }
+}
+
+bool ControlServer::parse(const std::string& _line, uint64_t _client, Command& _command,
+                          std::string& _error) const {
+    std::istringstream in(_line);
+    std::string word;
+    in >> word;
+    _command = Command{_client, CommandType::Metrics, 0, NB_SITES_TOTAL, 0, 0, 0.0, {}};
+
+    auto site = [&]() {
+        if (!(in >> _command.site) || _command.site >= NB_SITES_TOTAL) {
+            _error = "bad site";
+            return false;
+        }
+        return true;
+    };
+
+    if (word == "inject") {
+        _command.type = CommandType::Inject;
+        if (!site()) return false;
+        if (!(in >> _command.bikeType >> _command.count) || _command.bikeType >= Bike::nbBikeTypes
+            || _command.count == 0 || _command.count > MAX_INJECT) {
+            _error = "usage: inject <site> <type> <n>";
+            return false;
+        }
+    } else if (word == "close" || word == "open") {
+        _command.type = word == "close" ? CommandType::Close : CommandType::Open;
+        return site();
+    } else if (word == "vans") {
+        _command.type = CommandType::Vans;
+        if (!(in >> _command.count) || _command.count > MAX_VANS) {
+            _error = "usage: vans <n>";
+            return false;
+        }
+    } else if (word == "speed") {
+        _command.type = CommandType::Speed;
+        if (!(in >> _command.factor) || _command.factor <= 0) {
+            _error = "usage: speed <factor>";
+            return false;
+        }
+    } else if (word == "metrics") {
+        _command.type = CommandType::Metrics;
+    } else if (word == "locks") {
+        _command.type = CommandType::Locks;
+        if (!(in >> _command.count)) {
+            _command.count = DEFAULT_LOCK_ROWS;
+        }
+    } else if (word == "latency") {
+        _command.type = CommandType::Latency;
+        if (in >> _command.site) {
+            if (!(in >> _command.destination) || _command.site >= NB_SITES_TOTAL
+                || _command.destination >= NB_SITES_TOTAL) {
+                _error = "usage: latency [<from> <to>]";
+                return false;
+            }
+        }
+    } else if (word == "checkpoint") {
+        _command.type = CommandType::Checkpoint;
+        if (!(in >> _command.path)) {
+            _error = "usage: checkpoint <path>";
+            return false;
+        }
+    } else if (word == "stop") {
+        _command.type = CommandType::Stop;
+    } else {
+        _error = "unknown command";
+        return false;
+    }
+    return true;
+}
+
+std::string ControlServer::apply(const Command& _command) {
+    std::ostringstream out;
+    out << "ok";
+
+    switch (_command.type) {
+    case CommandType::Inject: {
+        std::vector<Bike*> bikes;
+        for (unsigned int i = 0; i < _command.count; ++i) {
+            auto* bike = new Bike;
+            bike->bikeType = _command.bikeType;
+            bikes.push_back(bike);
+        }
+        // Non-blocking: bikes that do not fit are refused
+        std::vector<Bike*> rejected = stations[_command.site]->tryAddBikes(bikes);
+        for (Bike* bike : rejected) delete bike;
+        if (binkingInterface) {
+            binkingInterface->setBikes(_command.site, stations[_command.site]->nbBikes());
+        }
+        out << " injected " << bikes.size() - rejected.size();
+        break;
+    }
+    case CommandType::Close:
+    case CommandType::Open:
+        stations[_command.site]->setOpen(_command.type == CommandType::Open);
+        break;
+    case CommandType::Vans:
+        out << " vans " << vanFleet->setCount(_command.count);
+        break;
+    case CommandType::Speed:
+        setSpeedFactor(_command.factor);
+        out << " speed " << speedFactor();
+        break;
+    case CommandType::Metrics:
+        out << " trips=" << globalMetrics.tripsCompleted.load()
+            << " waits=" << globalMetrics.riderWaits.load()
+            << " incentives=" << globalMetrics.incentivesAccepted.load()
+            << " breakdowns=" << globalMetrics.breakdowns.load()
+            << " repairs=" << globalMetrics.repairs.load()
+            << " vanDistance=" << globalMetrics.vanDistance()
+            << " vans=" << vanFleet->count()
+            << " speed=" << speedFactor();
+        break;
+    case CommandType::Locks: {
+        if (!LOCK_PROFILING_ENABLED) {
+            return "error lock profiling not compiled in";
+        }
+        std::vector<LockProfileEntry> entries = globalLockProfiler.collect();
+        for (size_t i = 0; i < entries.size() && i < _command.count; ++i) {
+            out << " " << entries[i].station << ":" << lockSiteName(entries[i].site)
+                << " acq=" << entries[i].acquisitions
+                << " contended=" << entries[i].contended
+                << " waitUs=" << entries[i].waitNs / 1000
+                << " holdUs=" << entries[i].holdNs / 1000;
+        }
+        break;
+    }
+    case CommandType::Latency:
+        // p50/p95/p99 in milliseconds
+        for (size_t p = 0; p < NB_TRIP_PHASES; ++p) {
+            LatencyHistogram histogram = _command.destination < NB_SITES_TOTAL
+                ? globalTripLatency.pair((TripPhase)p, _command.site, _command.destination)
+                : globalTripLatency.phase((TripPhase)p);
+            out << " " << tripPhaseName((TripPhase)p) << "=" << histogram.count() << ":"
+                << histogram.percentile(0.50) / 1e3 << "/" << histogram.percentile(0.95) / 1e3
+                << "/" << histogram.percentile(0.99) / 1e3;
+        }
+        break;
+    case CommandType::Checkpoint: {
+        // Pauses the simulation only while its state is copied
+        std::string error;
+        if (!checkpointSources) {
+            return "error checkpoints not available";
+        }
+        if (!saveCheckpoint(_command.path, *checkpointSources, error)) {
+            return "error " + error;
+        }
+        out << " saved " << _command.path;
+        break;
+    }
+    case CommandType::Stop:
+        stopSimulation(); // also stops this server
+        break;
+    }
+    return out.str();
+}
@@ -7,17 +7,17 @@
   ****************************************************************************/
 
 #include "display.h"
+#include "citylayout.h"
 
 #include <QPaintEvent>
 #include <QPainter>
+#include <QWheelEvent>
+#include <QStyleOptionGraphicsItem>
 
-#include <QParallelAnimationGroup>
-#include <QPropertyAnimation>
-#include <QEventLoop>
-#include <QMutex>
 
 
 #include <cmath>
+#include <utility>
 
 #define RADIUS 250.0
 #define SCENEOFFSET 50.0
@@ -28,58 +28,398 @@
 
 #define NBPERSONICONS 30
 
+// Au-delà de ce nombre de sites (dépôts compris), passage en mode grande ville
+#define LARGESITES 200
+// Rayon et espacement minimal des glyphes de site en mode grande ville
+#define GLYPHRADIUS 4.0
+#define GLYPHSPACING 12.0
+// Taille des courbes d'historique (mode normal, mode grande ville)
+#define SPARKWIDTH 50.0
+#define SPARKHEIGHT 14.0
+#define SPARKLARGEWIDTH 12.0
+#define SPARKLARGEHEIGHT 4.0
+// Niveau de détail à partir duquel les courbes sont dessinées (grande ville)
+#define SPARKLARGELOD 3.0
+
+// Période de l'animation des déplacements (~60 Hz)
+#define MOVEFRAMEMS 16
+// Clé (QGraphicsItem::data) de l'enregistrement de déplacement d'un élément
+#define MOVESLOTKEY 0
+
+SpriteAtlas::SpriteAtlas()
+{
+    bike=QPixmap(":/images/velo.png").scaledToWidth(BIKEWIDTH);
+    van=QPixmap(":/images/camionette.png").scaledToWidth(VANWIDTH);
+    for(int i=0;i<NBPERSONICONS;i++)
+        persons.append(QPixmap(QString(":/images/32x32/p%1.png").arg(i))
+                       .scaledToWidth(BIKEWIDTH));
+}
+
+const SpriteAtlas &SpriteAtlas::instance()
+{
+    static const SpriteAtlas atlas;
+    return atlas;
+}
+
+SiteLayer::SiteLayer(const QVector<QPointF> &pos,unsigned int nbSite,QRectF bounds):
+    m_pos(pos),m_count(pos.size(),0),m_capacity(pos.size(),0),
+    m_nbSite(nbSite),m_bounds(bounds)
+{
+    // Nécessaire pour obtenir la zone exposée dans paint()
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+QRectF SiteLayer::boundingRect() const
+{
+    return m_bounds;
+}
+
+QRectF SiteLayer::glyphRect(unsigned int site) const
+{
+    return QRectF(m_pos[site].x()-GLYPHRADIUS,m_pos[site].y()-GLYPHRADIUS,
+                  2*GLYPHRADIUS,2*GLYPHRADIUS);
+}
+
+void SiteLayer::paint(QPainter *painter,const QStyleOptionGraphicsItem *option,
+                      QWidget *)
+{
+    const qreal lod=QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+                painter->worldTransform());
+    const QRectF &exposed=option->exposedRect;
+
+    painter->setPen(Qt::NoPen);
+    for(int i=0;i<m_pos.size();i++) {
+        QRectF r=glyphRect(i);
+        if (!exposed.intersects(r))
+            continue;
+
+        // Rouge : site vide, vert : site plein
+        double ratio=m_capacity[i] ? qMin(1.0,double(m_count[i])/m_capacity[i])
+                                   : (m_count[i]>0 ? 1.0 : 0.0);
+        QColor color=QColor::fromHsvF(ratio/3.0,0.9,0.9);
+
+        if (lod<0.5) {
+            // Vue d'ensemble : un simple carré coloré par site
+            painter->fillRect(r,color);
+            continue;
+        }
+        painter->setBrush(color);
+        painter->drawPie(r,90*16,-int(ratio*360*16));
+        if ((lod>=3.0)&&((unsigned int)i<m_nbSite)) {
+            painter->setPen(Qt::black);
+            QFont font=painter->font();
+            font.setPointSizeF(GLYPHRADIUS);
+            painter->setFont(font);
+            painter->drawText(r.translated(0,2*GLYPHRADIUS),Qt::AlignCenter,
+                              QString::number(m_count[i]));
+            painter->setPen(Qt::NoPen);
+        }
+    }
+}
+
+void SiteLayer::setCount(unsigned int site,unsigned int nbBike)
+{
+    if ((int)site>=m_pos.size()||m_count[site]==nbBike)
+        return;
+    m_count[site]=nbBike;
+    update(glyphRect(site));
+}
+
+void SiteLayer::setCapacity(unsigned int site,unsigned int capacity)
+{
+    if ((int)site>=m_pos.size())
+        return;
+    m_capacity[site]=capacity;
+    update(glyphRect(site));
+}
+
+SparklineLayer::SparklineLayer(const QVector<QPointF> &pos,QSizeF size,
+                               qreal offset,qreal minLod,QRectF bounds):
+    m_pos(pos),m_series(pos.size()),m_size(size),m_offset(offset),
+    m_minLod(minLod),m_bounds(bounds)
+{
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+QRectF SparklineLayer::boundingRect() const
+{
+    return m_bounds;
+}
+
+QRectF SparklineLayer::sparkRect(unsigned int site) const
+{
+    return QRectF(m_pos[site].x()-m_size.width()/2,m_pos[site].y()+m_offset,
+                  m_size.width(),m_size.height());
+}
+
+void SparklineLayer::setSeries(unsigned int site,
+                               const std::vector<OccupancyHistory::Range> &series)
+{
+    if ((int)site>=m_pos.size())
+        return;
+    m_series[site]=series;
+    update(sparkRect(site));
+}
+
+void SparklineLayer::paint(QPainter *painter,const QStyleOptionGraphicsItem *option,
+                           QWidget *)
+{
+    const qreal lod=QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+                painter->worldTransform());
+    if (lod<m_minLod)
+        return;
+
+    QVector<QLineF> lines;
+    for(int i=0;i<m_pos.size();i++) {
+        const std::vector<OccupancyHistory::Range> &series=m_series[i];
+        QRectF r=sparkRect(i);
+        if (series.empty()||!option->exposedRect.intersects(r))
+            continue;
+
+        painter->fillRect(r,QColor(255,255,255,200));
+
+        // Une ligne verticale min-max par intervalle de temps
+        lines.clear();
+        const qreal step=r.width()/series.size();
+        for(size_t k=0;k<series.size();k++) {
+            qreal x=r.left()+(k+0.5)*step;
+            lines.append(QLineF(x,r.bottom()-series[k].min*r.height(),
+                                x,r.bottom()-series[k].max*r.height()-0.5));
+        }
+        QPen pen(QColor(30,30,200));
+        pen.setWidthF(qMax<qreal>(step,0.5));
+        painter->setPen(pen);
+        painter->drawLines(lines);
+    }
+}
+
+MoverLayer::MoverLayer(unsigned int nbPerson,QRectF bounds):
+    m_slot(nbPerson,-1),m_bounds(bounds)
+{
+    m_movers.reserve(nbPerson);
+    m_riding.reserve(nbPerson);
+    m_walking.reserve(nbPerson);
+    m_clock.start();
+}
+
+QRectF MoverLayer::boundingRect() const
+{
+    return m_bounds;
+}
+
+void MoverLayer::setBounds(QRectF bounds)
+{
+    prepareGeometryChange();
+    m_bounds=bounds;
+}
+
+void MoverLayer::start(unsigned int personId,QPointF from,QPointF to,
+                       unsigned int ms,bool riding)
+{
+    if ((int)personId>=m_slot.size())
+        m_slot.resize(personId+1,-1);
+    int index=m_slot[personId];
+    if (index<0) {
+        index=m_nbActive++;
+        if (index==m_movers.size())
+            m_movers.append(Mover());
+        m_slot[personId]=index;
+    }
+    Mover &mover=m_movers[index];
+    mover.personId=personId;
+    mover.from=from;
+    mover.to=to;
+    mover.t0=m_clock.elapsed();
+    mover.duration=qMax(1u,ms);
+    mover.riding=riding;
+}
+
+bool MoverLayer::advance()
+{
+    const qint64 now=m_clock.elapsed();
+    m_riding.clear();
+    m_walking.clear();
+    int i=0;
+    while (i<m_nbActive) {
+        Mover &mover=m_movers[i];
+        double f=double(now-mover.t0)/mover.duration;
+        if (f<1.0) {
+            QPointF p=mover.from+(mover.to-mover.from)*f;
+            (mover.riding ? m_riding : m_walking).append(p);
+            i++;
+            continue;
+        }
+        // Arrivé : remplacé par le dernier actif, l'enregistrement est gardé
+        m_slot[mover.personId]=-1;
+        if (i!=m_nbActive-1) {
+            std::swap(m_movers[i],m_movers[m_nbActive-1]);
+            m_slot[m_movers[i].personId]=i;
+        }
+        m_nbActive--;
+    }
+    return !m_riding.isEmpty()||!m_walking.isEmpty();
+}
+
+void MoverLayer::paint(QPainter *painter,const QStyleOptionGraphicsItem *,
+                       QWidget *)
+{
+    // Taille constante à l'écran, quel que soit le zoom
+    QPen pen(QColor(30,30,200),3);
+    pen.setCosmetic(true);
+    painter->setPen(pen);
+    painter->drawPoints(m_riding.constData(),m_riding.size());
+    pen.setColor(QColor(120,120,120));
+    painter->setPen(pen);
+    painter->drawPoints(m_walking.constData(),m_walking.size());
+}
+
 BikeItem::BikeItem() = default;
 
 PersonItem::PersonItem() = default;
 
-BikeDisplay::BikeDisplay(unsigned int nbSite,QWidget *parent):
+BikeDisplay::BikeDisplay(unsigned int nbSite,unsigned int nbDepot,
+                         unsigned int nbPerson,unsigned int nbBike,
+                         QWidget *parent):
     QGraphicsView(parent)
 {
-    m_sitePos=new QPointF[nbSite+1];
-    for(unsigned int i=0;i<nbSite;i++)
+    m_nbSite=nbSite;
+    m_nbDepot=nbDepot;
+    m_large=(nbSite+nbDepot>LARGESITES);
+
+    // En mode grande ville, la scène grandit avec le nombre de sites pour
+    // que les glyphes ne se chevauchent pas (ville répartie sur le disque)
+    m_radius=RADIUS;
+    if (m_large)
+        m_radius=qMax(RADIUS,GLYPHSPACING*std::sqrt((nbSite+nbDepot)/M_PI));
+
+    // Sites on the outer circle, depots on an inner circle (see citylayout.h)
+    m_sitePos=new QPointF[nbSite+nbDepot];
+    for(unsigned int i=0;i<nbSite+nbDepot;i++)
     {
-        m_sitePos[i]=
-                QPointF(SCENEOFFSET+RADIUS+RADIUS*cos(2.0*3.14/((float)nbSite)
-                                                      *((float)i)),
-                        SCENEOFFSET+RADIUS+RADIUS*sin(2.0*3.14/((float)nbSite)
-                                                      *((float)i)));
+        SitePosition p=sitePosition(i,nbSite,nbDepot);
+        m_sitePos[i]=QPointF(SCENEOFFSET+m_radius+m_radius*p.x,
+                             SCENEOFFSET+m_radius+m_radius*p.y);
     }
-    m_sitePos[nbSite]=
-            QPointF(SCENEOFFSET+RADIUS,
-                    SCENEOFFSET+RADIUS);
     m_scene=new QGraphicsScene(this);
-    this->setRenderHints(QPainter::Antialiasing |
-                         QPainter::SmoothPixmapTransform);
     this->setMinimumHeight(2*SCENEOFFSET+2*RADIUS+10.0);
     this->setMinimumWidth(2*SCENEOFFSET+2*RADIUS+10.0);
-    m_scene->setSceneRect(0,0,2*SCENEOFFSET+2*RADIUS,2*SCENEOFFSET+2*RADIUS);
+    m_scene->setSceneRect(sceneBounds());
     this->setScene(m_scene);
-    m_nbSite=nbSite;
 
-    QPen pen;
-    QBrush brush(QColor(100,255,100));
-    for(unsigned int i=0;i<nbSite;i++) {
-        m_scene->addEllipse(m_sitePos[i].x()-SITERADIUS,
-                            m_sitePos[i].y()-SITERADIUS,
-                            2*SITERADIUS,
-                            2*SITERADIUS,
-                            pen,brush);
-    }
-    brush=QBrush(QColor(255,100,100));
-    m_scene->addEllipse(m_sitePos[nbSite].x()-SITERADIUS,
-                        m_sitePos[nbSite].y()-SITERADIUS,
-                        2*SITERADIUS,
-                        2*SITERADIUS,
-                        pen,brush);
-    m_sites=new QList<BikeItem*>[nbSite+1];
-
-    QPixmap img("images/camionette.png");
-    QPixmap vanPixmap;
-    vanPixmap=img.scaledToWidth(VANWIDTH);
+    // Les disques des sites ne changent pas : dessinés dans le fond, en cache
+    this->setCacheMode(QGraphicsView::CacheBackground);
+
+    m_sites=new QList<BikeItem*>[nbSite+nbDepot];
+
+    // Un seul minuteur anime tout ce qui se déplace, voir advanceFrame()
+    m_clock.start();
+    m_frameTimer=new QTimer(this);
+    connect(m_frameTimer,&QTimer::timeout,this,&BikeDisplay::advanceFrame);
+    m_moves.reserve(2*nbPerson+1);
+
     m_van=new BikeItem();
-    m_van->setPixmap(vanPixmap);
+    m_van->setPixmap(SpriteAtlas::instance().van);
     m_scene->addItem(m_van);
     m_van->setPos(m_sitePos[nbSite]);
+
+    if (m_large) {
+        // Pas d'antialiasing, peu d'éléments qui couvrent toute la scène :
+        // redessiner toute la vue coûte moins que suivre les zones modifiées
+        this->setRenderHints(QPainter::RenderHints());
+        this->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+        this->setOptimizationFlags(QGraphicsView::DontSavePainterState |
+                                   QGraphicsView::DontAdjustForAntialiasing);
+        this->setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+        this->setDragMode(QGraphicsView::ScrollHandDrag);
+        m_scene->setItemIndexMethod(QGraphicsScene::NoIndex);
+
+        QVector<QPointF> pos(m_sitePos,m_sitePos+nbSite+nbDepot);
+        m_siteLayer=new SiteLayer(pos,nbSite,sceneBounds());
+        m_scene->addItem(m_siteLayer);
+        m_moverLayer=new MoverLayer(nbPerson+1,sceneBounds());
+        m_scene->addItem(m_moverLayer);
+
+        // La camionnette garde sa taille à l'écran, la ville tient dans la vue
+        m_sparklines=new SparklineLayer(pos,QSizeF(SPARKLARGEWIDTH,SPARKLARGEHEIGHT),
+                                        GLYPHRADIUS+1.0,SPARKLARGELOD,sceneBounds());
+        m_scene->addItem(m_sparklines);
+
+        m_van->setFlag(QGraphicsItem::ItemIgnoresTransformations);
+        m_van->setZValue(1);
+        this->scale(RADIUS/m_radius,RADIUS/m_radius);
+        return;
+    }
+
+    this->setRenderHints(QPainter::Antialiasing |
+                         QPainter::SmoothPixmapTransform);
+
+    QVector<QPointF> pos(m_sitePos,m_sitePos+nbSite+nbDepot);
+    m_sparklines=new SparklineLayer(pos,QSizeF(SPARKWIDTH,SPARKHEIGHT),
+                                    SITERADIUS+4.0,0.0,sceneBounds());
+    m_scene->addItem(m_sparklines);
+
+    // Tous les éléments sont créés au démarrage : un vélo est soit sur un
+    // site, soit en route, et les personnes sont numérotées de 0 à nbPerson
+    m_freeBikes.reserve(nbBike);
+    for(unsigned int i=0;i<nbBike;i++)
+        m_freeBikes << createBike();
+    getPerson(nbPerson);
+}
+
+QRectF BikeDisplay::sceneBounds() const
+{
+    return QRectF(0,0,2*SCENEOFFSET+2*m_radius,2*SCENEOFFSET+2*m_radius);
+}
+
+void BikeDisplay::drawBackground(QPainter *painter,const QRectF &rect)
+{
+    painter->fillRect(rect,backgroundBrush());
+
+    const double r=m_large ? GLYPHRADIUS+1.0 : SITERADIUS;
+    QPen pen;
+    pen.setCosmetic(true);
+    painter->setPen(m_large ? QPen(Qt::NoPen) : pen);
+    for(unsigned int i=0;i<m_nbSite+m_nbDepot;i++) {
+        QRectF disk(m_sitePos[i].x()-r,m_sitePos[i].y()-r,2*r,2*r);
+        if (!rect.intersects(disk))
+            continue;
+        painter->setBrush(i<m_nbSite ? QColor(100,255,100) : QColor(255,100,100));
+        painter->drawEllipse(disk);
+    }
+}
+
+void BikeDisplay::wheelEvent(QWheelEvent *event)
+{
+    if (!m_large) {
+        QGraphicsView::wheelEvent(event);
+        return;
+    }
+    double factor=std::pow(1.0015,event->angleDelta().y());
+    scale(factor,factor);
+}
+
+void BikeDisplay::setSiteCapacity(unsigned int site,unsigned int capacity)
+{
+    if (m_large)
+        m_siteLayer->setCapacity(site,capacity);
+}
+
+void BikeDisplay::startMover(unsigned int personId,unsigned int site1,
+                             unsigned int site2,unsigned int ms,bool riding)
+{
+    m_moverLayer->start(personId,m_sitePos[site1],m_sitePos[site2],ms,riding);
+    if (!m_frameTimer->isActive())
+        m_frameTimer->start(MOVEFRAMEMS);
+}
+
+
+BikeItem *BikeDisplay::createBike()
+{
+    auto *bike=new BikeItem();
+    bike->setPixmap(SpriteAtlas::instance().bike);
+    m_scene->addItem(bike);
+    bike->hide();
+    return bike;
 }
 
 
@@ -93,14 +433,8 @@ BikeItem *BikeDisplay::getFreeBike()
         return bike;
     }
     else {
-        QPixmap img("images/velo.png");
-        QPixmap bikePixmap;
-        bikePixmap=img.scaledToWidth(BIKEWIDTH);
-        auto *bike=new BikeItem();
-        bike->setPixmap(bikePixmap);
-        m_scene->addItem(bike);
-        bike->hide();
-        return bike;
+        // Uniquement si la flotte grandit (bouton +1 depot)
+        return createBike();
     }
 }
 
@@ -113,19 +447,9 @@ void BikeDisplay::setFreeBike(BikeItem *bike)
 void BikeDisplay::vanTravel(unsigned int site1,unsigned int site2,
                             unsigned int ms)
 {
-    static QMutex mutex;
-    mutex.lock();
     m_van->show();
-    auto *animation=new QPropertyAnimation(m_van, "pos");
-    animation->setDuration(ms-10);
-    animation->setStartValue(m_sitePos[site1]-QPointF(VANWIDTH/2,VANWIDTH/2));
-    animation->setEndValue(m_sitePos[site2]-QPointF(VANWIDTH/2,VANWIDTH/2));
-    animation->start();
-
-    QObject::connect(animation, SIGNAL(finished()), this,
-                     SLOT(finishedVanAnimation()));
-
-    mutex.unlock();
+    startMove(m_van,m_sitePos[site1]-QPointF(VANWIDTH/2,VANWIDTH/2),
+              m_sitePos[site2]-QPointF(VANWIDTH/2,VANWIDTH/2),ms,MoveKeep);
 }
 
 void BikeDisplay::walk(unsigned int personId,
@@ -133,45 +457,28 @@ void BikeDisplay::walk(unsigned int personId,
                        unsigned int site2,
                        unsigned int ms)
 {
-    static QMutex mutex;
-    mutex.lock();
-
-    auto *group = new QParallelAnimationGroup(this);
-
-    {
-        PersonItem *person = getPerson(personId);
-        person->show();
-        auto *animation = new QPropertyAnimation(person, "pos");
-        animation->setDuration(ms - 10);
-        animation->setStartValue(m_sitePos[site1] -
-                                 QPointF(BIKEWIDTH/2, BIKEWIDTH*1.2));
-        animation->setEndValue(m_sitePos[site2] -
-                               QPointF(BIKEWIDTH/2, BIKEWIDTH*1.2));
-        group->addAnimation(animation);
+    if (m_large) {
+        startMover(personId,site1,site2,ms,false);
+        return;
     }
 
-    group->start();
-
-    QObject::connect(group, SIGNAL(finished()), this,
-                     SLOT(finishedAnimation()));
-
-    mutex.unlock();
-}
-
-
-void BikeDisplay::finishedVanAnimation()
-{
-    auto *animation=dynamic_cast<QPropertyAnimation*>(sender());
-    delete animation;
+    PersonItem *person=getPerson(personId);
+    person->show();
+    startMove(person,m_sitePos[site1]-QPointF(BIKEWIDTH/2,BIKEWIDTH*1.2),
+              m_sitePos[site2]-QPointF(BIKEWIDTH/2,BIKEWIDTH*1.2),ms,MoveScatter);
 }
 
 void BikeDisplay::setBikes(unsigned int site,unsigned int nbBike)
 {
-    if (site>m_nbSite)
+    if (site>=m_nbSite+m_nbDepot)
         return;
+    if (m_large) {
+        m_siteLayer->setCount(site,nbBike);
+        return;
+    }
     BikeItem *bike = nullptr;
     while ((m_sites[site].count()>0)&&(m_sites[site].count()>(int)nbBike)) {
-        bike=getFreeBike();BikeItem *bike=m_sites[site].first();
+        bike=m_sites[site].first();
         m_sites[site].removeFirst();
         setFreeBike(bike);
         bike->hide();
@@ -190,6 +497,9 @@ void BikeDisplay::setBikes(unsigned int site,unsigned int nbBike)
 
 void BikeDisplay::setPerson(unsigned int site, unsigned int personID)
 {
+    // En mode grande ville, seules les personnes en route sont dessinées
+    if (m_large)
+        return;
     PersonItem *person = getPerson(personID);
     QPointF curPos = m_sitePos[site];
     float angle = rand();
@@ -202,11 +512,8 @@ PersonItem *BikeDisplay::getPerson(unsigned int personId)
 {
     while ((unsigned int)(m_persons.size()) <= personId)
     {
-        QPixmap img(QString("images/32x32/p%1.png").arg(m_persons.size() % NBPERSONICONS));
-        QPixmap personPixmap;
-        personPixmap=img.scaledToWidth(BIKEWIDTH);
         auto *person=new PersonItem();
-        person->setPixmap(personPixmap);
+        person->setPixmap(SpriteAtlas::instance().persons.at(m_persons.size() % NBPERSONICONS));
         m_scene->addItem(person);
         m_persons.append(person);
         person->hide();
@@ -217,63 +524,105 @@ PersonItem *BikeDisplay::getPerson(unsigned int personId)
 
 void BikeDisplay::travel(unsigned int personId,unsigned int site1, unsigned int site2,unsigned int ms)
 {
-    static QMutex mutex;
-    mutex.lock();
+    if (m_large) {
+        startMover(personId,site1,site2,ms,true);
+        return;
+    }
 
+    BikeItem *bike=getFreeBike();
+    bike->show();
+    startMove(bike,m_sitePos[site1]-QPointF(BIKEWIDTH/2,BIKEWIDTH/2),
+              m_sitePos[site2]-QPointF(BIKEWIDTH/2,BIKEWIDTH/2),ms,MoveFreeBike);
 
-    auto *group=new QParallelAnimationGroup(this);
+    PersonItem *person=getPerson(personId);
+    person->show();
+    startMove(person,m_sitePos[site1]-QPointF(BIKEWIDTH/2,BIKEWIDTH*1.2),
+              m_sitePos[site2]-QPointF(BIKEWIDTH/2,BIKEWIDTH*1.2),ms,MoveScatter);
+}
 
-    {
-        BikeItem *bike=getFreeBike();
-        bike->show();
-        auto *animation=new QPropertyAnimation(bike, "pos");
-        animation->setDuration(ms-10);
-        animation->setStartValue(m_sitePos[site1]-
-                                 QPointF(BIKEWIDTH/2,BIKEWIDTH/2));
-        animation->setEndValue(m_sitePos[site2]-
-                               QPointF(BIKEWIDTH/2,BIKEWIDTH/2));
-
-        group->addAnimation(animation);
-    }
-    {
-        PersonItem *person=getPerson(personId);
-        person->show();
-        auto *animation=new QPropertyAnimation(person, "pos");
-        animation->setDuration(ms-10);
-        animation->setStartValue(m_sitePos[site1]-
-                                 QPointF(BIKEWIDTH/2,BIKEWIDTH*1.2));
-        animation->setEndValue(m_sitePos[site2]-
-                               QPointF(BIKEWIDTH/2,BIKEWIDTH*1.2));
-
-        group->addAnimation(animation);
+void BikeDisplay::startMove(QGraphicsItem *item,QPointF from,QPointF to,
+                            unsigned int ms,MoveEnd end)
+{
+    // Un élément déjà en route reprend son enregistrement, sinon on en prend
+    // un nouveau à la fin de la partie active du tableau
+    QVariant slot=item->data(MOVESLOTKEY);
+    int index=slot.isValid() ? slot.toInt() : -1;
+    if (index<0) {
+        index=m_nbMoves++;
+        if (index==m_moves.size())
+            m_moves.append(Move());
+        item->setData(MOVESLOTKEY,index);
     }
 
-    group->start();
+    Move &move=m_moves[index];
+    move.item=item;
+    move.from=from;
+    move.to=to;
+    move.t0=m_clock.elapsed();
+    move.duration=qMax(1,int(ms)-10);
+    move.end=end;
+    item->setPos(from);
+
+    if (!m_frameTimer->isActive())
+        m_frameTimer->start(MOVEFRAMEMS);
+}
 
-    QObject::connect(group, SIGNAL(finished()), this,
-                     SLOT(finishedAnimation()));
+void BikeDisplay::finishMove(const Move &move)
+{
+    move.item->setPos(move.to);
+    switch (move.end) {
+    case MoveFreeBike:
+        move.item->hide();
+        setFreeBike(static_cast<BikeItem*>(move.item));
+        break;
+    case MoveScatter: {
+        QPointF curPos=move.to+QPointF(BIKEWIDTH/2,BIKEWIDTH*1.2);
+        float angle=rand();
+        move.item->setPos(curPos.x()+40*cos(angle),curPos.y()+40*sin(angle));
+        break;
+    }
+    case MoveKeep:
+        break;
+    }
+}
 
-    mutex.unlock();
+void BikeDisplay::setSiteHistory(unsigned int site,
+                                 const std::vector<OccupancyHistory::Range> &series)
+{
+    m_sparklines->setSeries(site,series);
 }
 
-void BikeDisplay::finishedAnimation()
+void BikeDisplay::advanceFrame()
 {
-    auto *group=dynamic_cast<QParallelAnimationGroup*>(sender());
-    for(int i=0;i<group->animationCount();i++) {
-        auto *animation=dynamic_cast<QPropertyAnimation*>(group->animationAt(i));
-        auto *bike=dynamic_cast<BikeItem*>(animation->targetObject());
-        if (bike) {
-            bike->hide();
-            setFreeBike(bike);
+    // Les enregistrements actifs sont contigus : le coût ne dépend que du
+    // nombre d'éléments en route. Un enregistrement terminé est remplacé
+    // par le dernier actif et reste dans le tableau pour être réutilisé.
+    const qint64 now=m_clock.elapsed();
+    int i=0;
+    while (i<m_nbMoves) {
+        Move &move=m_moves[i];
+        double f=double(now-move.t0)/move.duration;
+        if (f<1.0) {
+            move.item->setPos(move.from+(move.to-move.from)*f);
+            i++;
+            continue;
         }
-        auto *person=dynamic_cast<PersonItem*>(animation->targetObject());
-        if (person) {
-            QPointF curPos = person->pos()+ QPointF(BIKEWIDTH/2,BIKEWIDTH*1.2);
-            float angle = rand();
-            person->setPos(curPos.x() + 40*cos(angle),curPos.y() + 40*sin(angle));
+        move.item->setData(MOVESLOTKEY,-1);
+        finishMove(move);
+        if (i!=m_nbMoves-1) {
+            std::swap(m_moves[i],m_moves[m_nbMoves-1]);
+            m_moves[i].item->setData(MOVESLOTKEY,i);
         }
+        m_nbMoves--;
+    }
+
+    bool moving=m_nbMoves>0;
+    if (m_moverLayer) {
+        moving=m_moverLayer->advance()||moving;
+        m_moverLayer->update();
     }
-    delete group;
+    if (!moving)
+        m_frameTimer->stop();
 }
 
 
@@ -0,0 +1,173 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "eventlog.h"
+#include "config.h"
+
+#include <chrono>
+
+#include <pcosynchro/pcothread.h>
+
+EventLog globalEventLog;
+
+static const unsigned int IDLE_SLEEP_US = 5000;
+
+static const std::chrono::steady_clock::time_point logStart = std::chrono::steady_clock::now();
+
+// One line of text per event code
+std::string formatLogRecord(const LogRecord& record) {
+    const std::string id = std::to_string(record.actorId);
+    const auto arg = [&](size_t i) { return std::to_string(record.args[i]); };
+
+    switch ((LogEvent)record.event) {
+    case LogEvent::PersonPreference:
+        return "Person " + id + ", préfère type " + arg(0);
+    case LogEvent::PersonTookBike:
+        return "Person " + id + ": took bike type " + arg(0) + " from site " + arg(1);
+    case LogEvent::PersonDeposited:
+        return "Person " + id + ": deposited bike at site " + arg(0);
+    case LogEvent::PersonBikeBroke:
+        return "Person " + id + ": bike broke down";
+    case LogEvent::PersonExiting:
+        return "Person " + id + ": simulation ending, exiting";
+    case LogEvent::VanLoaded:
+        return "Van " + id + ": loaded " + arg(1) + " bikes at depot " + arg(0);
+    case LogEvent::VanUnloaded:
+        return "Van " + id + ": unloaded " + arg(1) + " bikes at depot " + arg(0);
+    case LogEvent::VanStopped:
+        return "Van stops cleanly";
+    default:
+        return "Unknown event " + std::to_string(record.event);
+    }
+}
+
+// Site argument of the events that concern a site
+int logRecordSite(const LogRecord& record) {
+    if (record.actor == (uint8_t)LogActor::Station)
+        return (int)record.actorId;
+
+    switch ((LogEvent)record.event) {
+    case LogEvent::PersonTookBike:
+        return (int)record.args[1];
+    case LogEvent::PersonDeposited:
+    case LogEvent::VanLoaded:
+    case LogEvent::VanUnloaded:
+        return (int)record.args[0];
+    default:
+        return -1;
+    }
+}
+
+FileLogSink::FileLogSink(const std::string& path) : file(std::fopen(path.c_str(), "w")) {}
+
+FileLogSink::~FileLogSink() {
+    if (file) std::fclose(file);
+}
+
+void FileLogSink::consume(const std::vector<LogRecord>& records) {
+    if (!file) return;
+    for (const LogRecord& record : records) {
+        std::fprintf(file, "[%10.3f] %s\n", record.timestampNs / 1e9,
+                     formatLogRecord(record).c_str());
+    }
+    std::fflush(file);
+}
+
+EventLog::EventLog() : minLevel((uint8_t)LOG_LEVEL) {}
+
+void EventLog::setLevel(LogLevel level) {
+    minLevel.store((uint8_t)level, std::memory_order_relaxed);
+}
+
+void EventLog::addSink(std::unique_ptr<LogSink> sink) {
+    sinks.push_back(std::move(sink));
+}
+
+// Ring of the calling thread, registered on first use
+EventLog::Ring* EventLog::threadRing() {
+    thread_local EventLog* owner = nullptr;
+    thread_local Ring* ring = nullptr;
+
+    if (owner != this) {
+        auto fresh = std::make_unique<Ring>();
+        mutex.lock();
+        ring = fresh.get();
+        rings.push_back(std::move(fresh));
+        mutex.unlock();
+        owner = this;
+    }
+    return ring;
+}
+
+// Producer side: never blocks, drops the record if the ring is full
+void EventLog::push(LogLevel level, LogActor actor, uint32_t actorId, LogEvent event,
+                    const std::array<uint32_t, 4>& args) {
+    Ring* ring = threadRing();
+
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    size_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail == Ring::SIZE) {
+        droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogRecord& record = ring->records[head % Ring::SIZE];
+    record.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - logStart).count();
+    record.actorId = actorId;
+    record.event = (uint16_t)event;
+    record.actor = (uint8_t)actor;
+    record.level = (uint8_t)level;
+    record.args = args;
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+// Consumer side: move every pending record into the batch
+size_t EventLog::drain(std::vector<LogRecord>& batch) {
+    batch.clear();
+
+    mutex.lock();
+    std::vector<Ring*> snapshot;
+    snapshot.reserve(rings.size());
+    for (auto& ring : rings) snapshot.push_back(ring.get());
+    mutex.unlock();
+
+    for (Ring* ring : snapshot) {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            batch.push_back(ring->records[tail % Ring::SIZE]);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    return batch.size();
+}
+
+// Logger thread
+void EventLog::run() {
+    std::vector<LogRecord> batch;
+
+    while (true) {
+        bool stopping = stopRequested.load();
+        if (drain(batch) > 0) {
+            for (auto& sink : sinks) sink->consume(batch);
+        } else if (stopping) {
+            return; // everything logged before the stop request was delivered
+        } else {
+            PcoThread::usleep(IDLE_SLEEP_US);
+        }
+    }
+}
+
+void EventLog::requestStop() {
+    stopRequested = true;
+}
+
+uint64_t EventLog::dropped() const {
+    return droppedRecords.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,429 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "eventtrace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pcosynchro/pcothread.h>
+
+EventTrace globalTrace;
+
+static const unsigned int FLUSH_PERIOD_US = 50000;
+static const uint64_t WINDOW_BYTES = 4 << 20;  // mapped at a time, multiple of the page size
+
+EventTrace::EventTrace() {}
+
+EventTrace::~EventTrace() {
+    if (fd >= 0) { // the writer never ran
+        active = false;
+        flush();
+        flushGaps();
+        closeFile();
+    }
+}
+
+bool EventTrace::open(const std::string& _path, uint32_t _nbSites) {
+    fd = ::open(_path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::perror(_path.c_str());
+        return false;
+    }
+
+    TraceFileHeader header{TRACE_MAGIC, TRACE_VERSION, _nbSites, Bike::nbBikeTypes};
+    if (!append(&header, sizeof(header))) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    start = std::chrono::steady_clock::now();
+    active = true;
+    return true;
+}
+
+// Ring of the calling thread, registered on first use
+EventTrace::Ring* EventTrace::threadRing() {
+    thread_local EventTrace* owner = nullptr;
+    thread_local Ring* ring = nullptr;
+
+    if (owner != this) {
+        auto fresh = std::make_unique<Ring>();
+        mutex.lock();
+        ring = fresh.get();
+        ring->stream = rings.size();
+        rings.push_back(std::move(fresh));
+        mutex.unlock();
+        owner = this;
+    }
+    return ring;
+}
+
+// Producer side: encodes the record, dropped if the ring is full
+void EventTrace::record(TraceKind _kind, const uint64_t* _fields, size_t _nbFields) {
+    if (!enabled()) return;
+    Ring* ring = threadRing();
+
+    uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start).count();
+    uint8_t encoded[MAX_RECORD];
+    uint8_t* end = encoded;
+    uint64_t drops = ring->pendingDrops.load(std::memory_order_relaxed);
+    if (drops > 0) { // at the time of the last record kept (delta 0)
+        end = traceVarint(end, (uint64_t)TraceKind::Gap);
+        end = traceVarint(end, drops);
+    }
+    end = traceVarint(end, (now - ring->lastNs) << 4 | (uint64_t)_kind);
+    for (size_t i = 0; i < _nbFields; ++i) {
+        end = traceVarint(end, _fields[i]);
+    }
+    size_t length = end - encoded;
+
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    if (Ring::SIZE - (head - ring->tail.load(std::memory_order_acquire)) < length) {
+        ring->pendingDrops.store(drops + 1, std::memory_order_relaxed); // the next delta spans it
+        droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    for (size_t i = 0; i < length; ++i) {
+        ring->bytes[(head + i) & (Ring::SIZE - 1)] = encoded[i];
+    }
+    ring->lastNs = now;
+    if (drops > 0) ring->pendingDrops.store(0, std::memory_order_relaxed);
+    ring->head.store(head + length, std::memory_order_release);
+}
+
+void EventTrace::actor(uint8_t _actor, uint32_t _id) {
+    const uint64_t fields[] = {_actor, _id};
+    record(TraceKind::Actor, fields, 2);
+}
+
+void EventTrace::stationInit(uint32_t _site, uint32_t _capacity,
+                             const std::array<uint32_t, Bike::nbBikeTypes>& _bikes, uint32_t _broken) {
+    uint64_t fields[3 + Bike::nbBikeTypes] = {_site, _capacity};
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) fields[2 + t] = _bikes[t];
+    fields[2 + Bike::nbBikeTypes] = _broken;
+    record(TraceKind::StationInit, fields, 3 + Bike::nbBikeTypes);
+}
+
+void EventTrace::take(uint32_t _site, uint32_t _type) {
+    const uint64_t fields[] = {_site, _type};
+    record(TraceKind::Take, fields, 2);
+}
+
+void EventTrace::put(uint32_t _site, uint32_t _type, bool _broken) {
+    const uint64_t fields[] = {_site, _type, _broken};
+    record(TraceKind::Put, fields, 3);
+}
+
+void EventTrace::add(uint32_t _site, const std::array<uint32_t, Bike::nbBikeTypes>& _bikes, uint32_t _broken) {
+    uint64_t fields[2 + Bike::nbBikeTypes] = {_site};
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) fields[1 + t] = _bikes[t];
+    fields[1 + Bike::nbBikeTypes] = _broken;
+    record(TraceKind::Add, fields, 2 + Bike::nbBikeTypes);
+}
+
+void EventTrace::remove(uint32_t _site, const std::array<uint32_t, Bike::nbBikeTypes>& _bikes) {
+    uint64_t fields[1 + Bike::nbBikeTypes] = {_site};
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) fields[1 + t] = _bikes[t];
+    record(TraceKind::Remove, fields, 1 + Bike::nbBikeTypes);
+}
+
+void EventTrace::removeBroken(uint32_t _site, uint32_t _count) {
+    const uint64_t fields[] = {_site, _count};
+    record(TraceKind::RemoveBroken, fields, 2);
+}
+
+void EventTrace::move(TraceKind _kind, uint32_t _from, uint32_t _to, uint32_t _durationMs) {
+    const uint64_t fields[] = {_from, _to, _durationMs};
+    record(_kind, fields, 3);
+}
+
+// Writer side: one chunk per ring with pending bytes
+size_t EventTrace::flush() {
+    mutex.lock();
+    std::vector<Ring*> snapshot;
+    snapshot.reserve(rings.size());
+    for (auto& ring : rings) snapshot.push_back(ring.get());
+    mutex.unlock();
+
+    size_t moved = 0;
+    for (Ring* ring : snapshot) {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        if (head == tail) continue;
+
+        TraceChunkHeader chunk{ring->stream, (uint32_t)(head - tail)};
+        size_t first = std::min(head - tail, Ring::SIZE - (tail & (Ring::SIZE - 1)));
+        bool written = append(&chunk, sizeof(chunk))
+                       && append(&ring->bytes[tail & (Ring::SIZE - 1)], first)
+                       && append(&ring->bytes[0], head - tail - first);
+        ring->tail.store(head, std::memory_order_release);
+        if (!written) {
+            active = false; // disk full or similar: stop tracing
+            return moved;
+        }
+        moved += head - tail;
+    }
+    return moved;
+}
+
+// Gap records of the threads that dropped their last records
+void EventTrace::flushGaps() {
+    mutex.lock();
+    std::vector<Ring*> snapshot;
+    snapshot.reserve(rings.size());
+    for (auto& ring : rings) snapshot.push_back(ring.get());
+    mutex.unlock();
+
+    for (Ring* ring : snapshot) {
+        uint64_t drops = ring->pendingDrops.exchange(0, std::memory_order_relaxed);
+        if (drops == 0) continue;
+
+        uint8_t encoded[MAX_RECORD];
+        uint8_t* end = traceVarint(encoded, (uint64_t)TraceKind::Gap);
+        end = traceVarint(end, drops);
+        TraceChunkHeader chunk{ring->stream, (uint32_t)(end - encoded)};
+        if (!append(&chunk, sizeof(chunk)) || !append(encoded, end - encoded)) return;
+    }
+}
+
+// Copy at the end of the file, through a mapped window
+bool EventTrace::append(const void* _data, size_t _size) {
+    const uint8_t* data = static_cast<const uint8_t*>(_data);
+    while (_size > 0) {
+        if (!window || fileSize == windowOffset + WINDOW_BYTES) {
+            if (window) munmap(window, WINDOW_BYTES);
+            window = nullptr;
+            windowOffset = fileSize - fileSize % WINDOW_BYTES;
+            if (ftruncate(fd, windowOffset + WINDOW_BYTES) != 0) {
+                std::perror("ftruncate");
+                return false;
+            }
+            void* memory = mmap(nullptr, WINDOW_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, windowOffset);
+            if (memory == MAP_FAILED) {
+                std::perror("mmap");
+                return false;
+            }
+            window = static_cast<uint8_t*>(memory);
+        }
+        size_t part = std::min<uint64_t>(_size, windowOffset + WINDOW_BYTES - fileSize);
+        std::memcpy(window + (fileSize - windowOffset), data, part);
+        fileSize += part;
+        data += part;
+        _size -= part;
+    }
+    return true;
+}
+
+// Cut the file at the bytes written
+void EventTrace::closeFile() {
+    if (window) munmap(window, WINDOW_BYTES);
+    window = nullptr;
+    if (ftruncate(fd, fileSize) != 0) std::perror("ftruncate");
+    ::close(fd);
+    fd = -1;
+}
+
+// Writer thread
+void EventTrace::run() {
+    while (!stopRequested.load()) {
+        if (flush() == 0) {
+            PcoThread::usleep(FLUSH_PERIOD_US);
+        }
+    }
+    active = false;
+    flush(); // everything recorded before the stop request
+    flushGaps();
+    closeFile();
+}
+
+void EventTrace::requestStop() {
+    stopRequested = true;
+}
+
+uint64_t EventTrace::dropped() const {
+    return droppedRecords.load(std::memory_order_relaxed);
+}
+
+// Reads one varint, false past the end
+static bool readVarint(const uint8_t*& _data, const uint8_t* _end, uint64_t& _value) {
+    _value = 0;
+    for (unsigned int shift = 0; _data < _end && shift < 64; shift += 7) {
+        uint8_t byte = *_data++;
+        _value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Number of fields of each kind
+static size_t fieldCount(TraceKind _kind) {
+    switch (_kind) {
+    case TraceKind::Actor:        return 2;
+    case TraceKind::StationInit:  return 3 + Bike::nbBikeTypes;
+    case TraceKind::Take:         return 2;
+    case TraceKind::Put:          return 3;
+    case TraceKind::Add:          return 2 + Bike::nbBikeTypes;
+    case TraceKind::Remove:       return 1 + Bike::nbBikeTypes;
+    case TraceKind::RemoveBroken: return 2;
+    case TraceKind::Gap:          return 1;
+    default:                      return 3; // moves
+    }
+}
+
+bool TraceReader::open(const std::string& _path, std::string& _error) {
+    int fd = ::open(_path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        _error = _path + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    void* memory = size >= sizeof(TraceFileHeader)
+                 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        _error = _path + ": not a trace";
+        return false;
+    }
+    madvise(memory, size, MADV_SEQUENTIAL);
+
+    const uint8_t* data = static_cast<const uint8_t*>(memory);
+    const uint8_t* end = data + size;
+    TraceFileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    bool valid = header.magic == TRACE_MAGIC && header.version == TRACE_VERSION
+                 && header.nbTypes == Bike::nbBikeTypes;
+    if (!valid) {
+        _error = _path + ": not a trace of this version";
+    }
+    sites = header.nbSites;
+    data += sizeof(header);
+
+    struct Stream { uint64_t timeNs = 0; uint8_t actor = 0; uint32_t actorId = 0; };
+    std::vector<Stream> streams;
+
+    while (valid && data < end) {
+        TraceChunkHeader chunk;
+        if ((size_t)(end - data) < sizeof(chunk)) break; // writer stopped mid-chunk
+        std::memcpy(&chunk, data, sizeof(chunk));
+        data += sizeof(chunk);
+        if (chunk.bytes > (size_t)(end - data)) break;
+        if (chunk.stream >= streams.size()) streams.resize(chunk.stream + 1);
+        Stream& stream = streams[chunk.stream];
+
+        const uint8_t* chunkEnd = data + chunk.bytes;
+        while (valid && data < chunkEnd) {
+            uint64_t tag;
+            uint64_t fields[3 + Bike::nbBikeTypes];
+            valid = readVarint(data, chunkEnd, tag) && (tag & 0xf) < (uint64_t)TraceKind::NbKinds;
+            TraceKind kind = (TraceKind)(tag & 0xf);
+            size_t count = valid ? fieldCount(kind) : 0;
+            for (size_t i = 0; valid && i < count; ++i) {
+                valid = readVarint(data, chunkEnd, fields[i]);
+            }
+            if (!valid) {
+                _error = _path + ": corrupted stream " + std::to_string(chunk.stream);
+                break;
+            }
+
+            stream.timeNs += tag >> 4;
+            if (kind == TraceKind::Actor) {
+                stream.actor = fields[0];
+                stream.actorId = fields[1];
+                continue;
+            }
+
+            TraceRecord record{};
+            record.timeNs = stream.timeNs;
+            record.stream = chunk.stream;
+            record.kind = kind;
+            record.actor = stream.actor;
+            record.actorId = stream.actorId;
+            record.site = kind == TraceKind::Gap ? 0 : fields[0];
+            switch (kind) {
+            case TraceKind::StationInit:
+                record.value = fields[1];
+                for (size_t t = 0; t < Bike::nbBikeTypes; ++t) record.bikes[t] = fields[2 + t];
+                record.broken = fields[2 + Bike::nbBikeTypes];
+                break;
+            case TraceKind::Take:
+                record.value = fields[1];
+                break;
+            case TraceKind::Put:
+                record.value = fields[1];
+                record.broken = fields[2];
+                break;
+            case TraceKind::Add:
+                for (size_t t = 0; t < Bike::nbBikeTypes; ++t) record.bikes[t] = fields[1 + t];
+                record.broken = fields[1 + Bike::nbBikeTypes];
+                break;
+            case TraceKind::Remove:
+                for (size_t t = 0; t < Bike::nbBikeTypes; ++t) record.bikes[t] = fields[1 + t];
+                break;
+            case TraceKind::RemoveBroken:
+                record.value = fields[1];
+                break;
+            case TraceKind::Gap:
+                record.value = fields[0];
+                droppedRecords += fields[0];
+                firstGapNs = std::min(firstGapNs, record.timeNs);
+                break;
+            default: // moves
+                record.to = fields[1];
+                record.value = fields[2];
+                break;
+            }
+            bool move = record.kind >= TraceKind::Ride && record.kind <= TraceKind::Drive;
+            if (record.site >= sites || (record.to >= sites && move)) {
+                valid = false;
+                _error = _path + ": site out of range in stream " + std::to_string(chunk.stream);
+                break;
+            }
+            decoded.push_back(record);
+        }
+        data = chunkEnd;
+    }
+    munmap(memory, size);
+
+    if (!valid) {
+        decoded.clear();
+        droppedRecords = 0;
+        firstGapNs = UINT64_MAX;
+        return false;
+    }
+    // Merge the streams; equal times keep the order of each stream
+    std::stable_sort(decoded.begin(), decoded.end(), [](const TraceRecord& a, const TraceRecord& b) {
+        return a.timeNs < b.timeNs;
+    });
+    return true;
+}
+
+uint32_t TraceReader::nbSites() const {
+    return sites;
+}
+
+const std::vector<TraceRecord>& TraceReader::records() const {
+    return decoded;
+}
+
+uint64_t TraceReader::dropped() const {
+    return droppedRecords;
+}
+
+uint64_t TraceReader::exactUntilNs() const {
+    return firstGapNs;
+}
@@ -0,0 +1,121 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "fleetadmin.h"
+#include "simgate.h"
+
+#include <pcosynchro/pcothread.h>
+
+FleetAdmin::FleetAdmin(const std::array<BikeStation*, NB_SITES_TOTAL>& _stations)
+    : stations(_stations) {}
+
+void FleetAdmin::setCallback(Callback _callback) {
+    callback = std::move(_callback);
+}
+
+// Queue an order (caller thread, never waits on a station)
+uint64_t FleetAdmin::submit(unsigned int _site, const std::array<int, Bike::nbBikeTypes>& _delta) {
+    mutex.lock();
+    FleetOrder order;
+    order.id = nextId++;
+    order.site = _site;
+    order.delta = _delta;
+    orders.push_back(order);
+    condWorker.notifyOne();
+    mutex.unlock();
+    return order.id;
+}
+
+// Worker loop: take the new orders, give every pending order one attempt
+void FleetAdmin::run() {
+    std::vector<Pending> pending;
+
+    while (true) {
+        globalGate.beginIdle(); // a checkpoint does not wait for an idle worker
+        mutex.lock();
+        // Mesa-style waiting, only when there is nothing left to retry
+        while (!shouldEnd && orders.empty() && pending.empty()) {
+            condWorker.wait(&mutex);
+        }
+        if (shouldEnd) {
+            mutex.unlock();
+            globalGate.endIdle();
+            break;
+        }
+        auto deadline = std::chrono::steady_clock::now()
+                      + std::chrono::milliseconds(FLEET_ADMIN_TIMEOUT_MS);
+        while (!orders.empty()) {
+            Pending p;
+            p.result.order = orders.front();
+            p.deadline = deadline;
+            pending.push_back(p);
+            orders.pop_front();
+        }
+        mutex.unlock();
+        globalGate.endIdle(); // parks while a checkpoint copies the stations
+
+        // Attempts outside our lock, with the non-blocking station API
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pending.size();) {
+            bool done = apply(pending[i]);
+            if (done || now >= pending[i].deadline) {
+                pending[i].result.complete = done;
+                if (callback) callback(pending[i].result);
+                pending[i] = pending.back();
+                pending.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        if (!pending.empty()) { // full or empty stations: try again later
+            PcoThread::usleep(FLEET_ADMIN_RETRY_MS * 1000);
+        }
+    }
+    globalGate.leave();
+}
+
+bool FleetAdmin::apply(Pending& _pending) {
+    const FleetOrder& order = _pending.result.order;
+    auto& done = _pending.result.done;
+    BikeStation* station = stations[order.site];
+
+    // Removals: whatever is there, never waits
+    std::array<size_t, Bike::nbBikeTypes> quotas{};
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        if (order.delta[t] < 0) quotas[t] = -order.delta[t] + done[t]; // done[t] <= 0
+    }
+    for (Bike* bike : station->getBikes(quotas)) {
+        done[bike->bikeType]--;
+        delete bike; // no longer in any station
+    }
+
+    // Additions: as many as there are free slots
+    std::vector<Bike*> bikes;
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        for (int k = done[t]; order.delta[t] > 0 && k < order.delta[t]; ++k) {
+            auto* bike = new Bike;
+            bike->bikeType = t;
+            bikes.push_back(bike);
+        }
+    }
+    for (Bike* bike : bikes) done[bike->bikeType]++;
+    for (Bike* bike : station->tryAddBikes(bikes)) {
+        done[bike->bikeType]--;
+        delete bike;
+    }
+
+    return done == order.delta;
+}
+
+// Wake up the worker so it can exit
+void FleetAdmin::ending() {
+    mutex.lock();
+    shouldEnd = true;
+    condWorker.notifyAll();
+    mutex.unlock();
+}
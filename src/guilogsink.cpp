@@ -0,0 +1,16 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "guilogsink.h"
+
+GuiLogSink::GuiLogSink(BikingInterface* _binkingInterface)
+    : binkingInterface(_binkingInterface) {}
+
+// The log view formats the records itself, only the visible ones
+void GuiLogSink::consume(const std::vector<LogRecord>& records) {
+    binkingInterface->appendLogRecords(records);
+}
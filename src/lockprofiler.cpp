@@ -0,0 +1,232 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "lockprofiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+
+LockProfiler globalLockProfiler;
+
+const char* lockSiteName(LockSite _site) {
+    static const char* names[NB_LOCK_SITES] = {"putBike", "getBike", "addBikes", "getBikes",
+                                               "countBikesOfType", "nbBikes", "ending", "other"};
+    return _site < LockSite::NbSites ? names[(size_t)_site] : "?";
+}
+
+LockProfiler::~LockProfiler() {}
+
+unsigned int LockProfiler::newLock() {
+    unsigned int id = nextLock.fetch_add(1, std::memory_order_relaxed);
+    return std::min<unsigned int>(id, MAX_LOCKS - 1);
+}
+
+void LockProfiler::setStation(unsigned int _lock, size_t _station) {
+    stations[_lock].store((long)_station + 1, std::memory_order_relaxed);
+}
+
+// Registers the counters of the calling thread on its first lock
+LockProfiler::ThreadCounters* LockProfiler::threadCounters() {
+    thread_local LockProfiler* owner = nullptr;
+    thread_local ThreadCounters* counters = nullptr;
+
+    if (owner != this) {
+        auto fresh = std::make_unique<ThreadCounters>();
+        fresh->tables.push_back(std::make_unique<Table>(INITIAL_SLOTS));
+        fresh->table.store(fresh->tables.back().get(), std::memory_order_relaxed);
+        mutex.lock();
+        counters = fresh.get();
+        threads.push_back(std::move(fresh));
+        mutex.unlock();
+        owner = this;
+    }
+    return counters;
+}
+
+// Slot holding a key, or the free slot where it would be inserted
+LockProfiler::Slot& LockProfiler::findSlot(const Table& _table, uint32_t _key) {
+    size_t mask = _table.size - 1;
+    size_t i = (_key * 0x9e3779b1u) & mask; // Fibonacci hashing of the key
+    for (;;) {
+        uint32_t key = _table.slots[i].key.load(std::memory_order_relaxed);
+        if (key == _key || key == 0) return _table.slots[i];
+        i = (i + 1) & mask;
+    }
+}
+
+// Copies the counters of a thread into a table twice as large
+LockProfiler::Table* LockProfiler::grow(ThreadCounters& _thread) {
+    const Table& old = *_thread.table.load(std::memory_order_relaxed);
+    auto table = std::make_unique<Table>(old.size * 2);
+    for (size_t i = 0; i < old.size; ++i) {
+        const Slot& from = old.slots[i];
+        uint32_t key = from.key.load(std::memory_order_relaxed);
+        if (key == 0) continue;
+        Slot& to = findSlot(*table, key);
+        to.counters.acquisitions.store(from.counters.acquisitions.load(std::memory_order_relaxed),
+                                       std::memory_order_relaxed);
+        to.counters.contended.store(from.counters.contended.load(std::memory_order_relaxed),
+                                    std::memory_order_relaxed);
+        to.counters.waitNs.store(from.counters.waitNs.load(std::memory_order_relaxed),
+                                 std::memory_order_relaxed);
+        to.counters.holdNs.store(from.counters.holdNs.load(std::memory_order_relaxed),
+                                 std::memory_order_relaxed);
+        to.key.store(key, std::memory_order_relaxed);
+    }
+    _thread.table.store(table.get(), std::memory_order_release); // published to collect()
+    _thread.tables.push_back(std::move(table));
+    return _thread.table.load(std::memory_order_relaxed);
+}
+
+LockProfiler::Counters& LockProfiler::counters(unsigned int _lock, LockSite _site) {
+    ThreadCounters* thread = threadCounters();
+    uint32_t key = _lock * NB_LOCK_SITES + (uint32_t)_site + 1;
+    Table* table = thread->table.load(std::memory_order_relaxed);
+    Slot* slot = &findSlot(*table, key);
+    if (slot->key.load(std::memory_order_relaxed) == key) return slot->counters;
+
+    // first use of this lock site by the thread
+    if ((thread->used + 1) * 2 > table->size) {
+        table = grow(*thread);
+        slot = &findSlot(*table, key);
+    }
+    slot->key.store(key, std::memory_order_release); // published to collect()
+    thread->used++;
+    return slot->counters;
+}
+
+// Only the owner thread writes: plain load and store, no read-modify-write
+static void add(std::atomic<uint64_t>& _counter, uint64_t _value) {
+    _counter.store(_counter.load(std::memory_order_relaxed) + _value, std::memory_order_relaxed);
+}
+
+void LockProfiler::acquired(unsigned int _lock, LockSite _site, bool _contended, uint64_t _waitNs) {
+    Counters& c = counters(_lock, _site);
+    add(c.acquisitions, 1);
+    if (_contended) {
+        add(c.contended, 1);
+        add(c.waitNs, _waitNs);
+    }
+}
+
+void LockProfiler::held(unsigned int _lock, LockSite _site, uint64_t _holdNs) {
+    add(counters(_lock, _site).holdNs, _holdNs);
+}
+
+std::vector<LockProfileEntry> LockProfiler::collect() const {
+    mutex.lock();
+    std::vector<ThreadCounters*> snapshot;
+    snapshot.reserve(threads.size());
+    for (auto& thread : threads) snapshot.push_back(thread.get());
+    mutex.unlock();
+
+    // Merged per lock and site, in lock order
+    std::map<std::pair<unsigned int, size_t>, LockProfileEntry> merged;
+    for (ThreadCounters* thread : snapshot) {
+        const Table* table = thread->table.load(std::memory_order_acquire);
+        for (size_t i = 0; i < table->size; ++i) {
+            const Slot& slot = table->slots[i];
+            uint32_t key = slot.key.load(std::memory_order_acquire);
+            if (key == 0) continue;
+            uint64_t acquisitions = slot.counters.acquisitions.load(std::memory_order_relaxed);
+            uint64_t holdNs = slot.counters.holdNs.load(std::memory_order_relaxed);
+            if (acquisitions == 0 && holdNs == 0) continue;
+
+            unsigned int lock = (key - 1) / NB_LOCK_SITES;
+            size_t site = (key - 1) % NB_LOCK_SITES;
+            auto index = std::make_pair(lock, site);
+            auto it = merged.find(index);
+            if (it == merged.end()) {
+                long station = stations[lock].load(std::memory_order_relaxed) - 1;
+                it = merged.emplace(index, LockProfileEntry{station, (LockSite)site, 0, 0, 0, 0}).first;
+            }
+            it->second.acquisitions += acquisitions;
+            it->second.contended += slot.counters.contended.load(std::memory_order_relaxed);
+            it->second.waitNs += slot.counters.waitNs.load(std::memory_order_relaxed);
+            it->second.holdNs += holdNs;
+        }
+    }
+
+    std::vector<LockProfileEntry> result;
+    result.reserve(merged.size());
+    for (auto& entry : merged) result.push_back(entry.second);
+    std::stable_sort(result.begin(), result.end(), [](const LockProfileEntry& a, const LockProfileEntry& b) {
+        return a.waitNs != b.waitNs ? a.waitNs > b.waitNs : a.holdNs > b.holdNs;
+    });
+    return result;
+}
+
+// One line of a ranking
+static void writeRow(std::ostream& _out, const std::string& _name, const LockProfileEntry& _entry) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-28s %12llu %7.2f%% %12.3f %12.3f\n", _name.c_str(),
+                  (unsigned long long)_entry.acquisitions,
+                  _entry.acquisitions ? 100.0 * _entry.contended / _entry.acquisitions : 0.0,
+                  _entry.waitNs / 1e6, _entry.holdNs / 1e6);
+    _out << line;
+}
+
+static void writeHeader(std::ostream& _out, const char* _title) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%s\n  %-28s %12s %8s %12s %12s\n", _title, "",
+                  "acquisitions", "contended", "wait ms", "hold ms");
+    _out << line;
+}
+
+static std::string stationName(long _station) {
+    return _station < 0 ? std::string("station ?") : "station " + std::to_string(_station);
+}
+
+void LockProfiler::report(std::ostream& _out, size_t _top) const {
+    if (!LOCK_PROFILING_ENABLED) {
+        _out << "Lock profiling not compiled in (WITH_LOCK_PROFILING)" << std::endl;
+        return;
+    }
+    std::vector<LockProfileEntry> entries = collect();
+
+    auto accumulate = [](LockProfileEntry& _total, const LockProfileEntry& _entry) {
+        _total.acquisitions += _entry.acquisitions;
+        _total.contended += _entry.contended;
+        _total.waitNs += _entry.waitNs;
+        _total.holdNs += _entry.holdNs;
+    };
+    auto byWait = [](const std::pair<std::string, LockProfileEntry>& a,
+                     const std::pair<std::string, LockProfileEntry>& b) {
+        return a.second.waitNs > b.second.waitNs;
+    };
+
+    std::vector<std::pair<std::string, LockProfileEntry>> sites(NB_LOCK_SITES);
+    std::map<long, LockProfileEntry> perStation;
+    for (size_t s = 0; s < NB_LOCK_SITES; ++s) {
+        sites[s] = {lockSiteName((LockSite)s), LockProfileEntry{-1, (LockSite)s, 0, 0, 0, 0}};
+    }
+    for (const LockProfileEntry& entry : entries) {
+        accumulate(sites[(size_t)entry.site].second, entry);
+        auto it = perStation.emplace(entry.station, LockProfileEntry{entry.station, LockSite::Other,
+                                                                     0, 0, 0, 0}).first;
+        accumulate(it->second, entry);
+    }
+    std::stable_sort(sites.begin(), sites.end(), byWait);
+    std::vector<std::pair<std::string, LockProfileEntry>> stationRows;
+    for (auto& station : perStation) stationRows.push_back({stationName(station.first), station.second});
+    std::stable_sort(stationRows.begin(), stationRows.end(), byWait);
+
+    writeHeader(_out, "Lock sites (all stations)");
+    for (auto& row : sites) {
+        if (row.second.acquisitions > 0) writeRow(_out, row.first, row.second);
+    }
+    writeHeader(_out, "Stations (all lock sites)");
+    for (size_t i = 0; i < stationRows.size() && i < _top; ++i) {
+        writeRow(_out, stationRows[i].first, stationRows[i].second);
+    }
+    writeHeader(_out, "Hottest lock sites of a station");
+    for (size_t i = 0; i < entries.size() && i < _top; ++i) {
+        writeRow(_out, stationName(entries[i].station) + " " + lockSiteName(entries[i].site), entries[i]);
+    }
+}
@@ -0,0 +1,127 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "logmodel.h"
+
+LogModel::LogModel(int _capacity, QObject* _parent)
+    : QAbstractListModel(_parent), capacity(_capacity), ring(_capacity)
+{
+    pending.reserve(_capacity);
+    incoming.reserve(_capacity);
+}
+
+int LogModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : count;
+}
+
+const LogModel::Entry& LogModel::entryAt(int _row) const {
+    return ring[(first + _row) % capacity];
+}
+
+// Called by the view for visible rows only
+QVariant LogModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= count)
+        return QVariant();
+
+    const Entry& entry = entryAt(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        if (!entry.text.isEmpty())
+            return entry.text;
+        return QString("[%1] %2")
+            .arg(entry.record.timestampNs / 1e9, 0, 'f', 3)
+            .arg(QString::fromStdString(formatLogRecord(entry.record)));
+    case ActorRole:
+        return entry.record.actor;
+    case ActorIdRole:
+        return entry.record.actorId;
+    case SiteRole:
+        return entry.text.isEmpty() ? logRecordSite(entry.record) : -1;
+    default:
+        return QVariant();
+    }
+}
+
+// Called by the logger thread
+void LogModel::post(const std::vector<LogRecord>& _records) {
+    QMutexLocker locker(&pendingMutex);
+    for (const LogRecord& record : _records)
+        pending.push_back({record, QString()});
+
+    // Only the last capacity entries could ever be shown
+    if (pending.size() > (size_t)capacity)
+        pending.erase(pending.begin(), pending.end() - capacity);
+}
+
+void LogModel::postText(LogActor _actor, unsigned int _actorId, const QString& _text) {
+    LogRecord record{};
+    record.actor = (uint8_t)_actor;
+    record.actorId = _actorId;
+
+    QMutexLocker locker(&pendingMutex);
+    pending.push_back({record, _text});
+    if (pending.size() > (size_t)capacity)
+        pending.erase(pending.begin());
+}
+
+// Called by the GUI thread once per frame
+void LogModel::flush() {
+    {
+        QMutexLocker locker(&pendingMutex);
+        incoming.swap(pending);
+    }
+    const int n = (int)incoming.size();
+    if (n == 0)
+        return;
+
+    // Drop the oldest rows to make room
+    const int overflow = count + n - capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        first = (first + overflow) % capacity;
+        count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), count, count + n - 1);
+    for (Entry& entry : incoming) {
+        ring[(first + count) % capacity] = std::move(entry);
+        ++count;
+    }
+    endInsertRows();
+    incoming.clear();
+}
+
+LogFilterModel::LogFilterModel(QObject* _parent) : QSortFilterProxyModel(_parent) {}
+
+void LogFilterModel::setFilter(Mode _mode, int _id) {
+    mode = _mode;
+    id = _id;
+    invalidateFilter();
+}
+
+bool LogFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const {
+    if (mode == All)
+        return true;
+
+    const QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+    const int actor = index.data(LogModel::ActorRole).toInt();
+
+    switch (mode) {
+    case Person:
+        return actor == (int)LogActor::Person &&
+               (id < 0 || index.data(LogModel::ActorIdRole).toInt() == id);
+    case Van:
+        return actor == (int)LogActor::Van;
+    case Station: {
+        const int site = index.data(LogModel::SiteRole).toInt();
+        return site >= 0 && (id < 0 || site == id);
+    }
+    default:
+        return true;
+    }
+}
@@ -11,25 +11,149 @@
 #include <QApplication>
 #include "bikinginterface.h"
 #include <cstdlib>
+#include <algorithm>
 #include <vector>
 
 #include "person.h"
 #include "van.h"
 #include "bikestation.h"
 #include "config.h"
+#include "rebalanceoptimizer.h"
+#include "metrics.h"
+#include "repairshop.h"
+#include "eventlog.h"
+#include "guilogsink.h"
+#include "stateexporter.h"
+#include "vanfleet.h"
+#include "controlserver.h"
+#include "fleetadmin.h"
+#include "checkpoint.h"
+#include "simgate.h"
+#include "eventtrace.h"
+#include "tracereplayer.h"
+#include "tripfeed.h"
+#include "columnarexporter.h"
+#include "citymodel.h"
+#include "lockprofiler.h"
+#include "triplatency.h"
+#include "simulation.h"
+
+#include <iostream>
+#include <cstring>
+#include <map>
 
 #include <pcosynchro/pcothread.h>
 
-std::array<BikeStation*, NB_SITES_TOTAL>* globalStations = nullptr;
-std::vector<std::unique_ptr<PcoThread>>* globalThreads = nullptr;
+// Parses a --log-level value, returns false if unknown
+bool parseLogLevel(const char* _name, LogLevel& _level) {
+    static const std::pair<const char*, LogLevel> levels[] = {
+        {"debug", LogLevel::Debug}, {"info", LogLevel::Info},
+        {"warning", LogLevel::Warning}, {"off", LogLevel::Off}};
+    for (const auto& l : levels) {
+        if (std::strcmp(_name, l.first) == 0) {
+            _level = l.second;
+            return true;
+        }
+    }
+    return false;
+}
+// Mean share of the time the sites spent empty (per type) and full
+void reportAvailability(const std::array<BikeStation*, NB_SITES_TOTAL>& _stations, std::ostream& _out) {
+    uint64_t now = BikeStation::availabilityClockNs(); // same instant for every site
+    std::array<double, Bike::nbBikeTypes> empty{};
+    double full = 0.0;
+    for (size_t s = 0; s < NBSITES; ++s) {
+        StationAvailability availability = _stations[s]->availability(now);
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            empty[t] += availability.emptyFraction(t) / NBSITES;
+        }
+        full += availability.fullFraction() / NBSITES;
+    }
+
+    _out << "=== Site availability ===" << '\n';
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        _out << "empty, type " << t << "       : " << empty[t] << '\n';
+    }
+    _out << "full                : " << full << '\n';
+}
+
+// Shows a recorded trace in the GUI instead of running the simulation
+int replayTrace(int argc, char* argv[], const char* _path, double _speed) {
+    TraceReader trace;
+    std::string error;
+    if (!trace.open(_path, error)) {
+        throw std::runtime_error(error);
+    }
+    if (trace.nbSites() != NB_SITES_TOTAL) {
+        throw std::runtime_error("The trace was recorded for another number of sites");
+    }
 
+    // Riders, bikes and starting points of the recorded run
+    unsigned int nbPeople = 0;
+    size_t nbBikes = 0;
+    std::map<unsigned int, unsigned int> firstSite;
+    for (const TraceRecord& record : trace.records()) {
+        if (record.kind == TraceKind::StationInit) {
+            for (uint32_t count : record.bikes) nbBikes += count;
+            nbBikes += record.broken;
+        } else if (record.kind == TraceKind::Ride || record.kind == TraceKind::Walk) {
+            nbPeople = std::max(nbPeople, record.actorId);
+            firstSite.emplace(record.actorId, record.site);
+        }
+    }
 
+    QApplication a(argc, argv);
+    BikingInterface::initialize(nbPeople, NBSITES, NBDEPOTS, nbBikes + nbPeople);
+    BikingInterface* binkingInterface = new BikingInterface();
+    for (const TraceRecord& record : trace.records()) {
+        if (record.kind == TraceKind::StationInit) {
+            size_t total = record.broken;
+            for (uint32_t count : record.bikes) total += count;
+            binkingInterface->setInitBikes(record.site, total);
+            binkingInterface->setSiteCapacity(record.site, record.value);
+        }
+    }
+    for (const auto& person : firstSite) {
+        binkingInterface->setInitPerson(person.second, person.first);
+    }
 
-// Should stop all threads and release waiting ones
-void stopSimulation() {
-    // call all thread the end one by one
-    for (BikeStation* st : *globalStations)
-        st->ending();
+    // The animations do not block the replay; their length follows the speed
+    TraceReplayer replayer(trace);
+    replayer.setSpeed(_speed);
+    replayer.setObserver([&](const TraceRecord& record) {
+        unsigned int ms = _speed > 0 ? (unsigned int)(record.value / _speed) : 0;
+        switch (record.kind) {
+        case TraceKind::Ride:
+            binkingInterface->travel(record.actorId, record.site, record.to, ms, false);
+            break;
+        case TraceKind::Walk:
+            binkingInterface->walk(record.actorId, record.site, record.to, ms, false);
+            break;
+        case TraceKind::Drive:
+            if (record.actorId == 0) // one van drawn
+                binkingInterface->vanTravel(record.site, record.to, ms, false);
+            break;
+        case TraceKind::Gap:
+            break;
+        default:
+            if (replayer.stations()[record.site])
+                binkingInterface->setBikes(record.site, replayer.stations()[record.site]->nbBikes());
+            break;
+        }
+    });
+
+    PcoThread replayThread(&TraceReplayer::run, &replayer);
+    int ret = a.exec();
+    replayer.requestStop();
+    replayThread.join();
+
+    std::cout << "Replayed " << replayer.position() << " of " << trace.records().size()
+              << " records, " << replayer.mismatches() << " mismatches" << std::endl;
+    if (trace.dropped() > 0) {
+        std::cout << "Incomplete trace: " << trace.dropped() << " records dropped from "
+                  << trace.exactUntilNs() / 1e9 << " s" << std::endl;
+    }
+    return ret;
 }
 
 
@@ -47,78 +171,371 @@ int main(int argc, char* argv[]) {
         throw std::runtime_error("Not enough bikes to initialize the stations and the depot"); 
     }
 
-    QApplication a(argc, argv);
+    // Logging options: --log-file <path>, --log-level <level>, --no-gui-log
+    // Control options: --headless, --control <socket path>
+    // Restart from a checkpoint: --restore <path>
+    // City model (sites, depots, fleet): --city <path>
+    // Binary trace: --trace <path>, or --replay <path> [--replay-speed <factor>]
+    // Columnar export of occupancy and trips: --export <path>
+    // Journey phase percentiles per trip, CSV written at the end: --latency <path>
+    // Live state in shared memory for external monitors: --state-name </name>
+    // Recorded trips: --trips <csv> --trip-map <csv> [--trip-speed <factor>]
+    //                 [--trip-columns start,origin,destination,type[,end]]
+    const char* logFile = nullptr;
+    const char* controlPath = nullptr;
+    const char* restorePath = nullptr;
+    const char* cityPath = nullptr;
+    const char* tracePath = nullptr;
+    const char* replayPath = nullptr;
+    const char* exportPath = nullptr;
+    const char* latencyPath = nullptr;
+    const char* stateName = nullptr;
+    double replaySpeed = 1.0;
+    const char* tripsPath = nullptr;
+    const char* tripMapPath = nullptr;
+    double tripSpeed = 0; // virtual time
+    TripColumns tripColumns;
+    bool guiLog = true;
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
+            logFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            LogLevel level;
+            if (!parseLogLevel(argv[++i], level)) {
+                throw std::runtime_error("Unknown log level (debug, info, warning or off)");
+            }
+            globalEventLog.setLevel(level);
+        } else if (std::strcmp(argv[i], "--no-gui-log") == 0) {
+            guiLog = false;
+        } else if (std::strcmp(argv[i], "--control") == 0 && i + 1 < argc) {
+            controlPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (std::strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restorePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--city") == 0 && i + 1 < argc) {
+            cityPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+            latencyPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--state-name") == 0 && i + 1 < argc) {
+            stateName = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay-speed") == 0 && i + 1 < argc) {
+            replaySpeed = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--trips") == 0 && i + 1 < argc) {
+            tripsPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--trip-map") == 0 && i + 1 < argc) {
+            tripMapPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--trip-speed") == 0 && i + 1 < argc) {
+            tripSpeed = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--trip-columns") == 0 && i + 1 < argc) {
+            if (!parseTripColumns(argv[++i], tripColumns)) {
+                throw std::runtime_error("Trip columns: start,origin,destination,type[,end]");
+            }
+        }
+    }
+    if (replayPath) {
+        return replayTrace(argc, argv, replayPath, replaySpeed);
+    }
+    if (tripsPath && !tripMapPath) {
+        throw std::runtime_error("--trips needs a station table (--trip-map)");
+    }
+    if (headless) {
+        guiLog = false;
+        if (!controlPath) {
+            controlPath = CONTROL_SOCKET_PATH; // the only way to stop the run
+        }
+    }
+
+    std::unique_ptr<QApplication> a;
     std::vector<std::unique_ptr<PcoThread>> threads;
     std::array<BikeStation*, NB_SITES_TOTAL> bikeStations;
+    std::vector<Person*> persons;
 
-    // Init of GUI
-    BikingInterface::initialize(NBPEOPLE, NBSITES);
-    auto* binkingInterface = new BikingInterface();
+    // City to build: config.h, or a model file of the same size (the
+    // simulation is sized at compile time)
+    CityModel city;
+    if (cityPath) {
+        std::string error;
+        if (!city.open(cityPath, error)) {
+            throw std::runtime_error(error);
+        }
+        if (city.nbSites() != NBSITES || city.nbDepots() != NBDEPOTS) {
+            throw std::runtime_error(std::string(cityPath) + ": this build simulates "
+                                     + std::to_string(NBSITES) + " sites and "
+                                     + std::to_string(NBDEPOTS) + " depots (config.h)");
+        }
+        modelSitePositions() = city.positions();
+    } else {
+        CityModel::fromConfig(city);
+    }
 
-    // Create bikes stations with BORNES slots
-    for (size_t s = 0; s < NBSITES; ++s) {
-        bikeStations[s] = new BikeStation(BORNES);
+    // Saved state, mapped in memory
+    std::unique_ptr<CheckpointFile> checkpoint;
+    unsigned int nbPeople = city.nbPeople();
+    size_t nbBikes = city.nbBikes();
+    if (restorePath) {
+        std::string error;
+        checkpoint = std::make_unique<CheckpointFile>();
+        if (!checkpoint->open(restorePath, error)) {
+            throw std::runtime_error(error);
+        }
+        persons = checkpoint->restoreRiders();
+        nbPeople = 0;
+        for (Person* person : persons) {
+            nbPeople = std::max(nbPeople, person->identifier());
+        }
+        nbBikes = checkpoint->header().nbBikes + persons.size();
+    }
+    unsigned int firstTripRider = 1;
+    if (tripsPath) { // trip riders replace the random ones, after the restored ones
+        firstTripRider = checkpoint ? nbPeople + 1 : 1;
+        nbPeople = firstTripRider - 1 + TRIP_RIDERS;
     }
 
-    // Create depot with NB_BIKES slots
-    bikeStations[DEPOT_ID] = new BikeStation(NB_BIKES);
+    // Init of GUI (none when headless)
+    BikingInterface* binkingInterface = nullptr;
+    if (!headless) {
+        a = std::make_unique<QApplication>(argc, argv);
+        BikingInterface::initialize(nbPeople, NBSITES, NBDEPOTS, nbBikes);
+        binkingInterface = new BikingInterface();
+    }
 
-    // Create all bikes
-    std::vector<Bike*> allBikes;
-    allBikes.reserve(NB_BIKES);
-    for (size_t i = 0; i < NB_BIKES; ++i) {
-        auto* bike = new Bike;
-        bike->bikeType = i % Bike::nbBikeTypes;
-        allBikes.push_back(bike);
+    if (checkpoint) {
+        checkpoint->restoreStations(bikeStations);
+        for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+            if (s < NBSITES)
+                bikeStations[s]->setTargetLevel(bikeStations[s]->nbSlots() - 2); // until the optimizer runs
+            if (binkingInterface)
+                binkingInterface->setInitBikes(s, bikeStations[s]->nbBikes());
+        }
+        checkpoint->restoreMetrics();
+    } else {
+        // Stations with their bikes, built in parallel
+        std::vector<BikeStation*> built = buildStations(city);
+        std::copy(built.begin(), built.end(), bikeStations.begin());
+        for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+            if (s < NBSITES)
+                bikeStations[s]->setTargetLevel(bikeStations[s]->nbSlots() - 2); // until the optimizer runs
+            if (binkingInterface)
+                binkingInterface->setInitBikes(s, bikeStations[s]->nbBikes());
+        }
+
+        for (size_t i = 1; i <= city.nbPeople() && !tripsPath; ++i) {
+            persons.push_back(new Person(i));
+        }
     }
 
-    // Distribute bikes to stations
-    size_t idx = 0;
-    for (size_t s = 0; s < NBSITES; ++s) {
-        std::vector<Bike*> chunk;
-        for (size_t k = 0; k < BORNES - 2; ++k) {
-            chunk.push_back(allBikes[idx++]);
+    for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+        bikeStations[s]->profileAs(s); // names the stations in the lock profile
+    }
+
+    // Binary trace of the station operations (optional)
+    std::unique_ptr<PcoThread> traceThread;
+    if (tracePath) {
+        if (!globalTrace.open(tracePath, NB_SITES_TOTAL)) {
+            throw std::runtime_error("Cannot create the trace file");
+        }
+        for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+            bikeStations[s]->traceAs(s);
         }
+        traceThread = std::make_unique<PcoThread>(&EventTrace::run, &globalTrace);
+    }
 
-        bikeStations[s]->addBikes(chunk);
-        binkingInterface->setInitBikes(s, chunk.size());
+    // Columnar export (optional), stopped once every rider is done
+    std::unique_ptr<ColumnarExporter> columnarExporter;
+    std::unique_ptr<PcoThread> columnarThread;
+    if (exportPath) {
+        columnarExporter = std::make_unique<ColumnarExporter>(exportPath, bikeStations);
+        if (!columnarExporter->open()) {
+            throw std::runtime_error("Cannot create the export file");
+        }
+        Person::setColumnarExporter(columnarExporter.get());
+        TripFeed::setColumnarExporter(columnarExporter.get());
+        columnarThread = std::make_unique<PcoThread>(&ColumnarExporter::run, columnarExporter.get());
+    }
+
+    // Log sinks, fed by a dedicated logger thread
+    if (guiLog) {
+        globalEventLog.addSink(std::make_unique<GuiLogSink>(binkingInterface));
+    } else {
+        globalEventLog.addSink(std::make_unique<NullLogSink>());
+    }
+    if (logFile) {
+        globalEventLog.addSink(std::make_unique<FileLogSink>(logFile));
     }
+    PcoThread loggerThread(&EventLog::run, &globalEventLog);
 
-    // Remaining bikes go to depot
-    std::vector<Bike*> depotBikes;
-    for (; idx < allBikes.size(); ++idx) {
-        depotBikes.push_back(allBikes[idx]);
+    for (size_t s = 0; s < NB_SITES_TOTAL && binkingInterface; ++s) {
+        binkingInterface->setSiteCapacity(s, bikeStations[s]->nbSlots());
     }
-    bikeStations[DEPOT_ID]->addBikes(depotBikes);
-    binkingInterface->setInitBikes(DEPOT_ID, depotBikes.size());
 
     // Setting up pointer for interfaces
     Person::setInterface(binkingInterface);
     Van::setInterface(binkingInterface);
+    ControlServer::setInterface(binkingInterface);
 
     // Setting up pointer for stations
     Person::setStations(bikeStations);
     Van::setStations(bikeStations);
 
+    // Per-site, per-type targets computed in the background
+    auto* optimizer = new RebalanceOptimizer(bikeStations);
+    Van::setOptimizer(optimizer);
+
     globalStations = &bikeStations;
     globalThreads = &threads;
+    globalOptimizer = optimizer;
+
+    threads.emplace_back(std::make_unique<PcoThread>(&RebalanceOptimizer::run, optimizer));
+
+    // Repair shop at the main depot, served by a pool of workers
+    auto* repairShop = new RepairShop(bikeStations[DEPOT_ID]);
+    Van::setRepairShop(repairShop);
+    globalRepairShop = repairShop;
+    for (size_t w = 0; w < NB_REPAIR_WORKERS; ++w) {
+        globalGate.join(); // waited for by a checkpoint as soon as it exists
+        threads.emplace_back(std::make_unique<PcoThread>(&RepairShop::workerRun, repairShop));
+    }
+
+    // Fleet administration orders from the GUI, applied in the background
+    auto* fleetAdmin = new FleetAdmin(bikeStations);
+    fleetAdmin->setCallback([binkingInterface, &bikeStations](const FleetResult& result) {
+        if (binkingInterface) {
+            binkingInterface->setBikes(result.order.site, bikeStations[result.order.site]->nbBikes());
+            binkingInterface->fleetOrderDone(result);
+        }
+    });
+    globalFleetAdmin = fleetAdmin;
+    globalGate.join();
+    threads.emplace_back(std::make_unique<PcoThread>(&FleetAdmin::run, fleetAdmin));
 
-    // Starting people and van threads
-    for(size_t i = 0; i <= NBPEOPLE; ++i){
-        if(i == 0) {
-            threads.emplace_back(std::make_unique<PcoThread>(&Van::run, new Van(i)));
-            continue;
+    // Live state in shared memory for external monitors (optional)
+    StateExporter* stateExporter = nullptr;
+    if (stateName) {
+        stateExporter = new StateExporter(stateName, bikeStations);
+        if (stateExporter->open()) {
+            Van::setStateExporter(stateExporter);
+            globalStateExporter = stateExporter;
+            threads.emplace_back(std::make_unique<PcoThread>(&StateExporter::run, stateExporter));
+        } else {
+            delete stateExporter;
+            stateExporter = nullptr;
+            std::cerr << "Shared state export disabled" << std::endl;
         }
+    }
 
-        threads.emplace_back(std::make_unique<PcoThread>(&Person::run, new Person(i)));
-        binkingInterface->setInitPerson(0, i);
+    // Starting van and people threads
+    VanFleet vanFleet;
+    if (checkpoint) {
+        // Bikes of retiring vans and repaired bikes go back to the main depot
+        std::vector<Bike*> toDepot;
+        vanFleet.restore(checkpoint->restoreVans(toDepot));
+        repairShop->submit(checkpoint->restoreRepairQueue(toDepot));
+        bikeStations[DEPOT_ID]->addBikes(toDepot);
+        if (binkingInterface)
+            binkingInterface->setInitBikes(DEPOT_ID, bikeStations[DEPOT_ID]->nbBikes());
+        checkpoint.reset(); // unmaps the file
+    } else {
+        vanFleet.setCount(city.nbVans());
     }
 
-    int ret = a.exec();
+    for (Person* person : persons) {
+        globalGate.join();
+        threads.emplace_back(std::make_unique<PcoThread>(&Person::run, person));
+        if (binkingInterface)
+            binkingInterface->setInitPerson(person->site(), person->identifier());
+    }
+
+    // Riders replaying a trip file
+    std::unique_ptr<TripFeed> tripFeed;
+    if (tripsPath) {
+        std::string error;
+        tripFeed = std::make_unique<TripFeed>(bikeStations);
+        if (!tripFeed->open(tripsPath, tripMapPath, tripColumns, error)) {
+            throw std::runtime_error(error);
+        }
+        tripFeed->setSpeed(tripSpeed);
+        TripFeed::setInterface(binkingInterface);
+        globalTripFeed = tripFeed.get();
+        threads.emplace_back(std::make_unique<PcoThread>(&TripFeed::run, tripFeed.get()));
+        for (unsigned int r = firstTripRider; r < firstTripRider + TRIP_RIDERS; ++r) {
+            threads.emplace_back(std::make_unique<PcoThread>(&TripFeed::riderRun, tripFeed.get(), r));
+            if (binkingInterface)
+                binkingInterface->setInitPerson(0, r);
+        }
+    }
+
+    // Everything a checkpoint is made of (control socket "checkpoint" command);
+    // trip riders hold bikes a checkpoint would not see
+    CheckpointSources checkpointSources{bikeStations, persons, &vanFleet, repairShop};
+    ControlServer::setCheckpointSources(tripFeed ? nullptr : &checkpointSources);
+
+    // Local control socket (optional)
+    std::unique_ptr<ControlServer> controlServer;
+    if (controlPath) {
+        controlServer = std::make_unique<ControlServer>(controlPath, bikeStations, &vanFleet);
+        if (controlServer->open()) {
+            globalControlServer = controlServer.get();
+            threads.emplace_back(std::make_unique<PcoThread>(&ControlServer::serverRun, controlServer.get()));
+            threads.emplace_back(std::make_unique<PcoThread>(&ControlServer::controlRun, controlServer.get()));
+            std::cout << "Control socket: " << controlPath << std::endl;
+        } else if (headless) {
+            throw std::runtime_error("A headless run needs a control socket");
+        }
+    }
+
+    // Headless: runs until a "stop" command
+    int ret = headless ? 0 : a->exec();
 
     for (auto& thread : threads) {
         thread->join();
     }
+    vanFleet.joinAll();
+
+    if (traceThread) {
+        globalTrace.requestStop();
+        traceThread->join();
+        if (globalTrace.dropped() > 0) {
+            std::cout << "Trace records dropped: " << globalTrace.dropped() << std::endl;
+        }
+    }
+
+    if (columnarThread) {
+        columnarExporter->requestStop();
+        columnarThread->join();
+        if (columnarExporter->dropped() > 0) {
+            std::cout << "Exported trips dropped: " << columnarExporter->dropped() << std::endl;
+        }
+    }
+
+    // Flush the remaining records once every producer is done
+    globalEventLog.requestStop();
+    loggerThread.join();
+    if (globalEventLog.dropped() > 0) {
+        std::cout << "Log records dropped: " << globalEventLog.dropped() << std::endl;
+    }
+
+    globalMetrics.report(std::cout);
+    reportAvailability(bikeStations, std::cout);
+    globalTripLatency.report(std::cout);
+    if (latencyPath) {
+        std::string error;
+        if (!globalTripLatency.exportCsv(latencyPath, error)) {
+            std::cerr << error << std::endl;
+        }
+    }
+    if (LOCK_PROFILING_ENABLED) {
+        globalLockProfiler.report(std::cout);
+    }
+
+    delete stateExporter; // removes the shared-memory segment
 
     return ret;
 }
@@ -9,41 +9,89 @@
 #include <QToolBar>
 #include <QAction>
 #include <QCoreApplication>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QScrollBar>
+#include <QStatusBar>
 #include "mainwindow.h"
+#include "simulation.h"
+#include "triplatency.h"
+
+#include <algorithm>
 
 #define min(a,b) ((a<b)?(a):(b))
 
-extern std::array<BikeStation*, NB_SITES_TOTAL>* globalStations;
+// Période de rafraîchissement de l'affichage des vélos (~30 Hz)
+#define FRAMEPERIODMS 33
+
+// Période de rafraîchissement des courbes d'historique
+#define HISTORYPERIODMS 1000
+
+// Nombre maximal de lignes gardées par la vue de log
+#define LOGCAPACITY 10000
+
+// Nombre maximal de vélos ajoutés ou retirés par un ordre d'administration
+#define ADMINMAXCOUNT 100
 
-extern void stopSimulation();
+// Durée d'affichage du résultat d'un ordre dans la barre d'état
+#define ADMINMESSAGEMS 5000
+
+// Nombre de sites affichés par la vue de disponibilité (les moins bien servis)
+#define AVAILABILITYROWS 10
 
 MainWindow::MainWindow(unsigned int nbConsoles,unsigned int nbSite,
-                       QWidget *parent)
+                       unsigned int nbDepot,unsigned int nbBike,QWidget *parent)
     : QMainWindow(parent)
 {
     m_nbConsoles=nbConsoles;
-    m_consoles=new QTextEdit*[nbConsoles];
-    for(unsigned int i=0;i<nbConsoles;i++) {
-        m_consoles[i]=new QTextEdit(this);
-        m_consoles[i]->setMinimumWidth(200);
-    }
-    m_docks=new QDockWidget*[nbConsoles];
-    for(unsigned int i=0;i<nbConsoles;i++) {
-        m_docks[i]=new QDockWidget(this);
-        m_docks[i]->setWidget(m_consoles[i]);
-    }
-    for(unsigned int i=0;i<nbConsoles/2;i++) {
-        this->addDockWidget(Qt::LeftDockWidgetArea,m_docks[i]);
-    }
-    for(unsigned int i=nbConsoles/2;i<nbConsoles;i++) {
-        this->addDockWidget(Qt::RightDockWidgetArea,m_docks[i]);
-    }
-
-    for(unsigned int i=0;i<nbConsoles;i++)
-        setConsoleTitle(i,QString("Console number : %1").arg(i));
-    m_display=new BikeDisplay(nbSite,this);
+    m_nbSites=nbSite+nbDepot;
+
+    // Une seule vue de log, quel que soit le nombre de personnes : le modèle
+    // est borné et la vue ne met en forme que les lignes visibles
+    m_logModel=new LogModel(LOGCAPACITY,this);
+    m_logFilterModel=new LogFilterModel(this);
+    m_logFilterModel->setSourceModel(m_logModel);
+
+    m_logView=new QListView(this);
+    m_logView->setModel(m_logFilterModel);
+    m_logView->setUniformItemSizes(true);
+    m_logView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_logView->setMinimumWidth(300);
+
+    m_logFilter=new QComboBox(this);
+    m_logFilter->addItem("Tout",LogFilterModel::All);
+    m_logFilter->addItem("Personne",LogFilterModel::Person);
+    m_logFilter->addItem("Camionnette",LogFilterModel::Van);
+    m_logFilter->addItem("Station",LogFilterModel::Station);
+    m_logFilterId=new QSpinBox(this);
+    m_logFilterId->setRange(-1,-1);
+    m_logFilterId->setSpecialValueText("Tous");
+    connect(m_logFilter, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onLogFilterChanged);
+    connect(m_logFilterId, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &MainWindow::onLogFilterChanged);
+
+    QWidget *logWidget=new QWidget(this);
+    QHBoxLayout *filterLayout=new QHBoxLayout;
+    filterLayout->addWidget(m_logFilter);
+    filterLayout->addWidget(m_logFilterId);
+    QVBoxLayout *logLayout=new QVBoxLayout(logWidget);
+    logLayout->addLayout(filterLayout);
+    logLayout->addWidget(m_logView);
+
+    m_logDock=new QDockWidget("Log",this);
+    m_logDock->setWidget(logWidget);
+    addDockWidget(Qt::RightDockWidgetArea,m_logDock);
+
+    m_display=new BikeDisplay(nbSite,nbDepot,nbConsoles,nbBike,this);
     setCentralWidget(m_display);
 
+    // Les threads écrivent dans l'instantané, l'affichage le relit à cadence fixe
+    m_occupancy=std::make_unique<OccupancySnapshot>(nbSite+nbDepot);
+    m_frameTimer=new QTimer(this);
+    connect(m_frameTimer, &QTimer::timeout, this, &MainWindow::refreshFrame);
+    m_frameTimer->start(FRAMEPERIODMS);
+
     QToolBar* toolbar = addToolBar("Controls");
 
     QAction* stopAction = toolbar->addAction("Stop simulation");
@@ -54,13 +102,63 @@ MainWindow::MainWindow(unsigned int nbConsoles,unsigned int nbSite,
     connect(closeAction, &QAction::triggered,
             this, &MainWindow::onEndClicked);
 
-    QAction* plusDepot = toolbar->addAction("+1 depot");
-    connect(plusDepot, &QAction::triggered,
-            this, &MainWindow::onDepotPlusClicked);
-
-    QAction* minusDepot = toolbar->addAction("-1 depot");
-    connect(minusDepot, &QAction::triggered,
-            this, &MainWindow::onDepotMinusClicked);
+    // Administration de la flotte : site, type et nombre de vélos. Les
+    // ordres sont exécutés par un thread de fond, le résultat arrive dans
+    // la barre d'état (fleetOrderDone)
+    m_adminSite=new QSpinBox(this);
+    m_adminSite->setRange(0,m_nbSites-1);
+    m_adminSite->setValue(DEPOT_ID);
+    m_adminSite->setPrefix("Site ");
+    m_adminType=new QComboBox(this);
+    for (size_t t=0;t<Bike::nbBikeTypes;t++)
+        m_adminType->addItem(QString("Type %1").arg(t));
+    m_adminCount=new QSpinBox(this);
+    m_adminCount->setRange(1,ADMINMAXCOUNT);
+    toolbar->addSeparator();
+    toolbar->addWidget(m_adminSite);
+    toolbar->addWidget(m_adminType);
+    toolbar->addWidget(m_adminCount);
+
+    QAction* addBikes = toolbar->addAction("Ajouter");
+    connect(addBikes, &QAction::triggered,
+            this, &MainWindow::onAdminAddClicked);
+
+    QAction* removeBikes = toolbar->addAction("Retirer");
+    connect(removeBikes, &QAction::triggered,
+            this, &MainWindow::onAdminRemoveClicked);
+    toolbar->addSeparator();
+
+    // Période affichée par les courbes d'historique : résolution, nombre
+    m_historyRange = new QComboBox(this);
+    m_historyRange->addItem("Dernière minute", QPoint(OccupancyHistory::Seconds, 60));
+    m_historyRange->addItem("Dernière heure", QPoint(OccupancyHistory::Minutes, 60));
+    m_historyRange->addItem("Dernier jour", QPoint(OccupancyHistory::Hours, 24));
+    m_historyRange->addItem("Dernière semaine", QPoint(OccupancyHistory::Hours, 24*7));
+    toolbar->addWidget(m_historyRange);
+    connect(m_historyRange, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::refreshHistory);
+
+    // Centiles des phases des trajets, relus avec les courbes d'historique
+    m_latencyLabel=new QLabel(this);
+    m_latencyLabel->setFont(QFont("Monospace"));
+    m_latencyLabel->setAlignment(Qt::AlignTop|Qt::AlignLeft);
+    m_latencyDock=new QDockWidget("Trajets",this);
+    m_latencyDock->setWidget(m_latencyLabel);
+    addDockWidget(Qt::RightDockWidgetArea,m_latencyDock);
+
+    // Part du temps passée vide (par type) ou pleine, par site
+    m_availabilityLabel=new QLabel(this);
+    m_availabilityLabel->setFont(QFont("Monospace"));
+    m_availabilityLabel->setAlignment(Qt::AlignTop|Qt::AlignLeft);
+    m_availabilityDock=new QDockWidget("Disponibilité",this);
+    m_availabilityDock->setWidget(m_availabilityLabel);
+    addDockWidget(Qt::RightDockWidgetArea,m_availabilityDock);
+
+    m_historyTimer=new QTimer(this);
+    connect(m_historyTimer, &QTimer::timeout, this, &MainWindow::refreshHistory);
+    connect(m_historyTimer, &QTimer::timeout, this, &MainWindow::refreshLatency);
+    connect(m_historyTimer, &QTimer::timeout, this, &MainWindow::refreshAvailability);
+    m_historyTimer->start(HISTORYPERIODMS);
 }
 
 void MainWindow::onEndClicked()
@@ -79,38 +177,28 @@ void MainWindow::onStopClicked()
     }
 }
 
-void MainWindow::onDepotPlusClicked()
+void MainWindow::onAdminAddClicked()
 {
-    if (!globalStations) return;
-
-    BikeStation* depot = (*globalStations)[DEPOT_ID];
+    if (!globalFleetAdmin) return;
 
-    // Create a new bike and add it to the depot
-    auto* bike = new Bike;
-    static thread_local std::mt19937_64 rng(std::random_device{}());
-    std::uniform_int_distribution<size_t> dist(0, Bike::nbBikeTypes - 1);
-    bike->bikeType = dist(rng);
-
-    depot->putBike(bike);
-
-    // Update GUI directly
-    m_display->setBikes(DEPOT_ID, depot->nbBikes());
+    // Ne touche aucune station : l'ordre est mis en file pour le thread de fond
+    std::array<int, Bike::nbBikeTypes> delta{};
+    delta[m_adminType->currentIndex()]=m_adminCount->value();
+    globalFleetAdmin->submit(m_adminSite->value(),delta);
 }
 
-void MainWindow::onDepotMinusClicked()
+void MainWindow::onAdminRemoveClicked()
 {
-    if (!globalStations) return;
+    if (!globalFleetAdmin) return;
 
-    BikeStation* depot = (*globalStations)[DEPOT_ID];
-
-    // Try to remove one bike from depot
-    auto bikes = depot->getBikes(1);
-    if (!bikes.empty()) {
-        delete bikes[0]; // bike is no longer in any station, we can delete it
-    }
+    std::array<int, Bike::nbBikeTypes> delta{};
+    delta[m_adminType->currentIndex()]=-m_adminCount->value();
+    globalFleetAdmin->submit(m_adminSite->value(),delta);
+}
 
-    // Update GUI
-    m_display->setBikes(DEPOT_ID, depot->nbBikes());
+void MainWindow::fleetOrderDone(QString text)
+{
+    statusBar()->showMessage(text,ADMINMESSAGEMS);
 }
 
 void MainWindow::walk(unsigned int personId,
@@ -122,24 +210,130 @@ void MainWindow::walk(unsigned int personId,
 }
 
 
-void MainWindow::setConsoleTitle(unsigned int consoleId,QString title)
+void MainWindow::consoleAppendText(unsigned int consoleId,QString text)
+{
+    // La console 0 est celle du système, les autres celles des personnes
+    m_logModel->postText(consoleId==0 ? LogActor::System : LogActor::Person,
+                         consoleId,text);
+}
+
+LogModel *MainWindow::logModel()
+{
+    return m_logModel;
+}
+
+void MainWindow::onLogFilterChanged()
 {
-    if (consoleId>=m_nbConsoles)
+    auto mode=(LogFilterModel::Mode)m_logFilter->currentData().toInt();
+
+    // L'identifiant n'a de sens que pour les personnes et les stations
+    int maxId=-1;
+    if (mode==LogFilterModel::Person)
+        maxId=m_nbConsoles;
+    else if (mode==LogFilterModel::Station)
+        maxId=m_nbSites-1;
+    m_logFilterId->blockSignals(true);
+    m_logFilterId->setRange(-1,maxId);
+    m_logFilterId->blockSignals(false);
+
+    m_logFilterModel->setFilter(mode,m_logFilterId->value());
+}
+
+
+void MainWindow::setBikes(unsigned int site,unsigned int nbBike)
+{
+    m_occupancy->publish(site,nbBike);
+}
+
+OccupancySnapshot *MainWindow::occupancy()
+{
+    return m_occupancy.get();
+}
+
+void MainWindow::refreshFrame()
+{
+    // Ajoute les lignes de log reçues depuis la dernière image, en restant
+    // en bas de la liste si l'utilisateur y était
+    QScrollBar *bar=m_logView->verticalScrollBar();
+    bool atBottom=bar->value()==bar->maximum();
+    m_logModel->flush();
+    if (atBottom)
+        m_logView->scrollToBottom();
+
+    // Ne redessine que les sites dont le nombre de vélos a changé
+    if (!m_occupancy->collectChanges(m_changedSites))
         return;
-    m_docks[consoleId]->setWindowTitle(title);
+    for (unsigned int site : m_changedSites)
+        m_display->setBikes(site,m_occupancy->count(site));
 }
 
-void MainWindow::consoleAppendText(unsigned int consoleId,QString text)
+
+void MainWindow::refreshHistory()
 {
-    if (consoleId>=m_nbConsoles)
+    if (!globalStations)
         return;
-    m_consoles[consoleId]->append(text);
+
+    // Lecture sans verrou des historiques tenus par les stations
+    QPoint range=m_historyRange->currentData().toPoint();
+    auto resolution=(OccupancyHistory::Resolution)range.x();
+    for (unsigned int site=0;site<m_nbSites;site++) {
+        (*globalStations)[site]->occupancyHistory().read(resolution,range.y(),m_history);
+        m_display->setSiteHistory(site,m_history);
+    }
 }
 
 
-void MainWindow::setBikes(unsigned int site,unsigned int nbBike)
+void MainWindow::refreshLatency()
+{
+    // Histogrammes fusionnés sans verrou, durées en millisecondes
+    QString text=QString("%1 %2 %3 %4 %5\n").arg("",-9).arg("n",7).arg("p50",8)
+                                            .arg("p95",8).arg("p99",8);
+    for (size_t p=0;p<NB_TRIP_PHASES;p++) {
+        LatencyHistogram histogram=globalTripLatency.phase((TripPhase)p);
+        text+=QString("%1 %2 %3 %4 %5\n").arg(tripPhaseName((TripPhase)p),-9)
+                  .arg(histogram.count(),7)
+                  .arg(histogram.percentile(0.50)/1e3,8,'f',1)
+                  .arg(histogram.percentile(0.95)/1e3,8,'f',1)
+                  .arg(histogram.percentile(0.99)/1e3,8,'f',1);
+    }
+    m_latencyLabel->setText(text);
+}
+
+
+void MainWindow::refreshAvailability()
 {
-    m_display->setBikes(site,nbBike);
+    if (!globalStations)
+        return;
+
+    // Tous les sites au même instant, sans verrou ; les moins bien servis
+    // (type le plus souvent absent, ou site plein) en premier
+    uint64_t now=BikeStation::availabilityClockNs();
+    std::vector<std::pair<double,unsigned int>> worst;
+    std::vector<StationAvailability> availability(NBSITES);
+    for (unsigned int site=0;site<NBSITES;site++) {
+        availability[site]=(*globalStations)[site]->availability(now);
+        double score=availability[site].fullFraction();
+        for (size_t t=0;t<Bike::nbBikeTypes;t++)
+            score=std::max(score,availability[site].emptyFraction(t));
+        worst.push_back({score,site});
+    }
+    std::stable_sort(worst.begin(),worst.end(),[](const std::pair<double,unsigned int>& a,
+                                                  const std::pair<double,unsigned int>& b) {
+        return a.first>b.first;
+    });
+
+    QString text=QString("%1").arg("Site",-5);
+    for (size_t t=0;t<Bike::nbBikeTypes;t++)
+        text+=QString(" %1").arg(QString("vide %1").arg(t),7);
+    text+=QString(" %1\n").arg("plein",7);
+    for (size_t i=0;i<worst.size() && i<AVAILABILITYROWS;i++) {
+        const StationAvailability& a=availability[worst[i].second];
+        text+=QString("%1").arg(worst[i].second,-5);
+        for (size_t t=0;t<Bike::nbBikeTypes;t++)
+            text+=QString(" %1%").arg(100.0*a.emptyFraction(t),6,'f',1);
+        text+=QString(" %1%\n").arg(100.0*a.fullFraction(),6,'f',1);
+    }
+    m_availabilityLabel->setText(text);
 }
 
 
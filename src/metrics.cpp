@@ -0,0 +1,80 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "metrics.h"
+#include "config.h"
+
+SimulationMetrics globalMetrics;
+
+void SimulationMetrics::addVanDistance(double distance) {
+    vanDistanceMilli.fetch_add((uint64_t)(distance * 1000.0), std::memory_order_relaxed);
+}
+
+double SimulationMetrics::vanDistance() const {
+    return vanDistanceMilli.load(std::memory_order_relaxed) / 1000.0;
+}
+
+// Accumulate broken-bike time since the last change (mutex held)
+void SimulationMetrics::integrateUnavailable() const {
+    auto now = std::chrono::steady_clock::now();
+    unavailableBikeSeconds += brokenNow * std::chrono::duration<double>(now - lastChange).count();
+    lastChange = now;
+}
+
+void SimulationMetrics::bikeBroken() {
+    breakdowns.fetch_add(1, std::memory_order_relaxed);
+    mutex.lock();
+    integrateUnavailable();
+    brokenNow++;
+    mutex.unlock();
+}
+
+void SimulationMetrics::bikeRepaired() {
+    repairs.fetch_add(1, std::memory_order_relaxed);
+    mutex.lock();
+    integrateUnavailable();
+    if (brokenNow > 0) brokenNow--;
+    mutex.unlock();
+}
+
+void SimulationMetrics::setBrokenNow(size_t broken) {
+    mutex.lock();
+    integrateUnavailable();
+    brokenNow = broken;
+    mutex.unlock();
+}
+
+double SimulationMetrics::fleetAvailability(size_t fleetSize) const {
+    mutex.lock();
+    integrateUnavailable();
+    double elapsed = std::chrono::duration<double>(lastChange - start).count();
+    double unavailable = unavailableBikeSeconds;
+    mutex.unlock();
+
+    if (fleetSize == 0 || elapsed <= 0.0) return 1.0;
+    return 1.0 - unavailable / (elapsed * fleetSize);
+}
+
+void SimulationMetrics::report(std::ostream& out) const {
+    uint64_t trips = tripsCompleted.load(std::memory_order_relaxed);
+    uint64_t waits = riderWaits.load(std::memory_order_relaxed);
+    double distance = vanDistance();
+
+    out << "=== Simulation metrics ===" << '\n'
+        << "incentives          : " << (INCENTIVES_ENABLED ? "on" : "off") << '\n'
+        << "trips completed     : " << trips << '\n'
+        << "rider waits         : " << waits << '\n'
+        << "wait ratio          : " << (trips ? (double)waits / trips : 0.0) << '\n'
+        << "van distance        : " << distance << '\n'
+        << "van distance / trip : " << (trips ? distance / trips : 0.0) << '\n'
+        << "incentives accepted : " << incentivesAccepted.load(std::memory_order_relaxed) << '\n'
+        << "bonus points paid   : " << bonusPointsPaid.load(std::memory_order_relaxed) << '\n'
+        << "repair workers      : " << NB_REPAIR_WORKERS << '\n'
+        << "breakdowns          : " << breakdowns.load(std::memory_order_relaxed) << '\n'
+        << "repairs             : " << repairs.load(std::memory_order_relaxed) << '\n'
+        << "fleet availability  : " << fleetAvailability(NB_BIKES) << '\n';
+}
@@ -0,0 +1,218 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "mincostflow.h"
+
+#include <deque>
+#include <queue>
+#include <limits>
+#include <functional>
+#include <algorithm>
+
+static const int64_t INF = std::numeric_limits<int64_t>::max() / 4;
+static const size_t NO_LEVEL = std::numeric_limits<size_t>::max();
+
+MinCostFlow::MinCostFlow(size_t _nbNodes)
+    : nbNodes(_nbNodes), adj(_nbNodes), potential(_nbNodes, 0),
+      dist(_nbNodes), level(_nbNodes), nextArc(_nbNodes) {}
+
+// Add a plain arc; residual 2*i is forward, 2*i+1 is backward
+size_t MinCostFlow::addArc(size_t _from, size_t _to, int64_t _capacity, int64_t _cost) {
+    size_t id = arcs.size();
+    arcs.push_back({_from, _to, _capacity, 0, _cost, {}});
+    adj[_from].push_back(2 * id);
+    adj[_to].push_back(2 * id + 1);
+    return id;
+}
+
+// Add a convex arc (one unit cost per unit of capacity)
+size_t MinCostFlow::addConvexArc(size_t _from, size_t _to, std::vector<int64_t> _unitCosts) {
+    size_t id = arcs.size();
+    int64_t capacity = (int64_t)_unitCosts.size();
+    arcs.push_back({_from, _to, capacity, 0, 0, std::move(_unitCosts)});
+    adj[_from].push_back(2 * id);
+    adj[_to].push_back(2 * id + 1);
+    return id;
+}
+
+// Head and cost of the next unit on a residual arc, false if saturated
+bool MinCostFlow::residual(size_t _residualId, size_t& _to, int64_t& _cost) const {
+    const Arc& a = arcs[_residualId / 2];
+    if (_residualId % 2 == 0) {
+        if (a.flow == a.capacity) return false;
+        _to = a.to;
+        _cost = a.unitCosts.empty() ? a.cost : a.unitCosts[a.flow];
+    } else {
+        if (a.flow == 0) return false;
+        _to = a.from;
+        _cost = a.unitCosts.empty() ? -a.cost : -a.unitCosts[a.flow - 1];
+    }
+    return true;
+}
+
+// Units that can be pushed on a residual arc before its cost changes
+int64_t MinCostFlow::run(size_t _residualId) const {
+    const Arc& a = arcs[_residualId / 2];
+    bool forward = (_residualId % 2) == 0;
+
+    if (a.unitCosts.empty()) {
+        return forward ? a.capacity - a.flow : a.flow;
+    }
+
+    int64_t n = 1;
+    if (forward) {
+        int64_t c = a.unitCosts[a.flow];
+        while (a.flow + n < a.capacity && a.unitCosts[a.flow + n] == c) ++n;
+    } else {
+        int64_t c = a.unitCosts[a.flow - 1];
+        while (a.flow - n > 0 && a.unitCosts[a.flow - n - 1] == c) ++n;
+    }
+    return n;
+}
+
+void MinCostFlow::push(size_t _residualId, int64_t _amount) {
+    Arc& a = arcs[_residualId / 2];
+    if (_residualId % 2 == 0) {
+        a.flow += _amount;
+    } else {
+        a.flow -= _amount;
+    }
+}
+
+// Bellman-Ford (queue based) so that negative arc costs are allowed
+void MinCostFlow::initPotentials(size_t _source) {
+    std::vector<int64_t> d(nbNodes, INF);
+    std::vector<bool> inQueue(nbNodes, false);
+    std::deque<size_t> queue;
+
+    d[_source] = 0;
+    queue.push_back(_source);
+    inQueue[_source] = true;
+
+    while (!queue.empty()) {
+        size_t u = queue.front();
+        queue.pop_front();
+        inQueue[u] = false;
+        for (size_t id : adj[u]) {
+            size_t to;
+            int64_t c;
+            if (residual(id, to, c) && d[u] + c < d[to]) {
+                d[to] = d[u] + c;
+                if (!inQueue[to]) {
+                    inQueue[to] = true;
+                    queue.push_back(to);
+                }
+            }
+        }
+    }
+
+    for (size_t v = 0; v < nbNodes; ++v) {
+        potential[v] = (d[v] < INF) ? d[v] : 0;
+    }
+}
+
+// Shortest reduced distances from the source, then potentials update
+bool MinCostFlow::dijkstra(size_t _source, size_t _sink) {
+    using Entry = std::pair<int64_t, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+
+    std::fill(dist.begin(), dist.end(), INF);
+    dist[_source] = 0;
+    heap.push({0, _source});
+
+    while (!heap.empty()) {
+        auto [du, u] = heap.top();
+        heap.pop();
+        if (du != dist[u]) continue; // stale entry
+        if (u == _sink) break;       // farther nodes cannot be on a shortest path
+
+        for (size_t id : adj[u]) {
+            size_t to;
+            int64_t c;
+            if (!residual(id, to, c)) continue;
+            int64_t nd = du + c + potential[u] - potential[to];
+            if (nd < dist[to]) {
+                dist[to] = nd;
+                heap.push({nd, to});
+            }
+        }
+    }
+
+    if (dist[_sink] >= INF) return false;
+
+    // nodes not settled before the sink are shifted like the sink,
+    // which keeps every reduced cost >= 0
+    for (size_t v = 0; v < nbNodes; ++v) {
+        potential[v] += std::min(dist[v], dist[_sink]);
+    }
+    return true;
+}
+
+// DFS along admissible arcs (zero reduced cost, next BFS level)
+int64_t MinCostFlow::augment(size_t _node, size_t _sink, int64_t _limit) {
+    if (_node == _sink) return _limit;
+
+    for (size_t& i = nextArc[_node]; i < adj[_node].size(); ++i) {
+        size_t id = adj[_node][i];
+        size_t to;
+        int64_t c;
+        if (!residual(id, to, c) || level[to] != level[_node] + 1) continue;
+        if (c + potential[_node] - potential[to] != 0) continue;
+
+        // a convex arc keeps the same cost only for run() units
+        int64_t pushed = augment(to, _sink, std::min(_limit, run(id)));
+        if (pushed > 0) {
+            push(id, pushed);
+            return pushed;
+        }
+    }
+    return 0;
+}
+
+int64_t MinCostFlow::solve(size_t _source, size_t _sink) {
+    int64_t flow = 0;
+    initPotentials(_source);
+
+    while (dijkstra(_source, _sink)) {
+        // blocking flows on the admissible graph until the sink is cut off
+        while (true) {
+            std::fill(level.begin(), level.end(), NO_LEVEL);
+            std::deque<size_t> queue{_source};
+            level[_source] = 0;
+            while (!queue.empty()) {
+                size_t u = queue.front();
+                queue.pop_front();
+                for (size_t id : adj[u]) {
+                    size_t to;
+                    int64_t c;
+                    if (residual(id, to, c) && level[to] == NO_LEVEL
+                        && c + potential[u] - potential[to] == 0) {
+                        level[to] = level[u] + 1;
+                        queue.push_back(to);
+                    }
+                }
+            }
+            if (level[_sink] == NO_LEVEL) break;
+
+            std::fill(nextArc.begin(), nextArc.end(), 0);
+            int64_t pushed;
+            while ((pushed = augment(_source, _sink, INF)) > 0) {
+                flow += pushed;
+                cost += pushed * (potential[_sink] - potential[_source]);
+            }
+        }
+    }
+    return flow;
+}
+
+int64_t MinCostFlow::flowOn(size_t _arcId) const {
+    return arcs[_arcId].flow;
+}
+
+int64_t MinCostFlow::totalCost() const {
+    return cost;
+}
@@ -0,0 +1,99 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "occupancyhistory.h"
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+
+static const std::chrono::steady_clock::time_point historyStart = std::chrono::steady_clock::now();
+
+// Milliseconds since the start of the program, shared by all stations
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - historyStart).count();
+}
+
+static uint16_t pack(uint8_t min, uint8_t max) {
+    return (uint16_t)(max << 8 | min);
+}
+
+OccupancyHistory::OccupancyHistory(size_t _capacity) : capacity(std::max<size_t>(_capacity, 1)) {
+    const size_t sizes[NbResolutions] = {HISTORY_SECONDS, HISTORY_MINUTES, HISTORY_HOURS};
+    const int64_t periods[NbResolutions] = {1000, 60 * 1000, 3600 * 1000};
+    const int64_t now = nowMs();
+
+    for (size_t r = 0; r < NbResolutions; ++r) {
+        Level& level = levels[r];
+        level.size = sizes[r];
+        level.periodMs = periods[r];
+        level.buckets.reset(new std::atomic<uint16_t>[level.size]);
+        for (size_t i = 0; i < level.size; ++i) {
+            level.buckets[i].store(0, std::memory_order_relaxed);
+        }
+        level.lastIndex.store(now / level.periodMs, std::memory_order_relaxed);
+    }
+}
+
+size_t OccupancyHistory::ringSize(Resolution _resolution) {
+    const size_t sizes[NbResolutions] = {HISTORY_SECONDS, HISTORY_MINUTES, HISTORY_HOURS};
+    return sizes[_resolution];
+}
+
+uint8_t OccupancyHistory::quantize(size_t _nbBikes) const {
+    return (uint8_t)(std::min(_nbBikes, capacity) * 255 / capacity);
+}
+
+// Called with the station mutex held: only one writer at a time
+void OccupancyHistory::record(size_t _nbBikes) {
+    const int64_t now = nowMs();
+    const uint8_t value = quantize(_nbBikes);
+    const uint8_t held = current.load(std::memory_order_relaxed);
+
+    for (Level& level : levels) {
+        const int64_t index = now / level.periodMs;
+        const int64_t last = level.lastIndex.load(std::memory_order_relaxed);
+        std::atomic<uint16_t>& bucket = level.buckets[index % level.size];
+
+        if (index == last) {
+            uint16_t old = bucket.load(std::memory_order_relaxed);
+            uint8_t min = std::min<uint8_t>(old & 0xff, value);
+            uint8_t max = std::max<uint8_t>(old >> 8, value);
+            bucket.store(pack(min, max), std::memory_order_relaxed);
+            continue;
+        }
+
+        // Buckets without change keep the previous value (at most one lap)
+        for (int64_t i = std::max(last + 1, index - (int64_t)level.size + 1); i < index; ++i) {
+            level.buckets[i % level.size].store(pack(held, held), std::memory_order_relaxed);
+        }
+        bucket.store(pack(std::min(held, value), std::max(held, value)), std::memory_order_relaxed);
+        level.lastIndex.store(index, std::memory_order_release);
+    }
+    current.store(value, std::memory_order_release);
+}
+
+void OccupancyHistory::read(Resolution _resolution, size_t _count, std::vector<Range>& _out) const {
+    const Level& level = levels[_resolution];
+    const int64_t index = nowMs() / level.periodMs;
+    const int64_t last = level.lastIndex.load(std::memory_order_acquire);
+    const uint8_t held = current.load(std::memory_order_acquire);
+    const int64_t count = (int64_t)std::min(_count, level.size);
+
+    _out.clear();
+    for (int64_t i = index - count + 1; i <= index; ++i) {
+        // Nothing recorded since the last bucket: the value has not changed
+        uint16_t b = 0; // before the start of the program
+        if (i > last) {
+            b = pack(held, held);
+        } else if (i >= 0) {
+            b = level.buckets[i % level.size].load(std::memory_order_relaxed);
+        }
+        _out.push_back({(b & 0xff) / 255.0f, (b >> 8) / 255.0f});
+    }
+}
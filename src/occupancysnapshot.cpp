@@ -0,0 +1,44 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "occupancysnapshot.h"
+
+OccupancySnapshot::OccupancySnapshot(unsigned int _nbSites)
+    : sites(_nbSites), back(new std::atomic<unsigned int>[_nbSites]), front(_nbSites, 0)
+{
+    for (unsigned int s = 0; s < sites; ++s) {
+        back[s].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Called by any simulation thread
+void OccupancySnapshot::publish(unsigned int _site, unsigned int _nbBikes) {
+    if (_site >= sites) return;
+    back[_site].store(_nbBikes, std::memory_order_relaxed);
+}
+
+// Called by the GUI thread once per frame
+bool OccupancySnapshot::collectChanges(std::vector<unsigned int>& _changed) {
+    _changed.clear();
+
+    for (unsigned int s = 0; s < sites; ++s) {
+        unsigned int n = back[s].load(std::memory_order_relaxed);
+        if (n != front[s]) {
+            front[s] = n;
+            _changed.push_back(s);
+        }
+    }
+    return !_changed.empty();
+}
+
+unsigned int OccupancySnapshot::count(unsigned int _site) const {
+    return front[_site];
+}
+
+unsigned int OccupancySnapshot::nbSites() const {
+    return sites;
+}
@@ -7,11 +7,18 @@
 
 #include "person.h"
 #include "bike.h"
+#include "citylayout.h"
+#include "metrics.h"
+#include "simtime.h"
+#include "simgate.h"
+#include "eventtrace.h"
+#include "triplatency.h"
 #include <random>
 
 // Static members initialization
 BikingInterface* Person::binkingInterface = nullptr; // GUI/interface pointer
 std::array<BikeStation*, NB_SITES_TOTAL> Person::stations{}; // all bike stations
+ColumnarExporter* Person::columnarExporter = nullptr; // trip records
 
 // Constructor
 Person::Person(unsigned int _id) : id(_id), homeSite(0), currentSite(0) {
@@ -20,11 +27,8 @@ Person::Person(unsigned int _id) : id(_id), homeSite(0), currentSite(0) {
     std::uniform_int_distribution<size_t> dist(0, Bike::nbBikeTypes - 1);
     preferredType = dist(rng); // assign a random preferred bike type
 
-    // log initial preference if interface exists
-    if (binkingInterface) {
-        log(QString("Person %1, préfère type %2")
-                .arg(id).arg(preferredType));
-    }
+    // log initial preference
+    log(LogEvent::PersonPreference, preferredType);
 }
 
 // Set static stations array (all Persons share same stations)
@@ -37,32 +41,119 @@ void Person::setInterface(BikingInterface* _binkingInterface) {
     binkingInterface = _binkingInterface;
 }
 
+// Set the exporter of the completed trips (shared by all Persons)
+void Person::setColumnarExporter(ColumnarExporter* _columnarExporter) {
+    columnarExporter = _columnarExporter;
+}
+
+// Constructor from a checkpoint
+Person::Person(const CheckpointRider& _record, Bike* _bike)
+    : id(_record.id), preferredType(_record.preferredType), homeSite(0),
+      currentSite(_record.site), phase((Phase)_record.phase),
+      destination(_record.destination), bike(_bike),
+      rngSeed(_record.rngSeed), rngCounter(_record.rngCounter), restoredRng(true) {}
+
 // Main loop of the Person (thread)
 void Person::run() {
+    globalTrace.actor((uint8_t)LogActor::Person, id);
+    if (restoredRng) { // continue the random sequence of the saved run
+        c_rng.seed = rngSeed;
+        c_rng.counter = rngCounter;
+    }
+
     // infinite loop: take bike -> ride -> deposit -> walk -> repeat
     while (true) {
-        // 1. try to take a bike of preferred type from current site
-        Bike* bike = takeBikeFromSite(currentSite);
-        if (!bike) { // simulation ending
-            log(QString("Person %1: simulation ending, exiting").arg(id));
-            return; // exit thread
-        }
+        // Consistent point for a checkpoint: the members describe the person
+        rngSeed = c_rng.seed;
+        rngCounter = c_rng.counter;
+        globalGate.safePoint();
 
-        // 2. choose another site to go to
-        unsigned int siteJ = chooseOtherSite(currentSite);
-        bikeTo(siteJ, bike); // travel by bike
+        switch (phase) {
+        case Phase::Taking: {
+            // 1. try to take a bike of preferred type from current site
+            uint64_t asked = TripLatency::nowUs();
+            bike = takeBikeFromSite(currentSite);
+            if (!bike) { // simulation ending
+                log(LogEvent::PersonExiting);
+                globalGate.leave();
+                return; // exit thread
+            }
+            tripOrigin = currentSite;
+            tripBeginUs = asked;
+            if (columnarExporter) tripStart = columnarExporter->elapsedMs();
+            // 2. choose another site to go to (may follow a return bonus)
+            destination = chooseDestination(currentSite, true);
+            globalTripLatency.record(TripPhase::WaitBike, tripOrigin, destination,
+                                     TripLatency::nowUs() - asked);
+            phase = Phase::Riding;
+            break;
+        }
 
-        // 3. deposit bike at destination
-        depositBikeAtSite(siteJ, bike);
+        case Phase::Riding: {
+            uint64_t start = TripLatency::nowUs();
+            bikeTo(destination, bike); // travel by bike
+            globalTripLatency.record(TripPhase::Ride, tripOrigin, currentSite,
+                                     TripLatency::nowUs() - start);
+            wearBike(bike);            // may break during the trip
+            phase = Phase::Depositing;
+            break;
+        }
 
-        // 4. choose another site to walk to
-        unsigned int siteK = chooseOtherSite(siteJ);
-        walkTo(siteK); // travel by walking
+        case Phase::Depositing: {
+            // 3. deposit bike at destination
+            size_t type = bike->bikeType; // the bike belongs to the station once docked
+            uint64_t start = TripLatency::nowUs();
+            depositBikeAtSite(currentSite, bike);
+            uint64_t docked = TripLatency::nowUs();
+            globalTripLatency.record(TripPhase::WaitDock, tripOrigin, currentSite, docked - start);
+            if (tripOrigin < NB_SITES_TOTAL) {
+                globalTripLatency.record(TripPhase::Trip, tripOrigin, currentSite, docked - tripBeginUs);
+                if (columnarExporter)
+                    columnarExporter->recordTrip(tripStart, tripOrigin, currentSite, type);
+            }
+            bike = nullptr;
+            // 4. choose another site to walk to (may follow a take bonus)
+            destination = chooseDestination(currentSite, false);
+            phase = Phase::Walking;
+            break;
+        }
 
+        case Phase::Walking: {
+            unsigned int from = currentSite;
+            uint64_t start = TripLatency::nowUs();
+            walkTo(destination); // travel by walking
+            globalTripLatency.record(TripPhase::Walk, from, currentSite, TripLatency::nowUs() - start);
+            phase = Phase::Taking;
+            break;
+        }
+        }
         // loop repeats indefinitely
     }
 }
 
+// State saved in a checkpoint (simulation paused)
+CheckpointRider Person::checkpointState() const {
+    CheckpointRider record{};
+    record.id = id;
+    record.site = currentSite;
+    record.destination = destination;
+    record.phase = (uint8_t)phase;
+    record.preferredType = preferredType;
+    record.hasBike = bike != nullptr;
+    if (bike) record.bike = checkpointBike(*bike);
+    record.rngSeed = rngSeed;
+    record.rngCounter = rngCounter;
+    return record;
+}
+
+unsigned int Person::identifier() const {
+    return id;
+}
+
+unsigned int Person::site() const {
+    return currentSite;
+}
+
 // Take a bike from a specific site
 Bike* Person::takeBikeFromSite(unsigned int _site) {
     Bike* bike = stations[_site]->getBike(preferredType); // may block if no bike available
@@ -76,8 +167,7 @@ Bike* Person::takeBikeFromSite(unsigned int _site) {
         binkingInterface->setBikes(_site, stations[_site]->nbBikes());
     }
 
-    log(QString("Person %1: took bike type %2 from site %3")
-        .arg(id).arg(preferredType).arg(_site));
+    log(LogEvent::PersonTookBike, preferredType, _site);
 
     return bike;
 }
@@ -85,37 +175,90 @@ Bike* Person::takeBikeFromSite(unsigned int _site) {
 // Deposit a bike at a specific site
 void Person::depositBikeAtSite(unsigned int _site, Bike* _bike) {
     stations[_site]->putBike(_bike); // may block if station full
+    globalMetrics.tripsCompleted.fetch_add(1, std::memory_order_relaxed);
 
     // update GUI with new bike count
     if (binkingInterface) {
         binkingInterface->setBikes(_site, stations[_site]->nbBikes());
     }
 
-    log(QString("Person %1: deposited bike at site %2")
-        .arg(id).arg(_site));
+    log(LogEvent::PersonDeposited, _site);
 }
 
 // Travel by bike to a destination
 void Person::bikeTo(unsigned int _dest, Bike* _bike) {
-    unsigned int t = bikeTravelTime(); // compute travel time
+    unsigned int t = scaledMs(bikeTravelTime()); // compute travel time
+    globalTrace.move(TraceKind::Ride, currentSite, _dest, t);
     if (binkingInterface) {
         binkingInterface->travel(id, currentSite, _dest, t); // GUI animation
+    } else {
+        sleepMs(t); // headless
     }
     currentSite = _dest; // update current site
 }
 
+// Wear the bike after a trip, it may break
+void Person::wearBike(Bike* _bike) {
+    _bike->wear += WEAR_PER_TRIP;
+
+    double p = std::min(1.0, _bike->wear * BREAKDOWN_PROBABILITY_PER_WEAR);
+    std::bernoulli_distribution breaks(p);
+    if (breaks(c_rng)) {
+        _bike->broken = true; // still docked, but nobody can take it
+        globalMetrics.bikeBroken();
+        log(LogEvent::PersonBikeBroke, 0, 0, LogLevel::Warning);
+    }
+}
+
 // Travel by walking to a destination
 void Person::walkTo(unsigned int _dest) {
-    unsigned int t = walkTravelTime(); // compute walking time
+    unsigned int t = scaledMs(walkTravelTime()); // compute walking time
+    globalTrace.move(TraceKind::Walk, currentSite, _dest, t);
     if (binkingInterface) {
         binkingInterface->walk(id, currentSite, _dest, t); // GUI animation
+    } else {
+        sleepMs(t); // headless
     }
     currentSite = _dest; // update current site
 }
 
 // Choose a random site that is different from _from
 unsigned int Person::chooseOtherSite(unsigned int _from) const {
-    return randomSiteExcept(NBSITES, _from);
+    // Avoid closed stations, unless (nearly) all of them are closed
+    unsigned int site = randomSiteExcept(NBSITES, _from);
+    for (unsigned int tries = 1; tries < NBSITES && !stations[site]->isOpen(); ++tries) {
+        site = randomSiteExcept(NBSITES, _from);
+    }
+    return site;
+}
+
+// Pick the intended site, then let bonuses compete with the extra distance
+unsigned int Person::chooseDestination(unsigned int _from, bool _returning) const {
+    unsigned int intended = chooseOtherSite(_from);
+    if (!INCENTIVES_ENABLED)
+        return intended;
+
+    auto bonusAt = [&](unsigned int s) {
+        return _returning ? stations[s]->returnBonus() : stations[s]->takeBonus();
+    };
+
+    unsigned int best = intended;
+    double bestScore = bonusAt(intended);
+    for (unsigned int s = 0; s < NBSITES; ++s) {
+        if (s == _from || s == intended || !stations[s]->isOpen()) continue;
+        double detour = siteDistance(s, intended, NBSITES, NBDEPOTS);
+        double score = bonusAt(s) - INCENTIVE_POINTS_PER_UNIT * detour;
+        if (score > bestScore) {
+            bestScore = score;
+            best = s;
+        }
+    }
+
+    if (best != intended) {
+        globalMetrics.incentivesAccepted.fetch_add(1, std::memory_order_relaxed);
+        globalMetrics.bonusPointsPaid.fetch_add(bonusAt(best), std::memory_order_relaxed);
+    }
+    return best;
 }
 
 // Random travel time for bike (ms)
@@ -128,9 +271,7 @@ unsigned int Person::walkTravelTime() const {
     return randomTravelTimeMs() + 2000; // add minimum time
 }
 
-// Log a message to the console (if GUI exists)
-void Person::log(const QString& msg) const {
-    if (binkingInterface) {
-        binkingInterface->consoleAppendText(id, msg);
-    }
+// Log a structured event (formatted later by the log sinks)
+void Person::log(LogEvent _event, uint32_t _a0, uint32_t _a1, LogLevel _level) const {
+    globalEventLog.log(_level, LogActor::Person, id, _event, _a0, _a1);
 }
@@ -0,0 +1,214 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "rebalanceoptimizer.h"
+#include "mincostflow.h"
+#include "simtime.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <pcosynchro/pcothread.h>
+
+// Integer cost model: benefits are quantized on a fixed number of levels,
+// which bounds the number of solver phases whatever the demand scale
+static const double  BENEFIT_LEVELS = 40.0;  // benefit of the first bike at the busiest site
+static const double  MISS_WEIGHT    = 2.0;   // a waiting rider counts more than a served one
+static const int64_t FIRST_BONUS    = 4;     // keep at least one bike of each type
+static const int64_t STAY_BONUS     = 1;     // a bike that does not move costs nothing
+static const double  EMPTY_WEIGHT   = 1.0;   // demand of a type missing all the time counts double
+static const double  FULL_DOCKS     = 2.0;   // free docks added at a site full all the time
+static const unsigned int SLEEP_SLICE_MS = 100;
+
+RebalanceOptimizer::RebalanceOptimizer(const std::array<BikeStation*, NB_SITES_TOTAL>& _stations)
+    : stations(_stations), sites(NBSITES), lastAvailability(NBSITES), targets(NBSITES)
+{
+    // Start from a uniform prior so the first solution spreads the fleet
+    for (SiteState& site : sites) {
+        site.takeRate.fill(1.0);
+        site.returnRate.fill(1.0);
+    }
+}
+
+// Main loop of the optimizer thread
+void RebalanceOptimizer::run() {
+    while (!stopRequested) {
+        optimizeOnce();
+
+        // sleep by small slices so a stop request is handled quickly, at
+        // least one slice so that compressed time does not spin
+        unsigned int period = std::max(scaledMs(OPTIMIZER_PERIOD_MS), SLEEP_SLICE_MS);
+        for (unsigned int slept = 0; slept < period && !stopRequested; slept += SLEEP_SLICE_MS) {
+            PcoThread::usleep(SLEEP_SLICE_MS * 1000);
+        }
+    }
+}
+
+void RebalanceOptimizer::requestStop() {
+    stopRequested = true;
+}
+
+bool RebalanceOptimizer::hasTargets() const {
+    mutex.lock();
+    bool result = published;
+    mutex.unlock();
+    return result;
+}
+
+RebalanceOptimizer::SiteTarget RebalanceOptimizer::target(unsigned int _site) const {
+    mutex.lock();
+    SiteTarget result = targets[_site];
+    mutex.unlock();
+    return result;
+}
+
+// Collect demand and availability from the stations, smooth them and publish new targets
+void RebalanceOptimizer::optimizeOnce() {
+    uint64_t now = BikeStation::availabilityClockNs(); // same instant for every site
+    for (size_t s = 0; s < NBSITES; ++s) {
+        DemandCounters d = stations[s]->collectDemand();
+        SiteState& site = sites[s];
+        site.capacity = stations[s]->nbSlots();
+
+        // shares of the period spent empty or full
+        StationAvailability a = stations[s]->availability(now);
+        StationAvailability& last = lastAvailability[s];
+        double period = a.elapsedNs > last.elapsedNs ? (double)(a.elapsedNs - last.elapsedNs) : 0.0;
+        auto share = [period](uint64_t _now, uint64_t _before) {
+            return period > 0.0 ? std::min(1.0, (_now - _before) / period) : 0.0;
+        };
+
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            site.takeRate[t]   += OPTIMIZER_SMOOTHING * (d.taken[t]    - site.takeRate[t]);
+            site.returnRate[t] += OPTIMIZER_SMOOTHING * (d.returned[t] - site.returnRate[t]);
+            site.missRate[t]   += OPTIMIZER_SMOOTHING * (d.missed[t]   - site.missRate[t]);
+            site.emptyShare[t] += OPTIMIZER_SMOOTHING * (share(a.emptyNs[t], last.emptyNs[t])
+                                                         - site.emptyShare[t]);
+            site.bikes[t] = stations[s]->countBikesOfType(t);
+        }
+        site.fullShare += OPTIMIZER_SMOOTHING * (share(a.fullNs, last.fullNs) - site.fullShare);
+        last = a;
+    }
+
+    // all depots are pooled into a single depot node
+    std::array<size_t, Bike::nbBikeTypes> depotStock{};
+    for (size_t d = DEPOT_ID; d < NB_SITES_TOTAL; ++d) {
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            depotStock[t] += stations[d]->countBikesOfType(t);
+        }
+    }
+
+    std::vector<SiteTarget> result = computeTargets(sites, depotStock);
+
+    // stations derive their rider bonuses from the new totals
+    for (size_t s = 0; s < NBSITES; ++s) {
+        size_t total = 0;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t)
+            total += result[s][t];
+        stations[s]->setTargetLevel(total);
+    }
+
+    mutex.lock();
+    targets.swap(result);
+    published = true;
+    mutex.unlock();
+}
+
+// Weighted demand for a type at a site
+static double demandOf(const RebalanceOptimizer::SiteState& _site, size_t _type) {
+    return (_site.takeRate[_type] + MISS_WEIGHT * _site.missRate[_type])
+           * (1.0 + EMPTY_WEIGHT * _site.emptyShare[_type]);
+}
+
+// Build and solve the min-cost-flow problem
+//
+//   source -> type t            (capacity: fleet of type t)
+//   type t -> site s            (convex arc, k-th unit costs -benefit of the k-th bike)
+//   type t -> depot -> sink     (cost 0, absorbs the bikes nobody needs)
+//   site s -> sink              (capacity: docks minus the free docks to keep)
+std::vector<RebalanceOptimizer::SiteTarget>
+RebalanceOptimizer::computeTargets(const std::vector<SiteState>& _sites,
+                                   const std::array<size_t, Bike::nbBikeTypes>& _depotStock) {
+    const size_t nbTypes = Bike::nbBikeTypes;
+    const size_t source = 0;
+    const size_t sink = 1;
+    const size_t firstType = 2;
+    const size_t depot = firstType + nbTypes;
+    const size_t firstSite = depot + 1;
+
+    MinCostFlow graph(firstSite + _sites.size());
+
+    std::array<int64_t, Bike::nbBikeTypes> fleet{};
+    for (size_t t = 0; t < nbTypes; ++t) {
+        fleet[t] = _depotStock[t];
+        for (const SiteState& site : _sites) {
+            fleet[t] += site.bikes[t];
+        }
+    }
+
+    int64_t totalFleet = 0;
+    for (size_t t = 0; t < nbTypes; ++t) {
+        graph.addArc(source, firstType + t, fleet[t], 0);
+        graph.addArc(firstType + t, depot, fleet[t], 0);
+        totalFleet += fleet[t];
+    }
+    graph.addArc(depot, sink, totalFleet, 0);
+
+    double maxDemand = 0.0;
+    for (const SiteState& site : _sites) {
+        for (size_t t = 0; t < nbTypes; ++t) {
+            maxDemand = std::max(maxDemand, demandOf(site, t));
+        }
+    }
+    double scale = (maxDemand > 0.0) ? BENEFIT_LEVELS / maxDemand : 0.0;
+
+    // arcs[s][t] is the convex arc type t -> site s (npos if none)
+    const size_t none = (size_t)-1;
+    std::vector<std::array<size_t, Bike::nbBikeTypes>> arcs(_sites.size());
+
+    for (size_t s = 0; s < _sites.size(); ++s) {
+        const SiteState& site = _sites[s];
+        arcs[s].fill(none);
+
+        // keep enough free docks for the expected net inflow of riders
+        double netInflow = 0.0;
+        for (size_t t = 0; t < nbTypes; ++t) {
+            netInflow += site.returnRate[t] - site.takeRate[t];
+        }
+        netInflow += FULL_DOCKS * site.fullShare;
+        size_t reserve = std::max(OPTIMIZER_MIN_FREE_DOCKS, (size_t)std::max(0.0, std::ceil(netInflow)));
+        size_t usable = site.capacity > reserve ? site.capacity - reserve : 0;
+        if (usable == 0) continue;
+
+        graph.addArc(firstSite + s, sink, usable, 0);
+
+        for (size_t t = 0; t < nbTypes; ++t) {
+            double demand = demandOf(site, t);
+            std::vector<int64_t> unitCosts;
+            for (size_t k = 1; k <= usable; ++k) {
+                int64_t benefit = (int64_t)std::lround(scale * demand / k);
+                if (k == 1) benefit += FIRST_BONUS;
+                if (k <= site.bikes[t]) benefit += STAY_BONUS;
+                if (benefit <= 0) break; // costs are non-decreasing in k
+                unitCosts.push_back(-benefit);
+            }
+            if (!unitCosts.empty()) {
+                arcs[s][t] = graph.addConvexArc(firstType + t, firstSite + s, std::move(unitCosts));
+            }
+        }
+    }
+
+    graph.solve(source, sink);
+
+    std::vector<SiteTarget> result(_sites.size());
+    for (size_t s = 0; s < _sites.size(); ++s) {
+        for (size_t t = 0; t < nbTypes; ++t) {
+            result[s][t] = (arcs[s][t] == none) ? 0 : graph.flowOn(arcs[s][t]);
+        }
+    }
+    return result;
+}
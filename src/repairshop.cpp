@@ -0,0 +1,110 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "repairshop.h"
+#include "config.h"
+#include "metrics.h"
+#include "simtime.h"
+#include "simgate.h"
+
+#include <algorithm>
+
+#include <pcosynchro/pcothread.h>
+
+
+RepairShop::RepairShop(BikeStation* _depot) : depot(_depot) {}
+
+// Drop broken bikes in the repair queue
+void RepairShop::submit(const std::vector<Bike*>& _bikes) {
+    if (_bikes.empty()) return;
+
+    mutex.lock();
+    for (Bike* bike : _bikes) {
+        queue.push_back(bike);
+        condWorkers.notifyOne(); // one worker per bike
+    }
+    mutex.unlock();
+}
+
+// Worker loop: take a bike, repair it, give it back to the depot
+void RepairShop::workerRun() {
+    while (true) {
+        globalGate.beginIdle(); // a checkpoint does not wait for idle workers
+        mutex.lock();
+        // Mesa-style waiting for a broken bike
+        while (!shouldEnd && queue.empty()) {
+            condWorkers.wait(&mutex);
+        }
+        if (shouldEnd) {
+            mutex.unlock();
+            globalGate.endIdle();
+            break;
+        }
+        Bike* bike = queue.front();
+        queue.pop_front();
+        held.push_back(bike);
+        repairing++;
+        mutex.unlock();
+        globalGate.endIdle();
+
+        sleepMs(scaledMs(REPAIR_TIME_MS)); // repair outside the lock
+
+        bike->wear = 0;
+        bike->broken = false;
+        repairing--;
+        globalMetrics.bikeRepaired();
+
+        // Back into the stock, not a rider return; retried while the depot is full
+        std::vector<Bike*> rejected{bike};
+        while (true) {
+            globalGate.safePoint(); // the repaired bike is still in held
+            rejected = depot->tryAddBikes(rejected);
+            if (rejected.empty() || isEnding()) break;
+            PcoThread::usleep(REPAIR_RETRY_MS * 1000);
+        }
+        if (!rejected.empty()) break; // simulation ending, the bike stays in held
+
+        mutex.lock();
+        held.erase(std::find(held.begin(), held.end(), bike));
+        mutex.unlock();
+    }
+    globalGate.leave();
+}
+
+// Wake up all workers so they can exit
+void RepairShop::ending() {
+    mutex.lock();
+    shouldEnd = true;
+    condWorkers.notifyAll();
+    mutex.unlock();
+}
+
+bool RepairShop::isEnding() const {
+    mutex.lock();
+    bool ending = shouldEnd;
+    mutex.unlock();
+    return ending;
+}
+
+size_t RepairShop::queueLength() const {
+    mutex.lock();
+    size_t length = queue.size();
+    mutex.unlock();
+    return length;
+}
+
+size_t RepairShop::inRepair() const {
+    return repairing;
+}
+
+std::vector<Bike*> RepairShop::contents() const {
+    mutex.lock();
+    std::vector<Bike*> result(queue.begin(), queue.end());
+    result.insert(result.end(), held.begin(), held.end());
+    mutex.unlock();
+    return result;
+}
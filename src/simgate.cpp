@@ -0,0 +1,90 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "simgate.h"
+
+#include <chrono>
+
+#include <pcosynchro/pcothread.h>
+
+SimulationGate globalGate;
+
+static const unsigned int QUIESCENT_POLL_US = 1000;
+
+void SimulationGate::join() {
+    mutex.lock();
+    registered++;
+    mutex.unlock();
+}
+
+void SimulationGate::leave() {
+    mutex.lock();
+    registered--;
+    mutex.unlock();
+}
+
+// Mesa-style parking until resume() or the end of the simulation
+void SimulationGate::park() {
+    mutex.lock();
+    parked++;
+    while (!shouldEnd && pausing.load(std::memory_order_relaxed)) {
+        condParked.wait(&mutex);
+    }
+    parked--;
+    mutex.unlock();
+}
+
+void SimulationGate::beginIdle() {
+    mutex.lock();
+    idle++;
+    mutex.unlock();
+}
+
+void SimulationGate::endIdle() {
+    mutex.lock();
+    idle--;
+    mutex.unlock();
+    safePoint();
+}
+
+void SimulationGate::requestPause() {
+    pausing.store(true, std::memory_order_release);
+}
+
+bool SimulationGate::waitQuiescent(const std::function<size_t()>& waiting, unsigned int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        mutex.lock();
+        bool ended = shouldEnd;
+        size_t quiet = parked + idle;
+        size_t total = registered;
+        mutex.unlock();
+
+        if (ended) return false;
+        // Waiting threads stay counted while their station is frozen
+        if (quiet + waiting() >= total) return true;
+
+        PcoThread::usleep(QUIESCENT_POLL_US);
+    }
+    return false;
+}
+
+void SimulationGate::resume() {
+    mutex.lock();
+    pausing.store(false, std::memory_order_release);
+    condParked.notifyAll();
+    mutex.unlock();
+}
+
+void SimulationGate::ending() {
+    mutex.lock();
+    shouldEnd = true;
+    pausing.store(false, std::memory_order_release);
+    condParked.notifyAll();
+    mutex.unlock();
+}
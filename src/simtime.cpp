@@ -0,0 +1,47 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "simtime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include <pcosynchro/pcothread.h>
+
+static std::atomic<double> currentSpeedFactor{1.0};
+static std::atomic<bool> timeCompressed{false};
+
+void setSpeedFactor(double _factor) {
+    if (_factor > 0) {
+        currentSpeedFactor.store(_factor, std::memory_order_relaxed);
+    }
+}
+
+double speedFactor() {
+    return currentSpeedFactor.load(std::memory_order_relaxed);
+}
+
+void setTimeCompressed(bool _compressed) {
+    timeCompressed.store(_compressed, std::memory_order_relaxed);
+}
+
+unsigned int scaledMs(unsigned int _ms) {
+    if (timeCompressed.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    return std::max(1u, (unsigned int)(_ms / speedFactor()));
+}
+
+void sleepMs(unsigned int _realMs) {
+    if (_realMs == 0) {
+        std::this_thread::yield();
+        return;
+    }
+    PcoThread::usleep((uint64_t)_realMs * 1000);
+}
@@ -0,0 +1,59 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "simulation.h"
+#include "bikestation.h"
+#include "controlserver.h"
+#include "fleetadmin.h"
+#include "rebalanceoptimizer.h"
+#include "repairshop.h"
+#include "simgate.h"
+#include "stateexporter.h"
+#include "tripfeed.h"
+#include "van.h"
+
+#include <pcosynchro/pcothread.h>
+
+std::array<BikeStation*, NB_SITES_TOTAL>* globalStations = nullptr;
+std::vector<std::unique_ptr<PcoThread>>* globalThreads = nullptr;
+RebalanceOptimizer* globalOptimizer = nullptr;
+RepairShop* globalRepairShop = nullptr;
+StateExporter* globalStateExporter = nullptr;
+ControlServer* globalControlServer = nullptr;
+FleetAdmin* globalFleetAdmin = nullptr;
+TripFeed* globalTripFeed = nullptr;
+
+// Should stop all threads and release waiting ones
+void stopSimulation() {
+    // call all thread the end one by one
+    if (globalStations) {
+        for (BikeStation* st : *globalStations)
+            st->ending();
+    }
+
+    Van::requestStop();
+
+    if (globalOptimizer)
+        globalOptimizer->requestStop();
+
+    if (globalRepairShop)
+        globalRepairShop->ending();
+
+    if (globalFleetAdmin)
+        globalFleetAdmin->ending();
+
+    if (globalTripFeed)
+        globalTripFeed->ending();
+
+    globalGate.ending(); // releases threads parked by a checkpoint
+
+    if (globalStateExporter)
+        globalStateExporter->requestStop();
+
+    if (globalControlServer)
+        globalControlServer->requestStop();
+}
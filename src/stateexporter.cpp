@@ -0,0 +1,132 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "stateexporter.h"
+#include "metrics.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <pcosynchro/pcothread.h>
+
+StateExporter::StateExporter(const std::string& _name,
+                             const std::array<BikeStation*, NB_SITES_TOTAL>& _stations)
+    : name(_name), stations(_stations) {}
+
+StateExporter::~StateExporter() {
+    if (segment) {
+        munmap(segment, sharedStateSize(NB_SITES_TOTAL));
+        shm_unlink(name.c_str());
+    }
+}
+
+bool StateExporter::open() {
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        if (errno == EEXIST) { // another run, or a crashed one: remove it by hand
+            std::fprintf(stderr, "shm_open: %s already exists\n", name.c_str());
+        } else {
+            std::perror("shm_open");
+        }
+        return false;
+    }
+
+    const size_t size = sharedStateSize(NB_SITES_TOTAL);
+    if (ftruncate(fd, size) != 0) {
+        std::perror("ftruncate");
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the segment alive
+    if (memory == MAP_FAILED) {
+        std::perror("mmap");
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // Fixed part, written once; the sequence starts even (consistent)
+    segment = new (memory) SharedStateHeader();
+    segment->magic = SHARED_STATE_MAGIC;
+    segment->version = SHARED_STATE_VERSION;
+    segment->nbSites = NB_SITES_TOTAL;
+    segment->nbDepots = NBDEPOTS;
+    segment->nbTypes = Bike::nbBikeTypes;
+    segment->sequence.store(0, std::memory_order_release);
+    return true;
+}
+
+// Called by the vans
+void StateExporter::setVanPosition(unsigned int _vanId, unsigned int _from, unsigned int _to,
+                                   size_t _cargo) {
+    if (_vanId >= SHARED_STATE_MAX_VANS) return;
+
+    vans[_vanId].from.store(_from, std::memory_order_relaxed);
+    vans[_vanId].to.store(_to, std::memory_order_relaxed);
+    vans[_vanId].cargo.store(_cargo, std::memory_order_relaxed);
+
+    uint32_t known = nbVans.load(std::memory_order_relaxed);
+    while (known <= _vanId && !nbVans.compare_exchange_weak(known, _vanId + 1)) {}
+}
+
+// Seqlock write side, single writer
+void StateExporter::publish() {
+    static const auto start = std::chrono::steady_clock::now();
+
+    // Gather first so the odd window stays as short as possible
+    SharedStationState states[NB_SITES_TOTAL];
+    for (size_t s = 0; s < NB_SITES_TOTAL; ++s) {
+        StationCounts counts = stations[s]->counts();
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            states[s].bikes[t] = counts.bikes[t];
+        }
+        states[s].broken = counts.broken;
+        states[s].slots = stations[s]->nbSlots();
+        states[s].waitingTakers = counts.waitingTakers;
+        states[s].waitingPutters = counts.waitingPutters;
+    }
+
+    uint64_t seq = segment->sequence.load(std::memory_order_relaxed);
+    segment->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    segment->timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::steady_clock::now() - start).count();
+    segment->tripsCompleted = globalMetrics.tripsCompleted.load(std::memory_order_relaxed);
+    segment->riderWaits = globalMetrics.riderWaits.load(std::memory_order_relaxed);
+    segment->breakdowns = globalMetrics.breakdowns.load(std::memory_order_relaxed);
+    segment->repairs = globalMetrics.repairs.load(std::memory_order_relaxed);
+    segment->vanDistanceMilli = globalMetrics.vanDistanceMilli.load(std::memory_order_relaxed);
+    segment->nbVans = nbVans.load(std::memory_order_relaxed);
+    for (size_t v = 0; v < SHARED_STATE_MAX_VANS; ++v) {
+        segment->vans[v] = {vans[v].from.load(std::memory_order_relaxed),
+                            vans[v].to.load(std::memory_order_relaxed),
+                            vans[v].cargo.load(std::memory_order_relaxed)};
+    }
+    std::memcpy(reinterpret_cast<SharedStationState*>(segment + 1), states, sizeof(states));
+
+    segment->sequence.store(seq + 2, std::memory_order_release);
+}
+
+void StateExporter::run() {
+    while (!stopRequested.load()) {
+        publish();
+        PcoThread::usleep(EXPORT_PERIOD_MS * 1000);
+    }
+    publish(); // final state
+}
+
+void StateExporter::requestStop() {
+    stopRequested = true;
+}
@@ -0,0 +1,168 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "tracereplayer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <pcosynchro/pcothread.h>
+
+static const int64_t MAX_SLEEP_US = 50000;
+
+TraceReplayer::TraceReplayer(const TraceReader& _trace)
+    : trace(_trace), replayed(_trace.nbSites(), nullptr) {}
+
+TraceReplayer::~TraceReplayer() {
+    for (BikeStation* station : replayed) {
+        delete station;
+    }
+}
+
+void TraceReplayer::setObserver(std::function<void(const TraceRecord&)> _observer) {
+    observer = std::move(_observer);
+}
+
+void TraceReplayer::setSpeed(double _speed) {
+    speed = _speed;
+}
+
+// Reuse a bike that left the stations, or make a new one
+Bike* TraceReplayer::takeLoose(size_t _type) {
+    if (!loose[_type].empty()) {
+        Bike* bike = loose[_type].back();
+        loose[_type].pop_back();
+        return bike;
+    }
+    bikes.push_back(std::make_unique<Bike>());
+    bikes.back()->bikeType = _type;
+    return bikes.back().get();
+}
+
+// Same station operation as in the recorded run
+bool TraceReplayer::apply(const TraceRecord& _record) {
+    if (_record.kind == TraceKind::StationInit) {
+        if (replayed[_record.site]) return false;
+        auto* station = new BikeStation(_record.value);
+        std::vector<Bike*> initial;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            for (uint32_t k = 0; k < _record.bikes[t]; ++k) initial.push_back(takeLoose(t));
+        }
+        for (uint32_t k = 0; k < _record.broken; ++k) {
+            initial.push_back(takeLoose(0));
+            initial.back()->broken = true;
+        }
+        replayed[_record.site] = station;
+        return station->tryAddBikes(initial).empty();
+    }
+
+    BikeStation* station = replayed[_record.site];
+    if (!station) return false;
+
+    switch (_record.kind) {
+    case TraceKind::Take: {
+        if (_record.value >= Bike::nbBikeTypes || station->countBikesOfType(_record.value) == 0)
+            return false;
+        loose[_record.value].push_back(station->getBike(_record.value));
+        return true;
+    }
+    case TraceKind::Put: {
+        if (_record.value >= Bike::nbBikeTypes || station->nbBikes() >= station->nbSlots())
+            return false;
+        Bike* bike = takeLoose(_record.value);
+        bike->broken = _record.broken != 0;
+        station->putBike(bike);
+        return true;
+    }
+    case TraceKind::Add: {
+        std::vector<Bike*> added;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            for (uint32_t k = 0; k < _record.bikes[t]; ++k) added.push_back(takeLoose(t));
+        }
+        for (uint32_t k = 0; k < _record.broken; ++k) { // the type of a broken bike is not traced
+            added.push_back(takeLoose(0));
+            added.back()->broken = true;
+        }
+        std::vector<Bike*> rejected = station->tryAddBikes(added);
+        for (Bike* bike : rejected) {
+            bike->broken = false;
+            loose[bike->bikeType].push_back(bike);
+        }
+        return rejected.empty();
+    }
+    case TraceKind::Remove: {
+        std::array<size_t, Bike::nbBikeTypes> quotas;
+        size_t wanted = 0;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            quotas[t] = _record.bikes[t];
+            wanted += quotas[t];
+        }
+        std::vector<Bike*> removed = station->getBikes(quotas);
+        for (Bike* bike : removed) loose[bike->bikeType].push_back(bike);
+        return removed.size() == wanted;
+    }
+    case TraceKind::RemoveBroken: {
+        std::vector<Bike*> removed = station->getBrokenBikes(_record.value);
+        for (Bike* bike : removed) {
+            bike->broken = false;
+            loose[bike->bikeType].push_back(bike);
+        }
+        return removed.size() == _record.value;
+    }
+    default:
+        return true; // moves change no station
+    }
+}
+
+bool TraceReplayer::step() {
+    const std::vector<TraceRecord>& records = trace.records();
+    if (next >= records.size()) return false;
+
+    const TraceRecord& record = records[next++];
+    if (!apply(record) && record.timeNs < trace.exactUntilNs()) {
+        mismatchCount++; // past a gap, the missing records explain it
+    }
+    if (observer) observer(record);
+    return true;
+}
+
+// Replay loop, paced on the recorded times
+void TraceReplayer::run() {
+    const std::vector<TraceRecord>& records = trace.records();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t firstNs = next < records.size() ? records[next].timeNs : 0;
+
+    while (!stopRequested.load() && next < records.size()) {
+        if (speed > 0) {
+            auto due = start + std::chrono::nanoseconds(
+                                   (uint64_t)((records[next].timeNs - firstNs) / speed));
+            auto now = std::chrono::steady_clock::now();
+            if (due > now) { // sleep in slices to notice a stop request
+                auto wait = std::chrono::duration_cast<std::chrono::microseconds>(due - now).count();
+                PcoThread::usleep(std::min<int64_t>(wait, MAX_SLEEP_US));
+                continue;
+            }
+        }
+        step();
+    }
+}
+
+void TraceReplayer::requestStop() {
+    stopRequested = true;
+}
+
+const std::vector<BikeStation*>& TraceReplayer::stations() const {
+    return replayed;
+}
+
+size_t TraceReplayer::position() const {
+    return next;
+}
+
+size_t TraceReplayer::mismatches() const {
+    return mismatchCount;
+}
@@ -0,0 +1,387 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "tripfeed.h"
+#include "bikinginterface.h"
+#include "columnarexporter.h"
+#include "eventtrace.h"
+#include "metrics.h"
+#include "simtime.h"
+#include "triplatency.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pcosynchro/pcothread.h>
+
+BikingInterface* TripFeed::binkingInterface = nullptr;
+ColumnarExporter* TripFeed::columnarExporter = nullptr;
+
+static const size_t RELEASE_BYTES = 16 << 20;   // pages given back at a time
+static const unsigned int MAX_SLEEP_US = 50000; // the feed notices ending() this fast
+
+// Without surrounding blanks and quotes
+static std::string_view trim(std::string_view _text) {
+    while (!_text.empty() && (_text.front() == ' ' || _text.front() == '\t')) _text.remove_prefix(1);
+    while (!_text.empty() && (_text.back() == ' ' || _text.back() == '\t' || _text.back() == '\r'))
+        _text.remove_suffix(1);
+    if (_text.size() >= 2 && _text.front() == '"' && _text.back() == '"') {
+        _text = _text.substr(1, _text.size() - 2);
+    }
+    return _text;
+}
+
+// Unsigned decimal number, false if empty or not a number
+static bool parseUnsigned(std::string_view _text, uint64_t& _value) {
+    if (_text.empty()) return false;
+    _value = 0;
+    for (char c : _text) {
+        if (c < '0' || c > '9') return false;
+        _value = _value * 10 + (c - '0');
+    }
+    return true;
+}
+
+// Days since 1970-01-01 of a civil date (proleptic Gregorian calendar)
+static int64_t daysFromCivil(int64_t _y, unsigned int _m, unsigned int _d) {
+    _y -= _m <= 2;
+    const int64_t era = (_y >= 0 ? _y : _y - 399) / 400;
+    const unsigned int yoe = (unsigned int)(_y - era * 400);
+    const unsigned int doy = (153 * (_m + (_m > 2 ? -3 : 9)) + 2) / 5 + _d - 1;
+    const unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+// Unix seconds (with fraction) or "YYYY-MM-DD HH:MM:SS[.fff]", in ms
+static bool parseTime(std::string_view _text, int64_t& _ms) {
+    uint64_t fraction = 0, scale = 1;
+    size_t dot = _text.find('.');
+    if (dot != std::string_view::npos) {
+        std::string_view digits = _text.substr(dot + 1);
+        if (!digits.empty() && digits.back() == 'Z') digits.remove_suffix(1);
+        digits = digits.substr(0, 3);
+        if (!parseUnsigned(digits, fraction)) return false;
+        for (size_t i = 0; i < digits.size(); ++i) scale *= 10;
+        _text = _text.substr(0, dot);
+    } else if (!_text.empty() && _text.back() == 'Z') {
+        _text.remove_suffix(1);
+    }
+    int64_t fractionMs = (int64_t)(fraction * 1000 / scale);
+
+    if (_text.size() == 19 && _text[4] == '-' && _text[7] == '-' && _text[13] == ':' && _text[16] == ':'
+        && (_text[10] == ' ' || _text[10] == 'T')) {
+        uint64_t y, mo, d, h, mi, s;
+        if (!parseUnsigned(_text.substr(0, 4), y) || !parseUnsigned(_text.substr(5, 2), mo)
+            || !parseUnsigned(_text.substr(8, 2), d) || !parseUnsigned(_text.substr(11, 2), h)
+            || !parseUnsigned(_text.substr(14, 2), mi) || !parseUnsigned(_text.substr(17, 2), s)
+            || mo < 1 || mo > 12 || d < 1 || d > 31) {
+            return false;
+        }
+        int64_t seconds = daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+        _ms = seconds * 1000 + fractionMs;
+        return true;
+    }
+
+    uint64_t seconds;
+    if (!parseUnsigned(_text, seconds)) return false;
+    _ms = (int64_t)seconds * 1000 + fractionMs;
+    return true;
+}
+
+bool parseTripColumns(const char* _text, TripColumns& _columns) {
+    std::vector<uint64_t> values;
+    std::string_view text(_text);
+    while (true) {
+        size_t comma = text.find(',');
+        uint64_t value;
+        if (!parseUnsigned(trim(text.substr(0, comma)), value) || value >= 16) return false;
+        values.push_back(value);
+        if (comma == std::string_view::npos) break;
+        text.remove_prefix(comma + 1);
+    }
+    if (values.size() != 4 && values.size() != 5) return false;
+
+    _columns.start = values[0];
+    _columns.origin = values[1];
+    _columns.destination = values[2];
+    _columns.type = values[3];
+    _columns.end = values.size() == 5 ? (long)values[4] : -1;
+    return true;
+}
+
+TripReader::TripReader() {}
+
+TripReader::~TripReader() {
+    if (data) munmap((void*)data, size);
+}
+
+bool TripReader::open(const std::string& _tripsPath, const std::string& _mapPath,
+                      const TripColumns& _columns, std::string& _error) {
+    columns = _columns;
+
+    // Station table, small: read in memory, the keys point into it
+    std::ifstream mapFile(_mapPath);
+    if (!mapFile) {
+        _error = _mapPath + ": " + std::strerror(errno);
+        return false;
+    }
+    std::stringstream content;
+    content << mapFile.rdbuf();
+    mapText = content.str();
+
+    std::string_view text(mapText);
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        std::string_view line = text.substr(0, newline);
+        text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+
+        size_t comma = line.find(',');
+        if (line.empty() || line[0] == '#' || comma == std::string_view::npos) continue;
+        uint64_t site;
+        if (!parseUnsigned(trim(line.substr(comma + 1)), site)) continue; // header
+        if (site >= NBSITES) {
+            _error = _mapPath + ": site " + std::to_string(site) + " out of range";
+            return false;
+        }
+        sites[trim(line.substr(0, comma))] = site;
+    }
+    if (sites.empty()) {
+        _error = _mapPath + ": no station";
+        return false;
+    }
+
+    // Trip file: mapped, read once from start to end
+    int fd = ::open(_tripsPath.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        _error = _tripsPath + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    size = info.st_size;
+    void* memory = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        _error = _tripsPath + ": empty or unreadable";
+        size = 0;
+        return false;
+    }
+    madvise(memory, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(memory);
+    return true;
+}
+
+// Quoted fields may contain commas; quotes are not unescaped
+size_t TripReader::splitLine() {
+    size_t count = 0;
+    while (cursor < size) {
+        size_t begin = cursor;
+        if (data[cursor] == '"') {
+            ++cursor;
+            while (cursor < size && !(data[cursor] == '"' && (cursor + 1 >= size || data[cursor + 1] != '"'))) {
+                cursor += data[cursor] == '"' ? 2 : 1;
+            }
+            ++cursor;
+        }
+        while (cursor < size && data[cursor] != ',' && data[cursor] != '\n') ++cursor;
+        if (count < fields.size()) {
+            fields[count++] = trim(std::string_view(data + begin, std::min(cursor, size) - begin));
+        }
+        if (cursor >= size || data[cursor++] == '\n') break;
+    }
+    return count;
+}
+
+bool TripReader::next(Trip& _trip) {
+    const size_t needed = std::max({columns.start, columns.origin, columns.destination, columns.type,
+                                    (size_t)std::max(columns.end, 0L)}) + 1;
+
+    while (cursor < size) {
+        // Pages behind the cursor will not be read again
+        if (cursor - released >= 2 * RELEASE_BYTES) {
+            madvise((void*)(data + released), RELEASE_BYTES, MADV_DONTNEED);
+            released += RELEASE_BYTES;
+        }
+
+        ++lineNumber;
+        size_t count = splitLine();
+        if (count == 1 && fields[0].empty()) continue; // blank line
+
+        int64_t startMs, endMs = 0;
+        if (count < needed || !parseTime(fields[columns.start], startMs)
+            || (columns.end >= 0 && !parseTime(fields[columns.end], endMs))) {
+            if (lineNumber > 1) malformedLines++; // else a header
+            continue;
+        }
+
+        auto origin = sites.find(fields[columns.origin]);
+        auto destination = sites.find(fields[columns.destination]);
+        if (origin == sites.end() || destination == sites.end()) {
+            unmappedLines++;
+            continue;
+        }
+
+        uint64_t type;
+        if (!parseUnsigned(fields[columns.type], type)) {
+            auto name = typeNames.emplace(fields[columns.type], typeNames.size()).first;
+            type = name->second;
+        }
+
+        _trip.startMs = startMs;
+        _trip.rideMs = columns.end >= 0 ? (uint32_t)std::max<int64_t>(0, endMs - startMs)
+                                        : TRIP_DEFAULT_RIDE_S * 1000;
+        _trip.origin = origin->second;
+        _trip.destination = destination->second;
+        _trip.bikeType = type % Bike::nbBikeTypes;
+        return true;
+    }
+    return false;
+}
+
+uint64_t TripReader::unmapped() const {
+    return unmappedLines;
+}
+
+uint64_t TripReader::malformed() const {
+    return malformedLines;
+}
+
+TripFeed::TripFeed(std::array<BikeStation*, NB_SITES_TOTAL> _stations) : stations(_stations) {}
+
+bool TripFeed::open(const std::string& _tripsPath, const std::string& _mapPath,
+                    const TripColumns& _columns, std::string& _error) {
+    return reader.open(_tripsPath, _mapPath, _columns, _error);
+}
+
+void TripFeed::setSpeed(double _speed) {
+    speed = _speed;
+}
+
+void TripFeed::setInterface(BikingInterface* _binkingInterface) {
+    binkingInterface = _binkingInterface;
+}
+
+void TripFeed::setColumnarExporter(ColumnarExporter* _columnarExporter) {
+    columnarExporter = _columnarExporter;
+}
+
+// Feed thread: trips are handed out at their recorded time
+void TripFeed::run() {
+    auto start = std::chrono::steady_clock::now();
+    int64_t firstMs = 0;
+    uint64_t trips = 0;
+    Trip trip;
+
+    while (reader.next(trip)) {
+        if (trips++ == 0) firstMs = trip.startMs;
+
+        if (speed > 0) {
+            auto due = start + std::chrono::microseconds((int64_t)((trip.startMs - firstMs) * 1000 / speed));
+            while (true) {
+                auto now = std::chrono::steady_clock::now();
+                mutex.lock();
+                bool stopping = shouldEnd;
+                mutex.unlock();
+                if (stopping || due <= now) break;
+                auto wait = std::chrono::duration_cast<std::chrono::microseconds>(due - now).count();
+                PcoThread::usleep(std::min<int64_t>(wait, MAX_SLEEP_US));
+            }
+        }
+
+        mutex.lock();
+        // Mesa-style waiting for a free place (riders all busy)
+        while (!shouldEnd && queue.size() >= TRIP_QUEUE_CAPACITY) {
+            condFeed.wait(&mutex);
+        }
+        if (shouldEnd) {
+            mutex.unlock();
+            return;
+        }
+        queue.push_back(trip);
+        condRiders.notifyOne();
+        mutex.unlock();
+    }
+
+    std::cout << "Trip file done: " << trips << " trips, " << reader.unmapped()
+              << " with an unknown station, " << reader.malformed() << " malformed lines" << std::endl;
+}
+
+// Rider thread: one recorded trip at a time
+void TripFeed::riderRun(unsigned int _riderId) {
+    globalTrace.actor((uint8_t)LogActor::Person, _riderId);
+
+    while (true) {
+        mutex.lock();
+        while (!shouldEnd && queue.empty()) {
+            condRiders.wait(&mutex);
+        }
+        if (shouldEnd) {
+            mutex.unlock();
+            return;
+        }
+        Trip trip = queue.front();
+        queue.pop_front();
+        condFeed.notifyOne();
+        mutex.unlock();
+
+        uint64_t asked = TripLatency::nowUs();
+        Bike* bike = stations[trip.origin]->getBike(trip.bikeType); // may wait for a bike
+        if (!bike) return; // simulation ending
+        uint64_t taken = TripLatency::nowUs();
+        globalTripLatency.record(TripPhase::WaitBike, trip.origin, trip.destination, taken - asked);
+        uint32_t tripStart = columnarExporter ? columnarExporter->elapsedMs() : 0;
+        if (binkingInterface) {
+            binkingInterface->setBikes(trip.origin, stations[trip.origin]->nbBikes());
+        }
+
+        unsigned int ms = speed > 0 ? (unsigned int)(trip.rideMs / speed) : 0;
+        globalTrace.move(TraceKind::Ride, trip.origin, trip.destination, ms);
+        if (ms > 0) {
+            if (binkingInterface) {
+                binkingInterface->travel(_riderId, trip.origin, trip.destination, ms);
+            } else {
+                sleepMs(ms);
+            }
+        }
+
+        uint64_t arrived = TripLatency::nowUs();
+        globalTripLatency.record(TripPhase::Ride, trip.origin, trip.destination, arrived - taken);
+        stations[trip.destination]->putBike(bike); // may wait for a free dock
+        uint64_t docked = TripLatency::nowUs();
+        globalTripLatency.record(TripPhase::WaitDock, trip.origin, trip.destination, docked - arrived);
+        globalTripLatency.record(TripPhase::Trip, trip.origin, trip.destination, docked - asked);
+        if (columnarExporter) {
+            columnarExporter->recordTrip(tripStart, trip.origin, trip.destination, trip.bikeType);
+        }
+        completedTrips.fetch_add(1, std::memory_order_relaxed);
+        globalMetrics.tripsCompleted.fetch_add(1, std::memory_order_relaxed);
+        if (binkingInterface) {
+            binkingInterface->setBikes(trip.destination, stations[trip.destination]->nbBikes());
+        }
+    }
+}
+
+void TripFeed::ending() {
+    mutex.lock();
+    shouldEnd = true;
+    condRiders.notifyAll();
+    condFeed.notifyAll();
+    mutex.unlock();
+}
+
+uint64_t TripFeed::completed() const {
+    return completedTrips.load(std::memory_order_relaxed);
+}
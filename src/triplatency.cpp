@@ -0,0 +1,250 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "triplatency.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+TripLatency globalTripLatency;
+
+static_assert(LatencyHistogram::SUB_BUCKETS == 8, "bucketOf() splits the octaves in 8");
+
+const char* tripPhaseName(TripPhase _phase) {
+    static const char* names[NB_TRIP_PHASES] = {"waitBike", "ride", "waitDock", "walk", "trip"};
+    return _phase < TripPhase::NbPhases ? names[(size_t)_phase] : "?";
+}
+
+// Octave 0 holds 0..SUB_BUCKETS-1 exactly, octave k the values with their
+// highest bit at log2(SUB_BUCKETS) + k - 1, split in SUB_BUCKETS
+size_t LatencyHistogram::bucketOf(uint64_t _us) {
+    if (_us < SUB_BUCKETS) return (size_t)_us;
+    int msb = 63 - __builtin_clzll(_us);
+    int shift = msb - 3; // log2(SUB_BUCKETS)
+    size_t bucket = (size_t)(shift + 1) * SUB_BUCKETS + (size_t)((_us >> shift) - SUB_BUCKETS);
+    return std::min(bucket, NB_BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t _bucket) {
+    if (_bucket < SUB_BUCKETS) return _bucket;
+    size_t shift = _bucket / SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(SUB_BUCKETS + _bucket % SUB_BUCKETS) << shift;
+    return low + ((uint64_t)1 << shift) / 2;
+}
+
+void LatencyHistogram::add(uint64_t _us, uint64_t _count) {
+    buckets[bucketOf(_us)] += _count;
+    total += _count;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& _other) {
+    for (size_t b = 0; b < NB_BUCKETS; ++b) buckets[b] += _other.buckets[b];
+    total += _other.total;
+}
+
+uint64_t LatencyHistogram::count() const {
+    return total;
+}
+
+uint64_t LatencyHistogram::percentile(double _q) const {
+    if (total == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(_q * total));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < NB_BUCKETS; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) return bucketValue(b);
+    }
+    return bucketValue(NB_BUCKETS - 1);
+}
+
+TripLatency::~TripLatency() {
+    for (auto& pair : pairs) delete pair.load();
+}
+
+uint64_t TripLatency::nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Slot of a pair: Fibonacci hashing, then linear probing
+static size_t slotOf(uint32_t _key, size_t _probe) {
+    return ((size_t)(_key * 0x9e3779b1u) + _probe) % TripLatency::PAIR_SLOTS;
+}
+
+TripLatency::PairHistograms* TripLatency::findOrAdd(uint32_t _key) {
+    for (size_t probe = 0; probe < PAIR_SLOTS; ++probe) {
+        std::atomic<PairHistograms*>& slot = pairs[slotOf(_key, probe)];
+        PairHistograms* histograms = slot.load(std::memory_order_acquire);
+        if (!histograms) {
+            // First trip of the pair: a slot is reserved before the
+            // allocation, so the table is never more than half full
+            if (nbPairs.load(std::memory_order_relaxed) >= MAX_PAIRS) return nullptr;
+            if (nbPairs.fetch_add(1, std::memory_order_relaxed) >= MAX_PAIRS) {
+                nbPairs.fetch_sub(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            auto* fresh = new PairHistograms(_key);
+            if (slot.compare_exchange_strong(histograms, fresh, std::memory_order_acq_rel)) {
+                return fresh;
+            }
+            // another rider took the slot first, maybe for the same pair
+            delete fresh;
+            nbPairs.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (histograms->key == _key) return histograms;
+    }
+    return nullptr;
+}
+
+const TripLatency::PairHistograms* TripLatency::find(uint32_t _key) const {
+    for (size_t probe = 0; probe < PAIR_SLOTS; ++probe) {
+        const PairHistograms* histograms = pairs[slotOf(_key, probe)].load(std::memory_order_acquire);
+        if (!histograms || histograms->key == _key) return histograms;
+    }
+    return nullptr;
+}
+
+std::vector<const TripLatency::PairHistograms*> TripLatency::usedPairs() const {
+    std::vector<const PairHistograms*> used;
+    for (const auto& slot : pairs) {
+        const PairHistograms* histograms = slot.load(std::memory_order_acquire);
+        if (histograms) used.push_back(histograms);
+    }
+    std::sort(used.begin(), used.end(), [](const PairHistograms* a, const PairHistograms* b) {
+        return a->key < b->key;
+    });
+    return used;
+}
+
+void TripLatency::record(TripPhase _phase, unsigned int _from, unsigned int _to, uint64_t _us) {
+    if (_from >= NB_SITES_TOTAL || _to >= NB_SITES_TOTAL || _phase >= TripPhase::NbPhases) return;
+
+    size_t bucket = LatencyHistogram::bucketOf(_us);
+    phases[(size_t)_phase][bucket].fetch_add(1, std::memory_order_relaxed);
+
+    PairHistograms* histograms = findOrAdd((uint32_t)(_from * NB_SITES_TOTAL + _to));
+    if (histograms) {
+        histograms->phases[(size_t)_phase][bucket].fetch_add(1, std::memory_order_relaxed);
+    } else {
+        untrackedSamples.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void TripLatency::addTo(const Counters& _counters, TripPhase _phase, LatencyHistogram& _out) {
+    const auto& counters = _counters[(size_t)_phase];
+    for (size_t b = 0; b < LatencyHistogram::NB_BUCKETS; ++b) {
+        uint32_t n = counters[b].load(std::memory_order_relaxed);
+        if (n > 0) _out.add(LatencyHistogram::bucketValue(b), n);
+    }
+}
+
+LatencyHistogram TripLatency::phase(TripPhase _phase) const {
+    LatencyHistogram histogram;
+    if (_phase < TripPhase::NbPhases) addTo(phases, _phase, histogram);
+    return histogram;
+}
+
+LatencyHistogram TripLatency::pair(TripPhase _phase, unsigned int _from, unsigned int _to) const {
+    LatencyHistogram histogram;
+    if (_from >= NB_SITES_TOTAL || _to >= NB_SITES_TOTAL || _phase >= TripPhase::NbPhases) return histogram;
+    const PairHistograms* histograms = find((uint32_t)(_from * NB_SITES_TOTAL + _to));
+    if (histograms) addTo(histograms->phases, _phase, histogram);
+    return histogram;
+}
+
+uint64_t TripLatency::untracked() const {
+    return untrackedSamples.load(std::memory_order_relaxed);
+}
+
+// One line of a table: count and percentiles in milliseconds
+static void writeRow(std::ostream& _out, const std::string& _name, const LatencyHistogram& _histogram) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-16s %10llu %10.3f %10.3f %10.3f\n", _name.c_str(),
+                  (unsigned long long)_histogram.count(), _histogram.percentile(0.50) / 1e3,
+                  _histogram.percentile(0.95) / 1e3, _histogram.percentile(0.99) / 1e3);
+    _out << line;
+}
+
+static void writeHeader(std::ostream& _out, const char* _title) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%s\n  %-16s %10s %10s %10s %10s\n", _title, "",
+                  "count", "p50 ms", "p95 ms", "p99 ms");
+    _out << line;
+}
+
+void TripLatency::report(std::ostream& _out, size_t _top) const {
+    writeHeader(_out, "=== Journey phases ===");
+    for (size_t p = 0; p < NB_TRIP_PHASES; ++p) {
+        writeRow(_out, tripPhaseName((TripPhase)p), phase((TripPhase)p));
+    }
+
+    // Slowest pairs, end to end
+    std::vector<std::pair<uint64_t, const PairHistograms*>> slowest; // p95, pair
+    for (const PairHistograms* histograms : usedPairs()) {
+        LatencyHistogram trip;
+        addTo(histograms->phases, TripPhase::Trip, trip);
+        if (trip.count() > 0) slowest.push_back({trip.percentile(0.95), histograms});
+    }
+    std::stable_sort(slowest.begin(), slowest.end(),
+                     [](const std::pair<uint64_t, const PairHistograms*>& a,
+                        const std::pair<uint64_t, const PairHistograms*>& b) {
+                         return a.first > b.first;
+                     });
+    writeHeader(_out, "Slowest trips (p95)");
+    for (size_t i = 0; i < slowest.size() && i < _top; ++i) {
+        unsigned int from = slowest[i].second->key / NB_SITES_TOTAL;
+        unsigned int to = slowest[i].second->key % NB_SITES_TOTAL;
+        writeRow(_out, std::to_string(from) + " -> " + std::to_string(to),
+                 pair(TripPhase::Trip, from, to));
+    }
+    if (untracked() > 0) {
+        _out << "  (" << untracked() << " samples of pairs beyond the first " << MAX_PAIRS
+             << " not shown)" << std::endl;
+    }
+}
+
+bool TripLatency::exportCsv(const std::string& _path, std::string& _error) const {
+    std::FILE* file = std::fopen(_path.c_str(), "w");
+    if (!file) {
+        _error = _path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    // Origin and destination are empty on the rows merging every pair
+    auto writeLine = [&](TripPhase _phase, const std::string& _from, const std::string& _to,
+                         const LatencyHistogram& _histogram) {
+        std::fprintf(file, "%s,%s,%s,%llu,%.3f,%.3f,%.3f\n", tripPhaseName(_phase), _from.c_str(),
+                     _to.c_str(), (unsigned long long)_histogram.count(),
+                     _histogram.percentile(0.50) / 1e3, _histogram.percentile(0.95) / 1e3,
+                     _histogram.percentile(0.99) / 1e3);
+    };
+    std::fprintf(file, "phase,origin,destination,count,p50_ms,p95_ms,p99_ms\n");
+    for (size_t p = 0; p < NB_TRIP_PHASES; ++p) {
+        writeLine((TripPhase)p, "", "", phase((TripPhase)p));
+    }
+    for (const PairHistograms* histograms : usedPairs()) {
+        std::string from = std::to_string(histograms->key / NB_SITES_TOTAL);
+        std::string to = std::to_string(histograms->key % NB_SITES_TOTAL);
+        for (size_t p = 0; p < NB_TRIP_PHASES; ++p) {
+            LatencyHistogram histogram;
+            addTo(histograms->phases, (TripPhase)p, histogram);
+            if (histogram.count() > 0) writeLine((TripPhase)p, from, to, histogram);
+        }
+    }
+
+    bool failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed) {
+        _error = _path + ": write error";
+        return false;
+    }
+    return true;
+}
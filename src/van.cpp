@@ -8,11 +8,21 @@
 
 
 #include "van.h"
+#include "citylayout.h"
+#include "metrics.h"
+#include "simtime.h"
+#include "simgate.h"
+#include "eventtrace.h"
+
+#include <algorithm>
 
 // Initialize static members
 BikingInterface* Van::binkingInterface = nullptr; // pointer to GUI / interface
 std::array<BikeStation*, NB_SITES_TOTAL> Van::stations{}; // all bike stations
-bool Van::stopVanRequested = false; // flag to request van stop
+RebalanceOptimizer* Van::optimizer = nullptr; // per-type targets (optional)
+RepairShop* Van::repairShop = nullptr; // receives broken bikes (optional)
+StateExporter* Van::stateExporter = nullptr; // live state export (optional)
+std::atomic<bool> Van::stopVanRequested{false}; // flag to request van stop
 
 // Constructor: sets van ID and initial site (depot)
 Van::Van(unsigned int _id)
@@ -20,21 +30,73 @@ Van::Van(unsigned int _id)
       currentSite(DEPOT_ID)
 {}
 
+// Constructor from a checkpoint: cargo stacks in saved order
+Van::Van(const CheckpointVan& _record, const std::vector<Bike*>& _cargo)
+    : id(_record.id),
+      currentSite(_record.site),
+      tourSite(_record.tourSite)
+{
+    size_t next = 0;
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        cargo[t].assign(_cargo.begin() + next, _cargo.begin() + next + _record.cargo[t]);
+        next += _record.cargo[t];
+    }
+    brokenCargo.assign(_cargo.begin() + next, _cargo.end());
+}
+
 // Main van loop
 void Van::run() {
-    while (!stopVanRequested) { // keep running until stop requested
-        loadAtDepot(); // load some bikes at the depot
+    globalTrace.actor((uint8_t)LogActor::Van, id);
+    while (!stopVanRequested && !retired) { // keep running until stop requested
+        globalGate.safePoint(); // between two tours
+        if (tourSite == NBSITES) { // not resuming a saved tour
+            loadAtDepot(); // load some bikes at the depot
+            tourSite = 0;
+        }
 
         // Visit each site to balance bikes
-        for (unsigned int s = 0; s < NBSITES; ++s) {
-            driveTo(s);       // drive to the site
-            balanceSite(s);   // balance bikes at the site
+        for (; tourSite < NBSITES; ++tourSite) {
+            globalGate.safePoint(); // consistent point for a checkpoint
+            unsigned int s = tourSite;
+            if (!stations[s]->isOpen()) continue; // closed sites are skipped
+            driveTo(s);             // drive to the site
+            collectBrokenBikes(s);  // broken bikes block slots
+            balanceSite(s);         // balance bikes at the site
         }
 
-        returnToDepot(); // return to depot to unload
+        returnToDepot(); // return to a depot to unload
+        if (!stopVanRequested)
+            rebalanceDepots(); // spread stock between depots
+        tourSite = NBSITES;
     }
 
-    log("Van stops cleanly"); // log message when loop ends
+    log(LogEvent::VanStopped); // log message when loop ends
+    globalGate.leave();
+}
+
+// State saved in a checkpoint (simulation paused)
+CheckpointVan Van::checkpointState(std::vector<Bike*>& _cargo) const {
+    CheckpointVan record{};
+    record.id = id;
+    record.site = currentSite;
+    record.tourSite = tourSite;
+    record.retired = retired;
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        _cargo.insert(_cargo.end(), cargo[t].begin(), cargo[t].end());
+        record.cargo[t] = cargo[t].size();
+    }
+    _cargo.insert(_cargo.end(), brokenCargo.begin(), brokenCargo.end());
+    record.broken = brokenCargo.size();
+    return record;
+}
+
+unsigned int Van::identifier() const {
+    return id;
+}
+
+// Leave the service at the end of the current tour
+void Van::retire() {
+    retired = true;
 }
 
 // Set the GUI / interface pointer
@@ -47,11 +109,28 @@ void Van::setStations(const std::array<BikeStation*, NB_SITES_TOTAL>& _stations)
     stations = _stations;
 }
 
-// Log a message to the console or GUI
-void Van::log(const QString& msg) const {
-    if (binkingInterface) {
-        binkingInterface->consoleAppendText(0, msg);
-    }
+// Set the optimizer shared by all vans
+void Van::setOptimizer(RebalanceOptimizer* _optimizer) {
+    optimizer = _optimizer;
+}
+
+// Set the repair shop shared by all vans
+void Van::setRepairShop(RepairShop* _repairShop) {
+    repairShop = _repairShop;
+}
+
+// Set the exporter receiving the van positions
+void Van::setStateExporter(StateExporter* _stateExporter) {
+    stateExporter = _stateExporter;
+}
+
+void Van::requestStop() {
+    stopVanRequested = true;
+}
+
+// Log a structured event (formatted later by the log sinks)
+void Van::log(LogEvent _event, uint32_t _a0, uint32_t _a1) const {
+    globalEventLog.log(LogLevel::Info, LogActor::Van, id, _event, _a0, _a1);
 }
 
 // Drive to a destination site
@@ -59,62 +138,218 @@ void Van::driveTo(unsigned int _dest) {
     if (currentSite == _dest)
         return; // already at destination
 
-    unsigned int travelTime = randomTravelTimeMs(); // random travel time
-    if (binkingInterface) {
-        binkingInterface->vanTravel(currentSite, _dest, travelTime); // GUI animation
+    // travel time proportional to the distance
+    double distance = siteDistance(currentSite, _dest, NBSITES, NBDEPOTS);
+    unsigned int travelTime = scaledMs(100 + (unsigned int)(distance * VAN_MS_PER_UNIT));
+    globalMetrics.addVanDistance(distance);
+    globalTrace.move(TraceKind::Drive, currentSite, _dest, travelTime);
+    if (stateExporter) {
+        stateExporter->setVanPosition(id, currentSite, _dest, cargoSize() + brokenCargo.size());
+    }
+    if (binkingInterface && id == 0) {
+        binkingInterface->vanTravel(currentSite, _dest, travelTime); // GUI animation (one van drawn)
+    } else {
+        sleepMs(travelTime);
     }
 
     currentSite = _dest; // update current site
+    if (stateExporter) {
+        stateExporter->setVanPosition(id, _dest, _dest, cargoSize() + brokenCargo.size());
+    }
 }
 
-// Load bikes at the depot into the van
+// Choose the nearest depot able to load / unload
+unsigned int Van::chooseDepot(bool _loading) const {
+    unsigned int best = DEPOT_ID;
+    unsigned int nearest = DEPOT_ID;
+    double bestDistance = -1.0;
+    double nearestDistance = -1.0;
+
+    for (unsigned int d = DEPOT_ID; d < NB_SITES_TOTAL; ++d) {
+        double distance = siteDistance(currentSite, d, NBSITES, NBDEPOTS);
+        if (nearestDistance < 0.0 || distance < nearestDistance) {
+            nearestDistance = distance;
+            nearest = d;
+        }
+
+        size_t stock = stations[d]->nbBikes();
+        bool usable = _loading ? stock > 0
+                               : stations[d]->nbSlots() - stock >= cargoSize();
+        if (usable && (bestDistance < 0.0 || distance < bestDistance)) {
+            bestDistance = distance;
+            best = d;
+        }
+    }
+
+    return (bestDistance < 0.0) ? nearest : best;
+}
+
+// Load bikes at a depot into the van
 void Van::loadAtDepot() {
-    driveTo(DEPOT_ID); // make sure we're at the depot
-    cargo.clear();      // empty the van cargo
+    unsigned int depotId = chooseDepot(true);
+    driveTo(depotId);   // make sure we're at the depot
 
-    BikeStation* depot = stations[DEPOT_ID];
+    BikeStation* depot = stations[depotId];
 
-    // Load at most min(2, D) bikes
-    size_t D = depot->nbBikes(); // number of bikes available
-    size_t toLoad = std::min((size_t)2, D);
+    // bikes left from a depot transfer go back to the stock, those that do
+    // not fit stay in the van
+    if (cargoSize() > 0) {
+        for (Bike* b : depot->tryAddBikes(unloadCargo()))
+            addToCargo(b);
+    }
 
-    if (toLoad > 0) {
-        // getBikes respects FIFO and wakes up waiting threads
-        std::vector<Bike*> loaded = depot->getBikes(toLoad);
-        for (Bike* b : loaded) {
-            cargo.push_back(b); // add to cargo
-        }
+    // Load the per-type mix needed along the route, keeping the space
+    // already taken by broken bikes
+    std::array<size_t, Bike::nbBikeTypes> quotas = planDepotLoad(depot);
+    size_t room = freeSpace();
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        quotas[t] = std::min(quotas[t], room);
+        room -= quotas[t];
+    }
+
+    // getBikes respects FIFO and wakes up waiting threads
+    std::vector<Bike*> loaded = depot->getBikes(quotas);
+    for (Bike* b : loaded) {
+        addToCargo(b);
     }
+    log(LogEvent::VanLoaded, depotId, loaded.size());
 
     // Update GUI to reflect new bike count at depot
     if (binkingInterface) {
-        binkingInterface->setBikes(DEPOT_ID, stations[DEPOT_ID]->nbBikes());
+        binkingInterface->setBikes(depotId, depot->nbBikes());
     }
 }
 
+// Per-type targets: optimizer result if any, otherwise capacity - 2 bikes
+// with at least one bike of each type
+bool Van::siteTarget(unsigned int _site, RebalanceOptimizer::SiteTarget& _typeTarget,
+                     unsigned int& _total) const {
+    if (optimizer && optimizer->hasTargets()) {
+        _typeTarget = optimizer->target(_site);
+        _total = 0;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t)
+            _total += _typeTarget[t];
+        return true;
+    }
+
+    _typeTarget.fill(1);
+    _total = stations[_site]->nbSlots() - 2;
+    return false;
+}
+
+// Per-type load from the deficits along the upcoming route
+std::array<size_t, Bike::nbBikeTypes> Van::planDepotLoad(BikeStation* _depot) const {
+    std::array<long, Bike::nbBikeTypes> balance{}; // cargo balance along the route
+    std::array<long, Bike::nbBikeTypes> need{};    // worst shortfall per type
+    long untypedNeed = 0;                          // deficits of any type
+
+    for (unsigned int s = 0; s < NBSITES; ++s) {
+        if (!stations[s]->isOpen()) continue; // not on the route
+
+        RebalanceOptimizer::SiteTarget typeTarget;
+        unsigned int total;
+        bool exact = siteTarget(s, typeTarget, total);
+
+        long present = 0;
+        long typedDeficit = 0;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            long count = (long)stations[s]->countBikesOfType(t);
+            long gap = count - (long)typeTarget[t];
+            present += count;
+
+            if (exact) {
+                balance[t] += gap;            // picks up surplus, drops deficit
+            } else if (gap < 0) {
+                balance[t] += gap;            // only the per-type minimums are typed
+                typedDeficit -= gap;
+            }
+            need[t] = std::max(need[t], -balance[t]);
+        }
+
+        if (!exact && present + typedDeficit < (long)total) {
+            untypedNeed += (long)total - present - typedDeficit;
+        }
+    }
+
+    std::array<size_t, Bike::nbBikeTypes> stock;
+    std::array<size_t, Bike::nbBikeTypes> want;
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        stock[t] = _depot->countBikesOfType(t);
+        want[t] = std::min((size_t)need[t], stock[t]);
+    }
+
+    // share the van fairly between types: one bike per type per round
+    std::array<size_t, Bike::nbBikeTypes> quotas{};
+    size_t loaded = 0;
+    bool progress = true;
+    while (loaded < VAN_CAPACITY && progress) {
+        progress = false;
+        for (size_t t = 0; t < Bike::nbBikeTypes && loaded < VAN_CAPACITY; ++t) {
+            if (quotas[t] < want[t]) {
+                quotas[t]++;
+                loaded++;
+                progress = true;
+            }
+        }
+    }
+
+    // untyped deficits: take from the most stocked types
+    while (loaded < VAN_CAPACITY && untypedNeed > 0) {
+        size_t best = 0;
+        for (size_t t = 1; t < Bike::nbBikeTypes; ++t) {
+            if (stock[t] - quotas[t] > stock[best] - quotas[best])
+                best = t;
+        }
+        if (stock[best] == quotas[best])
+            break; // depot empty
+        quotas[best]++;
+        loaded++;
+        untypedNeed--;
+    }
+
+    return quotas;
+}
+
 // Balance bikes at a specific site
 void Van::balanceSite(unsigned int _site)
 {
-    if (_site == DEPOT_ID) return; // skip the depot
+    if (isDepot(_site)) return; // skip the depots
 
     BikeStation* st = stations[_site];
 
-    unsigned int target = BORNES - 2; // target number of bikes per site
+    RebalanceOptimizer::SiteTarget typeTarget;
+    unsigned int target;
+    bool exact = siteTarget(_site, typeTarget, target);
+
     unsigned int Vi = st->nbBikes();   // current bikes at the site
-    unsigned int a = cargo.size();     // current bikes in the van
 
     //
     // ===== CASE 1: SURPLUS → remove bikes from the site =====
     //
     if (Vi > target) {
         unsigned int surplus = Vi - target;           // number of bikes to remove
-        unsigned int freeSpace = VAN_CAPACITY - a;   // free space in the van
-        unsigned int c = std::min(surplus, freeSpace);
+        unsigned int space = freeSpace();            // free space in the van
+        unsigned int c = std::min(surplus, space);
 
         if (c > 0) {
-            std::vector<Bike*> taken = st->getBikes(c); // take c bikes
+            std::vector<Bike*> taken;
+            if (exact) {
+                // take the types that are above their own target
+                std::array<size_t, Bike::nbBikeTypes> quotas{};
+                unsigned int planned = 0;
+                for (size_t t = 0; t < Bike::nbBikeTypes && planned < c; ++t) {
+                    size_t count = st->countBikesOfType(t);
+                    if (count > typeTarget[t]) {
+                        quotas[t] = std::min<size_t>(count - typeTarget[t], c - planned);
+                        planned += quotas[t];
+                    }
+                }
+                taken = st->getBikes(quotas);
+            } else {
+                taken = st->getBikes(c); // take c bikes
+            }
             for (Bike* b : taken)
-                cargo.push_back(b); // add to cargo
+                addToCargo(b); // add to cargo
         }
     }
 
@@ -123,7 +358,7 @@ void Van::balanceSite(unsigned int _site)
     //
     else if (Vi < target) {
         unsigned int needed = target - Vi;            // number of bikes to add
-        unsigned int a = cargo.size();
+        unsigned int a = cargoSize();
         unsigned int c = std::min(needed, a);         // number of bikes we can deposit
 
         std::vector<Bike*> toAdd;
@@ -131,26 +366,38 @@ void Van::balanceSite(unsigned int _site)
         unsigned int deposited = 0;
 
         //
-        // 2b.1 — deposit one bike of each missing type first
+        // 2b.1 — deposit the bikes of each type below its target first,
+        //        the most missing type first when there is not room for all
         //
-        for (size_t t = 0; t < Bike::nbBikeTypes && deposited < c; ++t) {
-            if (st->countBikesOfType(t) == 0) {      // type is missing
+        std::array<size_t, Bike::nbBikeTypes> present;
+        std::array<size_t, Bike::nbBikeTypes> order;
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            present[t] = st->countBikesOfType(t);
+            order[t] = t;
+        }
+        auto gap = [&](size_t t) { return (long)typeTarget[t] - (long)present[t]; };
+        std::stable_sort(order.begin(), order.end(),
+                         [&](size_t a, size_t b) { return gap(a) > gap(b); });
+
+        for (size_t t : order) {
+            if (deposited >= c) break;
+            while (present[t] < typeTarget[t] && deposited < c) { // type is missing
                 Bike* chosen = takeBikeFromCargo(t); // take bike of this type from cargo
-                if (chosen) {
-                    toAdd.push_back(chosen);        // prepare to deposit
-                    deposited++;
-                }
+                if (!chosen) break;
+                toAdd.push_back(chosen);            // prepare to deposit
+                deposited++;
+                present[t]++;
             }
         }
 
         //
         // 2b.2 — fill remaining slots with any bikes left in the cargo
         //
-        while (deposited < c && !cargo.empty()) {
-            Bike* b = cargo.back();
-            cargo.pop_back();
-            toAdd.push_back(b);
-            deposited++;
+        for (size_t t = 0; t < Bike::nbBikeTypes && deposited < c; ++t) {
+            while (deposited < c && !cargo[t].empty()) {
+                toAdd.push_back(takeBikeFromCargo(t));
+                deposited++;
+            }
         }
 
         //
@@ -161,51 +408,196 @@ void Van::balanceSite(unsigned int _site)
 
             // Return rejected bikes to cargo
             for (Bike* b : rejected)
-                cargo.push_back(b);
+                addToCargo(b);
+        }
+    }
+
+    //
+    // ===== CASE 3: RIGHT TOTAL, WRONG MIX → swap types (exact targets) =====
+    //
+    // Riders waiting for a missing type would otherwise wait until other
+    // riders change the total.
+    else if (exact) {
+        size_t free = st->nbSlots() > Vi ? st->nbSlots() - Vi : 0; // Vi counts the broken bikes
+
+        // deposit the missing types first, into the free slots
+        std::vector<Bike*> toAdd;
+        for (size_t t = 0; t < Bike::nbBikeTypes && toAdd.size() < free; ++t) {
+            size_t present = st->countBikesOfType(t);
+            while (present < typeTarget[t] && toAdd.size() < free) {
+                Bike* chosen = takeBikeFromCargo(t);
+                if (!chosen) break;
+                toAdd.push_back(chosen);
+                present++;
+            }
+        }
+
+        if (!toAdd.empty()) {
+            // riders may have taken the free slots meanwhile: never wait for one
+            std::vector<Bike*> rejected = st->tryAddBikes(toAdd);
+            for (Bike* b : rejected)
+                addToCargo(b);
+
+            // then take back as many bikes of the types above their target
+            size_t swap = std::min(toAdd.size() - rejected.size(), freeSpace());
+            std::array<size_t, Bike::nbBikeTypes> quotas{};
+            size_t planned = 0;
+            for (size_t t = 0; t < Bike::nbBikeTypes && planned < swap; ++t) {
+                size_t count = st->countBikesOfType(t);
+                if (count > typeTarget[t]) {
+                    quotas[t] = std::min(count - typeTarget[t], swap - planned);
+                    planned += quotas[t];
+                }
+            }
+            for (Bike* b : st->getBikes(quotas))
+                addToCargo(b);
         }
     }
 
-    // Update GUI to reflect new bike count at site and depot
+    // Update GUI to reflect new bike count at site
     if (binkingInterface) {
         binkingInterface->setBikes(_site, st->nbBikes());
-        binkingInterface->setBikes(DEPOT_ID, stations[DEPOT_ID]->nbBikes());
     }
 }
 
-// Return to depot and unload cargo
+// Collect broken bikes at a site
+void Van::collectBrokenBikes(unsigned int _site) {
+    if (!repairShop || isDepot(_site)) return;
+
+    size_t space = freeSpace();
+    if (space == 0) return;
+
+    std::vector<Bike*> broken = stations[_site]->getBrokenBikes(space);
+    brokenCargo.insert(brokenCargo.end(), broken.begin(), broken.end());
+}
+
+// Return to a depot and unload cargo
 void Van::returnToDepot() {
-    driveTo(DEPOT_ID);
+    unsigned int depotId = chooseDepot(false);
+    driveTo(depotId);
 
-    BikeStation* depot = stations[DEPOT_ID];
+    BikeStation* depot = stations[depotId];
+
+    // broken bikes go to the repair queue
+    if (repairShop && !brokenCargo.empty()) {
+        repairShop->submit(brokenCargo);
+        brokenCargo.clear();
+    }
+
+    if (cargoSize() > 0) {
+        std::vector<Bike*> unloaded = unloadCargo(); // clear cargo
 
-    if (!cargo.empty()) {
         // addBikes can return bikes if simulation ended
-        std::vector<Bike*> rejected = depot->addBikes(cargo);
+        std::vector<Bike*> rejected = depot->addBikes(unloaded);
+
+        log(LogEvent::VanUnloaded, depotId, unloaded.size() - rejected.size());
 
         // If none could be added → shutdown detected
-        if (rejected.size() == cargo.size()) {
+        if (rejected.size() == unloaded.size()) {
+            for (Bike* b : rejected)
+                addToCargo(b);
             stopVanRequested = true;
             return; // run() will detect stopVanRequested and exit
         }
-
-        cargo.clear(); // clear cargo
     }
 
     // Update GUI
     if (binkingInterface) {
-        binkingInterface->setBikes(DEPOT_ID, stations[DEPOT_ID]->nbBikes());
+        binkingInterface->setBikes(depotId, depot->nbBikes());
+    }
+}
+
+// Move surplus stock from the current depot to the emptiest one
+void Van::rebalanceDepots() {
+    if (NBDEPOTS < 2 || !isDepot(currentSite))
+        return;
+
+    // fill ratio of the whole depot network
+    size_t totalBikes = 0;
+    size_t totalSlots = 0;
+    for (unsigned int d = DEPOT_ID; d < NB_SITES_TOTAL; ++d) {
+        totalBikes += stations[d]->nbBikes();
+        totalSlots += stations[d]->nbSlots();
+    }
+    if (totalSlots == 0)
+        return;
+
+    // how far each depot is from its fair share
+    auto fairShare = [&](unsigned int d) {
+        return (double)totalBikes * stations[d]->nbSlots() / totalSlots;
+    };
+
+    unsigned int from = currentSite;
+    double excess = stations[from]->nbBikes() - fairShare(from);
+
+    unsigned int to = from;
+    double worstDeficit = 0.0;
+    for (unsigned int d = DEPOT_ID; d < NB_SITES_TOTAL; ++d) {
+        double deficit = fairShare(d) - stations[d]->nbBikes();
+        if (deficit > worstDeficit) {
+            worstDeficit = deficit;
+            to = d;
+        }
+    }
+
+    // only worth a trip for a full van load
+    size_t toMove = (size_t)std::min(excess, worstDeficit);
+    toMove = std::min(toMove, VAN_CAPACITY);
+    if (to == from || toMove < VAN_CAPACITY)
+        return;
+
+    for (Bike* b : stations[from]->getBikes(toMove))
+        addToCargo(b);
+    if (binkingInterface) {
+        binkingInterface->setBikes(from, stations[from]->nbBikes());
+    }
+
+    driveTo(to);
+    // the depot may have been filled meanwhile: never wait for a slot, the
+    // bikes that do not fit stay in the van until the next depot visit
+    for (Bike* b : stations[to]->tryAddBikes(unloadCargo()))
+        addToCargo(b);
+    if (binkingInterface) {
+        binkingInterface->setBikes(to, stations[to]->nbBikes());
     }
 }
 
 // Take a bike of a specific type from the cargo
 Bike* Van::takeBikeFromCargo(size_t type) {
-    for (size_t i = 0; i < cargo.size(); ++i) {
-        if (cargo[i]->bikeType == type) {
-            Bike* bike = cargo[i];
-            cargo[i] = cargo.back(); // swap with last bike for fast removal
-            cargo.pop_back();
-            return bike;
-        }
+    if (cargo[type].empty())
+        return nullptr; // no bike of this type in cargo
+
+    Bike* bike = cargo[type].back(); // per-type stack
+    cargo[type].pop_back();
+    return bike;
+}
+
+// Put a bike on the stack of its type
+void Van::addToCargo(Bike* _bike) {
+    cargo[_bike->bikeType].push_back(_bike);
+}
+
+// Number of bikes in the van
+size_t Van::cargoSize() const {
+    size_t total = 0;
+    for (const auto& stack : cargo)
+        total += stack.size();
+    return total;
+}
+
+// Free space, broken bikes included
+size_t Van::freeSpace() const {
+    size_t used = cargoSize() + brokenCargo.size();
+    return used < VAN_CAPACITY ? VAN_CAPACITY - used : 0;
+}
+
+// Empty the cargo
+std::vector<Bike*> Van::unloadCargo() {
+    std::vector<Bike*> all;
+    all.reserve(cargoSize());
+    for (auto& stack : cargo) {
+        all.insert(all.end(), stack.begin(), stack.end());
+        stack.clear();
     }
-    return nullptr; // no bike of this type in cargo
+    return all;
 }
@@ -0,0 +1,71 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include "vanfleet.h"
+#include "config.h"
+#include "simgate.h"
+
+#include <algorithm>
+
+VanFleet::VanFleet() {}
+
+size_t VanFleet::setCount(size_t _count) {
+    _count = std::min(_count, MAX_VANS);
+
+    mutex.lock();
+    // A retired van may still be finishing its tour: always start new vans
+    while (inService.size() < _count) {
+        vans.emplace_back(std::make_unique<Van>(nextId++));
+        globalGate.join(); // before the van can move bikes
+        threads.emplace_back(std::make_unique<PcoThread>(&Van::run, vans.back().get()));
+        inService.push_back(vans.back().get());
+    }
+    while (inService.size() > _count) {
+        inService.back()->retire();
+        inService.pop_back();
+    }
+    size_t result = inService.size();
+    mutex.unlock();
+    return result;
+}
+
+void VanFleet::restore(std::vector<std::unique_ptr<Van>> _vans) {
+    mutex.lock();
+    for (auto& van : _vans) {
+        nextId = std::max(nextId, van->identifier() + 1);
+        vans.push_back(std::move(van));
+        globalGate.join();
+        threads.emplace_back(std::make_unique<PcoThread>(&Van::run, vans.back().get()));
+        inService.push_back(vans.back().get());
+    }
+    mutex.unlock();
+}
+
+std::vector<Van*> VanFleet::all() {
+    mutex.lock();
+    std::vector<Van*> result;
+    for (auto& van : vans) {
+        result.push_back(van.get());
+    }
+    mutex.unlock();
+    return result;
+}
+
+size_t VanFleet::count() {
+    mutex.lock();
+    size_t result = inService.size();
+    mutex.unlock();
+    return result;
+}
+
+void VanFleet::joinAll() {
+    mutex.lock();
+    for (auto& thread : threads) {
+        thread->join();
+    }
+    mutex.unlock();
+}
@@ -0,0 +1,138 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include <QtTest>
+
+#include <limits>
+
+#include "columnarformat.h"
+
+using Column = std::vector<uint64_t>;
+using Encoder = void (*)(std::vector<uint8_t>&, const Column&);
+using Decoder = bool (*)(const uint8_t*&, const uint8_t*, size_t, Column&);
+
+/**
+ * @brief Encodes a column, decodes it back and checks that every byte was read.
+ */
+static Column roundTrip(Encoder _encode, Decoder _decode, const Column& _values,
+                        std::vector<uint8_t>& _bytes, bool& _ok)
+{
+    _bytes.clear();
+    _encode(_bytes, _values);
+    const uint8_t* data = _bytes.data();
+    Column decoded;
+    _ok = _decode(data, _bytes.data() + _bytes.size(), _values.size(), decoded)
+          && data == _bytes.data() + _bytes.size();
+    return decoded;
+}
+
+/**
+ * @brief Encode -> decode of the column codecs of the columnar export.
+ */
+class TestColumnarFormat : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // Range of the whole 64 bits: base 0, width 64
+    void packedWidth64()
+    {
+        const uint64_t max = std::numeric_limits<uint64_t>::max();
+        Column values = {0, max, 1ULL << 63, 12345, max - 1};
+        std::vector<uint8_t> bytes;
+        bool ok;
+
+        QCOMPARE(roundTrip(encodePacked, decodePacked, values, bytes, ok), values);
+        QVERIFY(ok);
+        QCOMPARE((int)bytes[1], 64); // after the one-byte varint base
+        QCOMPARE(bytes.size(), (size_t)2 + values.size() * 8);
+    }
+
+    // Deltas wrapping around 2^64
+    void integersWidth64()
+    {
+        const uint64_t max = std::numeric_limits<uint64_t>::max();
+        Column values = {max, 0, max, 1ULL << 63, 1};
+        std::vector<uint8_t> bytes;
+        bool ok;
+
+        QCOMPARE(roundTrip(encodeIntegers, decodeIntegers, values, bytes, ok), values);
+        QVERIFY(ok);
+    }
+
+    void emptyColumns()
+    {
+        std::vector<uint8_t> bytes;
+        bool ok;
+
+        QCOMPARE(roundTrip(encodePacked, decodePacked, {}, bytes, ok), Column());
+        QVERIFY(ok);
+        QCOMPARE(roundTrip(encodeIntegers, decodeIntegers, {}, bytes, ok), Column());
+        QVERIFY(ok);
+        QCOMPARE(roundTrip(encodeDictionary, decodeDictionary, {}, bytes, ok), Column());
+        QVERIFY(ok);
+    }
+
+    // One value on every row: a single run, stored as a width 0 packed column
+    void singleRun()
+    {
+        Column values(1000, 7);
+        std::vector<uint8_t> bytes;
+        bool ok;
+
+        QCOMPARE(roundTrip(encodeIntegers, decodeIntegers, values, bytes, ok), values);
+        QVERIFY(ok);
+        QCOMPARE(bytes[0], (uint8_t)ColumnarMode::Packed);
+        QCOMPARE(bytes.size(), (size_t)3); // mode, base, width 0
+    }
+
+    // 100, 101, 102...: a run of delta 100, then a run of delta 1
+    void runs()
+    {
+        Column values;
+        for (uint64_t k = 0; k < 1000; ++k) values.push_back(100 + k);
+        std::vector<uint8_t> bytes;
+        bool ok;
+
+        QCOMPARE(roundTrip(encodeIntegers, decodeIntegers, values, bytes, ok), values);
+        QVERIFY(ok);
+        QCOMPARE(bytes[0], (uint8_t)ColumnarMode::Runs);
+        QCOMPARE((int)bytes[1], 2); // number of runs
+    }
+
+    // Few distinct values, far apart
+    void dictionary()
+    {
+        Column values = {4000000000ULL, 3, 4000000000ULL, 4000000000ULL, 70000, 3};
+        std::vector<uint8_t> bytes;
+        bool ok;
+
+        QCOMPARE(roundTrip(encodeDictionary, decodeDictionary, values, bytes, ok), values);
+        QVERIFY(ok);
+        QCOMPARE((int)bytes[0], 3); // distinct values
+    }
+
+    void truncatedColumns()
+    {
+        Column values = {5, 900, 17, 4, 65000, 2};
+        std::vector<uint8_t> bytes;
+        Column decoded;
+
+        encodePacked(bytes, values);
+        const uint8_t* data = bytes.data();
+        QVERIFY(!decodePacked(data, bytes.data() + bytes.size() - 1, values.size(), decoded));
+
+        bytes.clear();
+        encodeDictionary(bytes, values);
+        data = bytes.data();
+        QVERIFY(!decodeDictionary(data, bytes.data() + 4, values.size(), decoded));
+    }
+};
+
+QTEST_APPLESS_MAIN(TestColumnarFormat)
+
+#include "tst_columnarformat.moc"
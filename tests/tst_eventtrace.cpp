@@ -0,0 +1,216 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include <QtTest>
+
+#include <cstdio>
+#include <limits>
+#include <unistd.h>
+
+#include "eventlog.h"
+#include "eventtrace.h"
+
+/**
+ * @brief One stream of records, encoded as EventTrace does.
+ */
+struct Stream
+{
+    std::vector<uint8_t> bytes;
+
+    void record(uint64_t _deltaNs, TraceKind _kind, std::initializer_list<uint64_t> _fields)
+    {
+        uint8_t encoded[16 * 10];
+        uint8_t* end = traceVarint(encoded, _deltaNs << 4 | (uint64_t)_kind);
+        for (uint64_t field : _fields) end = traceVarint(end, field);
+        bytes.insert(bytes.end(), encoded, end);
+    }
+};
+
+/**
+ * @brief Decoding of hand-made trace files by TraceReader.
+ */
+class TestEventTrace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        char pattern[] = "/tmp/tst_eventtraceXXXXXX";
+        int fd = mkstemp(pattern);
+        QVERIFY(fd >= 0);
+        ::close(fd);
+        path = pattern;
+    }
+
+    void cleanup()
+    {
+        std::remove(path.c_str());
+    }
+
+    // Multi-byte varints: actor id, a 2^40 ns delta, a 32-bit duration
+    void varints()
+    {
+        Stream stream;
+        stream.record(0, TraceKind::Actor, {(uint64_t)LogActor::Person, 300});
+        stream.record(1ULL << 40, TraceKind::Take, {2, 1});
+        stream.record(5, TraceKind::Put, {3, 0, 1});
+        stream.record(127, TraceKind::Ride, {3, 1, 0xffffffffULL});
+        write({stream});
+
+        TraceReader reader;
+        std::string error;
+        QVERIFY(reader.open(path, error));
+        QCOMPARE(reader.nbSites(), (uint32_t)4);
+        const std::vector<TraceRecord>& records = reader.records();
+        QCOMPARE(records.size(), (size_t)3);
+
+        QCOMPARE(records[0].kind, TraceKind::Take);
+        QCOMPARE(records[0].timeNs, (uint64_t)1 << 40);
+        QCOMPARE(records[0].actor, (uint8_t)LogActor::Person);
+        QCOMPARE(records[0].actorId, (uint32_t)300);
+        QCOMPARE(records[0].site, (uint32_t)2);
+        QCOMPARE(records[0].value, (uint32_t)1);
+
+        QCOMPARE(records[1].kind, TraceKind::Put);
+        QCOMPARE(records[1].timeNs, ((uint64_t)1 << 40) + 5);
+        QCOMPARE(records[1].broken, (uint32_t)1);
+
+        QCOMPARE(records[2].kind, TraceKind::Ride);
+        QCOMPARE(records[2].timeNs, ((uint64_t)1 << 40) + 132);
+        QCOMPARE(records[2].to, (uint32_t)1);
+        QCOMPARE(records[2].value, (uint32_t)0xffffffff);
+    }
+
+    // Two streams merged by time
+    void streams()
+    {
+        Stream first, second;
+        first.record(10, TraceKind::Take, {0, 0});
+        first.record(20, TraceKind::Take, {1, 0});
+        second.record(15, TraceKind::Put, {2, 0, 0});
+        write({first, second});
+
+        TraceReader reader;
+        std::string error;
+        QVERIFY(reader.open(path, error));
+        const std::vector<TraceRecord>& records = reader.records();
+        QCOMPARE(records.size(), (size_t)3);
+        QCOMPARE(records[0].site, (uint32_t)0);
+        QCOMPARE(records[1].stream, (uint32_t)1);
+        QCOMPARE(records[2].timeNs, (uint64_t)30);
+    }
+
+    // A gap is stamped at the last record kept; it is counted, not checked
+    // against the sites
+    void gap()
+    {
+        Stream first, second;
+        first.record(10, TraceKind::Take, {0, 0});
+        first.record(0, TraceKind::Gap, {1000});
+        first.record(90, TraceKind::Put, {1, 0, 0});
+        second.record(50, TraceKind::Take, {2, 0});
+        write({first, second});
+
+        TraceReader reader;
+        std::string error;
+        QVERIFY(reader.open(path, error));
+        QCOMPARE(reader.dropped(), (uint64_t)1000);
+        QCOMPARE(reader.exactUntilNs(), (uint64_t)10);
+        const std::vector<TraceRecord>& records = reader.records();
+        QCOMPARE(records.size(), (size_t)4);
+        QCOMPARE(records[1].kind, TraceKind::Gap);
+        QCOMPARE(records[1].value, (uint32_t)1000);
+        QCOMPARE(records[3].timeNs, (uint64_t)100);
+    }
+
+    void exact()
+    {
+        Stream stream;
+        stream.record(10, TraceKind::Take, {0, 0});
+        write({stream});
+
+        TraceReader reader;
+        std::string error;
+        QVERIFY(reader.open(path, error));
+        QCOMPARE(reader.dropped(), (uint64_t)0);
+        QCOMPARE(reader.exactUntilNs(), std::numeric_limits<uint64_t>::max());
+    }
+
+    // Without a writer the ring fills up: the dropped records end the trace
+    // with a gap
+    void recorderGap()
+    {
+        uint64_t dropped = 0;
+        {
+            EventTrace trace;
+            QVERIFY(trace.open(path, 4));
+            for (int i = 0; i < 100000; ++i) trace.take(i % 4, 0);
+            dropped = trace.dropped();
+        }
+        QVERIFY(dropped > 0);
+
+        TraceReader reader;
+        std::string error;
+        QVERIFY(reader.open(path, error));
+        QCOMPARE(reader.dropped(), dropped);
+        QCOMPARE(reader.records().size(), (size_t)(100000 - dropped + 1));
+        QCOMPARE(reader.records().back().kind, TraceKind::Gap);
+        QCOMPARE(reader.exactUntilNs(), reader.records().back().timeNs);
+    }
+
+    // The last byte of the chunk still announces a continuation
+    void truncatedVarint()
+    {
+        Stream stream;
+        stream.record(1, TraceKind::Take, {2, 1});
+        stream.bytes.back() |= 0x80;
+        write({stream});
+
+        TraceReader reader;
+        std::string error;
+        QVERIFY(!reader.open(path, error));
+        QVERIFY(error.find("corrupted") != std::string::npos);
+    }
+
+    // More than 64 bits of continuation bytes
+    void overlongVarint()
+    {
+        Stream stream;
+        stream.bytes.assign(11, 0x80);
+        stream.bytes.push_back(0);
+        write({stream});
+
+        TraceReader reader;
+        std::string error;
+        QVERIFY(!reader.open(path, error));
+    }
+
+private:
+    /**
+     * @brief Writes a trace of 4 stations, one chunk per stream.
+     */
+    void write(const std::vector<Stream>& _streams)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        QVERIFY(file);
+        TraceFileHeader header{TRACE_MAGIC, TRACE_VERSION, 4, Bike::nbBikeTypes};
+        std::fwrite(&header, sizeof(header), 1, file);
+        for (size_t s = 0; s < _streams.size(); ++s) {
+            TraceChunkHeader chunk{(uint32_t)s, (uint32_t)_streams[s].bytes.size()};
+            std::fwrite(&chunk, sizeof(chunk), 1, file);
+            std::fwrite(_streams[s].bytes.data(), 1, _streams[s].bytes.size(), file);
+        }
+        std::fclose(file);
+    }
+
+    std::string path;
+};
+
+QTEST_APPLESS_MAIN(TestEventTrace)
+
+#include "tst_eventtrace.moc"
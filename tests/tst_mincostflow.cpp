@@ -0,0 +1,91 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include <QtTest>
+
+#include "mincostflow.h"
+
+/**
+ * @brief Small graphs whose optimal flow is found by hand.
+ */
+class TestMinCostFlow : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // s -> t directly (cost 5) or through a (cost 1 + 1, one unit)
+    void cheapestPathFirst()
+    {
+        MinCostFlow graph(3);
+        size_t direct = graph.addArc(0, 2, 1, 5);
+        size_t toA = graph.addArc(0, 1, 2, 1);
+        size_t fromA = graph.addArc(1, 2, 1, 1);
+
+        QCOMPARE(graph.solve(0, 2), (int64_t)2);
+        QCOMPARE(graph.totalCost(), (int64_t)7);
+        QCOMPARE(graph.flowOn(direct), (int64_t)1);
+        QCOMPARE(graph.flowOn(toA), (int64_t)1);
+        QCOMPARE(graph.flowOn(fromA), (int64_t)1);
+    }
+
+    // Every arc is saturated: the flow is forced, cost 2 + 2 + 1 + 3 + 2
+    void forcedFlow()
+    {
+        MinCostFlow graph(4); // s = 0, a = 1, b = 2, t = 3
+        graph.addArc(0, 1, 2, 1);
+        graph.addArc(0, 2, 1, 2);
+        size_t ab = graph.addArc(1, 2, 1, 1);
+        graph.addArc(1, 3, 1, 3);
+        graph.addArc(2, 3, 2, 1);
+
+        QCOMPARE(graph.solve(0, 3), (int64_t)3);
+        QCOMPARE(graph.totalCost(), (int64_t)10);
+        QCOMPARE(graph.flowOn(ab), (int64_t)1);
+    }
+
+    // Three units out of a convex arc (1, 3, 4) and a plain one (2, 2):
+    // the cheapest are 1, 2 and 2
+    void convexArc()
+    {
+        MinCostFlow graph(3);
+        size_t convex = graph.addConvexArc(0, 1, {1, 3, 4});
+        size_t plain = graph.addArc(0, 1, 2, 2);
+        graph.addArc(1, 2, 3, 0);
+
+        QCOMPARE(graph.solve(0, 2), (int64_t)3);
+        QCOMPARE(graph.totalCost(), (int64_t)5);
+        QCOMPARE(graph.flowOn(convex), (int64_t)1);
+        QCOMPARE(graph.flowOn(plain), (int64_t)2);
+    }
+
+    // A negative arc is used, and the flow stays maximal
+    void negativeCost()
+    {
+        MinCostFlow graph(3);
+        size_t toA = graph.addArc(0, 1, 1, -2);
+        graph.addArc(1, 2, 1, 1);
+        graph.addArc(0, 2, 1, 0);
+
+        QCOMPARE(graph.solve(0, 2), (int64_t)2);
+        QCOMPARE(graph.totalCost(), (int64_t)-1);
+        QCOMPARE(graph.flowOn(toA), (int64_t)1);
+    }
+
+    void noPath()
+    {
+        MinCostFlow graph(3);
+        size_t arc = graph.addArc(0, 1, 4, 1);
+
+        QCOMPARE(graph.solve(0, 2), (int64_t)0);
+        QCOMPARE(graph.totalCost(), (int64_t)0);
+        QCOMPARE(graph.flowOn(arc), (int64_t)0);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestMinCostFlow)
+
+#include "tst_mincostflow.moc"
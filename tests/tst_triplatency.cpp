@@ -0,0 +1,121 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+#include <QtTest>
+
+#include <limits>
+
+#include "triplatency.h"
+
+/**
+ * @brief Buckets and percentiles of the journey phase histograms.
+ */
+class TestTripLatency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // 0..7 exact, then 8 buckets per power of two
+    void bucketOf()
+    {
+        QCOMPARE(LatencyHistogram::bucketOf(0), (size_t)0);
+        QCOMPARE(LatencyHistogram::bucketOf(7), (size_t)7);
+        QCOMPARE(LatencyHistogram::bucketOf(8), (size_t)8);
+        QCOMPARE(LatencyHistogram::bucketOf(15), (size_t)15);
+        QCOMPARE(LatencyHistogram::bucketOf(16), (size_t)16);
+        QCOMPARE(LatencyHistogram::bucketOf(17), (size_t)16);
+        QCOMPARE(LatencyHistogram::bucketOf(18), (size_t)17);
+        QCOMPARE(LatencyHistogram::bucketOf(std::numeric_limits<uint64_t>::max()),
+                 LatencyHistogram::NB_BUCKETS - 1);
+    }
+
+    // Non-decreasing, and a bucket value within 1/8 of the durations it holds
+    void bucketValue()
+    {
+        size_t previous = 0;
+        for (uint64_t us = 1; us < ((uint64_t)1 << 34); us += us / 7 + 1) {
+            size_t bucket = LatencyHistogram::bucketOf(us);
+            QVERIFY(bucket >= previous);
+            previous = bucket;
+
+            uint64_t value = LatencyHistogram::bucketValue(bucket);
+            uint64_t error = value > us ? value - us : us - value;
+            QVERIFY(error * LatencyHistogram::SUB_BUCKETS <= us);
+        }
+    }
+
+    // 1..100 us once each: the median falls in 48..51, p99 in 96..103
+    void percentile()
+    {
+        LatencyHistogram histogram;
+        QCOMPARE(histogram.percentile(0.5), (uint64_t)0);
+
+        for (uint64_t us = 1; us <= 100; ++us) histogram.add(us);
+        QCOMPARE(histogram.count(), (uint64_t)100);
+        QCOMPARE(histogram.percentile(0.0), (uint64_t)1);
+        QCOMPARE(histogram.percentile(0.5), (uint64_t)50);
+        QCOMPARE(histogram.percentile(0.99), (uint64_t)100);
+        QCOMPARE(histogram.percentile(1.0), (uint64_t)100);
+    }
+
+    void merge()
+    {
+        LatencyHistogram fast, slow;
+        fast.add(10, 3);
+        slow.add(1000);
+        fast.merge(slow);
+
+        QCOMPARE(fast.count(), (uint64_t)4);
+        QCOMPARE(fast.percentile(0.75), LatencyHistogram::bucketValue(LatencyHistogram::bucketOf(10)));
+        QCOMPARE(fast.percentile(1.0), LatencyHistogram::bucketValue(LatencyHistogram::bucketOf(1000)));
+    }
+
+    // Per pair and per phase, out of range stations ignored
+    void record()
+    {
+        TripLatency latency;
+        latency.record(TripPhase::WaitBike, 1, 0, 1000);
+        latency.record(TripPhase::WaitBike, 1, 0, 1000);
+        latency.record(TripPhase::WaitBike, 0, 1, 2000);
+        latency.record(TripPhase::Trip, 1, 0, 5000);
+        latency.record(TripPhase::Trip, NB_SITES_TOTAL, 0, 5000);
+
+        QCOMPARE(latency.pair(TripPhase::WaitBike, 1, 0).count(), (uint64_t)2);
+        QCOMPARE(latency.pair(TripPhase::WaitBike, 0, 1).count(), (uint64_t)1);
+        QCOMPARE(latency.phase(TripPhase::WaitBike).count(), (uint64_t)3);
+        QCOMPARE(latency.phase(TripPhase::Trip).count(), (uint64_t)1);
+        QCOMPARE(latency.phase(TripPhase::Ride).count(), (uint64_t)0);
+        QCOMPARE(latency.untracked(), (uint64_t)0);
+    }
+
+    // Built with enough sites for more pairs than MAX_PAIRS: the others
+    // only count in the phases
+    void pairsBeyondMax()
+    {
+        QVERIFY(NB_SITES_TOTAL * NB_SITES_TOTAL > TripLatency::MAX_PAIRS);
+
+        TripLatency latency;
+        uint64_t tracked = 0;
+        for (unsigned int from = 0; from < NB_SITES_TOTAL; ++from) {
+            for (unsigned int to = 0; to < NB_SITES_TOTAL; ++to) {
+                latency.record(TripPhase::Trip, from, to, 100);
+                latency.record(TripPhase::Trip, from, to, 100);
+                tracked += latency.pair(TripPhase::Trip, from, to).count();
+            }
+        }
+
+        uint64_t samples = 2 * NB_SITES_TOTAL * NB_SITES_TOTAL;
+        QCOMPARE(latency.phase(TripPhase::Trip).count(), samples);
+        QCOMPARE(tracked, (uint64_t)(2 * TripLatency::MAX_PAIRS));
+        QCOMPARE(latency.untracked(), samples - tracked);
+        QCOMPARE(latency.pair(TripPhase::Trip, 0, 1).count(), (uint64_t)2);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestTripLatency)
+
+#include "tst_triplatency.moc"
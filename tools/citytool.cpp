@@ -0,0 +1,147 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+// Offline tool for the city models read with --city.
+//
+// Usage: pco_city generate <model> <sites> <depots> <bikes> [--text]
+//        pco_city convert <model> <binary model>
+//        pco_city build <model> [threads]
+
+#include "citymodel.h"
+#include "bikestation.h"
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Writes the text form of a model
+static bool saveText(const char* path, const CityModelHeader& header,
+                     const std::vector<CitySiteRecord>& sites) {
+    std::FILE* file = std::fopen(path, "w");
+    if (!file) {
+        std::perror(path);
+        return false;
+    }
+    std::fprintf(file, "# %u sites, %u depots\npeople %u\nvans %u\nbikes", header.nbSites,
+                 header.nbDepots, header.nbPeople, header.nbVans);
+    for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+        std::fprintf(file, " %llu", (unsigned long long)header.fleet[t]);
+    }
+    for (size_t s = 0; s < sites.size(); ++s) {
+        std::fprintf(file, "\n%s %.5f %.5f %u", s < header.nbSites ? "site" : "depot",
+                     sites[s].x, sites[s].y, sites[s].capacity);
+        for (size_t t = 0; t < Bike::nbBikeTypes && s < header.nbSites; ++t) {
+            std::fprintf(file, " %u", sites[s].stock[t]);
+        }
+    }
+    std::fputc('\n', file);
+    return std::fclose(file) == 0;
+}
+
+// Random city in a disc: sites of 10 to 30 slots filled at 60%, the other
+// bikes in the depots
+static int generate(const char* path, size_t nbSites, size_t nbDepots, uint64_t nbBikes, bool text) {
+    std::mt19937_64 rng(nbSites * 31 + nbDepots);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<uint32_t> capacity(10, 30);
+    const double pi = 3.14159265358979323846;
+
+    CityModelHeader header{CITY_MODEL_MAGIC, CITY_MODEL_VERSION, (uint32_t)nbSites,
+                           (uint32_t)nbDepots, Bike::nbBikeTypes, (uint32_t)std::min<size_t>(nbSites, 1000),
+                           (uint32_t)std::min<size_t>(nbDepots, MAX_VANS), 0, {}};
+    for (uint64_t i = 0; i < nbBikes; ++i) header.fleet[i % Bike::nbBikeTypes]++;
+
+    std::vector<CitySiteRecord> sites(nbSites + nbDepots);
+    uint64_t placed = 0;
+    for (size_t s = 0; s < sites.size(); ++s) {
+        double radius = s < nbSites ? std::sqrt(unit(rng)) : 0.4 * std::sqrt(unit(rng));
+        double angle = 2 * pi * unit(rng);
+        sites[s].x = radius * std::cos(angle);
+        sites[s].y = radius * std::sin(angle);
+        if (s >= nbSites) continue;
+        sites[s].capacity = capacity(rng);
+        for (uint32_t k = 0; k < sites[s].capacity * 6 / 10 && placed < nbBikes; ++k, ++placed) {
+            sites[s].stock[placed % Bike::nbBikeTypes]++;
+        }
+    }
+    uint64_t perDepot = (nbBikes - placed + nbDepots - 1) / nbDepots;
+    for (size_t d = nbSites; d < sites.size(); ++d) {
+        sites[d].capacity = (uint32_t)std::max<uint64_t>(perDepot * 2, 10);
+    }
+
+    CityModel model;
+    std::string error;
+    if (!model.assign(header, sites, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (text ? !saveText(path, header, sites) : !model.save(path, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static int convert(const char* from, const char* to) {
+    CityModel model;
+    std::string error;
+    if (!model.open(from, error) || !model.save(to, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static int build(const char* path, unsigned int nbThreads) {
+    auto start = std::chrono::steady_clock::now();
+    CityModel model;
+    std::string error;
+    if (!model.open(path, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    double openMs = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<BikeStation*> stations = buildStations(model, nbThreads);
+    double buildMs = elapsedMs(start);
+
+    uint64_t bikes = 0;
+    for (BikeStation* station : stations) bikes += station->nbBikes();
+    std::printf("%zu sites, %zu depots, %llu bikes: opened in %.1f ms, built in %.1f ms\n",
+                model.nbSites(), model.nbDepots(), (unsigned long long)bikes, openMs, buildMs);
+    return bikes == model.nbBikes() ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 6 && std::strcmp(argv[1], "generate") == 0) {
+        bool text = argc > 6 && std::strcmp(argv[6], "--text") == 0;
+        return generate(argv[2], std::atol(argv[3]), std::max(1L, std::atol(argv[4])),
+                        std::atoll(argv[5]), text);
+    }
+    if (argc == 4 && std::strcmp(argv[1], "convert") == 0) {
+        return convert(argv[2], argv[3]);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "build") == 0) {
+        return build(argv[2], argc > 3 ? std::atoi(argv[3]) : 0);
+    }
+    std::fprintf(stderr, "Usage: %s generate <model> <sites> <depots> <bikes> [--text]\n"
+                         "       %s convert <model> <binary model>\n"
+                         "       %s build <model> [threads]\n", argv[0], argv[0], argv[0]);
+    return 2;
+}
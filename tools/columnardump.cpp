@@ -0,0 +1,135 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+// Offline tool for the columnar exports written with --export.
+//
+// Usage: pco_columnar stats <export>
+//        pco_columnar csv <export> occupancy|trips
+
+#include "columnarformat.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static const char* TABLE_NAMES[] = {"occupancy", "trips"};
+static const char* CSV_HEADERS[] = {"time_ms,station,type,bikes\n",
+                                    "end_ms,duration_ms,origin,destination,type\n"};
+static const size_t NB_COLUMNS[] = {4, 5};
+
+// Decodes one row group into its columns, false if it is invalid
+static bool decodeGroup(uint32_t table, size_t rows, const uint8_t* data, const uint8_t* end,
+                        std::vector<std::vector<uint64_t>>& columns) {
+    columns.assign(NB_COLUMNS[table], {});
+    if (!decodeIntegers(data, end, rows, columns[0])) return false;
+    if (table == (uint32_t)ColumnarTable::Occupancy) {
+        return decodeDictionary(data, end, rows, columns[1])
+               && decodeIntegers(data, end, rows, columns[2])
+               && decodeIntegers(data, end, rows, columns[3]);
+    }
+    return decodeIntegers(data, end, rows, columns[1])
+           && decodeDictionary(data, end, rows, columns[2])
+           && decodeDictionary(data, end, rows, columns[3])
+           && decodeIntegers(data, end, rows, columns[4]);
+}
+
+// Formats a row as a CSV line, returns its length
+static size_t csvLine(const std::vector<std::vector<uint64_t>>& columns, size_t row, char* line) {
+    size_t n = 0;
+    for (size_t c = 0; c < columns.size(); ++c) {
+        n += std::snprintf(line + n, 32, "%s%llu", c ? "," : "",
+                           (unsigned long long)columns[c][row]);
+    }
+    line[n++] = '\n';
+    return n;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || (std::strcmp(argv[1], "stats") != 0 && std::strcmp(argv[1], "csv") != 0)
+        || (std::strcmp(argv[1], "csv") == 0 && argc < 4)) {
+        std::fprintf(stderr, "Usage: %s stats <export>\n"
+                             "       %s csv <export> occupancy|trips\n", argv[0], argv[0]);
+        return 2;
+    }
+    bool csv = std::strcmp(argv[1], "csv") == 0;
+    long wanted = -1;
+    if (csv) {
+        for (long t = 0; t < 2; ++t) {
+            if (std::strcmp(argv[3], TABLE_NAMES[t]) == 0) wanted = t;
+        }
+        if (wanted < 0) {
+            std::fprintf(stderr, "Unknown table %s\n", argv[3]);
+            return 2;
+        }
+    }
+
+    std::ifstream in(argv[2], std::ios::binary);
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ColumnarFileHeader header;
+    if (!in.is_open() || file.size() < sizeof(header)) {
+        std::fprintf(stderr, "%s: cannot read the export\n", argv[2]);
+        return 2;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != COLUMNAR_MAGIC || header.version != COLUMNAR_VERSION) {
+        std::fprintf(stderr, "%s: not a columnar export (or another version)\n", argv[2]);
+        return 2;
+    }
+
+    uint64_t rows[2] = {0, 0}, groups[2] = {0, 0}, bytes[2] = {0, 0}, csvBytes[2] = {0, 0};
+    if (csv) std::fputs(CSV_HEADERS[wanted], stdout);
+
+    std::vector<std::vector<uint64_t>> columns;
+    char line[256];
+    size_t offset = sizeof(header);
+    while (offset < file.size()) {
+        ColumnarGroupHeader group;
+        if (file.size() - offset < sizeof(group)) break;
+        std::memcpy(&group, file.data() + offset, sizeof(group));
+        offset += sizeof(group);
+        if (group.table > 1 || group.rows > header.groupRows || group.bytes > file.size() - offset
+            || !decodeGroup(group.table, group.rows, file.data() + offset,
+                            file.data() + offset + group.bytes, columns)) {
+            std::fprintf(stderr, "%s: invalid row group at byte %zu\n", argv[2],
+                         offset - sizeof(group));
+            return 1;
+        }
+        offset += group.bytes;
+
+        rows[group.table] += group.rows;
+        groups[group.table]++;
+        bytes[group.table] += sizeof(group) + group.bytes;
+        for (size_t r = 0; r < group.rows; ++r) {
+            size_t n = csvLine(columns, r, line);
+            csvBytes[group.table] += n;
+            if (csv && (long)group.table == wanted) std::fwrite(line, 1, n, stdout);
+        }
+    }
+    if (offset != file.size()) {
+        std::fprintf(stderr, "%s: truncated row group\n", argv[2]);
+        return 1;
+    }
+    if (csv) return 0;
+
+    std::printf("%u sites, %u types, samples every %u ms\n", header.nbSites, header.nbTypes,
+                header.samplePeriodMs);
+    for (size_t t = 0; t < 2; ++t) {
+        csvBytes[t] += std::strlen(CSV_HEADERS[t]);
+        std::printf("%-10s %10llu rows %6llu groups %12llu bytes (CSV %12llu, %.1fx)\n",
+                    TABLE_NAMES[t], (unsigned long long)rows[t], (unsigned long long)groups[t],
+                    (unsigned long long)bytes[t], (unsigned long long)csvBytes[t],
+                    bytes[t] ? (double)csvBytes[t] / bytes[t] : 0.0);
+    }
+    uint64_t total = file.size(), totalCsv = csvBytes[0] + csvBytes[1];
+    std::printf("%-10s %35llu bytes (CSV %12llu, %.1fx)\n", "total", (unsigned long long)total,
+                (unsigned long long)totalCsv, total ? (double)totalCsv / total : 0.0);
+    return 0;
+}
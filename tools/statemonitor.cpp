@@ -0,0 +1,116 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+// Lightweight out-of-process monitor: maps the shared-memory segment
+// exported by the simulation (--state-name) read-only and prints it
+// periodically.
+//
+// Usage: pco_state_monitor [--name /pco_biking] [--interval ms] [--once]
+
+#include "sharedstate.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Map the segment read-only, nullptr if the simulation is not running
+static const SharedStateHeader* attach(const char* name, size_t& size) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SharedStateHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    size = st.st_size;
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return nullptr;
+
+    auto* header = static_cast<const SharedStateHeader*>(memory);
+    if (header->magic != SHARED_STATE_MAGIC || header->version != SHARED_STATE_VERSION ||
+        header->nbTypes != Bike::nbBikeTypes || sharedStateSize(header->nbSites) > size) {
+        std::fprintf(stderr, "Incompatible shared state layout\n");
+        munmap(memory, size);
+        return nullptr;
+    }
+    return header;
+}
+
+static void print(const SharedStateCopy& state) {
+    const SharedStateHeader& h = state.header;
+    std::printf("t=%.1fs trips=%llu waits=%llu breakdowns=%llu repairs=%llu van distance=%.2f\n",
+                h.timestampMs / 1000.0, (unsigned long long)h.tripsCompleted,
+                (unsigned long long)h.riderWaits, (unsigned long long)h.breakdowns,
+                (unsigned long long)h.repairs, h.vanDistanceMilli / 1000.0);
+
+    for (uint32_t v = 0; v < h.nbVans && v < SHARED_STATE_MAX_VANS; ++v) {
+        const SharedVanState& van = h.vans[v];
+        std::printf("  van %u: %u -> %u, %u bikes\n", v, van.fromSite, van.toSite, van.cargo);
+    }
+
+    std::printf("  %-6s %-10s", "site", "kind");
+    for (uint32_t t = 0; t < h.nbTypes; ++t) std::printf(" type%u", t);
+    std::printf(" broken slots takers putters\n");
+    for (uint32_t s = 0; s < h.nbSites; ++s) {
+        const SharedStationState& st = state.stations[s];
+        std::printf("  %-6u %-10s", s, s + h.nbDepots >= h.nbSites ? "depot" : "site");
+        for (uint32_t t = 0; t < h.nbTypes; ++t) std::printf(" %5u", st.bikes[t]);
+        std::printf(" %6u %5u %6u %7u\n", st.broken, st.slots, st.waitingTakers, st.waitingPutters);
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    const char* name = SHARED_STATE_NAME;
+    unsigned int intervalMs = 1000;
+    bool once = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else if (std::strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            intervalMs = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--once") == 0) {
+            once = true;
+        } else {
+            std::fprintf(stderr, "Usage: %s [--name /pco_biking] [--interval ms] [--once]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size_t size = 0;
+    const SharedStateHeader* segment = attach(name, size);
+    if (!segment) {
+        std::fprintf(stderr, "Cannot attach to %s (is the simulation running?)\n", name);
+        return 1;
+    }
+
+    SharedStateCopy state;
+    uint64_t lastTimestamp = UINT64_MAX;
+    while (true) {
+        if (!readSharedState(segment, state)) {
+            std::fprintf(stderr, "Writer busy, skipping\n");
+        } else if (state.header.timestampMs != lastTimestamp) {
+            lastTimestamp = state.header.timestampMs;
+            print(state);
+        }
+        if (once) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+
+    munmap(const_cast<SharedStateHeader*>(segment), size);
+    return 0;
+}
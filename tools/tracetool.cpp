@@ -0,0 +1,224 @@
+/*
+ * Auteur : Anthony Pfister, Santiago Sugranes
+ * Date : 09.12.2025
+ * PCO2025 lab05
+ * HEIG
+ */
+
+// Offline tool for the binary traces written with --trace.
+//
+// Usage: pco_trace stats <trace>
+//        pco_trace replay <trace> [--speed factor]
+//        pco_trace diff <trace> <other trace>
+
+#include "eventtrace.h"
+#include "tracereplayer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* KIND_NAMES[] = {"actor", "init", "take", "put", "add", "remove",
+                                   "remove-broken", "ride", "walk", "drive", "gap"};
+
+// Reads a trace or exits
+static void load(TraceReader& trace, const char* path) {
+    std::string error;
+    if (!trace.open(path, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        std::exit(2);
+    }
+}
+
+// One line per record
+static std::string describe(const TraceRecord& r) {
+    char text[160];
+    int n = std::snprintf(text, sizeof(text), "%10.3f s  %-13s site %u", r.timeNs / 1e9,
+                          KIND_NAMES[(size_t)r.kind], r.site);
+    switch (r.kind) {
+    case TraceKind::Take:
+    case TraceKind::Put:
+        std::snprintf(text + n, sizeof(text) - n, " type %u%s", r.value, r.broken ? " broken" : "");
+        break;
+    case TraceKind::RemoveBroken:
+    case TraceKind::Gap:
+        std::snprintf(text + n, sizeof(text) - n, " count %u", r.value);
+        break;
+    case TraceKind::StationInit:
+    case TraceKind::Add:
+    case TraceKind::Remove:
+        for (size_t t = 0; t < Bike::nbBikeTypes; ++t) {
+            n += std::snprintf(text + n, sizeof(text) - n, "%s%u", t ? "/" : " bikes ", r.bikes[t]);
+        }
+        std::snprintf(text + n, sizeof(text) - n, " broken %u", r.broken);
+        break;
+    default:
+        break;
+    }
+    return text;
+}
+
+// Notes that the trace misses records, if it does
+static void printGaps(const char* path, const TraceReader& trace) {
+    if (trace.dropped() > 0) {
+        std::printf("%s: incomplete, %llu records dropped from %.3f s\n", path,
+                    (unsigned long long)trace.dropped(), trace.exactUntilNs() / 1e9);
+    }
+}
+
+// Same station operation, times aside
+static bool sameOperation(const TraceRecord& a, const TraceRecord& b) {
+    return a.kind == b.kind && a.site == b.site && a.value == b.value
+           && a.bikes == b.bikes && a.broken == b.broken;
+}
+
+static bool isStationRecord(const TraceRecord& r) {
+    return r.kind < TraceKind::Ride;
+}
+
+static int stats(const char* path) {
+    TraceReader trace;
+    load(trace, path);
+
+    const std::vector<TraceRecord>& records = trace.records();
+    std::vector<size_t> perKind((size_t)TraceKind::NbKinds, 0);
+    uint32_t streams = 0;
+    for (const TraceRecord& r : records) {
+        perKind[(size_t)r.kind]++;
+        streams = std::max(streams, r.stream + 1);
+    }
+    double seconds = records.empty() ? 0 : records.back().timeNs / 1e9;
+
+    std::printf("%zu records, %u streams, %u sites, %.3f s\n", records.size(), streams,
+                trace.nbSites(), seconds);
+    for (size_t k = 1; k < perKind.size(); ++k) {
+        std::printf("  %-13s %zu\n", KIND_NAMES[k], perKind[k]);
+    }
+    printGaps(path, trace);
+    return 0;
+}
+
+static int replay(const char* path, double speed) {
+    TraceReader trace;
+    load(trace, path);
+
+    TraceReplayer replayer(trace);
+    replayer.setSpeed(speed);
+    replayer.run();
+
+    std::printf("%zu records, %zu mismatches\n", replayer.position(), replayer.mismatches());
+    printGaps(path, trace);
+    const std::vector<BikeStation*>& stations = replayer.stations();
+    for (size_t s = 0; s < stations.size(); ++s) {
+        if (!stations[s]) continue;
+        std::printf("  site %3zu: %zu/%zu bikes, %zu broken\n", s, stations[s]->nbBikes(),
+                    stations[s]->nbSlots(), stations[s]->nbBrokenBikes());
+    }
+    return replayer.mismatches() == 0 ? 0 : 1;
+}
+
+static int diff(const char* pathA, const char* pathB) {
+    TraceReader a, b;
+    load(a, pathA);
+    load(b, pathB);
+    if (a.nbSites() != b.nbSites()) {
+        std::printf("different cities: %u and %u sites\n", a.nbSites(), b.nbSites());
+        return 1;
+    }
+
+    // Operations of each station, in order, up to the first gap of each trace
+    std::vector<std::vector<const TraceRecord*>> opsA(a.nbSites()), opsB(b.nbSites());
+    for (const TraceRecord& r : a.records())
+        if (isStationRecord(r) && r.timeNs < a.exactUntilNs()) opsA[r.site].push_back(&r);
+    for (const TraceRecord& r : b.records())
+        if (isStationRecord(r) && r.timeNs < b.exactUntilNs()) opsB[r.site].push_back(&r);
+    bool exact = a.dropped() == 0 && b.dropped() == 0;
+    printGaps(pathA, a);
+    printGaps(pathB, b);
+
+    // The earliest operation (in the first trace) where a station differs
+    const TraceRecord* firstA = nullptr;
+    const TraceRecord* firstB = nullptr;
+    size_t firstIndex = 0;
+    for (size_t s = 0; s < opsA.size(); ++s) {
+        size_t common = std::min(opsA[s].size(), opsB[s].size());
+        size_t i = 0;
+        while (i < common && sameOperation(*opsA[s][i], *opsB[s][i])) ++i;
+        if (i == opsA[s].size() && i == opsB[s].size()) continue;
+        if (i == common) { // one ends first: maybe only at its gap
+            const TraceReader& shorter = i == opsA[s].size() ? a : b;
+            if (shorter.dropped() > 0) continue;
+        }
+
+        const TraceRecord* ra = i < opsA[s].size() ? opsA[s][i] : nullptr;
+        const TraceRecord* rb = i < opsB[s].size() ? opsB[s][i] : nullptr;
+        uint64_t time = ra ? ra->timeNs : rb->timeNs;
+        uint64_t best = firstA ? firstA->timeNs : firstB ? firstB->timeNs : UINT64_MAX;
+        if (time < best) {
+            firstA = ra;
+            firstB = rb;
+            firstIndex = i;
+        }
+    }
+
+    // Occupancy at the end of both runs, meaningless if records are missing
+    size_t differentSites = 0;
+    if (exact) {
+        TraceReplayer replayA(a), replayB(b);
+        while (replayA.step()) {}
+        while (replayB.step()) {}
+        for (size_t s = 0; s < a.nbSites(); ++s) {
+            BikeStation* sa = replayA.stations()[s];
+            BikeStation* sb = replayB.stations()[s];
+            size_t na = sa ? sa->nbBikes() : 0;
+            size_t nb = sb ? sb->nbBikes() : 0;
+            if (na != nb) {
+                if (differentSites++ == 0) std::printf("final occupancy differs:\n");
+                std::printf("  site %3zu: %zu / %zu bikes\n", s, na, nb);
+            }
+        }
+    }
+
+    if (!firstA && !firstB) {
+        if (exact) {
+            std::printf("same station operations (%zu / %zu records)\n",
+                        a.records().size(), b.records().size());
+        } else {
+            std::printf("same station operations up to the first gap\n");
+        }
+        return differentSites == 0 ? 0 : 1;
+    }
+    std::printf("first divergence, operation %zu of site %u:\n", firstIndex,
+                firstA ? firstA->site : firstB->site);
+    std::printf("  %s\n", firstA ? describe(*firstA).c_str() : "(end of trace)");
+    std::printf("  %s\n", firstB ? describe(*firstB).c_str() : "(end of trace)");
+    return 1;
+}
+
+static int usage() {
+    std::fprintf(stderr, "usage: pco_trace stats <trace>\n"
+                         "       pco_trace replay <trace> [--speed factor]\n"
+                         "       pco_trace diff <trace> <other trace>\n");
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && std::strcmp(argv[1], "stats") == 0) {
+        return stats(argv[2]);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "replay") == 0) {
+        double speed = 0; // as fast as possible
+        if (argc >= 5 && std::strcmp(argv[3], "--speed") == 0) {
+            speed = std::atof(argv[4]);
+        }
+        return replay(argv[2], speed);
+    }
+    if (argc >= 4 && std::strcmp(argv[1], "diff") == 0) {
+        return diff(argv[2], argv[3]);
+    }
+    return usage();
+}